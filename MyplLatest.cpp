@@ -1,42 +1,256 @@
  //-----------
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <ctime>
 #include "token.h"
 #include "mypl_exception.h"
 #include "lexer.h"
 #include "parser.h"
+#include "parallel_parser.h"
+#include "modules.h"
 #include "ast.h"
 #include "type_checker.h"
 #include "interpreter.h"
+#include "profiler.h"
+#include "stats.h"
+#include "ast_cache.h"
+#include "cpp_emitter.h"
+#include "server.h"
+#include "input_scanner.h"
 
 using namespace std;
 
 
+// write <file>.profile (report) and <file>.folded (collapsed stacks)
+void write_profile(Profiler* profiler, const string& file_name)
+{
+  if (!profiler)
+    return;
+  string prefix = file_name == "" ? "mypl" : file_name;
+  profiler->finish();
+  profiler->write_report(prefix + ".profile");
+  profiler->write_collapsed(prefix + ".folded");
+  cerr << "profile written to " << prefix << ".profile and "
+       << prefix << ".folded" << endl;
+  delete profiler;
+}
+
+
+// wall and CPU time of the pipeline phases (for --stats)
+class PhaseTimes
+{
+public:
+  // start timing a phase
+  void start()
+  {
+    wall_start = chrono::steady_clock::now();
+    cpu_start = clock();
+  }
+  // finish timing the phase started last
+  void stop(const string& phase)
+  {
+    double wall = chrono::duration<double, milli>(chrono::steady_clock::now() - wall_start).count();
+    double cpu = 1000.0 * (clock() - cpu_start) / CLOCKS_PER_SEC;
+    phases.push_back({phase, wall, cpu});
+  }
+  // the recorded time of a phase (0 if not run)
+  void get(const string& phase, double& wall, double& cpu) const
+  {
+    wall = cpu = 0;
+    for (const Phase& p : phases)
+      if (p.name == phase) {
+        wall = p.wall_ms;
+        cpu = p.cpu_ms;
+      }
+  }
+  // print the phase times and the run counters to stderr
+  void print_stats(size_t tokens) const;
+private:
+  struct Phase {string name; double wall_ms; double cpu_ms;};
+  vector<Phase> phases;
+  chrono::steady_clock::time_point wall_start;
+  clock_t cpu_start = 0;
+};
+
+
+void PhaseTimes::print_stats(size_t tokens) const
+{
+  ostream& out = cerr;
+  out << fixed << setprecision(3);
+  out << "--- mypl stats ---" << endl;
+  out << left << setw(12) << "phase" << right << setw(14) << "wall (ms)"
+      << setw(14) << "cpu (ms)" << endl;
+  double total_wall = 0, total_cpu = 0;
+  double lex_wall, lex_cpu;
+  get("lex", lex_wall, lex_cpu);
+  for (const Phase& p : phases) {
+    double wall = p.wall_ms, cpu = p.cpu_ms;
+    // parsing re-reads the tokens, so report it without the lexing
+    if (p.name == "parse") {
+      wall = max(0.0, wall - lex_wall);
+      cpu = max(0.0, cpu - lex_cpu);
+    }
+    total_wall += wall;
+    total_cpu += cpu;
+    out << left << setw(12) << p.name << right << setw(14) << wall
+        << setw(14) << cpu << endl;
+  }
+  out << left << setw(12) << "total" << right << setw(14) << total_wall
+      << setw(14) << total_cpu << endl;
+#if MYPL_STATS
+  out << "tokens:                    " << tokens << endl;
+  out << "AST nodes:                 " << mypl_stats.ast_nodes << endl;
+  out << "peak heap objects:         " << mypl_stats.max_heap_objects << endl;
+  out << "peak environments:         " << mypl_stats.max_environments << endl;
+  out << "DataObject allocations:    " << mypl_stats.data_objects << endl;
+  if (mypl_stats.jit_functions or mypl_stats.jit_loops)
+    out << "JIT compiled:              " << mypl_stats.jit_functions
+        << " functions, " << mypl_stats.jit_loops << " loops" << endl;
+#else
+  out << "(counters not available: built with MYPL_STATS=0)" << endl;
+#endif
+}
+
+
 int main(int argc, char* argv[])
 {
-  // use standard input if no input file given
-  istream* input_stream = &cin;
-  if (argc == 2)
-    input_stream = new ifstream(argv[1]);
-
-  // create the lexer
-  Lexer lexer(*input_stream);
-  Parser parser(lexer);
-  // read each token in the file until EOS or error
+  // options: [--profile] [--stats] [--no-cache] [--jit[=threshold]]
+  //          [--emit-cpp] [file]
+  //          --serve SOCKET [--no-cache]
+  //          --connect SOCKET [file]
+  string file_name = "";
+  string serve_socket = "";
+  string connect_socket = "";
+  bool profile = false;
+  bool emit_cpp = false;
+  bool stats = false;
+  bool use_cache = true;
+  size_t jit_threshold = 0;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--profile")
+      profile = true;
+    else if (arg == "--jit")
+      jit_threshold = 1000;
+    else if (arg.compare(0, 6, "--jit=") == 0)
+      jit_threshold = max(1, atoi(arg.c_str() + 6));
+    else if (arg == "--stats")
+      stats = true;
+    else if (arg == "--no-cache")
+      use_cache = false;
+    else if (arg == "--emit-cpp")
+      emit_cpp = true;
+    else if (arg == "--serve" and i + 1 < argc)
+      serve_socket = argv[++i];
+    else if (arg == "--connect" and i + 1 < argc)
+      connect_socket = argv[++i];
+    else
+      file_name = arg;
+  }
+
+  // standard input is read a buffer at a time (see input_scanner.h)
+  static FileInput stdin_buffer(STDIN_FILENO);
+  cin.rdbuf(&stdin_buffer);
+
+  // run scripts for clients, or have a server run this one
+  if (serve_socket != "")
+    return Server(serve_socket, use_cache).serve();
+  if (connect_socket != "")
+    return Server::connect(connect_socket, file_name);
+
+  // read the whole source (use standard input if no input file given)
+  string source;
+  {
+    stringstream buffer;
+    if (file_name != "") {
+      ifstream file_stream(file_name);
+      buffer << file_stream.rdbuf();
+    }
+    else
+      buffer << cin.rdbuf();
+    source = buffer.str();
+  }
+
+  // programs read from a file are cached (checked) in <file>.myplc
+  use_cache = use_cache and file_name != "";
+  string cache_path = file_name + ".myplc";
+  ModuleLoader modules(use_cache);
+
+  PhaseTimes times;
+  size_t tokens = 0;
   Interpreter interpreter;
+  Program ast_root_node;
+  Profiler* profiler = nullptr;
+  Jit* jit = nullptr;
   try {
-    Program ast_root_node;
-    parser.parse(ast_root_node);
-    TypeChecker type_checker;
-    ast_root_node.accept(type_checker);
+    // imported modules (compiled if changed) come first; the program's
+    // cache key covers them
+    times.start();
+    vector<Module*> imports = modules.load_imports(source, file_name);
+    times.stop("modules");
+    uint64_t hash = ModuleLoader::key(source, imports);
+    bool cached = false;
+    if (use_cache) {
+      times.start();
+      cached = load_program_cache(cache_path, hash, ast_root_node);
+      times.stop("load");
+    }
+    if (!cached) {
+      // with --stats the source is lexed once on its own first (to time
+      // the lexer)
+      if (stats) {
+        istringstream lex_stream(source);
+        Lexer lex_only(lex_stream);
+        size_t before = mypl_stats.tokens;
+        times.start();
+        while (lex_only.next_token().type() != EOS)
+          ;
+        times.stop("lex");
+        tokens = mypl_stats.tokens - before;
+      }
+      times.start();
+      parse_source(source, ast_root_node);
+      times.stop("parse");
+      times.start();
+      TypeChecker type_checker;
+      modules.link(type_checker, imports);
+      ast_root_node.accept(type_checker);
+      times.stop("typecheck");
+      if (use_cache)
+        save_program_cache(cache_path, hash, ast_root_node);
+    }
+    modules.link(ast_root_node, imports);
+    // translate to C++ (on standard output) instead of running
+    if (emit_cpp) {
+      CppEmitter emitter(cout);
+      ast_root_node.accept(emitter);
+      return 0;
+    }
+    if (profile) {
+      profiler = new Profiler;
+      interpreter.set_profiler(profiler);
+    }
+    if (jit_threshold) {
+      jit = new Jit(jit_threshold);
+      interpreter.set_jit(jit);
+    }
+    times.start();
     ast_root_node.accept(interpreter);
+    times.stop("execute");
   } catch (MyPLException e) {
     cout << e.to_string() << endl;
+    write_profile(profiler, file_name);
+    if (stats)
+      times.print_stats(tokens);
+    delete jit;
     exit(1);
   }
-  // clean up the input stream
-  if (input_stream != &cin)
-    delete input_stream;
+  delete jit;
+  write_profile(profiler, file_name);
+  if (stats)
+    times.print_stats(tokens);
   return interpreter.return_code();
 }
-
@@ -0,0 +1,50 @@
+//----------------------------------------------------------------------
+// FILE: array_builtins.h
+// DESC: Native array built-ins: push and pop. Both update the array
+//       variable given as their first argument in place (so it is only
+//       copied if it is shared), and are generic in the element type T
+//       (see TypeChecker::match_type). length is in builtins.h.
+//----------------------------------------------------------------------
+
+#ifndef ARRAY_BUILTINS_H
+#define ARRAY_BUILTINS_H
+
+#include "builtins.h"
+
+
+// the array in the variable given as the first argument
+inline Array* array_var(NativeContext& ctx, NativeArgs args)
+{
+  Array* a = args[0].mutable_array_ptr();
+  if (!a)
+    ctx.error("nil array");
+  return a;
+}
+
+// push(xs, x) adds x at the end of xs
+inline void native_push(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  if (!array_var(ctx, args)->push(args[1]))
+    ctx.error("cannot store nil in an array of primitive values");
+  result.set_nil();
+}
+
+// pop(xs) removes and returns the last element of xs
+inline void native_pop(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Array* a = array_var(ctx, args);
+  if (a->size() == 0)
+    ctx.error("pop from an empty array");
+  a->pop(result);
+}
+
+
+// register the array family
+inline void add_array_builtins(BuiltinRegistry& r)
+{
+  r.add("push", StringVec{"array<T>", "T", "nil"}, native_push, true);
+  r.add("pop", StringVec{"array<T>", "T"}, native_pop, true);
+}
+
+
+#endif
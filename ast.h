@@ -11,7 +11,10 @@
 #define AST_H
 
 #include <list>
+#include <memory>
+#include <mutex>
 #include<vector>
+#include "stats.h"
 //----------------------------------------------------------------------
 // Visitor interface
 //----------------------------------------------------------------------
@@ -38,6 +41,10 @@ class IDRValue;
 class NegatedRValue;
 class TransposedRValue;
 class MatrixValue;
+class ArrayValue;
+
+// native built-in function (see builtins.h)
+struct NativeFunction;
 
 
 class Visitor {
@@ -65,6 +72,7 @@ public:
   virtual void visit(NegatedRValue& node) = 0;
 virtual void visit(TransposedRValue& node) = 0;
   virtual void visit(MatrixValue& node) = 0;
+  virtual void visit(ArrayValue& node) = 0;
 };
 
 
@@ -76,6 +84,7 @@ virtual void visit(TransposedRValue& node) = 0;
 class ASTNode
 {
 public:
+  ASTNode() {MYPL_COUNT(++mypl_stats.ast_nodes);}
   virtual ~ASTNode() {};
   virtual void accept(Visitor& v) = 0;
 };
@@ -90,6 +99,8 @@ class Decl : public ASTNode
 // root statement node
 class Stmt : public ASTNode
 {
+public:
+  virtual Token first_token() = 0;
 };
 
 
@@ -120,10 +131,13 @@ public:
   ExprTerm* first = nullptr;    // the first term
   Token* op = nullptr;          // optional operator
   Expr* rest = nullptr;         // expression after operator (if exists)
+  std::string type;             // static type (set by the type checker)
   // cleanup
   ~Expr() {delete first; delete op; delete rest;}
   // get first token
   Token first_token() {return first->first_token();}
+  // the id rvalue if the expression is a bare id path (else nullptr)
+  IDRValue* id_rvalue();
   // visitor access
   void accept(Visitor& v) {v.visit(*this);}
 };
@@ -163,6 +177,7 @@ public:
 class Program : public ASTNode
 {
 public:
+  std::list<Token> imports;     //  paths of imported modules
   std::list<Decl*> decls;       //  list of declarations
   // cleanup memory
   ~Program() {for (Decl* d : decls) delete d;}
@@ -171,6 +186,17 @@ public:
 };
 
 
+// a function body left in a program cache until the function is first
+// used (see ast_cache.h)
+class LazyBody
+{
+public:
+  virtual ~LazyBody() {}
+  virtual void read(std::list<Stmt*>& stmts) = 0;
+  std::once_flag once;
+};
+
+
 class FunDecl : public Decl
 {
 public:
@@ -179,6 +205,10 @@ public:
   Token id;                                // function name
   std::list<FunParam> params;              // function params
   std::list<Stmt*> stmts;                  // function body 
+  std::unique_ptr<LazyBody> lazy_body;     // body still to be read
+  // read the body if it is still in a cache (visitors of the body call
+  // this first; callers on several threads read it once)
+  void read_body() {if (lazy_body) std::call_once(lazy_body->once, [this] {lazy_body->read(stmts);});}
   // cleanup memory
   ~FunDecl() {for (Stmt* s : stmts) delete s;}
   // visitor access
@@ -194,6 +224,8 @@ public:
   Expr* expr = nullptr;         // variable initialization expression
   // cleanup memory
   ~VarDeclStmt() {delete type; delete expr;}
+  // return first token
+  Token first_token() {return id;}
   // visitor access
   void accept(Visitor& v) {v.visit(*this);}
 };
@@ -220,9 +252,15 @@ class AssignStmt : public Stmt
 {
 public:
   std::list<Token> lvalue_list; // lhs as one or more ids
+  std::list<Expr*> indexes;     // array element indexes after the ids
   Expr* expr = nullptr;         // rhs expression
   // cleanup memory
-  ~AssignStmt() {delete expr;}
+  ~AssignStmt() {delete expr; for (Expr* e : indexes) delete e;}
+  // return first token
+  Token first_token() {return lvalue_list.front();}
+  // the expression appended if the statement has the form x = x + e
+  // for a string variable x (else nullptr)
+  Expr* appended();
   // visitor access
   void accept(Visitor& v) {v.visit(*this);}
 };
@@ -234,6 +272,8 @@ public:
   Expr* expr = nullptr;         // return expression
   // cleanup memory
   ~ReturnStmt() {delete expr;}
+  // return first token (of the returned expression)
+  Token first_token() {return expr->first_token();}
   // visitor access
   void accept(Visitor& v) {v.visit(*this);}
 };  
@@ -265,6 +305,8 @@ public:
     for (Stmt* s : body_stmts)
       delete s;
   }
+  // return first token (of the condition)
+  Token first_token() {return if_part->expr->first_token();}
   // visitor access
   void accept(Visitor& v) {v.visit(*this);}
 };  
@@ -277,6 +319,8 @@ public:
   std::list<Stmt*> stmts;       // body statements
   // cleanup memory
   ~WhileStmt() {delete expr; for (Stmt* s : stmts) delete s;}
+  // return first token (of the condition)
+  Token first_token() {return expr->first_token();}
   // visitor access
   void accept(Visitor& v) {v.visit(*this);}
 };  
@@ -286,11 +330,22 @@ class ForStmt : public Stmt
 {
 public:
   Token var_id;                 // loop variable
-  Expr* start;                  // loop start expression
-  Expr* end;                    // loop end expression
+  Expr* start;                  // loop start expression (the array of a for-in loop)
+  Expr* end = nullptr;          // loop end expression (null for a for-in loop)
   std::list<Stmt*> stmts;       // loop body
+  bool parallel = false;        // a parfor loop
+  bool each = false;            // a "for x in xs" loop over an array's elements
+  bool counter_written = true;  // the body may assign the loop variable
+                                // (cleared by the type checker)
+  // outer variables a parfor body reads, and the outer variables it
+  // combines with (variable, reduction built-in) pairs (set by the
+  // type checker)
+  std::list<std::string> shared;
+  std::list<std::pair<std::string,std::string>> reductions;
   // cleanup memory
   ~ForStmt() {delete start; delete end; for (Stmt* s : stmts) delete s;}
+  // return first token
+  Token first_token() {return var_id;}
   // visitor access
   void accept(Visitor& v) {v.visit(*this);}
 };  
@@ -328,6 +383,9 @@ class CallExpr : public RValue, public Stmt
 public:
   Token function_id;            // function name being called
   std::list<Expr*> arg_list;    // call arguments
+  FunDecl* fun_decl = nullptr;  // resolved user-defined function (cached)
+  const NativeFunction* native = nullptr; // resolved built-in (cached)
+  int overload = 0;             // signature of an overloaded built-in (set by the type checker)
   // cleanup memory
   ~CallExpr() {for(Expr* e : arg_list) delete e;}
   // return first token
@@ -341,6 +399,9 @@ class IDRValue : public RValue
 {
 public:
   std::list<Token> path;        // one or more ids (path expression)
+  std::list<Expr*> indexes;     // array element indexes after the path
+  // cleanup memory
+  ~IDRValue() {for (Expr* e : indexes) delete e;}
   // return first token
   Token first_token() {return path.front();}  
   // visitor access
@@ -358,6 +419,19 @@ public:
   Token first_token() {return first_bracket;}
   void accept(Visitor& v) {v.visit(*this);}
 };  
+class ArrayValue : public RValue
+{
+public:
+  Token first_brace;
+  std::list<Expr*> elements;    // one or more element expressions
+  std::string elem_type;        // element type (set by the type checker)
+  // cleanup memory
+  ~ArrayValue() {for (Expr* e : elements) delete e;}
+  // return first token
+  Token first_token() {return first_brace;}
+  // visitor access
+  void accept(Visitor& v) {v.visit(*this);}
+};
 class TransposedRValue : public RValue
 {
 public:
@@ -383,5 +457,28 @@ public:
 };  
 
 
+inline Expr* AssignStmt::appended()
+{
+  if (lvalue_list.size() != 1 or !indexes.empty() or expr->type != "string" or
+      expr->negated or !expr->op or expr->op->type() != PLUS)
+    return nullptr;
+  SimpleTerm* term = dynamic_cast<SimpleTerm*>(expr->first);
+  IDRValue* var = term ? dynamic_cast<IDRValue*>(term->rvalue) : nullptr;
+  if (!var or var->path.size() != 1 or !var->indexes.empty() or
+      var->path.front().lexeme() != lvalue_list.front().lexeme())
+    return nullptr;
+  return expr->rest;
+}
+
+inline IDRValue* Expr::id_rvalue()
+{
+  if (negated or op or rest)
+    return nullptr;
+  SimpleTerm* term = dynamic_cast<SimpleTerm*>(first);
+  if (!term)
+    return nullptr;
+  return dynamic_cast<IDRValue*>(term->rvalue);
+}
+
 
 #endif
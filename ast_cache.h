@@ -0,0 +1,897 @@
+//----------------------------------------------------------------------
+// FILE: ast_cache.h
+// DESC: Precompiled program cache. A type-checked AST is serialized
+//       to a compact binary form (varint-encoded, with lexemes shared
+//       through a string table) tagged with a hash of its source. A
+//       later run of the same source maps the file in and rebuilds the
+//       AST directly, skipping the lexer, parser, and type checker.
+//       Function bodies are written with their size in front, and the
+//       file stays mapped while any of them has not been read: a body
+//       is only rebuilt when its function is first called (or otherwise
+//       visited), so a run starts main after reading the declarations.
+//
+//       A checksum of everything after the header is checked before
+//       anything is decoded, and every count read is bounded by the
+//       bytes left, so a damaged file is recompiled rather than
+//       crashing the run.
+//
+//       file layout: magic "MYPLC", format version, source hash,
+//                    checksum, string table, node stream (Program)
+//----------------------------------------------------------------------
+
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "token.h"
+#include "ast.h"
+#include "mypl_exception.h"
+
+
+// bump when the node encoding changes (older cache files are ignored)
+const uint32_t AST_CACHE_VERSION = 8;
+
+
+// 64-bit FNV-1a hash of size bytes
+inline uint64_t fnv1a_hash(const char* data, size_t size)
+{
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= (unsigned char)data[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// hash of the source text
+inline uint64_t source_hash(const std::string& source)
+{
+  return fnv1a_hash(source.data(), source.size());
+}
+
+
+// node tags in the serialized stream
+enum AstTag : uint8_t {
+  TAG_NULL, TAG_FUN_DECL, TAG_TYPE_DECL, TAG_VAR_DECL, TAG_ASSIGN,
+  TAG_RETURN, TAG_IF, TAG_WHILE, TAG_FOR, TAG_CALL, TAG_EXPR,
+  TAG_SIMPLE_TERM, TAG_COMPLEX_TERM, TAG_SIMPLE_RVALUE, TAG_NEW_RVALUE,
+  TAG_ID_RVALUE, TAG_NEGATED_RVALUE, TAG_TRANSPOSED_RVALUE,
+  TAG_MATRIX_VALUE, TAG_ARRAY_VALUE
+};
+
+
+//----------------------------------------------------------------------
+// WRITER
+//----------------------------------------------------------------------
+
+class AstWriter : public Visitor
+{
+public:
+  // serialize the program (tagged with the given source hash)
+  std::string write(Program& program, uint64_t hash);
+
+  // top-level
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  // rvalues
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+  void visit(MatrixValue& node);
+  void visit(ArrayValue& node);
+  void visit(TransposedRValue& node);
+
+private:
+  std::string nodes;                            // the node stream
+  std::vector<std::string> strings;             // the string table
+  std::unordered_map<std::string,size_t> string_ids;
+  int last_line = 0;                            // lines are delta-coded
+
+  void put_byte(uint8_t b) {nodes += (char)b;}
+  void put_uint(uint64_t v);
+  void put_string(const std::string& s);
+  void put_token(const Token& t);
+  void put_tokens(const std::list<Token>& ts);
+  void put_stmts(const std::list<Stmt*>& stmts);
+  void put_exprs(const std::list<Expr*>& exprs);
+  void put_basic_if(BasicIf* b);
+  // a possibly-null child
+  template<typename T> void put_node(T* node);
+};
+
+
+inline void AstWriter::put_uint(uint64_t v)
+{
+  while (v >= 0x80) {
+    put_byte((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  put_byte((uint8_t)v);
+}
+
+inline void AstWriter::put_string(const std::string& s)
+{
+  auto it = string_ids.find(s);
+  if (it == string_ids.end()) {
+    it = string_ids.insert({s, strings.size()}).first;
+    strings.push_back(s);
+  }
+  put_uint(it->second);
+}
+
+inline void AstWriter::put_token(const Token& t)
+{
+  put_uint(t.type());
+  put_string(t.lexeme());
+  // zigzag-encoded line change (mostly 0 or small)
+  int delta = t.line() - last_line;
+  put_uint(delta >= 0 ? 2 * (uint64_t)delta : 2 * (uint64_t)(-(int64_t)delta) - 1);
+  last_line = t.line();
+  put_uint(t.column());
+}
+
+inline void AstWriter::put_tokens(const std::list<Token>& ts)
+{
+  put_uint(ts.size());
+  for (const Token& t : ts)
+    put_token(t);
+}
+
+inline void AstWriter::put_stmts(const std::list<Stmt*>& stmts)
+{
+  put_uint(stmts.size());
+  for (Stmt* s : stmts)
+    put_node(s);
+}
+
+inline void AstWriter::put_exprs(const std::list<Expr*>& exprs)
+{
+  put_uint(exprs.size());
+  for (Expr* e : exprs)
+    put_node(e);
+}
+
+inline void AstWriter::put_basic_if(BasicIf* b)
+{
+  put_node(b->expr);
+  put_stmts(b->stmts);
+}
+
+template<typename T>
+void AstWriter::put_node(T* node)
+{
+  if (node)
+    node->accept(*this);
+  else
+    put_byte(TAG_NULL);
+}
+
+inline std::string AstWriter::write(Program& program, uint64_t hash)
+{
+  nodes.clear();
+  strings.clear();
+  string_ids.clear();
+  last_line = 0;
+  program.accept(*this);
+  std::string body = nodes;
+  // the string table goes in front of the nodes
+  nodes.clear();
+  put_uint(strings.size());
+  for (const std::string& s : strings) {
+    put_uint(s.size());
+    nodes += s;
+  }
+  std::string payload = nodes + body;
+  // and the header in front of both
+  nodes = "MYPLC";
+  put_uint(AST_CACHE_VERSION);
+  uint64_t checksum = fnv1a_hash(payload.data(), payload.size());
+  for (uint64_t v : {hash, checksum})
+    for (int i = 0; i < 8; ++i)
+      put_byte((uint8_t)(v >> (8 * i)));
+  return nodes + payload;
+}
+
+inline void AstWriter::visit(Program& node)
+{
+  put_uint(node.decls.size());
+  for (Decl* d : node.decls)
+    put_node(d);
+}
+
+inline void AstWriter::visit(FunDecl& node)
+{
+  put_byte(TAG_FUN_DECL);
+  put_token(node.return_type);
+  put_token(node.id);
+  put_uint(node.params.size());
+  for (const FunDecl::FunParam& p : node.params) {
+    put_token(p.id);
+    put_token(p.type);
+  }
+  // the body on its own (its lines coded from the declaration's, which
+  // the next declaration continues from)
+  node.read_body();
+  int line = last_line;
+  std::string outer;
+  outer.swap(nodes);
+  put_stmts(node.stmts);
+  std::string body;
+  body.swap(nodes);
+  nodes.swap(outer);
+  last_line = line;
+  put_uint(body.size());
+  nodes += body;
+}
+
+inline void AstWriter::visit(TypeDecl& node)
+{
+  put_byte(TAG_TYPE_DECL);
+  put_token(node.id);
+  put_uint(node.vdecls.size());
+  for (VarDeclStmt* v : node.vdecls)
+    put_node(v);
+}
+
+inline void AstWriter::visit(VarDeclStmt& node)
+{
+  put_byte(TAG_VAR_DECL);
+  put_byte(node.type != nullptr);
+  if (node.type)
+    put_token(*node.type);
+  put_token(node.id);
+  put_node(node.expr);
+}
+
+inline void AstWriter::visit(AssignStmt& node)
+{
+  put_byte(TAG_ASSIGN);
+  put_tokens(node.lvalue_list);
+  put_exprs(node.indexes);
+  put_node(node.expr);
+}
+
+inline void AstWriter::visit(ReturnStmt& node)
+{
+  put_byte(TAG_RETURN);
+  put_node(node.expr);
+}
+
+inline void AstWriter::visit(IfStmt& node)
+{
+  put_byte(TAG_IF);
+  put_basic_if(node.if_part);
+  put_uint(node.else_ifs.size());
+  for (BasicIf* b : node.else_ifs)
+    put_basic_if(b);
+  put_stmts(node.body_stmts);
+}
+
+inline void AstWriter::visit(WhileStmt& node)
+{
+  put_byte(TAG_WHILE);
+  put_node(node.expr);
+  put_stmts(node.stmts);
+}
+
+inline void AstWriter::visit(ForStmt& node)
+{
+  put_byte(TAG_FOR);
+  put_token(node.var_id);
+  put_node(node.start);
+  put_node(node.end);
+  put_stmts(node.stmts);
+  put_byte(node.parallel);
+  put_byte(node.each);
+  put_byte(node.counter_written);
+  put_uint(node.shared.size());
+  for (const std::string& name : node.shared)
+    put_string(name);
+  put_uint(node.reductions.size());
+  for (const auto& r : node.reductions) {
+    put_string(r.first);
+    put_string(r.second);
+  }
+}
+
+inline void AstWriter::visit(Expr& node)
+{
+  put_byte(TAG_EXPR);
+  put_byte(node.negated);
+  put_node(node.first);
+  put_byte(node.op != nullptr);
+  if (node.op)
+    put_token(*node.op);
+  put_node(node.rest);
+  put_string(node.type);
+}
+
+inline void AstWriter::visit(SimpleTerm& node)
+{
+  put_byte(TAG_SIMPLE_TERM);
+  put_node(node.rvalue);
+}
+
+inline void AstWriter::visit(ComplexTerm& node)
+{
+  put_byte(TAG_COMPLEX_TERM);
+  put_node(node.expr);
+}
+
+inline void AstWriter::visit(SimpleRValue& node)
+{
+  put_byte(TAG_SIMPLE_RVALUE);
+  put_token(node.value);
+}
+
+inline void AstWriter::visit(NewRValue& node)
+{
+  put_byte(TAG_NEW_RVALUE);
+  put_token(node.type_id);
+}
+
+inline void AstWriter::visit(CallExpr& node)
+{
+  put_byte(TAG_CALL);
+  put_token(node.function_id);
+  put_uint(node.overload);
+  put_uint(node.arg_list.size());
+  for (Expr* e : node.arg_list)
+    put_node(e);
+}
+
+inline void AstWriter::visit(IDRValue& node)
+{
+  put_byte(TAG_ID_RVALUE);
+  put_tokens(node.path);
+  put_exprs(node.indexes);
+}
+
+inline void AstWriter::visit(NegatedRValue& node)
+{
+  put_byte(TAG_NEGATED_RVALUE);
+  put_node(node.expr);
+}
+
+inline void AstWriter::visit(MatrixValue& node)
+{
+  put_byte(TAG_MATRIX_VALUE);
+  put_token(node.first_bracket);
+  put_uint(node.M.size());
+  for (const std::vector<Expr*>& row : node.M) {
+    put_uint(row.size());
+    for (Expr* e : row)
+      put_node(e);
+  }
+}
+
+inline void AstWriter::visit(ArrayValue& node)
+{
+  put_byte(TAG_ARRAY_VALUE);
+  put_token(node.first_brace);
+  put_exprs(node.elements);
+  put_string(node.elem_type);
+}
+
+inline void AstWriter::visit(TransposedRValue& node)
+{
+  put_byte(TAG_TRANSPOSED_RVALUE);
+  put_node(node.expr);
+}
+
+
+//----------------------------------------------------------------------
+// READER
+//----------------------------------------------------------------------
+
+class AstReader
+{
+public:
+  // reader over an in-memory cache image
+  AstReader(const char* data, size_t size) : pos(data), end(data + size) {}
+
+  // leave function bodies in the image until first used; the owner
+  // keeps the image in place until the last of them is read
+  void leave_bodies(std::shared_ptr<const void> owner) {image = std::move(owner);}
+
+  // rebuild the program if the image is a current-format cache of the
+  // source with the given hash (returns false, leaving the program
+  // empty, otherwise)
+  bool read(Program& program, uint64_t hash);
+
+private:
+  // thrown on a truncated or malformed image
+  class Corrupt : public std::exception {};
+
+  // a body left in the image
+  class ImageBody : public LazyBody
+  {
+  public:
+    ImageBody(const AstReader& reader, size_t size);
+    void read(std::list<Stmt*>& stmts);
+  private:
+    std::shared_ptr<const void> image;
+    std::shared_ptr<std::vector<std::string>> strings;
+    const char* data;
+    size_t size;
+    int line;
+  };
+
+  const char* pos;
+  const char* end;
+  std::shared_ptr<std::vector<std::string>> strings {new std::vector<std::string>};
+  int last_line = 0;
+  std::shared_ptr<const void> image;      // set if bodies are left
+
+  uint8_t get_byte();
+  uint64_t get_uint();
+  uint64_t get_word();
+  // a count of items (each at least a byte long, so no more than the
+  // bytes left)
+  uint64_t get_count();
+  const std::string& get_string();
+  Token get_token();
+  void get_tokens(std::list<Token>& ts);
+  void get_stmts(std::list<Stmt*>& stmts);
+  void get_exprs(std::list<Expr*>& exprs);
+  BasicIf* get_basic_if();
+  Decl* get_decl();
+  Stmt* get_stmt();
+  VarDeclStmt* get_var_decl();
+  Expr* get_expr();
+  Expr* get_optional_expr();
+  ExprTerm* get_term();
+  RValue* get_rvalue();
+  CallExpr* get_call();
+};
+
+
+inline uint8_t AstReader::get_byte()
+{
+  if (pos == end)
+    throw Corrupt();
+  return (uint8_t)*pos++;
+}
+
+inline uint64_t AstReader::get_uint()
+{
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    uint8_t b = get_byte();
+    v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return v;
+  }
+  throw Corrupt();
+}
+
+inline uint64_t AstReader::get_word()
+{
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i)
+    v |= (uint64_t)get_byte() << (8 * i);
+  return v;
+}
+
+inline uint64_t AstReader::get_count()
+{
+  uint64_t n = get_uint();
+  if (n > (uint64_t)(end - pos))
+    throw Corrupt();
+  return n;
+}
+
+inline const std::string& AstReader::get_string()
+{
+  uint64_t id = get_uint();
+  if (id >= strings->size())
+    throw Corrupt();
+  return (*strings)[id];
+}
+
+inline Token AstReader::get_token()
+{
+  uint64_t type = get_uint();
+  // (IMPORT is the last token type)
+  if (type > IMPORT)
+    throw Corrupt();
+  const std::string& lexeme = get_string();
+  uint64_t zigzag = get_uint();
+  int line = last_line + (zigzag & 1 ? -(int)((zigzag + 1) / 2) : (int)(zigzag / 2));
+  last_line = line;
+  int column = get_uint();
+  return Token((TokenType)type, lexeme, line, column);
+}
+
+inline void AstReader::get_tokens(std::list<Token>& ts)
+{
+  for (uint64_t n = get_count(); n > 0; --n)
+    ts.push_back(get_token());
+}
+
+inline void AstReader::get_stmts(std::list<Stmt*>& stmts)
+{
+  for (uint64_t n = get_count(); n > 0; --n)
+    stmts.push_back(get_stmt());
+}
+
+inline void AstReader::get_exprs(std::list<Expr*>& exprs)
+{
+  for (uint64_t n = get_count(); n > 0; --n)
+    exprs.push_back(get_expr());
+}
+
+inline BasicIf* AstReader::get_basic_if()
+{
+  BasicIf* b = new BasicIf;
+  b->expr = get_expr();
+  get_stmts(b->stmts);
+  return b;
+}
+
+inline Decl* AstReader::get_decl()
+{
+  uint8_t tag = get_byte();
+  if (tag == TAG_FUN_DECL) {
+    FunDecl* f = new FunDecl;
+    f->return_type = get_token();
+    f->id = get_token();
+    for (uint64_t n = get_count(); n > 0; --n) {
+      FunDecl::FunParam p;
+      p.id = get_token();
+      p.type = get_token();
+      f->params.push_back(p);
+    }
+    uint64_t size = get_uint();
+    if ((uint64_t)(end - pos) < size)
+      throw Corrupt();
+    if (image) {
+      f->lazy_body.reset(new ImageBody(*this, size));
+      pos += size;
+    }
+    else {
+      const char* body_end = pos + size;
+      int line = last_line;
+      get_stmts(f->stmts);
+      if (pos != body_end)
+        throw Corrupt();
+      last_line = line;
+    }
+    return f;
+  }
+  if (tag == TAG_TYPE_DECL) {
+    TypeDecl* t = new TypeDecl;
+    t->id = get_token();
+    for (uint64_t n = get_count(); n > 0; --n)
+      t->vdecls.push_back(get_var_decl());
+    return t;
+  }
+  throw Corrupt();
+}
+
+inline VarDeclStmt* AstReader::get_var_decl()
+{
+  if (get_byte() != TAG_VAR_DECL)
+    throw Corrupt();
+  VarDeclStmt* v = new VarDeclStmt;
+  if (get_byte())
+    v->type = new Token(get_token());
+  v->id = get_token();
+  v->expr = get_expr();
+  return v;
+}
+
+inline Stmt* AstReader::get_stmt()
+{
+  uint8_t tag = get_byte();
+  switch (tag) {
+  case TAG_VAR_DECL:
+    --pos;
+    return get_var_decl();
+  case TAG_ASSIGN: {
+    AssignStmt* a = new AssignStmt;
+    get_tokens(a->lvalue_list);
+    get_exprs(a->indexes);
+    a->expr = get_expr();
+    return a;
+  }
+  case TAG_RETURN: {
+    ReturnStmt* r = new ReturnStmt;
+    r->expr = get_expr();
+    return r;
+  }
+  case TAG_IF: {
+    IfStmt* i = new IfStmt;
+    i->if_part = get_basic_if();
+    for (uint64_t n = get_count(); n > 0; --n)
+      i->else_ifs.push_back(get_basic_if());
+    get_stmts(i->body_stmts);
+    return i;
+  }
+  case TAG_WHILE: {
+    WhileStmt* w = new WhileStmt;
+    w->expr = get_expr();
+    get_stmts(w->stmts);
+    return w;
+  }
+  case TAG_FOR: {
+    ForStmt* f = new ForStmt;
+    f->var_id = get_token();
+    f->start = get_expr();
+    // (a for-each loop has no end)
+    f->end = get_optional_expr();
+    get_stmts(f->stmts);
+    f->parallel = get_byte();
+    f->each = get_byte();
+    f->counter_written = get_byte();
+    if (!f->end and !f->each)
+      throw Corrupt();
+    for (uint64_t n = get_count(); n > 0; --n)
+      f->shared.push_back(get_string());
+    for (uint64_t n = get_count(); n > 0; --n) {
+      std::string var = get_string();
+      f->reductions.push_back({var, get_string()});
+    }
+    return f;
+  }
+  case TAG_CALL:
+    --pos;
+    return get_call();
+  }
+  throw Corrupt();
+}
+
+// an expression the interpreter evaluates (never null)
+inline Expr* AstReader::get_expr()
+{
+  if (get_byte() != TAG_EXPR)
+    throw Corrupt();
+  Expr* e = new Expr;
+  e->negated = get_byte();
+  e->first = get_term();
+  if (get_byte())
+    e->op = new Token(get_token());
+  e->rest = get_optional_expr();
+  e->type = get_string();
+  return e;
+}
+
+inline Expr* AstReader::get_optional_expr()
+{
+  if (pos < end and *pos == TAG_NULL) {
+    ++pos;
+    return nullptr;
+  }
+  return get_expr();
+}
+
+inline ExprTerm* AstReader::get_term()
+{
+  uint8_t tag = get_byte();
+  if (tag == TAG_SIMPLE_TERM) {
+    SimpleTerm* t = new SimpleTerm;
+    t->rvalue = get_rvalue();
+    return t;
+  }
+  if (tag == TAG_COMPLEX_TERM) {
+    ComplexTerm* t = new ComplexTerm;
+    t->expr = get_expr();
+    return t;
+  }
+  throw Corrupt();
+}
+
+inline RValue* AstReader::get_rvalue()
+{
+  uint8_t tag = get_byte();
+  switch (tag) {
+  case TAG_SIMPLE_RVALUE: {
+    SimpleRValue* r = new SimpleRValue;
+    r->value = get_token();
+    return r;
+  }
+  case TAG_NEW_RVALUE: {
+    NewRValue* r = new NewRValue;
+    r->type_id = get_token();
+    return r;
+  }
+  case TAG_CALL:
+    --pos;
+    return get_call();
+  case TAG_ID_RVALUE: {
+    IDRValue* r = new IDRValue;
+    get_tokens(r->path);
+    get_exprs(r->indexes);
+    return r;
+  }
+  case TAG_NEGATED_RVALUE: {
+    NegatedRValue* r = new NegatedRValue;
+    r->expr = get_expr();
+    return r;
+  }
+  case TAG_TRANSPOSED_RVALUE: {
+    TransposedRValue* r = new TransposedRValue;
+    r->expr = get_expr();
+    return r;
+  }
+  case TAG_MATRIX_VALUE: {
+    MatrixValue* m = new MatrixValue;
+    m->first_bracket = get_token();
+    m->M.resize(get_count());
+    for (std::vector<Expr*>& row : m->M) {
+      row.resize(get_count());
+      for (Expr*& e : row)
+        e = get_expr();
+    }
+    return m;
+  }
+  case TAG_ARRAY_VALUE: {
+    ArrayValue* a = new ArrayValue;
+    a->first_brace = get_token();
+    get_exprs(a->elements);
+    a->elem_type = get_string();
+    return a;
+  }
+  }
+  throw Corrupt();
+}
+
+inline CallExpr* AstReader::get_call()
+{
+  if (get_byte() != TAG_CALL)
+    throw Corrupt();
+  CallExpr* c = new CallExpr;
+  c->function_id = get_token();
+  c->overload = (int)get_uint();
+  for (uint64_t n = get_count(); n > 0; --n)
+    c->arg_list.push_back(get_expr());
+  return c;
+}
+
+inline bool AstReader::read(Program& program, uint64_t hash)
+{
+  try {
+    if (end - pos < 5 or memcmp(pos, "MYPLC", 5) != 0)
+      return false;
+    pos += 5;
+    if (get_uint() != AST_CACHE_VERSION)
+      return false;
+    if (get_word() != hash)
+      return false;
+    uint64_t checksum = get_word();
+    if (fnv1a_hash(pos, end - pos) != checksum)
+      return false;
+    strings->resize(get_count());
+    for (std::string& s : *strings) {
+      uint64_t n = get_uint();
+      if ((uint64_t)(end - pos) < n)
+        throw Corrupt();
+      s.assign(pos, n);
+      pos += n;
+    }
+    for (uint64_t n = get_count(); n > 0; --n)
+      program.decls.push_back(get_decl());
+    if (pos == end)
+      return true;
+  }
+  catch (const Corrupt&) {
+  }
+  // (sizes that passed the bounds but not the allocator)
+  catch (const std::bad_alloc&) {
+  }
+  catch (const std::length_error&) {
+  }
+  // drop what was read so the caller can recompile into the program
+  // (a partly read declaration is leaked; corrupt caches are rare)
+  for (Decl* d : program.decls)
+    delete d;
+  program.decls.clear();
+  return false;
+}
+
+
+inline AstReader::ImageBody::ImageBody(const AstReader& reader, size_t size)
+  : image(reader.image), strings(reader.strings), data(reader.pos), size(size),
+    line(reader.last_line)
+{
+}
+
+inline void AstReader::ImageBody::read(std::list<Stmt*>& stmts)
+{
+  AstReader reader(data, size);
+  reader.strings = strings;
+  reader.last_line = line;
+  try {
+    reader.get_stmts(stmts);
+    if (reader.pos != reader.end)
+      throw Corrupt();
+  }
+  catch (const Corrupt&) {
+    throw MyPLException(RUNTIME, "corrupt program cache (run with --no-cache)");
+  }
+  catch (const std::bad_alloc&) {
+    throw MyPLException(RUNTIME, "corrupt program cache (run with --no-cache)");
+  }
+  catch (const std::length_error&) {
+    throw MyPLException(RUNTIME, "corrupt program cache (run with --no-cache)");
+  }
+  // the image is no longer needed for this body
+  image.reset();
+}
+
+
+//----------------------------------------------------------------------
+// CACHE FILES
+//----------------------------------------------------------------------
+
+// load the program from the cache file if it holds the given source
+// hash (on false the program is left empty)
+inline bool load_program_cache(const std::string& path, uint64_t hash, Program& program)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  bool loaded = false;
+  if (fstat(fd, &info) == 0 and info.st_size > 0) {
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      // unmapped once the last function body left in it is read
+      size_t size = info.st_size;
+      std::shared_ptr<const void> mapping(data, [size](const void* p) {munmap((void*)p, size);});
+      AstReader reader((const char*)data, size);
+      reader.leave_bodies(mapping);
+      loaded = reader.read(program, hash);
+    }
+  }
+  close(fd);
+  return loaded;
+}
+
+// write the (type-checked) program to the cache file, replacing it
+// atomically; failures are ignored (the cache is only an optimization)
+inline void save_program_cache(const std::string& path, uint64_t hash, Program& program)
+{
+  AstWriter writer;
+  std::string image = writer.write(program, hash);
+  // (a server may save from several threads)
+  static std::atomic<unsigned> saves {0};
+  std::string tmp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(saves++);
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (!f)
+    return;
+  bool ok = fwrite(image.data(), 1, image.size(), f) == image.size();
+  ok = fclose(f) == 0 and ok;
+  if (!ok or rename(tmp.c_str(), path.c_str()) != 0)
+    remove(tmp.c_str());
+}
+
+
+#endif
@@ -0,0 +1,686 @@
+//----------------------------------------------------------------------
+// FILE: bench.cpp
+// DESC: Benchmark harness for the MyPL pipeline. Generates scaled-up
+//       MyPL workloads and times each phase separately (lexing,
+//       parsing, type checking, interpreting), reporting ns/op,
+//       allocations per op, and peak RSS as JSON. Each workload runs
+//       in its own child process so peak RSS (and any crash) is
+//       attributed to that workload alone. With --baseline, results
+//       are compared against an earlier run and regressions beyond
+//       the tolerance make the harness exit non-zero.
+//
+//       usage: mypl_bench [--scale N] [--reps N] [--workload NAME]
+//                         [--out FILE] [--baseline FILE]
+//                         [--tolerance FRACTION] [--emit DIR] [--list]
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "token.h"
+#include "mypl_exception.h"
+#include "lexer.h"
+#include "parser.h"
+#include "parallel_parser.h"
+#include "ast.h"
+#include "type_checker.h"
+#include "interpreter.h"
+
+using namespace std;
+
+
+//----------------------------------------------------------------------
+// ALLOCATION COUNTING
+//----------------------------------------------------------------------
+
+// (counted from the thread pool's threads as well, so atomic)
+static atomic<size_t> alloc_count(0);
+static atomic<size_t> alloc_bytes(0);
+
+// every form of new and delete is replaced, so that all memory comes
+// from malloc (or posix_memalign) and goes back to free
+static void* counted_alloc(size_t n, size_t align = 0) noexcept
+{
+  alloc_count.fetch_add(1, memory_order_relaxed);
+  alloc_bytes.fetch_add(n, memory_order_relaxed);
+  if (n == 0)
+    n = 1;
+  if (align <= alignof(max_align_t))
+    return malloc(n);
+  void* p = nullptr;
+  return posix_memalign(&p, align, n) == 0 ? p : nullptr;
+}
+
+static void* checked_alloc(size_t n, size_t align = 0)
+{
+  void* p = counted_alloc(n, align);
+  if (!p)
+    throw bad_alloc();
+  return p;
+}
+
+void* operator new(size_t n) {return checked_alloc(n);}
+void* operator new[](size_t n) {return checked_alloc(n);}
+void* operator new(size_t n, align_val_t a) {return checked_alloc(n, (size_t)a);}
+void* operator new[](size_t n, align_val_t a) {return checked_alloc(n, (size_t)a);}
+void* operator new(size_t n, const nothrow_t&) noexcept {return counted_alloc(n);}
+void* operator new[](size_t n, const nothrow_t&) noexcept {return counted_alloc(n);}
+void* operator new(size_t n, align_val_t a, const nothrow_t&) noexcept {return counted_alloc(n, (size_t)a);}
+void* operator new[](size_t n, align_val_t a, const nothrow_t&) noexcept {return counted_alloc(n, (size_t)a);}
+
+void operator delete(void* p) noexcept {free(p);}
+void operator delete[](void* p) noexcept {free(p);}
+void operator delete(void* p, size_t) noexcept {free(p);}
+void operator delete[](void* p, size_t) noexcept {free(p);}
+void operator delete(void* p, align_val_t) noexcept {free(p);}
+void operator delete[](void* p, align_val_t) noexcept {free(p);}
+void operator delete(void* p, size_t, align_val_t) noexcept {free(p);}
+void operator delete[](void* p, size_t, align_val_t) noexcept {free(p);}
+void operator delete(void* p, const nothrow_t&) noexcept {free(p);}
+void operator delete[](void* p, const nothrow_t&) noexcept {free(p);}
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept {free(p);}
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept {free(p);}
+
+
+//----------------------------------------------------------------------
+// WORKLOADS
+//----------------------------------------------------------------------
+
+struct Workload {
+  string name;
+  string source;
+};
+
+// repeated calls down a deep recursion, plus naive fib
+string recursion_workload(int scale)
+{
+  return
+    "fun int depth(n: int)\n"
+    "  if n <= 0 then\n"
+    "    return 0\n"
+    "  end\n"
+    "  return 1 + depth(n - 1)\n"
+    "end\n\n"
+    "fun int fib(n: int)\n"
+    "  if n <= 1 then\n"
+    "    return n\n"
+    "  end\n"
+    "  return fib(n - 1) + fib(n - 2)\n"
+    "end\n\n"
+    "fun int main()\n"
+    "  var total = 0\n"
+    "  for i = 1 to " + to_string(20 * scale) + " do\n"
+    "    total = total + depth(500)\n"
+    "  end\n"
+    "  total = total + fib(" + to_string(15 + scale) + ")\n"
+    "  return 0\n"
+    "end\n";
+}
+
+// nested for loops and a while loop over integer arithmetic
+string int_loops_workload(int scale)
+{
+  return
+    "fun int main()\n"
+    "  var total = 0\n"
+    "  for i = 0 to " + to_string(200 * scale) + " do\n"
+    "    for j = 0 to 200 do\n"
+    "      total = total + (i * j) % 7\n"
+    "    end\n"
+    "  end\n"
+    "  var k = 0\n"
+    "  while k < " + to_string(20000 * scale) + " do\n"
+    "    k = k + 1\n"
+    "  end\n"
+    "  return 0\n"
+    "end\n";
+}
+
+// growing a string by repeated concatenation
+string strings_workload(int scale)
+{
+  return
+    "fun int main()\n"
+    "  var s = \"\"\n"
+    "  for i = 1 to " + to_string(2000 * scale) + " do\n"
+    "    s = s + \"ab\" + itos(i)\n"
+    "  end\n"
+    "  var n = length(s)\n"
+    "  return 0\n"
+    "end\n";
+}
+
+// scanning, searching, and splitting a long string
+string text_workload(int scale)
+{
+  return
+    "fun int main()\n"
+    "  var words = new array<string>\n"
+    "  for i = 1 to " + to_string(2000 * scale) + " do\n"
+    "    push(words, \"w\" + itos(i % 97))\n"
+    "  end\n"
+    "  var text = join(words, \" \")\n"
+    "  var count = 0\n"
+    "  for i = 0 to length(text) - 1 do\n"
+    "    if get(i, text) == 'w' then\n"
+    "      count = count + 1\n"
+    "    end\n"
+    "  end\n"
+    "  var pos = find(text, \"w9\")\n"
+    "  while pos >= 0 do\n"
+    "    pos = find(text, \"w9\", pos + 1)\n"
+    "  end\n"
+    "  var n = length(split(replace(text, \"w1\", \"v\"), \" \"))\n"
+    "  return 0\n"
+    "end\n";
+}
+
+// building and walking a UDT linked list
+string linked_list_workload(int scale)
+{
+  string n = to_string(2000 * scale);
+  return
+    "type Node\n"
+    "  var val = 0\n"
+    "  var next: Node = nil\n"
+    "end\n\n"
+    "fun int main()\n"
+    "  var head: Node = nil\n"
+    "  for i = 1 to " + n + " do\n"
+    "    var n = new Node\n"
+    "    n.val = i\n"
+    "    n.next = head\n"
+    "    head = n\n"
+    "  end\n"
+    "  var total = 0\n"
+    "  var p = head\n"
+    "  for i = 1 to " + n + " do\n"
+    "    total = total + p.val\n"
+    "    p = p.next\n"
+    "  end\n"
+    "  return 0\n"
+    "end\n";
+}
+
+// recursive inserts into and traversal of a UDT binary search tree
+string tree_workload(int scale)
+{
+  return
+    "type Tree\n"
+    "  var val = 0\n"
+    "  var left: Tree = nil\n"
+    "  var right: Tree = nil\n"
+    "end\n\n"
+    "fun Tree insert(t: Tree, v: int)\n"
+    "  if t == nil then\n"
+    "    var n = new Tree\n"
+    "    n.val = v\n"
+    "    return n\n"
+    "  end\n"
+    "  if v < t.val then\n"
+    "    t.left = insert(t.left, v)\n"
+    "  else\n"
+    "    t.right = insert(t.right, v)\n"
+    "  end\n"
+    "  return t\n"
+    "end\n\n"
+    "fun int sum(t: Tree)\n"
+    "  if t == nil then\n"
+    "    return 0\n"
+    "  end\n"
+    "  return t.val + sum(t.left) + sum(t.right)\n"
+    "end\n\n"
+    "fun int main()\n"
+    "  var root: Tree = nil\n"
+    "  var k = 1\n"
+    "  for i = 1 to " + to_string(500 * scale) + " do\n"
+    "    k = (k * 75 + 74) % 65537\n"
+    "    root = insert(root, k)\n"
+    "  end\n"
+    "  var s = sum(root)\n"
+    "  return 0\n"
+    "end\n";
+}
+
+// dense matrix products, solves, reductions, and element loops
+string matrix_workload(int scale)
+{
+  return
+    "fun int main()\n"
+    "  var n = " + to_string(40 * scale) + "\n"
+    "  var A = m_random(n, n)\n"
+    "  var B = A * A\n"
+    "  var b = m_random(n, 1)\n"
+    "  var x = m_solve(A, b)\n"
+    "  var C = m_zeros(n, n)\n"
+    "  for i = 0 to n - 1 do\n"
+    "    for j = 0 to n - 1 do\n"
+    "      m_set(C, i, j, m_get(A, i, j) + m_get(B, j, i))\n"
+    "    end\n"
+    "  end\n"
+    "  var d = m_norm(C) + m_det(A) + m_sum(x)\n"
+    "  return 0\n"
+    "end\n";
+}
+
+// filling, indexing, and iterating over arrays
+string arrays_workload(int scale)
+{
+  return
+    "fun int main()\n"
+    "  var xs = new array<int>\n"
+    "  for i = 0 to " + to_string(20000 * scale) + " do\n"
+    "    push(xs, i % 97)\n"
+    "  end\n"
+    "  for i = 1 to length(xs) - 1 do\n"
+    "    xs[i] = xs[i] + xs[i - 1]\n"
+    "  end\n"
+    "  var total = 0\n"
+    "  for x in xs do\n"
+    "    total = total + x % 13\n"
+    "  end\n"
+    "  while length(xs) > 0 do\n"
+    "    total = total + pop(xs) % 3\n"
+    "  end\n"
+    "  return 0\n"
+    "end\n";
+}
+
+// string keyed map updates, lookups, and removals
+string maps_workload(int scale)
+{
+  return
+    "fun int main()\n"
+    "  var counts = new map<string,int>\n"
+    "  for i = 0 to " + to_string(20000 * scale) + " do\n"
+    "    var k = \"k\" + itos(i % 1009)\n"
+    "    if has(counts, k) then\n"
+    "      put(counts, k, get(counts, k) + 1)\n"
+    "    else\n"
+    "      put(counts, k, 1)\n"
+    "    end\n"
+    "  end\n"
+    "  var total = 0\n"
+    "  for k in keys(counts) do\n"
+    "    total = total + get(counts, k)\n"
+    "    remove(counts, k)\n"
+    "  end\n"
+    "  return 0\n"
+    "end\n";
+}
+
+// a large program with many small functions (front-end heavy)
+string large_source_workload(int scale)
+{
+  string s;
+  int count = 400 * scale;
+  for (int i = 0; i < count; ++i) {
+    string f = "f" + to_string(i);
+    s += "fun int " + f + "(x: int, y: double)\n";
+    s += "  var a = x * 2 + 1\n";
+    s += "  var b = y / 2.0\n";
+    s += "  var c = \"name\" + itos(a)\n";
+    s += "  if a > 10 then\n";
+    s += "    a = a - 1\n";
+    s += "  elseif a == 3 then\n";
+    s += "    a = a + 1\n";
+    s += "  else\n";
+    s += "    a = 0\n";
+    s += "  end\n";
+    s += "  while a > 0 do\n";
+    s += "    a = a - 1\n";
+    s += "  end\n";
+    s += "  return a\n";
+    s += "end\n\n";
+  }
+  s += "fun int main()\n";
+  s += "  var total = 0\n";
+  for (int i = 0; i < count; ++i)
+    s += "  total = total + f" + to_string(i) + "(" + to_string(i % 13) + ", 1.5)\n";
+  s += "  return 0\n";
+  s += "end\n";
+  return s;
+}
+
+vector<Workload> workloads(int scale)
+{
+  return {
+    {"recursion", recursion_workload(scale)},
+    {"int_loops", int_loops_workload(scale)},
+    {"strings", strings_workload(scale)},
+    {"text", text_workload(scale)},
+    {"linked_list", linked_list_workload(scale)},
+    {"tree", tree_workload(scale)},
+    {"matrix", matrix_workload(scale)},
+    {"arrays", arrays_workload(scale)},
+    {"maps", maps_workload(scale)},
+    {"large_source", large_source_workload(scale)},
+  };
+}
+
+
+//----------------------------------------------------------------------
+// MEASUREMENT
+//----------------------------------------------------------------------
+
+struct PhaseResult {
+  string phase;
+  string op;                    // what one op is ("token" or "run")
+  size_t ops_per_run = 0;
+  double ns_per_op = 0;         // median over the reps
+  double min_ns_per_op = 0;
+  double allocs_per_op = 0;
+  double bytes_per_op = 0;
+};
+
+// run f (which returns the number of ops it performed) reps times
+// after one warmup run
+PhaseResult measure(const string& phase, const string& op, int reps,
+                    const function<size_t()>& f)
+{
+  PhaseResult result;
+  result.phase = phase;
+  result.op = op;
+  f();
+  vector<double> times;
+  size_t allocs = 0;
+  size_t bytes = 0;
+  size_t ops = 0;
+  for (int i = 0; i < reps; ++i) {
+    size_t start_allocs = alloc_count.load(memory_order_relaxed);
+    size_t start_bytes = alloc_bytes.load(memory_order_relaxed);
+    auto start = chrono::steady_clock::now();
+    ops = f();
+    auto end = chrono::steady_clock::now();
+    allocs += alloc_count.load(memory_order_relaxed) - start_allocs;
+    bytes += alloc_bytes.load(memory_order_relaxed) - start_bytes;
+    double ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    times.push_back(ns / max<size_t>(ops, 1));
+  }
+  sort(times.begin(), times.end());
+  result.ops_per_run = ops;
+  result.ns_per_op = times[times.size() / 2];
+  result.min_ns_per_op = times.front();
+  result.allocs_per_op = (double)allocs / reps / max<size_t>(ops, 1);
+  result.bytes_per_op = (double)bytes / reps / max<size_t>(ops, 1);
+  return result;
+}
+
+// time every phase of one workload
+vector<PhaseResult> run_workload(const Workload& w, int reps)
+{
+  vector<PhaseResult> results;
+
+  // lexer: one op per token (Lexer::next_token call)
+  results.push_back(measure("lex", "token", reps, [&]() {
+    istringstream in(w.source);
+    Lexer lexer(in);
+    size_t tokens = 1;
+    while (lexer.next_token().type() != EOS)
+      ++tokens;
+    return tokens;
+  }));
+
+  // parser (including the lexing it drives): one op per program
+  results.push_back(measure("parse", "run", reps, [&]() {
+    Program program;
+    parse_source(w.source, program);
+    return (size_t)1;
+  }));
+
+  // the type checker and interpreter share one parsed program
+  Program program;
+  parse_source(w.source, program);
+
+  results.push_back(measure("typecheck", "run", reps, [&]() {
+    TypeChecker type_checker;
+    program.accept(type_checker);
+    return (size_t)1;
+  }));
+
+  results.push_back(measure("interpret", "run", reps, [&]() {
+    Interpreter interpreter;
+    program.accept(interpreter);
+    return (size_t)1;
+  }));
+
+  return results;
+}
+
+// peak resident set size of this process (KB)
+long peak_rss_kb()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+string json_string(const string& s)
+{
+  string out = "\"";
+  for (char c : s) {
+    if (c == '"' or c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out + "\"";
+}
+
+string result_json(const string& workload, const PhaseResult& r, long rss_kb)
+{
+  ostringstream out;
+  out.precision(6);
+  out << "{\"workload\": " << json_string(workload)
+      << ", \"phase\": " << json_string(r.phase)
+      << ", \"op\": " << json_string(r.op)
+      << ", \"ops_per_run\": " << r.ops_per_run
+      << ", \"ns_per_op\": " << fixed << r.ns_per_op
+      << ", \"min_ns_per_op\": " << r.min_ns_per_op
+      << ", \"allocs_per_op\": " << r.allocs_per_op
+      << ", \"bytes_per_op\": " << r.bytes_per_op
+      << ", \"peak_rss_kb\": " << rss_kb << "}";
+  return out.str();
+}
+
+// run one workload in a child process, returning its JSON result lines
+vector<string> run_isolated(const Workload& w, int reps)
+{
+  int fds[2];
+  if (pipe(fds) != 0) {
+    cerr << "pipe failed" << endl;
+    exit(1);
+  }
+  cout.flush();
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    string out;
+    try {
+      vector<PhaseResult> results = run_workload(w, reps);
+      long rss = peak_rss_kb();
+      for (const PhaseResult& r : results)
+        out += result_json(w.name, r, rss) + "\n";
+    }
+    catch (const MyPLException& e) {
+      out = "{\"workload\": " + json_string(w.name) + ", \"error\": "
+        + json_string(e.to_string()) + "}\n";
+    }
+    size_t written = 0;
+    while (written < out.size()) {
+      ssize_t n = write(fds[1], out.data() + written, out.size() - written);
+      if (n <= 0)
+        break;
+      written += n;
+    }
+    close(fds[1]);
+    _exit(0);
+  }
+  close(fds[1]);
+  string text;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(fds[0], buffer, sizeof(buffer))) > 0)
+    text.append(buffer, n);
+  close(fds[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) or WEXITSTATUS(status) != 0)
+    text = "{\"workload\": " + json_string(w.name)
+      + ", \"error\": \"benchmark process crashed\"}\n";
+  vector<string> lines;
+  istringstream lines_in(text);
+  string line;
+  while (getline(lines_in, line))
+    if (line != "")
+      lines.push_back(line);
+  return lines;
+}
+
+
+//----------------------------------------------------------------------
+// BASELINE COMPARISON
+//----------------------------------------------------------------------
+
+// the raw value of "key" in a one-line JSON object ("" if missing)
+string json_field(const string& line, const string& key)
+{
+  string pattern = "\"" + key + "\": ";
+  size_t start = line.find(pattern);
+  if (start == string::npos)
+    return "";
+  start += pattern.size();
+  if (line[start] == '"') {
+    size_t end = line.find('"', start + 1);
+    return line.substr(start + 1, end - start - 1);
+  }
+  size_t end = line.find_first_of(",}", start);
+  return line.substr(start, end - start);
+}
+
+// compare result lines against a baseline file, reporting regressions
+// (slower or allocating more than tolerance allows) on stderr
+int compare_baseline(const vector<string>& lines, const string& path, double tolerance)
+{
+  ifstream in(path);
+  if (!in) {
+    cerr << "cannot read baseline '" << path << "'" << endl;
+    return 1;
+  }
+  map<string,string> baseline;
+  string line;
+  while (getline(in, line))
+    if (json_field(line, "phase") != "")
+      baseline[json_field(line, "workload") + "/" + json_field(line, "phase")] = line;
+
+  int regressions = 0;
+  for (const string& l : lines) {
+    string key = json_field(l, "workload") + "/" + json_field(l, "phase");
+    if (json_field(l, "error") != "") {
+      cerr << "ERROR " << json_field(l, "workload") << ": " << json_field(l, "error") << endl;
+      ++regressions;
+      continue;
+    }
+    auto base = baseline.find(key);
+    if (base == baseline.end())
+      continue;
+    for (const char* metric : {"ns_per_op", "allocs_per_op"}) {
+      double old_val = atof(json_field(base->second, metric).c_str());
+      double new_val = atof(json_field(l, metric).c_str());
+      if (new_val > old_val * (1.0 + tolerance) and new_val - old_val > 1e-9) {
+        cerr << "REGRESSION " << key << " " << metric << ": " << old_val
+             << " -> " << new_val << endl;
+        ++regressions;
+      }
+    }
+  }
+  return regressions > 0 ? 2 : 0;
+}
+
+
+//----------------------------------------------------------------------
+// MAIN
+//----------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+  int scale = 1;
+  int reps = 5;
+  double tolerance = 0.10;
+  string only = "";
+  string out_path = "";
+  string baseline_path = "";
+  string emit_dir = "";
+  bool list = false;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--scale" and has_value)
+      scale = max(1, atoi(argv[++i]));
+    else if (arg == "--reps" and has_value)
+      reps = max(1, atoi(argv[++i]));
+    else if (arg == "--workload" and has_value)
+      only = argv[++i];
+    else if (arg == "--out" and has_value)
+      out_path = argv[++i];
+    else if (arg == "--baseline" and has_value)
+      baseline_path = argv[++i];
+    else if (arg == "--tolerance" and has_value)
+      tolerance = atof(argv[++i]);
+    else if (arg == "--emit" and has_value)
+      emit_dir = argv[++i];
+    else if (arg == "--list")
+      list = true;
+    else {
+      cerr << "usage: " << argv[0] << " [--scale N] [--reps N] [--workload NAME]"
+           << " [--out FILE] [--baseline FILE] [--tolerance FRACTION]"
+           << " [--emit DIR] [--list]" << endl;
+      return 1;
+    }
+  }
+
+  vector<string> lines;
+  for (const Workload& w : workloads(scale)) {
+    if (only != "" and w.name != only)
+      continue;
+    if (list) {
+      cout << w.name << endl;
+      continue;
+    }
+    if (emit_dir != "") {
+      ofstream(emit_dir + "/" + w.name + ".mypl") << w.source;
+      continue;
+    }
+    cerr << "running " << w.name << endl;
+    for (const string& line : run_isolated(w, reps))
+      lines.push_back(line);
+  }
+  if (list or emit_dir != "")
+    return 0;
+
+  ostringstream doc;
+  doc << "{\"scale\": " << scale << ", \"reps\": " << reps << ", \"results\": [" << endl;
+  for (size_t i = 0; i < lines.size(); ++i)
+    doc << "  " << lines[i] << (i + 1 < lines.size() ? "," : "") << endl;
+  doc << "]}" << endl;
+  if (out_path != "")
+    ofstream(out_path) << doc.str();
+  else
+    cout << doc.str();
+
+  if (baseline_path != "")
+    return compare_baseline(lines, baseline_path, tolerance);
+  return 0;
+}
@@ -0,0 +1,329 @@
+//----------------------------------------------------------------------
+// FILE: builtins.h
+// DESC: Registry of native (C++) built-in functions. Each built-in is
+//       declared once with its MyPL signature and a native function
+//       pointer. The type checker reads the signatures and the
+//       interpreter calls the functions, passing the evaluated
+//       arguments in place (no per-call argument vectors).
+//----------------------------------------------------------------------
+
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+#include "token.h"
+#include "mypl_exception.h"
+#include "data_object.h"
+#include "symbol_table.h"
+#include "input_scanner.h"
+
+
+// view over the evaluated arguments of a native call
+class NativeArgs
+{
+public:
+  NativeArgs(DataObject* args, size_t count) : args(args), count(count) {}
+  // number of arguments
+  size_t size() const {return count;}
+  // the i-th argument
+  DataObject& operator[](size_t i) const {return args[i];}
+private:
+  DataObject* args;
+  size_t count;
+};
+
+
+// state a native function may use: the program's input and output and
+// the call site (for error locations)
+struct NativeContext
+{
+  NativeContext(InputScanner& in, std::ostream& out) : in(in), out(out) {}
+  InputScanner& in;
+  std::ostream& out;
+  const Token* call_site = nullptr;
+  // throw a runtime error located at the call site
+  void error(const std::string& msg) const;
+};
+
+
+// native calling convention: args in, result out
+typedef void (*NativeFun)(NativeContext& ctx, NativeArgs args, DataObject& result);
+
+
+// a registered native function
+struct NativeFunction
+{
+  std::string name;             // function name
+  StringVec type;               // param types followed by the return type
+                                // (T stands for an array element type, K
+                                // and V for a map's key and value types,
+                                // and | separates alternative param types)
+  NativeFun fun;                // the implementation
+  bool in_place;                // first argument is a variable updated in place
+  bool reduction;               // an in-place reduction (allowed on parfor outer variables)
+  NativeFunction* overload = nullptr; // the next signature of the same name
+};
+
+
+class BuiltinRegistry
+{
+public:
+
+  // the registry holding the standard MyPL built-ins
+  static BuiltinRegistry& instance();
+
+  // add (or replace) a native function; an in-place function takes a
+  // variable as its first argument and may modify it, and a reduction
+  // is an in-place function combining its arguments (see
+  // reduction_builtins.h)
+  void add(const std::string& name, const StringVec& type, NativeFun fun,
+           bool in_place = false, bool reduction = false);
+
+  // add another signature for a registered function (the type checker
+  // picks the first signature the arguments match, see
+  // CallExpr::overload); all signatures of a name agree on in_place
+  void add_overload(const std::string& name, const StringVec& type, NativeFun fun);
+
+  // find a native function by name (nullptr if not registered)
+  const NativeFunction* find(const std::string& name) const;
+
+  // all registered native functions
+  std::vector<const NativeFunction*> functions() const;
+
+private:
+  // nodes are stable, so handed out pointers stay valid
+  std::unordered_map<std::string,NativeFunction> natives;
+  std::list<NativeFunction> overloads;
+};
+
+
+inline void NativeContext::error(const std::string& msg) const
+{
+  if (call_site)
+    throw MyPLException(RUNTIME, msg, call_site->line(), call_site->column());
+  throw MyPLException(RUNTIME, msg);
+}
+
+
+//----------------------------------------------------------------------
+// STANDARD BUILT-INS
+//----------------------------------------------------------------------
+
+// the i-th argument's string, read in place (nil is the empty string)
+inline const std::string& string_arg(NativeArgs args, size_t i)
+{
+  static const std::string empty;
+  const std::string* s = args[i].string_ptr();
+  return s ? *s : empty;
+}
+
+inline void native_print(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  // expand the \n and \t escapes left in string literals, writing the
+  // text between them as is
+  const std::string& s = string_arg(args, 0);
+  size_t start = 0;
+  for (size_t i = 0; i + 1 < s.size(); ++i) {
+    if (s[i] == '\\' and (s[i+1] == 'n' or s[i+1] == 't')) {
+      ctx.out.write(s.data() + start, i - start);
+      ctx.out.put(s[i+1] == 'n' ? '\n' : '\t');
+      start = ++i + 1;
+    }
+  }
+  ctx.out.write(s.data() + start, s.size() - start);
+  result.set_nil();
+}
+
+inline void native_m_print(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Matrix* x = args[0].matrix_ptr();
+  if (x) {
+    for (size_t row = 0; row < x->rows(); row++) {
+      ctx.out << std::endl;
+      for (size_t column = 0; column < x->cols(); column++)
+        ctx.out << x->at(row, column) << " ";
+    }
+  }
+  ctx.out << std::endl;
+  result.set_nil();
+}
+
+inline void native_m_singleton(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  double V = 0.0;
+  int R = 0;
+  int C = 0;
+  args[0].value(V);
+  args[1].value(R);
+  args[2].value(C);
+  if (R < 0 or C < 0)
+    ctx.error("Negative matrix dimensions");
+  result.set(Matrix(R, C, V));
+}
+
+inline void native_stod(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const std::string& s = string_arg(args, 0);
+  try {
+    result.set(std::stod(s));
+  }
+  catch (const std::exception& e) {
+    ctx.error("invalid double value '" + s + "'");
+  }
+}
+
+inline void native_stoi(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const std::string& s = string_arg(args, 0);
+  try {
+    result.set(std::stoi(s));
+  }
+  catch (const std::exception& e) {
+    ctx.error("invalid int value '" + s + "'");
+  }
+}
+
+inline void native_dtos(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  double double_arg = 0.0;
+  args[0].value(double_arg);
+  result.set(std::to_string(double_arg));
+}
+
+inline void native_itos(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  int int_arg = 0;
+  args[0].value(int_arg);
+  result.set(std::to_string(int_arg));
+}
+
+inline void native_read(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  // (the empty string at the end of the input)
+  std::string line;
+  {
+    std::lock_guard<std::mutex> guard(ctx.in.lock);
+    ctx.in.line(line);
+  }
+  result.set(std::move(line));
+}
+
+inline void native_length(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  if (const Array* a = args[0].array_ptr()) {
+    result.set((int)a->size());
+    return;
+  }
+  if (const Map* m = args[0].map_ptr()) {
+    result.set((int)m->size());
+    return;
+  }
+  result.set((int)string_arg(args, 0).size());
+}
+
+inline void native_m_get(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Matrix* M = args[0].matrix_ptr();
+  int row = 0;
+  int col = 0;
+  args[1].value(row);
+  args[2].value(col);
+  if (!M or row < 0 or col < 0 or row >= M->rows() or col >= M->cols())
+    ctx.error("Accessing out of bounds matrix");
+  result.set(M->at(row, col));
+}
+
+inline void native_get(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  int index = 0;
+  args[0].value(index);
+  const std::string& s = string_arg(args, 1);
+  if (index < 0 or index >= s.size())
+    ctx.error("string index out of range");
+  result.set(s[index]);
+}
+
+
+// native built-in families
+#include "math_builtins.h"
+#include "matrix_builtins.h"
+#include "reduction_builtins.h"
+#include "array_builtins.h"
+#include "map_builtins.h"
+#include "string_builtins.h"
+#include "input_builtins.h"
+
+
+//----------------------------------------------------------------------
+// REGISTRY
+//----------------------------------------------------------------------
+
+inline BuiltinRegistry& BuiltinRegistry::instance()
+{
+  static BuiltinRegistry registry = [] {
+    BuiltinRegistry r;
+    r.add("print", StringVec{"string", "nil"}, native_print);
+    r.add("stoi", StringVec{"string", "int"}, native_stoi);
+    r.add("stod", StringVec{"string", "double"}, native_stod);
+    r.add("itos", StringVec{"int", "string"}, native_itos);
+    r.add("dtos", StringVec{"double", "string"}, native_dtos);
+    r.add("get", StringVec{"int", "string", "char"}, native_get);
+    r.add("length", StringVec{"string|array<T>|map<K,V>", "int"}, native_length);
+    r.add("read", StringVec{"nil"}, native_read);
+    r.add("m_print", StringVec{"matrix", "nil"}, native_m_print);
+    r.add("m_get", StringVec{"matrix", "int", "int", "double"}, native_m_get);
+    r.add("m_singleton", StringVec{"double", "int", "int", "matrix"}, native_m_singleton);
+    add_math_builtins(r);
+    add_matrix_builtins(r);
+    add_reduction_builtins(r);
+    add_array_builtins(r);
+    add_map_builtins(r);
+    add_string_builtins(r);
+    add_input_builtins(r);
+    return r;
+  }();
+  return registry;
+}
+
+
+inline void BuiltinRegistry::add(const std::string& name, const StringVec& type, NativeFun fun,
+                          bool in_place, bool reduction)
+{
+  natives[name] = NativeFunction{name, type, fun, in_place, reduction};
+}
+
+
+inline void BuiltinRegistry::add_overload(const std::string& name, const StringVec& type, NativeFun fun)
+{
+  NativeFunction* last = &natives.at(name);
+  while (last->overload)
+    last = last->overload;
+  overloads.push_back(NativeFunction{name, type, fun, last->in_place, last->reduction});
+  last->overload = &overloads.back();
+}
+
+
+inline const NativeFunction* BuiltinRegistry::find(const std::string& name) const
+{
+  auto it = natives.find(name);
+  if (it == natives.end())
+    return nullptr;
+  return &it->second;
+}
+
+
+inline std::vector<const NativeFunction*> BuiltinRegistry::functions() const
+{
+  std::vector<const NativeFunction*> fs;
+  for (const auto& entry : natives)
+    fs.push_back(&entry.second);
+  return fs;
+}
+
+
+#endif
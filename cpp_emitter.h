@@ -0,0 +1,913 @@
+//----------------------------------------------------------------------
+// FILE: cpp_emitter.h
+// DESC: Translates a type-checked program to a standalone C++
+//       translation unit (see --emit-cpp). The generated code uses the
+//       runtime library in mypl_runtime.h: operators and built-ins are
+//       runtime calls that follow the interpreter, so the native
+//       program prints what the interpreted one prints.
+//
+//       Names are prefixed so they cannot clash with C++ or the
+//       runtime: variables and fields get v_, functions f_, and types
+//       t_. Objects are heap allocated structs (never freed, as in the
+//       interpreter), arrays are std::vectors, and maps are the
+//       interpreter's hash tables (flat_map.h). Nil converts to the zero
+//       value of any type (an empty array or map), and a function that
+//       ends without a return gives nil.
+//
+//       Primitive values that may be nil are mypl::Nullables: fields,
+//       and the variables, parameters, and function results that may be
+//       given nil. Which those are is found before writing anything
+//       (find_nullable), and the rest stay plain C++ values.
+//----------------------------------------------------------------------
+
+#ifndef CPP_EMITTER_H
+#define CPP_EMITTER_H
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "ast.h"
+#include "builtins.h"
+#include "mypl_exception.h"
+
+
+class CppEmitter : public Visitor
+{
+public:
+  // constructor
+  CppEmitter(std::ostream& output_stream) : out(output_stream) {}
+
+  // top-level
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  // rvalues
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+  void visit(TransposedRValue& node);
+  void visit(MatrixValue& node);
+  void visit(ArrayValue& node);
+
+private:
+  std::ostream& out;
+  int indent = 0;
+
+  // the C++ code of the last expression visited
+  std::string curr_expr;
+  // true if that expression calls a function (and may have effects)
+  bool curr_calls = false;
+
+  // numbers temporaries (mypl_t1, mypl_t2, ...)
+  int next_temp = 0;
+
+  // the primitive values that may be nil: the variables (and
+  // parameters) of each function by name, the parameters of each
+  // function by position, and the functions whose results may be
+  std::unordered_map<std::string, std::unordered_set<std::string>> nullable_vars;
+  std::unordered_map<std::string, std::vector<bool>> nullable_params;
+  std::unordered_set<std::string> nullable_results;
+  // the function being written
+  std::string curr_fun;
+
+  // find the nullable values, repeating until nothing new is found
+  void find_nullable(const std::vector<TypeDecl*>& types, const std::vector<FunDecl*>& funs);
+  // note the values of a function given values that may be nil (true
+  // if any were new)
+  bool find_nullable(const std::string& fun, const std::list<Stmt*>& stmts);
+  bool find_nullable(const std::string& fun, Expr* e);
+  bool find_nullable(const std::string& fun, CallExpr& call);
+  // true if an expression of a function may be nil
+  bool may_be_nil(const std::string& fun, Expr* e);
+  // true if a variable of the function being written may be nil
+  bool nullable(const std::string& var) {return nullable_vars[curr_fun].count(var);}
+
+  // write a statement list, one level deeper
+  void block(const std::list<Stmt*>& stmts);
+  // write one statement
+  void statement(Stmt* stmt);
+  // the C++ type for a MyPL type name (a Nullable primitive type if
+  // nullable)
+  std::string cpp_type(const std::string& type) const;
+  std::string cpp_type(const std::string& type, bool nullable) const;
+  static bool primitive(const std::string& type);
+  // the C++ declarator of a function
+  std::string signature(FunDecl& fun);
+  // the C++ code and call flag of an expression
+  std::string expr(Expr* e, bool& calls);
+  // a runtime location argument for a token
+  std::string loc(const Token& token) const;
+  // a fresh temporary name
+  std::string temp();
+  // the element type of an array type
+  static std::string element_type(const std::string& type);
+  // the C++ key and value types of a map type
+  std::string map_types(const std::string& type) const;
+  // the runtime function for a binary operator
+  std::string operator_function(const Token& op) const;
+  // a call that evaluates its arguments left to right
+  std::string call(const std::string& fun, const std::vector<std::string>& prefix,
+                   const std::vector<std::string>& args,
+                   const std::vector<bool>& calls);
+  // C++ literal text
+  std::string string_literal(const std::string& s) const;
+  std::string char_literal(char c) const;
+
+  std::string get_indent() const {return std::string(indent, ' ');}
+
+  // the built-ins mypl_runtime.h provides
+  static const std::unordered_set<std::string>& runtime_builtins();
+
+  // error message
+  void error(const std::string& msg, const Token& token);
+};
+
+
+inline const std::unordered_set<std::string>& CppEmitter::runtime_builtins()
+{
+  static const std::unordered_set<std::string> names = {
+    "print", "stoi", "stod", "itos", "dtos", "get", "length", "read",
+    "m_print", "m_get", "m_set", "m_singleton", "m_zeros", "m_identity",
+    "m_random", "m_rows", "m_cols",
+    "sqrt", "exp", "log", "sin", "cos", "abs", "floor", "ceil", "pow",
+    "min", "max", "m_sqrt", "m_exp", "m_log", "m_sin", "m_cos", "m_abs",
+    "m_floor", "m_ceil", "m_pow", "m_min", "m_max",
+    "m_sum", "m_mean", "m_row_sums", "m_row_means", "m_col_sums",
+    "m_col_means", "m_norm", "m_dot", "m_solve", "m_inverse", "m_det",
+    "reduce_sum", "reduce_min", "reduce_max", "reduce_isum", "reduce_imin",
+    "reduce_imax", "m_reduce_sum", "push", "pop", "put", "has", "remove", "keys",
+    "substr", "find", "split", "join", "replace", "read_line", "read_int",
+    "read_double", "read_matrix"
+  };
+  return names;
+}
+
+
+inline void CppEmitter::error(const std::string& msg, const Token& token)
+{
+  throw MyPLException(SEMANTIC, msg, token.line(), token.column());
+}
+
+
+//----------------------------------------------------------------------
+// HELPERS
+//----------------------------------------------------------------------
+
+inline std::string CppEmitter::cpp_type(const std::string& type) const
+{
+  if (type == "int" or type == "double" or type == "bool" or type == "char")
+    return type;
+  if (type == "string")
+    return "std::string";
+  if (type == "matrix")
+    return "Matrix";
+  if (type == "nil" or type == "")
+    return "mypl::Nil";
+  if (type.compare(0, 6, "array<") == 0)
+    return "std::vector<" + cpp_type(element_type(type)) + ">";
+  if (type.compare(0, 4, "map<") == 0)
+    return "mypl::Map<" + map_types(type) + ">";
+  return "t_" + type + "*";
+}
+
+inline std::string CppEmitter::cpp_type(const std::string& type, bool nullable) const
+{
+  if (nullable and primitive(type))
+    return "mypl::Nullable<" + cpp_type(type) + ">";
+  return cpp_type(type);
+}
+
+inline bool CppEmitter::primitive(const std::string& type)
+{
+  return type == "int" or type == "double" or type == "bool" or type == "char" or
+    type == "string" or type == "matrix";
+}
+
+inline std::string CppEmitter::map_types(const std::string& type) const
+{
+  // split at the comma outside any nested <...>
+  int depth = 0;
+  for (size_t i = 4; i + 1 < type.size(); ++i) {
+    if (type[i] == '<')
+      ++depth;
+    else if (type[i] == '>')
+      --depth;
+    else if (type[i] == ',' and depth == 0)
+      return cpp_type(type.substr(4, i - 4)) + ", " +
+        cpp_type(type.substr(i + 1, type.size() - i - 2));
+  }
+  return "";
+}
+
+inline std::string CppEmitter::element_type(const std::string& type)
+{
+  return type.substr(6, type.size() - 7);
+}
+
+inline std::string CppEmitter::signature(FunDecl& fun)
+{
+  const std::string& name = fun.id.lexeme();
+  std::string params;
+  size_t i = 0;
+  for (const FunDecl::FunParam& p : fun.params)
+    params += (params.empty() ? "" : ", ") + cpp_type(p.type.lexeme(), nullable_params[name][i++]) +
+      " v_" + p.id.lexeme();
+  return cpp_type(fun.return_type.lexeme(), nullable_results.count(name)) + " f_" + name +
+    "(" + params + ")";
+}
+
+inline std::string CppEmitter::expr(Expr* e, bool& calls)
+{
+  e->accept(*this);
+  calls = curr_calls;
+  return curr_expr;
+}
+
+inline std::string CppEmitter::loc(const Token& token) const
+{
+  return "{" + std::to_string(token.line()) + ", " + std::to_string(token.column()) + "}";
+}
+
+inline std::string CppEmitter::temp()
+{
+  return "mypl_t" + std::to_string(++next_temp);
+}
+
+inline std::string CppEmitter::operator_function(const Token& op) const
+{
+  static const std::unordered_map<std::string,std::string> functions = {
+    {"+", "op_add"}, {"-", "op_sub"}, {"*", "op_mul"}, {"/", "op_div"},
+    {"%", "op_mod"}, {"^", "op_pow"}, {".*", "op_emul"}, {"./", "op_ediv"},
+    {".^", "op_epow"}, {"and", "op_and"}, {"or", "op_or"}, {"==", "op_eq"},
+    {"!=", "op_ne"}, {"<", "op_lt"}, {"<=", "op_le"}, {">", "op_gt"},
+    {">=", "op_ge"}
+  };
+  auto f = functions.find(op.lexeme());
+  if (f == functions.end())
+    throw MyPLException(SEMANTIC, "unexpected operator '" + op.lexeme() + "'",
+                        op.line(), op.column());
+  return "mypl::" + f->second;
+}
+
+inline std::string CppEmitter::call(const std::string& fun, const std::vector<std::string>& prefix,
+                             const std::vector<std::string>& args,
+                             const std::vector<bool>& calls)
+{
+  // C++ leaves the argument order open, so when more than one argument
+  // calls a function, all but the last are evaluated into temporaries
+  // first (the prefix arguments are never moved)
+  size_t calling = 0;
+  for (bool c : calls)
+    calling += c;
+  std::string code;
+  std::vector<std::string> passed = prefix;
+  if (calling > 1)
+    code = "[&] {";
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (calling > 1 and i + 1 < args.size()) {
+      passed.push_back(temp());
+      code += " auto " + passed.back() + " = " + args[i] + ";";
+    }
+    else
+      passed.push_back(args[i]);
+  }
+  if (calling > 1)
+    code += " return ";
+  code += fun + "(";
+  for (size_t i = 0; i < passed.size(); ++i)
+    code += (i ? ", " : "") + passed[i];
+  code += ")";
+  if (calling > 1)
+    code += "; }()";
+  return code;
+}
+
+inline std::string CppEmitter::string_literal(const std::string& s) const
+{
+  std::string code = "std::string(\"";
+  for (unsigned char c : s) {
+    if (c == '"' or c == '\\')
+      code += std::string("\\") + (char)c;
+    else if (c < 32 or c >= 127) {
+      // three digit octal escapes cannot run into the next character
+      char escape[5];
+      snprintf(escape, sizeof(escape), "\\%03o", c);
+      code += escape;
+    }
+    else
+      code += c;
+  }
+  return code + "\")";
+}
+
+inline std::string CppEmitter::char_literal(char c) const
+{
+  if (c == '\'' or c == '\\')
+    return std::string("'\\") + c + "'";
+  if ((unsigned char)c < 32 or (unsigned char)c >= 127)
+    return "(char)" + std::to_string((int)c);
+  return std::string("'") + c + "'";
+}
+
+
+//----------------------------------------------------------------------
+// NULLABLE VALUES
+//----------------------------------------------------------------------
+
+inline void CppEmitter::find_nullable(const std::vector<TypeDecl*>& types,
+                                      const std::vector<FunDecl*>& funs)
+{
+  for (FunDecl* f : funs) {
+    f->read_body();
+    nullable_params[f->id.lexeme()].assign(f->params.size(), false);
+  }
+  // (only ever adds values, so it ends)
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (TypeDecl* t : types)
+      for (VarDeclStmt* v : t->vdecls)
+        changed |= find_nullable("", v->expr);
+    for (FunDecl* f : funs) {
+      const std::string& name = f->id.lexeme();
+      size_t i = 0;
+      for (const FunDecl::FunParam& p : f->params)
+        if (nullable_params[name][i++])
+          changed |= nullable_vars[name].insert(p.id.lexeme()).second;
+      changed |= find_nullable(name, f->stmts);
+      // (see visit(FunDecl&))
+      if (f->stmts.empty() or !dynamic_cast<ReturnStmt*>(f->stmts.back()))
+        changed |= nullable_results.insert(name).second;
+    }
+  }
+}
+
+inline bool CppEmitter::find_nullable(const std::string& fun, const std::list<Stmt*>& stmts)
+{
+  bool changed = false;
+  for (Stmt* s : stmts) {
+    if (VarDeclStmt* v = dynamic_cast<VarDeclStmt*>(s)) {
+      changed |= find_nullable(fun, v->expr);
+      if (may_be_nil(fun, v->expr))
+        changed |= nullable_vars[fun].insert(v->id.lexeme()).second;
+    }
+    else if (AssignStmt* a = dynamic_cast<AssignStmt*>(s)) {
+      for (Expr* index : a->indexes)
+        changed |= find_nullable(fun, index);
+      changed |= find_nullable(fun, a->expr);
+      // (fields are always nullable, and array elements never are)
+      if (a->lvalue_list.size() == 1 and a->indexes.empty() and may_be_nil(fun, a->expr))
+        changed |= nullable_vars[fun].insert(a->lvalue_list.front().lexeme()).second;
+    }
+    else if (ReturnStmt* r = dynamic_cast<ReturnStmt*>(s)) {
+      changed |= find_nullable(fun, r->expr);
+      if (may_be_nil(fun, r->expr))
+        changed |= nullable_results.insert(fun).second;
+    }
+    else if (IfStmt* i = dynamic_cast<IfStmt*>(s)) {
+      changed |= find_nullable(fun, i->if_part->expr);
+      changed |= find_nullable(fun, i->if_part->stmts);
+      for (BasicIf* else_if : i->else_ifs) {
+        changed |= find_nullable(fun, else_if->expr);
+        changed |= find_nullable(fun, else_if->stmts);
+      }
+      changed |= find_nullable(fun, i->body_stmts);
+    }
+    else if (WhileStmt* w = dynamic_cast<WhileStmt*>(s)) {
+      changed |= find_nullable(fun, w->expr);
+      changed |= find_nullable(fun, w->stmts);
+    }
+    else if (ForStmt* f = dynamic_cast<ForStmt*>(s)) {
+      changed |= find_nullable(fun, f->start);
+      if (f->end)
+        changed |= find_nullable(fun, f->end);
+      changed |= find_nullable(fun, f->stmts);
+    }
+    else if (CallExpr* c = dynamic_cast<CallExpr*>(s))
+      changed |= find_nullable(fun, *c);
+  }
+  return changed;
+}
+
+inline bool CppEmitter::find_nullable(const std::string& fun, Expr* e)
+{
+  bool changed = false;
+  if (e->rest)
+    changed |= find_nullable(fun, e->rest);
+  if (ComplexTerm* t = dynamic_cast<ComplexTerm*>(e->first))
+    return find_nullable(fun, t->expr) or changed;
+  RValue* r = static_cast<SimpleTerm*>(e->first)->rvalue;
+  if (CallExpr* c = dynamic_cast<CallExpr*>(r))
+    changed |= find_nullable(fun, *c);
+  else if (IDRValue* v = dynamic_cast<IDRValue*>(r)) {
+    for (Expr* index : v->indexes)
+      changed |= find_nullable(fun, index);
+  }
+  else if (NegatedRValue* n = dynamic_cast<NegatedRValue*>(r))
+    changed |= find_nullable(fun, n->expr);
+  else if (TransposedRValue* t = dynamic_cast<TransposedRValue*>(r))
+    changed |= find_nullable(fun, t->expr);
+  else if (MatrixValue* m = dynamic_cast<MatrixValue*>(r)) {
+    for (const std::vector<Expr*>& row : m->M)
+      for (Expr* x : row)
+        changed |= find_nullable(fun, x);
+  }
+  else if (ArrayValue* a = dynamic_cast<ArrayValue*>(r)) {
+    for (Expr* x : a->elements)
+      changed |= find_nullable(fun, x);
+  }
+  return changed;
+}
+
+inline bool CppEmitter::find_nullable(const std::string& fun, CallExpr& call)
+{
+  // a parameter may be nil if any call may pass nil
+  const std::string& name = call.function_id.lexeme();
+  bool user = !BuiltinRegistry::instance().find(name);
+  bool changed = false;
+  size_t i = 0;
+  for (Expr* arg : call.arg_list) {
+    changed |= find_nullable(fun, arg);
+    if (user and may_be_nil(fun, arg)) {
+      std::vector<bool>& params = nullable_params[name];
+      if (i < params.size() and !params[i]) {
+        params[i] = true;
+        changed = true;
+      }
+    }
+    ++i;
+  }
+  return changed;
+}
+
+inline bool CppEmitter::may_be_nil(const std::string& fun, Expr* e)
+{
+  if (e->type == "nil")
+    return true;
+  if (e->negated or !primitive(e->type))
+    return false;
+  if (e->op) {
+    // (== and != always give a bool)
+    if (e->op->type() == EQUAL or e->op->type() == NOT_EQUAL)
+      return false;
+    if (may_be_nil(fun, e->rest))
+      return true;
+  }
+  if (ComplexTerm* t = dynamic_cast<ComplexTerm*>(e->first))
+    return may_be_nil(fun, t->expr);
+  RValue* r = static_cast<SimpleTerm*>(e->first)->rvalue;
+  if (SimpleRValue* v = dynamic_cast<SimpleRValue*>(r))
+    return v->value.type() == NIL;
+  if (CallExpr* c = dynamic_cast<CallExpr*>(r))
+    return nullable_results.count(c->function_id.lexeme());
+  if (IDRValue* v = dynamic_cast<IDRValue*>(r)) {
+    if (!v->indexes.empty())
+      return false;
+    return v->path.size() > 1 or nullable_vars[fun].count(v->path.front().lexeme());
+  }
+  if (NegatedRValue* n = dynamic_cast<NegatedRValue*>(r))
+    return may_be_nil(fun, n->expr);
+  return false;
+}
+
+
+//----------------------------------------------------------------------
+// DECLARATIONS
+//----------------------------------------------------------------------
+
+inline void CppEmitter::visit(Program& node)
+{
+  std::vector<TypeDecl*> types;
+  std::vector<FunDecl*> funs;
+  for (Decl* d : node.decls) {
+    if (TypeDecl* t = dynamic_cast<TypeDecl*>(d))
+      types.push_back(t);
+    else if (FunDecl* f = dynamic_cast<FunDecl*>(d))
+      funs.push_back(f);
+  }
+  find_nullable(types, funs);
+  out << "// generated by mypl --emit-cpp" << std::endl;
+  out << "#include \"mypl_runtime.h\"" << std::endl << std::endl;
+  // declarations first, so types and functions may be used in any order
+  for (TypeDecl* t : types)
+    out << "struct t_" << t->id.lexeme() << ";" << std::endl;
+  if (types.size())
+    out << std::endl;
+  FunDecl* main_fun = nullptr;
+  for (FunDecl* f : funs) {
+    out << signature(*f) << ";" << std::endl;
+    if (f->id.lexeme() == "main")
+      main_fun = f;
+  }
+  out << std::endl;
+  for (TypeDecl* t : types) {
+    out << "struct t_" << t->id.lexeme() << std::endl << "{" << std::endl;
+    for (VarDeclStmt* v : t->vdecls) {
+      std::string type = v->type ? v->type->lexeme() : v->expr->type;
+      out << "  " << cpp_type(type, true) << " v_" << v->id.lexeme() << ";" << std::endl;
+    }
+    out << "  t_" << t->id.lexeme() << "();" << std::endl;
+    out << "};" << std::endl << std::endl;
+  }
+  // then the definitions
+  for (TypeDecl* t : types)
+    t->accept(*this);
+  for (FunDecl* f : funs)
+    f->accept(*this);
+  // the program entry: run main and report runtime errors like the
+  // interpreter does
+  out << "int main()" << std::endl << "{" << std::endl;
+  out << "  try {" << std::endl;
+  if (main_fun and main_fun->return_type.lexeme() == "int")
+    out << "    return f_main();" << std::endl;
+  else if (main_fun)
+    out << "    f_main();" << std::endl;
+  out << "  }" << std::endl;
+  out << "  catch (const MyPLException& e) {" << std::endl;
+  out << "    std::cout << e.to_string() << std::endl;" << std::endl;
+  out << "    return 1;" << std::endl;
+  out << "  }" << std::endl;
+  out << "  return 0;" << std::endl;
+  out << "}" << std::endl;
+}
+
+inline void CppEmitter::visit(FunDecl& node)
+{
+  node.read_body();
+  curr_fun = node.id.lexeme();
+  out << signature(node) << std::endl << "{" << std::endl;
+  block(node.stmts);
+  if (node.stmts.empty() or !dynamic_cast<ReturnStmt*>(node.stmts.back()))
+    out << "  return mypl::nil;" << std::endl;
+  out << "}" << std::endl << std::endl;
+}
+
+inline void CppEmitter::visit(TypeDecl& node)
+{
+  // the constructor runs the field initializers in order
+  std::string name = "t_" + node.id.lexeme();
+  out << name << "::" << name << "()";
+  std::string sep = "\n  : ";
+  for (VarDeclStmt* v : node.vdecls) {
+    bool calls = false;
+    out << sep << "v_" << v->id.lexeme() << "(" << expr(v->expr, calls) << ")";
+    sep = ",\n    ";
+  }
+  out << std::endl << "{" << std::endl << "}" << std::endl << std::endl;
+}
+
+
+//----------------------------------------------------------------------
+// STATEMENTS
+//----------------------------------------------------------------------
+
+inline void CppEmitter::block(const std::list<Stmt*>& stmts)
+{
+  indent += 2;
+  for (Stmt* s : stmts)
+    statement(s);
+  indent -= 2;
+}
+
+inline void CppEmitter::statement(Stmt* stmt)
+{
+  stmt->accept(*this);
+  // a call statement only builds its expression
+  if (dynamic_cast<CallExpr*>(stmt))
+    out << get_indent() << curr_expr << ";" << std::endl;
+}
+
+inline void CppEmitter::visit(VarDeclStmt& node)
+{
+  // untyped variables take the type of their value (unless it may
+  // become nil)
+  bool calls = false;
+  std::string value = expr(node.expr, calls);
+  bool may_be_nil = nullable(node.id.lexeme());
+  std::string type = "auto";
+  if (node.type)
+    type = cpp_type(node.type->lexeme(), may_be_nil);
+  else if (may_be_nil)
+    type = cpp_type(node.expr->type, true);
+  out << get_indent() << type << " v_" << node.id.lexeme() << " = " << value << ";" << std::endl;
+}
+
+inline void CppEmitter::visit(AssignStmt& node)
+{
+  // s = s + e appends to s (instead of copying it)
+  if (Expr* rest = node.appended()) {
+    bool calls = false;
+    out << get_indent() << "mypl::append(v_" << node.lvalue_list.front().lexeme()
+        << ", " << expr(rest, calls) << ");" << std::endl;
+    return;
+  }
+  // the value is computed before the target is looked up
+  bool calls = false;
+  std::string value = expr(node.expr, calls);
+  std::string target;
+  for (const Token& id : node.lvalue_list)
+    target += (target.empty() ? "v_" : "->v_") + id.lexeme();
+  if (node.indexes.empty()) {
+    out << get_indent() << target << " = " << value << ";" << std::endl;
+    return;
+  }
+  // an array element: the value and then the indexes are computed into
+  // temporaries when any of them calls a function
+  std::vector<std::string> indexes;
+  std::vector<bool> index_calls;
+  for (Expr* index : node.indexes) {
+    bool c = false;
+    indexes.push_back(expr(index, c));
+    index_calls.push_back(c);
+    calls = calls or c;
+  }
+  if (calls) {
+    out << get_indent() << "{" << std::endl;
+    indent += 2;
+    std::string t = temp();
+    out << get_indent() << "auto " << t << " = " << value << ";" << std::endl;
+    value = t;
+    for (std::string& index : indexes) {
+      t = temp();
+      out << get_indent() << "int " << t << " = " << index << ";" << std::endl;
+      index = t;
+    }
+  }
+  std::string at = loc(node.first_token());
+  for (size_t i = 0; i + 1 < indexes.size(); ++i)
+    target = "mypl::at(" + at + ", " + target + ", " + indexes[i] + ")";
+  out << get_indent() << "mypl::set(" << at << ", " << target << ", "
+      << indexes.back() << ", " << value << ");" << std::endl;
+  if (calls) {
+    indent -= 2;
+    out << get_indent() << "}" << std::endl;
+  }
+}
+
+inline void CppEmitter::visit(ReturnStmt& node)
+{
+  bool calls = false;
+  out << get_indent() << "return " << expr(node.expr, calls) << ";" << std::endl;
+}
+
+inline void CppEmitter::visit(IfStmt& node)
+{
+  bool calls = false;
+  out << get_indent() << "if (" << expr(node.if_part->expr, calls) << ") {" << std::endl;
+  block(node.if_part->stmts);
+  for (BasicIf* else_if : node.else_ifs) {
+    out << get_indent() << "}" << std::endl;
+    out << get_indent() << "else if (" << expr(else_if->expr, calls) << ") {" << std::endl;
+    block(else_if->stmts);
+  }
+  if (node.body_stmts.size()) {
+    out << get_indent() << "}" << std::endl;
+    out << get_indent() << "else {" << std::endl;
+    block(node.body_stmts);
+  }
+  out << get_indent() << "}" << std::endl;
+}
+
+inline void CppEmitter::visit(WhileStmt& node)
+{
+  bool calls = false;
+  out << get_indent() << "while (" << expr(node.expr, calls) << ") {" << std::endl;
+  block(node.stmts);
+  out << get_indent() << "}" << std::endl;
+}
+
+inline void CppEmitter::visit(ForStmt& node)
+{
+  // the end value is computed once, after the loop variable is set; the
+  // body may assign the loop variable (a parfor runs its iterations in
+  // order: the type checker already keeps them independent)
+  bool calls = false;
+  std::string var = "v_" + node.var_id.lexeme();
+  if (node.each) {
+    // a for-in loop visits the elements the array has when it starts
+    std::string type = cpp_type(element_type(node.start->type), nullable(node.var_id.lexeme()));
+    out << get_indent() << "for (" << type << " " << var << " : "
+        << cpp_type(node.start->type) << "(" << expr(node.start, calls) << ")) {" << std::endl;
+    block(node.stmts);
+    out << get_indent() << "}" << std::endl;
+    return;
+  }
+  std::string end = temp();
+  out << get_indent() << "{" << std::endl;
+  indent += 2;
+  out << get_indent() << "int " << var << " = " << expr(node.start, calls) << ";" << std::endl;
+  out << get_indent() << "for (int " << end << " = " << expr(node.end, calls) << "; "
+      << var << " <= " << end << "; ++" << var << ") {" << std::endl;
+  block(node.stmts);
+  out << get_indent() << "}" << std::endl;
+  indent -= 2;
+  out << get_indent() << "}" << std::endl;
+}
+
+
+//----------------------------------------------------------------------
+// EXPRESSIONS
+//----------------------------------------------------------------------
+
+inline void CppEmitter::visit(Expr& node)
+{
+  if (node.negated) {
+    node.first->accept(*this);
+    curr_expr = "!(" + curr_expr + ")";
+    return;
+  }
+  node.first->accept(*this);
+  if (!node.op)
+    return;
+  std::string lhs = curr_expr;
+  bool lhs_calls = curr_calls;
+  node.rest->accept(*this);
+  curr_expr = call(operator_function(*node.op), {loc(node.first_token())},
+                   {lhs, curr_expr}, {lhs_calls, curr_calls});
+  curr_calls = lhs_calls or curr_calls;
+}
+
+inline void CppEmitter::visit(SimpleTerm& node)
+{
+  node.rvalue->accept(*this);
+}
+
+inline void CppEmitter::visit(ComplexTerm& node)
+{
+  node.expr->accept(*this);
+  curr_expr = "(" + curr_expr + ")";
+}
+
+
+//----------------------------------------------------------------------
+// RVALUES
+//----------------------------------------------------------------------
+
+inline void CppEmitter::visit(SimpleRValue& node)
+{
+  const Token& value = node.value;
+  curr_calls = false;
+  if (value.type() == CHAR_VAL)
+    curr_expr = char_literal(value.lexeme().at(0));
+  else if (value.type() == STRING_VAL)
+    curr_expr = string_literal(value.lexeme());
+  else if (value.type() == INT_VAL or value.type() == DOUBLE_VAL) {
+    // out of range literals fail when evaluated, as in the interpreter
+    bool is_int = value.type() == INT_VAL;
+    try {
+      curr_expr = is_int ? std::to_string(std::stoi(value.lexeme())) : value.lexeme();
+      if (!is_int)
+        std::stod(value.lexeme());
+    }
+    catch (const std::exception& e) {
+      std::string msg = is_int ? "Int out of range" : "Double out of range";
+      curr_expr = "(mypl::error(" + loc(value) + ", \"" + msg + "\"), " +
+        (is_int ? "0" : "0.0") + ")";
+    }
+  }
+  else if (value.type() == BOOL_VAL)
+    curr_expr = value.lexeme() == "true" ? "true" : "false";
+  else
+    curr_expr = "mypl::nil";
+}
+
+inline void CppEmitter::visit(NewRValue& node)
+{
+  const std::string& type = node.type_id.lexeme();
+  if (type.compare(0, 6, "array<") == 0 or type.compare(0, 4, "map<") == 0) {
+    curr_expr = cpp_type(type) + "()";
+    curr_calls = false;
+    return;
+  }
+  curr_expr = "new t_" + type + "()";
+  curr_calls = true;
+}
+
+inline void CppEmitter::visit(CallExpr& node)
+{
+  std::string name = node.function_id.lexeme();
+  const NativeFunction* native = BuiltinRegistry::instance().find(name);
+  std::vector<std::string> prefix;
+  std::vector<std::string> args;
+  std::vector<bool> calls;
+  std::string fun = "f_" + name;
+  if (native) {
+    if (!runtime_builtins().count(name))
+      error("built-in '" + name + "' is not supported by the C++ backend", node.function_id);
+    fun = "mypl::" + name;
+    prefix.push_back(loc(node.function_id));
+  }
+  for (Expr* arg : node.arg_list) {
+    // an in-place built-in updates the variable it is given
+    if (native and native->in_place and prefix.size() == 1) {
+      IDRValue* var = arg->id_rvalue();
+      if (!var or !var->indexes.empty())
+        error("expecting a variable", node.function_id);
+      std::string name = var->path.front().lexeme();
+      if (var->path.size() == 1) {
+        prefix.push_back(nullable(name) ? "mypl::ref(v_" + name + ")" : "v_" + name);
+        continue;
+      }
+      // or a field (of the object the rest of the path reads)
+      std::string object = "v_" + name;
+      auto last = std::prev(var->path.end());
+      for (auto id = std::next(var->path.begin()); id != last; ++id)
+        object = "MYPL_FIELD(" + object + ", v_" + id->lexeme() + ")";
+      prefix.push_back("mypl::ref(MYPL_FIELD_REF(" + object + ", v_" + last->lexeme() + ", " +
+                       loc(*std::prev(last)) + "))");
+      continue;
+    }
+    bool arg_calls = false;
+    args.push_back(expr(arg, arg_calls));
+    // built-ins take plain values
+    if (native)
+      args.back() = "mypl::value(" + args.back() + ")";
+    calls.push_back(arg_calls);
+  }
+  curr_expr = call(fun, prefix, args, calls);
+  curr_calls = true;
+}
+
+inline void CppEmitter::visit(IDRValue& node)
+{
+  curr_expr.clear();
+  for (const Token& id : node.path) {
+    if (curr_expr.empty())
+      curr_expr = "v_" + id.lexeme();
+    else
+      curr_expr = "MYPL_FIELD(" + curr_expr + ", v_" + id.lexeme() + ")";
+  }
+  curr_calls = false;
+  // array elements
+  for (Expr* index : node.indexes) {
+    std::string array = curr_expr;
+    bool array_calls = curr_calls;
+    bool index_calls = false;
+    std::string i = expr(index, index_calls);
+    curr_expr = call("mypl::element", {loc(node.first_token())}, {array, i},
+                     {array_calls, index_calls});
+    curr_calls = array_calls or index_calls;
+  }
+}
+
+inline void CppEmitter::visit(NegatedRValue& node)
+{
+  node.expr->accept(*this);
+  curr_expr = "mypl::op_neg(" + curr_expr + ")";
+}
+
+inline void CppEmitter::visit(TransposedRValue& node)
+{
+  node.expr->accept(*this);
+  curr_expr = "mypl::op_transpose(" + curr_expr + ")";
+}
+
+inline void CppEmitter::visit(MatrixValue& node)
+{
+  // braced lists evaluate their elements in order
+  std::string rows;
+  bool calls = false;
+  for (const std::vector<Expr*>& row : node.M) {
+    std::string elements;
+    for (Expr* e : row) {
+      bool element_calls = false;
+      elements += (elements.empty() ? "" : ", ") + expr(e, element_calls);
+      calls = calls or element_calls;
+    }
+    rows += (rows.empty() ? "" : ", ") + std::string("mypl::Row{") + elements + "}";
+  }
+  curr_expr = "mypl::matrix({" + rows + "})";
+  curr_calls = calls;
+}
+
+inline void CppEmitter::visit(ArrayValue& node)
+{
+  std::string elements;
+  bool calls = false;
+  for (Expr* e : node.elements) {
+    bool element_calls = false;
+    elements += (elements.empty() ? "" : ", ") + expr(e, element_calls);
+    calls = calls or element_calls;
+  }
+  curr_expr = cpp_type("array<" + node.elem_type + ">") + "{" + elements + "}";
+  curr_calls = calls;
+}
+
+
+#endif
@@ -4,16 +4,24 @@
 #ifndef DATA_OBJECT_H
 #define DATA_OBJECT_H
 
+#include <atomic>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "matrix.h"
+#include "flat_map.h"
+#include "stats.h"
 
 
 
+class Array;
+class Map;
+
 class DataObject
 {
 public:
 
-  enum DataType {INTEGER, DOUBLE, STRING, CHAR, BOOL, OID, NIL, MATRIX};
+  enum DataType {INTEGER, DOUBLE, STRING, CHAR, BOOL, OID, NIL, MATRIX, ARRAY, MAP};
 
   // construction
   DataObject();
@@ -21,24 +29,41 @@ public:
   DataObject(double val);
   DataObject(const char* val);
   DataObject(const std::string& val);
+  DataObject(std::string&& val);
   DataObject(char val);
   DataObject(bool val);
   DataObject(size_t val);
   DataObject(vector<vector<double>> val); //DECLARE
+  DataObject(const Matrix& val);
+  DataObject(Matrix&& val);
+  DataObject(const Array& val);
+  DataObject(Array&& val);
+  DataObject(const Map& val);
+  DataObject(Map&& val);
   // destruction
   ~DataObject();
   // copying
   DataObject(const DataObject& rhs);
   DataObject& operator=(const DataObject& rhs);
+  // moving (takes over the value, leaving rhs nil)
+  DataObject(DataObject&& rhs) noexcept;
+  DataObject& operator=(DataObject&& rhs) noexcept;
   // set/update
   void set(int val);
   void set(double val);
   void set(const char* val);
   void set(const std::string& val);
+  void set(std::string&& val);
   void set(char val);
   void set(bool val);
   void set(size_t val);
   void set(vector<vector<double>> val); //DECLARE
+  void set(const Matrix& val);
+  void set(Matrix&& val);
+  void set(const Array& val);
+  void set(Array&& val);
+  void set(const Map& val);
+  void set(Map&& val);
   void set_nil(); 
   // get and check type
   DataType type() const;
@@ -50,6 +75,8 @@ public:
   bool is_bool() const;
   bool is_oid() const;
   bool is_matrix() const; //DECLARE
+  bool is_array() const;
+  bool is_map() const;
   // get the value
   bool value(int& val) const;
   bool value(double& val) const;
@@ -58,9 +85,46 @@ public:
   bool value(bool& val) const;
   bool value(size_t& val) const;
   bool value(vector<vector<double>>& val) const; //Declare  
+  bool value(Matrix& val) const;
+  // the string storage itself (nullptr if not a string)
+  const std::string* string_ptr() const;
+  // the string storage for modification, first unsharing it from any
+  // copies (nullptr if not a string)
+  std::string* mutable_string_ptr();
+  // add to the end of a string value (in place unless it is shared)
+  void append(const std::string& val);
+  void append(char val);
+  // the matrix storage itself (nullptr if not a matrix)
+  const Matrix* matrix_ptr() const;
+  // the matrix storage for modification, first unsharing it from any
+  // copies (nullptr if not a matrix)
+  Matrix* mutable_matrix_ptr();
+  // the array storage itself (nullptr if not an array)
+  const Array* array_ptr() const;
+  // the array storage for modification, first unsharing it from any
+  // copies (nullptr if not an array)
+  Array* mutable_array_ptr();
+  // the map storage itself (nullptr if not a map)
+  const Map* map_ptr() const;
+  // the map storage for modification, first unsharing it from any
+  // copies (nullptr if not a map)
+  Map* mutable_map_ptr();
   // get a string representation
   std::string to_string() const;
+  // number of string and matrix values created so far by this thread
+  // (for profiling)
+  static inline thread_local size_t string_allocations = 0;
+  static inline thread_local size_t matrix_allocations = 0;
  private:
+  // matrices are copy-on-write: copies share one reference-counted
+  // matrix until one of them asks for mutable access (the count is
+  // atomic since parfor iterations share the outer values)
+  struct SharedMatrix {Matrix matrix; std::atomic<size_t> refs;};
+  // strings, arrays, and maps are shared the same way (so a string
+  // only referenced once can be appended to in place)
+  struct SharedString {std::string str; std::atomic<size_t> refs;};
+  struct SharedArray;
+  struct SharedMap;
   void* value_ptr = nullptr;
   DataType value_type = DataType::NIL;
   void delete_obj();
@@ -68,76 +132,228 @@ public:
 
 
 
+//----------------------------------------------------------------------
+// ARRAYS
+//----------------------------------------------------------------------
+
+// the elements of an array value: int, double, bool, and char elements
+// are stored unboxed in one contiguous vector, any others (strings,
+// matrices, objects, and arrays) as data objects
+class Array
+{
+public:
+  // an empty array with elements of the given MyPL type
+  explicit Array(const std::string& elem_type);
+  // number of elements
+  size_t size() const;
+  // get element i (which must exist)
+  void get(size_t i, DataObject& val) const;
+  // replace element i (which must exist); false if the value cannot be
+  // stored (e.g., nil in an unboxed array)
+  bool set(size_t i, const DataObject& val);
+  // add an element at the end (false if it cannot be stored)
+  bool push(const DataObject& val);
+  // remove the last element (which must exist) into val
+  void pop(DataObject& val);
+  // element i (which must exist) for updating it in place, e.g. an
+  // inner array (nullptr if the elements are unboxed)
+  DataObject* object(size_t i);
+private:
+  enum Kind {INTS, DOUBLES, BOOLS, CHARS, OBJECTS};
+  Kind kind;
+  std::vector<int> ints;
+  std::vector<double> doubles;
+  std::vector<char> chars;            // bool and char elements
+  std::vector<DataObject> objects;
+};
+
+struct DataObject::SharedArray {Array array; std::atomic<size_t> refs;};
+
+
+//----------------------------------------------------------------------
+// MAPS
+//----------------------------------------------------------------------
+
+// a map key: int, bool, and char keys (and double keys, by their bits)
+// are held as a number, string keys as the string
+struct MapKey
+{
+  long long n = 0;
+  std::string s;
+  bool operator==(const MapKey& k) const {return n == k.n and s == k.s;}
+};
+
+// a key to look up, viewing the string of the value looked up in place
+// (a MapKey copy is only made to add a key)
+struct MapKeyView
+{
+  long long n = 0;
+  std::string_view s;
+};
+
+inline bool operator==(const MapKey& k, const MapKeyView& v) {return k.n == v.n and k.s == v.s;}
+
+struct MapKeyHash
+{
+  uint64_t operator()(const MapKey& k) const {return (*this)(MapKeyView{k.n, k.s});}
+  uint64_t operator()(const MapKeyView& k) const
+  {
+    return k.s.empty() ? hash_mix((uint64_t)k.n) : hash_bytes(k.s.data(), k.s.size());
+  }
+};
+
+// the entries of a map value: keys are of one primitive MyPL type
+// (int, double, bool, char, or string), values are data objects
+class Map
+{
+public:
+  // an empty map with keys of the given MyPL type
+  explicit Map(const std::string& key_type);
+  // number of keys
+  size_t size() const;
+  // the value of a key (nullptr if the key is not in the map)
+  const DataObject* find(const DataObject& key) const;
+  // set the value of a key (false if the key is nil)
+  bool put(const DataObject& key, const DataObject& val);
+  // remove a key (false if it was not in the map)
+  bool remove(const DataObject& key);
+  // the keys, in insertion order
+  void keys(Array& out) const;
+  // the MyPL type of the keys
+  const std::string& key_type_name() const {return key_type;}
+private:
+  enum Kind {INTS, DOUBLES, BOOLS, CHARS, STRINGS};
+  Kind kind;
+  std::string key_type;
+  FlatMap<MapKey, DataObject, MapKeyHash> table;
+  // the key for a value (false if it is nil)
+  bool key_of(const DataObject& val, MapKeyView& key) const;
+};
+
+struct DataObject::SharedMap {Map map; std::atomic<size_t> refs;};
+
+
 //----------------------------------------------------------------------
 // CONSTRUCTION
 //----------------------------------------------------------------------
 
-DataObject::DataObject()
+inline DataObject::DataObject()
 {
   set_nil();
 }
 
-DataObject::DataObject(int val)
+inline DataObject::DataObject(int val)
 {
   set(val);
 }
 
-DataObject::DataObject(double val)
+inline DataObject::DataObject(double val)
 {
   set(val);
 }
 
-DataObject::DataObject(const char* val)
+inline DataObject::DataObject(const char* val)
 {
   set(std::string(val));
 }
 
-DataObject::DataObject(const std::string& val)
+inline DataObject::DataObject(const std::string& val)
+{
+  set(val);
+}
+
+inline DataObject::DataObject(std::string&& val)
+{
+  set(std::move(val));
+}
+
+inline DataObject::DataObject(char val)
 {
   set(val);
 }
 
-DataObject::DataObject(char val)
+inline DataObject::DataObject(bool val)
 {
   set(val);
 }
 
-DataObject::DataObject(bool val)
+inline DataObject::DataObject(size_t val)
+{
+  set(val);
+}
+inline DataObject::DataObject(vector<vector<double>> val)
 {
   set(val);
 }
 
-DataObject::DataObject(size_t val)
+inline DataObject::DataObject(const Matrix& val)
 {
   set(val);
 }
-DataObject::DataObject(vector<vector<double>> val)
+
+inline DataObject::DataObject(Matrix&& val)
+{
+  set(std::move(val));
+}
+
+inline DataObject::DataObject(const Array& val)
 {
   set(val);
 }
 
+inline DataObject::DataObject(Array&& val)
+{
+  set(std::move(val));
+}
+
+inline DataObject::DataObject(const Map& val)
+{
+  set(val);
+}
+
+inline DataObject::DataObject(Map&& val)
+{
+  set(std::move(val));
+}
+
 //----------------------------------------------------------------------
 // DESTRUCTION
 //----------------------------------------------------------------------
-void DataObject::delete_obj()
+inline void DataObject::delete_obj()
 {
   if (value_type == DataType::INTEGER)
     delete (int*)value_ptr;
   else if (value_type == DataType::DOUBLE)
     delete (double*)value_ptr;
-  else if (value_type == DataType::STRING)
-    delete (std::string*)value_ptr;
+  else if (value_type == DataType::STRING) {
+    SharedString* str = (SharedString*)value_ptr;
+    if (--str->refs == 0)
+      delete str;
+  }
   else if (value_type == DataType::CHAR)
     delete (char*)value_ptr;
   else if (value_type == DataType::BOOL)
     delete (bool*)value_ptr;
   else if (value_type == DataType::OID)
     delete (size_t*)value_ptr;
-     else if (value_type == DataType::MATRIX)
-    delete (vector<vector<double>>*)value_ptr;
+  else if (value_type == DataType::MATRIX) {
+    SharedMatrix* m = (SharedMatrix*)value_ptr;
+    if (--m->refs == 0)
+      delete m;
+  }
+  else if (value_type == DataType::ARRAY) {
+    SharedArray* a = (SharedArray*)value_ptr;
+    if (--a->refs == 0)
+      delete a;
+  }
+  else if (value_type == DataType::MAP) {
+    SharedMap* m = (SharedMap*)value_ptr;
+    if (--m->refs == 0)
+      delete m;
+  }
 }
 
-DataObject::~DataObject()
+inline DataObject::~DataObject()
 {
   delete_obj();
 }
@@ -147,12 +363,12 @@ DataObject::~DataObject()
 // COPYING
 //----------------------------------------------------------------------
 
-DataObject::DataObject(const DataObject& rhs)
+inline DataObject::DataObject(const DataObject& rhs)
 {
   *this = rhs;
 }
 
-DataObject& DataObject::operator=(const DataObject& rhs)
+inline DataObject& DataObject::operator=(const DataObject& rhs)
 {
   if (this == &rhs)
     return *this;
@@ -167,9 +383,11 @@ DataObject& DataObject::operator=(const DataObject& rhs)
     set(v);
   }
   else if (rhs.is_string()) {
-    std::string v;
-    rhs.value(v);
-    set(v);
+    SharedString* str = (SharedString*)rhs.value_ptr;
+    ++str->refs;
+    delete_obj();
+    value_ptr = str;
+    value_type = DataType::STRING;
   }
   else if (rhs.is_char()) {
     char v;
@@ -190,81 +408,186 @@ DataObject& DataObject::operator=(const DataObject& rhs)
     set_nil();
   }
   else if (rhs.is_matrix()) {
-  vector<vector<double>> v;
-  rhs.value(v);
-  set(v);
+    // share rhs's matrix (taking the reference first, in case it is
+    // already ours)
+    SharedMatrix* m = (SharedMatrix*)rhs.value_ptr;
+    ++m->refs;
+    delete_obj();
+    value_ptr = m;
+    value_type = DataType::MATRIX;
+  }
+  else if (rhs.is_array()) {
+    SharedArray* a = (SharedArray*)rhs.value_ptr;
+    ++a->refs;
+    delete_obj();
+    value_ptr = a;
+    value_type = DataType::ARRAY;
+  }
+  else if (rhs.is_map()) {
+    SharedMap* m = (SharedMap*)rhs.value_ptr;
+    ++m->refs;
+    delete_obj();
+    value_ptr = m;
+    value_type = DataType::MAP;
   }
   return *this;
 }
 
+inline DataObject::DataObject(DataObject&& rhs) noexcept
+  : value_ptr(rhs.value_ptr), value_type(rhs.value_type)
+{
+  rhs.value_ptr = nullptr;
+  rhs.value_type = DataType::NIL;
+}
+
+inline DataObject& DataObject::operator=(DataObject&& rhs) noexcept
+{
+  if (this == &rhs)
+    return *this;
+  delete_obj();
+  value_ptr = rhs.value_ptr;
+  value_type = rhs.value_type;
+  rhs.value_ptr = nullptr;
+  rhs.value_type = DataType::NIL;
+  return *this;
+}
+
 
 //----------------------------------------------------------------------
 // SET/UPDATE
 //----------------------------------------------------------------------
 
-void DataObject::set(int val)
+inline void DataObject::set(int val)
 {
+  // reuse an int's box
+  if (value_type == DataType::INTEGER) {
+    *((int*)value_ptr) = val;
+    return;
+  }
   delete_obj();
   value_ptr = new int;
+  MYPL_COUNT(++mypl_stats.data_objects);
   *((int*)value_ptr) = val;
   value_type = DataType::INTEGER;
 }
 
-void DataObject::set(double val)
+inline void DataObject::set(double val)
 {
   delete_obj();
   value_ptr = new double;
+  MYPL_COUNT(++mypl_stats.data_objects);
   *((double*)value_ptr) = val;
   value_type = DataType::DOUBLE;
 }
 
-void DataObject::set(const char* val)
+inline void DataObject::set(const char* val)
+{
+  set(std::string(val));
+}
+
+inline void DataObject::set(const std::string& val)
 {
+  // copy before releasing (val may be this object's own string)
+  SharedString* str = new SharedString{val, 1};
+  MYPL_COUNT(++mypl_stats.data_objects);
+  ++string_allocations;
   delete_obj();
-  value_ptr = new std::string;
-  *((std::string*)value_ptr) = val;
+  value_ptr = str;
   value_type = DataType::STRING;
 }
 
-void DataObject::set(const std::string& val)
+inline void DataObject::set(std::string&& val)
 {
+  SharedString* str = new SharedString{std::move(val), 1};
+  MYPL_COUNT(++mypl_stats.data_objects);
+  ++string_allocations;
   delete_obj();
-  value_ptr = new std::string;
-  *((std::string*)value_ptr) = val;
+  value_ptr = str;
   value_type = DataType::STRING;
 }
 
-void DataObject::set(char val)
+inline void DataObject::set(char val)
 {
   delete_obj();
   value_ptr = new char;
+  MYPL_COUNT(++mypl_stats.data_objects);
   *((char*)value_ptr) = val;
   value_type = DataType::CHAR;
 }
 
-void DataObject::set(bool val)
+inline void DataObject::set(bool val)
 {
   delete_obj();
   value_ptr = new bool;
+  MYPL_COUNT(++mypl_stats.data_objects);
   *((bool*)value_ptr) = val;
   value_type = DataType::BOOL;
 }
 
-void DataObject::set(size_t val)
+inline void DataObject::set(size_t val)
 {
   delete_obj();
   value_ptr = new size_t;
+  MYPL_COUNT(++mypl_stats.data_objects);
   *((size_t*)value_ptr) = val;
   value_type = DataType::OID;
 }
-void DataObject::set(vector<vector<double>> val)
+inline void DataObject::set(vector<vector<double>> val)
+{
+  set(Matrix(val));
+}
+inline void DataObject::set(const Matrix& val)
+{
+  // copy before releasing (val may be this object's own matrix)
+  SharedMatrix* m = new SharedMatrix{val, 1};
+  MYPL_COUNT(++mypl_stats.data_objects);
+  ++matrix_allocations;
+  delete_obj();
+  value_ptr = m;
+  value_type = DataType::MATRIX;
+}
+inline void DataObject::set(Matrix&& val)
 {
+  SharedMatrix* m = new SharedMatrix{std::move(val), 1};
+  MYPL_COUNT(++mypl_stats.data_objects);
+  ++matrix_allocations;
   delete_obj();
-  value_ptr = new vector<vector<double>>;
-  *((vector<vector<double>>*)value_ptr) = val;
+  value_ptr = m;
   value_type = DataType::MATRIX;
 }
-void DataObject::set_nil() 
+inline void DataObject::set(const Array& val)
+{
+  SharedArray* a = new SharedArray{val, 1};
+  MYPL_COUNT(++mypl_stats.data_objects);
+  delete_obj();
+  value_ptr = a;
+  value_type = DataType::ARRAY;
+}
+inline void DataObject::set(Array&& val)
+{
+  SharedArray* a = new SharedArray{std::move(val), 1};
+  MYPL_COUNT(++mypl_stats.data_objects);
+  delete_obj();
+  value_ptr = a;
+  value_type = DataType::ARRAY;
+}
+inline void DataObject::set(const Map& val)
+{
+  SharedMap* m = new SharedMap{val, 1};
+  MYPL_COUNT(++mypl_stats.data_objects);
+  delete_obj();
+  value_ptr = m;
+  value_type = DataType::MAP;
+}
+inline void DataObject::set(Map&& val)
+{
+  SharedMap* m = new SharedMap{std::move(val), 1};
+  MYPL_COUNT(++mypl_stats.data_objects);
+  delete_obj();
+  value_ptr = m;
+  value_type = DataType::MAP;
+}
+inline void DataObject::set_nil() 
 {
   delete_obj();
   value_ptr = nullptr;
@@ -276,47 +599,55 @@ void DataObject::set_nil()
 // GET TYPE
 //----------------------------------------------------------------------
 
-DataObject::DataType DataObject::type() const
+inline DataObject::DataType DataObject::type() const
 {
   return value_type;
 }
 
-bool DataObject::is_nil() const
+inline bool DataObject::is_nil() const
 {
   return type() == DataType::NIL;
 }
 
-bool DataObject::is_integer() const
+inline bool DataObject::is_integer() const
 {
   return type() == DataType::INTEGER;
 }
 
-bool DataObject::is_double() const
+inline bool DataObject::is_double() const
 {
   return type() == DataType::DOUBLE;
 }
 
-bool DataObject::is_string() const
+inline bool DataObject::is_string() const
 {
   return type() == DataType::STRING;
 }
 
-bool DataObject::is_char() const
+inline bool DataObject::is_char() const
 {
   return type() == DataType::CHAR;
 }
 
-bool DataObject::is_bool() const
+inline bool DataObject::is_bool() const
 {
   return type() == DataType::BOOL;
 }
-bool DataObject::is_matrix() const
+inline bool DataObject::is_matrix() const
 {
   return type() == DataType::MATRIX;
 }
+inline bool DataObject::is_array() const
+{
+  return type() == DataType::ARRAY;
+}
+inline bool DataObject::is_map() const
+{
+  return type() == DataType::MAP;
+}
 
 
-bool DataObject::is_oid() const
+inline bool DataObject::is_oid() const
 {
   return type() == DataType::OID;
 }
@@ -326,7 +657,7 @@ bool DataObject::is_oid() const
 // GET THE VALUE
 //----------------------------------------------------------------------
 
-bool DataObject::value(int& val) const
+inline bool DataObject::value(int& val) const
 {
   if (value_type != DataType::INTEGER or !value_ptr)
     return false;
@@ -334,7 +665,7 @@ bool DataObject::value(int& val) const
   return true;
 }
 
-bool DataObject::value(double& val) const
+inline bool DataObject::value(double& val) const
 {
   if (value_type != DataType::DOUBLE or !value_ptr)
     return false;
@@ -342,15 +673,15 @@ bool DataObject::value(double& val) const
   return true;
 }
 
-bool DataObject::value(std::string& val) const
+inline bool DataObject::value(std::string& val) const
 {
   if (value_type != DataType::STRING or !value_ptr)
     return false;
-  val = *((std::string*)value_ptr);
+  val = ((SharedString*)value_ptr)->str;
   return true;
 }
 
-bool DataObject::value(char& val) const
+inline bool DataObject::value(char& val) const
 {
   if (value_type != DataType::CHAR or !value_ptr)
     return false;
@@ -358,7 +689,7 @@ bool DataObject::value(char& val) const
   return true;
 }
 
-bool DataObject::value(bool& val) const
+inline bool DataObject::value(bool& val) const
 {
   if (value_type != DataType::BOOL or !value_ptr)
     return false;
@@ -366,27 +697,148 @@ bool DataObject::value(bool& val) const
   return true;
 }
 
-bool DataObject::value(size_t& val) const  
+inline bool DataObject::value(size_t& val) const  
 {
   if (value_type != DataType::OID or !value_ptr)
     return false;
   val = *((size_t*)value_ptr);
   return true;
 }
-bool DataObject::value(vector<vector<double>>& val) const
+inline bool DataObject::value(vector<vector<double>>& val) const
+{
+  if (value_type != DataType::MATRIX or !value_ptr)
+    return false;
+  val = ((SharedMatrix*)value_ptr)->matrix.to_nested();
+  return true;
+}
+inline bool DataObject::value(Matrix& val) const
 {
   if (value_type != DataType::MATRIX or !value_ptr)
     return false;
-  val = *((vector<vector<double>>*)value_ptr);
+  val = ((SharedMatrix*)value_ptr)->matrix;
   return true;
 }
+inline const std::string* DataObject::string_ptr() const
+{
+  if (value_type != DataType::STRING)
+    return nullptr;
+  return &((SharedString*)value_ptr)->str;
+}
+inline std::string* DataObject::mutable_string_ptr()
+{
+  if (value_type != DataType::STRING)
+    return nullptr;
+  SharedString* str = (SharedString*)value_ptr;
+  if (str->refs > 1) {
+    SharedString* shared = str;
+    str = new SharedString{shared->str, 1};
+    if (--shared->refs == 0)
+      delete shared;
+    MYPL_COUNT(++mypl_stats.data_objects);
+    ++string_allocations;
+    value_ptr = str;
+  }
+  return &str->str;
+}
+inline void DataObject::append(const std::string& val)
+{
+  SharedString* str = (SharedString*)value_ptr;
+  if (str->refs > 1) {
+    std::string joined;
+    joined.reserve(str->str.size() + val.size());
+    joined += str->str;
+    joined += val;
+    set(std::move(joined));
+  }
+  else
+    str->str += val;
+}
+inline void DataObject::append(char val)
+{
+  SharedString* str = (SharedString*)value_ptr;
+  if (str->refs > 1) {
+    std::string joined;
+    joined.reserve(str->str.size() + 1);
+    joined += str->str;
+    joined += val;
+    set(std::move(joined));
+  }
+  else
+    str->str += val;
+}
+inline const Matrix* DataObject::matrix_ptr() const
+{
+  if (value_type != DataType::MATRIX)
+    return nullptr;
+  return &((SharedMatrix*)value_ptr)->matrix;
+}
+inline Matrix* DataObject::mutable_matrix_ptr()
+{
+  if (value_type != DataType::MATRIX)
+    return nullptr;
+  SharedMatrix* m = (SharedMatrix*)value_ptr;
+  if (m->refs > 1) {
+    // other copies still see the old values (copied before letting go,
+    // since the last other copy may be released meanwhile)
+    SharedMatrix* shared = m;
+    m = new SharedMatrix{shared->matrix, 1};
+    if (--shared->refs == 0)
+      delete shared;
+    MYPL_COUNT(++mypl_stats.data_objects);
+    value_ptr = m;
+    ++matrix_allocations;
+  }
+  return &m->matrix;
+}
+inline const Array* DataObject::array_ptr() const
+{
+  if (value_type != DataType::ARRAY)
+    return nullptr;
+  return &((SharedArray*)value_ptr)->array;
+}
+inline Array* DataObject::mutable_array_ptr()
+{
+  if (value_type != DataType::ARRAY)
+    return nullptr;
+  SharedArray* a = (SharedArray*)value_ptr;
+  if (a->refs > 1) {
+    SharedArray* shared = a;
+    a = new SharedArray{shared->array, 1};
+    if (--shared->refs == 0)
+      delete shared;
+    MYPL_COUNT(++mypl_stats.data_objects);
+    value_ptr = a;
+  }
+  return &a->array;
+}
+inline const Map* DataObject::map_ptr() const
+{
+  if (value_type != DataType::MAP)
+    return nullptr;
+  return &((SharedMap*)value_ptr)->map;
+}
+inline Map* DataObject::mutable_map_ptr()
+{
+  if (value_type != DataType::MAP)
+    return nullptr;
+  SharedMap* m = (SharedMap*)value_ptr;
+  if (m->refs > 1) {
+    SharedMap* shared = m;
+    m = new SharedMap{shared->map, 1};
+    if (--shared->refs == 0)
+      delete shared;
+    MYPL_COUNT(++mypl_stats.data_objects);
+    value_ptr = m;
+  }
+  return &m->map;
+}
 
 
 //----------------------------------------------------------------------
 // GET A STRING REPRESENTATION
 //----------------------------------------------------------------------
 
-std::string DataObject::to_string() const
+inline std::string DataObject::to_string() const
 {
   if (!value_ptr or value_type == DataType::NIL)
     return "";
@@ -395,7 +847,7 @@ std::string DataObject::to_string() const
   else if (value_type == DataType::DOUBLE)
     return std::to_string(*((double*)value_ptr));
   else if (value_type == DataType::STRING)
-    return *((std::string*)value_ptr);
+    return ((SharedString*)value_ptr)->str;
   else if (value_type == DataType::CHAR)
     return std::to_string(*((char*)value_ptr));
   else if (value_type == DataType::BOOL)
@@ -408,4 +860,202 @@ std::string DataObject::to_string() const
 
 
 
+//----------------------------------------------------------------------
+// ARRAY STORAGE
+//----------------------------------------------------------------------
+
+inline Array::Array(const std::string& elem_type)
+{
+  if (elem_type == "int")
+    kind = INTS;
+  else if (elem_type == "double")
+    kind = DOUBLES;
+  else if (elem_type == "bool")
+    kind = BOOLS;
+  else if (elem_type == "char")
+    kind = CHARS;
+  else
+    kind = OBJECTS;
+}
+
+inline size_t Array::size() const
+{
+  if (kind == INTS)
+    return ints.size();
+  else if (kind == DOUBLES)
+    return doubles.size();
+  else if (kind == OBJECTS)
+    return objects.size();
+  return chars.size();
+}
+
+inline void Array::get(size_t i, DataObject& val) const
+{
+  if (kind == INTS)
+    val.set(ints[i]);
+  else if (kind == DOUBLES)
+    val.set(doubles[i]);
+  else if (kind == BOOLS)
+    val.set(chars[i] != 0);
+  else if (kind == CHARS)
+    val.set(chars[i]);
+  else
+    val = objects[i];
+}
+
+inline bool Array::set(size_t i, const DataObject& val)
+{
+  bool b = false;
+  if (kind == INTS)
+    return val.value(ints[i]);
+  else if (kind == DOUBLES)
+    return val.value(doubles[i]);
+  else if (kind == CHARS)
+    return val.value(chars[i]);
+  else if (kind == BOOLS) {
+    if (!val.value(b))
+      return false;
+    chars[i] = b;
+    return true;
+  }
+  objects[i] = val;
+  return true;
+}
+
+inline bool Array::push(const DataObject& val)
+{
+  if (kind == INTS)
+    ints.emplace_back();
+  else if (kind == DOUBLES)
+    doubles.emplace_back();
+  else if (kind == OBJECTS)
+    objects.emplace_back();
+  else
+    chars.emplace_back();
+  if (set(size() - 1, val))
+    return true;
+  DataObject last;
+  pop(last);
+  return false;
+}
+
+inline void Array::pop(DataObject& val)
+{
+  get(size() - 1, val);
+  if (kind == INTS)
+    ints.pop_back();
+  else if (kind == DOUBLES)
+    doubles.pop_back();
+  else if (kind == OBJECTS)
+    objects.pop_back();
+  else
+    chars.pop_back();
+}
+
+inline DataObject* Array::object(size_t i)
+{
+  return kind == OBJECTS ? &objects[i] : nullptr;
+}
+
+
+//----------------------------------------------------------------------
+// MAP STORAGE
+//----------------------------------------------------------------------
+
+inline Map::Map(const std::string& key_type)
+  : key_type(key_type)
+{
+  if (key_type == "int")
+    kind = INTS;
+  else if (key_type == "double")
+    kind = DOUBLES;
+  else if (key_type == "bool")
+    kind = BOOLS;
+  else if (key_type == "char")
+    kind = CHARS;
+  else
+    kind = STRINGS;
+}
+
+inline size_t Map::size() const
+{
+  return table.size();
+}
+
+inline bool Map::key_of(const DataObject& val, MapKeyView& key) const
+{
+  const std::string* str = nullptr;
+  int i = 0;
+  double d = 0.0;
+  bool b = false;
+  char c = 0;
+  if (kind == INTS and val.value(i))
+    key.n = i;
+  else if (kind == DOUBLES and val.value(d)) {
+    // 0.0 and -0.0 are the same key
+    if (d == 0.0)
+      d = 0.0;
+    std::memcpy(&key.n, &d, sizeof(d));
+  }
+  else if (kind == BOOLS and val.value(b))
+    key.n = b;
+  else if (kind == CHARS and val.value(c))
+    key.n = c;
+  else if (kind == STRINGS and (str = val.string_ptr()))
+    key.s = *str;
+  else
+    return false;
+  return true;
+}
+
+inline const DataObject* Map::find(const DataObject& key) const
+{
+  MapKeyView k;
+  if (!key_of(key, k))
+    return nullptr;
+  return table.find(k);
+}
+
+inline bool Map::put(const DataObject& key, const DataObject& val)
+{
+  MapKeyView k;
+  if (!key_of(key, k))
+    return false;
+  // (an existing key's value is replaced in place)
+  if (DataObject* existing = table.find(k)) {
+    *existing = val;
+    return true;
+  }
+  table.put(MapKey{k.n, std::string(k.s)}, val);
+  return true;
+}
+
+inline bool Map::remove(const DataObject& key)
+{
+  MapKeyView k;
+  if (!key_of(key, k))
+    return false;
+  return table.remove(k);
+}
+
+inline void Map::keys(Array& out) const
+{
+  table.for_each([&](const MapKey& k, const DataObject& val) {
+    double d = 0.0;
+    if (kind == INTS)
+      out.push((int)k.n);
+    else if (kind == DOUBLES) {
+      std::memcpy(&d, &k.n, sizeof(d));
+      out.push(d);
+    }
+    else if (kind == BOOLS)
+      out.push(k.n != 0);
+    else if (kind == CHARS)
+      out.push((char)k.n);
+    else
+      out.push(k.s);
+  });
+}
+
+
 #endif
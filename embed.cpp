@@ -0,0 +1,146 @@
+//----------------------------------------------------------------------
+// FILE: embed.cpp
+// DESC: The C++ embedding API (see embed.h).
+//----------------------------------------------------------------------
+
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include "token.h"
+#include "mypl_exception.h"
+#include "lexer.h"
+#include "parser.h"
+#include "parallel_parser.h"
+#include "modules.h"
+#include "ast.h"
+#include "type_checker.h"
+#include "interpreter.h"
+#include "ast_cache.h"
+#include "embed.h"
+
+
+// passes writes on to another stream buffer, one write at a time (it
+// has no buffer of its own, so every write takes the lock)
+class LockedOutput : public std::streambuf
+{
+public:
+  explicit LockedOutput(std::streambuf* target) : target(target) {}
+protected:
+  int overflow(int c) override;
+  std::streamsize xsputn(const char* s, std::streamsize n) override;
+  int sync() override;
+private:
+  std::streambuf* target;
+  std::mutex lock;
+};
+
+
+int LockedOutput::overflow(int c)
+{
+  if (c == traits_type::eof())
+    return traits_type::not_eof(c);
+  std::lock_guard<std::mutex> guard(lock);
+  return target->sputc((char)c);
+}
+
+
+std::streamsize LockedOutput::xsputn(const char* s, std::streamsize n)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return target->sputn(s, n);
+}
+
+
+int LockedOutput::sync()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return target->pubsync();
+}
+
+
+std::shared_ptr<const CompiledProgram> CompiledProgram::compile(const std::string& source,
+                                                                const std::string& path,
+                                                                bool use_cache)
+{
+  // as mypl does (imported modules come first, and the cache key of
+  // the program covers them)
+  use_cache = use_cache and path != "";
+  ModuleLoader modules(use_cache);
+  std::vector<Module*> imports = modules.load_imports(source, path);
+  uint64_t hash = ModuleLoader::key(source, imports);
+  Program ast_root_node;
+  std::string cache_path = path + ".myplc";
+  if (!use_cache or !load_program_cache(cache_path, hash, ast_root_node)) {
+    parse_source(source, ast_root_node);
+    TypeChecker type_checker;
+    modules.link(type_checker, imports);
+    ast_root_node.accept(type_checker);
+    if (use_cache)
+      save_program_cache(cache_path, hash, ast_root_node);
+  }
+  modules.link(ast_root_node, imports);
+  std::shared_ptr<CompiledProgram> compiled(new CompiledProgram);
+  compiled->hash = hash;
+  compiled->image = AstWriter().write(ast_root_node, hash);
+  compiled->module_sources = modules.sources();
+  return compiled;
+}
+
+
+std::shared_ptr<const CompiledProgram> CompiledProgram::compile_file(const std::string& path,
+                                                                     bool use_cache)
+{
+  std::ifstream file(path);
+  if (!file)
+    throw MyPLException(SEMANTIC, "cannot open '" + path + "'");
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return compile(buffer.str(), path, use_cache);
+}
+
+
+ProgramInstance::ProgramInstance(std::shared_ptr<const CompiledProgram> program)
+  : compiled(std::move(program))
+{
+}
+
+
+ProgramInstance::~ProgramInstance()
+{
+}
+
+
+int ProgramInstance::run(std::istream& in, std::ostream& out)
+{
+  if (!ast) {
+    ast.reset(new Program);
+    AstReader reader(compiled->image.data(), compiled->image.size());
+    reader.leave_bodies(compiled);
+    reader.read(*ast, compiled->hash);
+  }
+  LockedOutput locked(out.rdbuf());
+  std::ostream shared_out(&locked);
+  Interpreter interpreter(in, shared_out);
+  ast->accept(interpreter);
+  shared_out.flush();
+  return interpreter.return_code();
+}
+
+
+int ProgramInstance::run(const std::string& input, std::string& output)
+{
+  std::istringstream in(input);
+  std::ostringstream out;
+  try {
+    int code = run(in, out);
+    output += out.str();
+    return code;
+  }
+  catch (...) {
+    // (the output before the error)
+    output += out.str();
+    throw;
+  }
+}
@@ -0,0 +1,87 @@
+//----------------------------------------------------------------------
+// FILE: embed.h
+// DESC: The C++ embedding API (the mypl_embed library; see embed_c.h
+//       for C). A program is compiled once into a CompiledProgram,
+//       which is not changed afterwards and may be shared by any number
+//       of threads. It is run by ProgramInstances: independent
+//       interpreters, each with its own heap, environments, and AST,
+//       and with standard input and output given for each run. The
+//       instances of one program may run at the same time, each on one
+//       thread at a time.
+//----------------------------------------------------------------------
+
+#ifndef EMBED_H
+#define EMBED_H
+
+#include <cstdint>
+#include <exception>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "mypl_exception.h"
+
+class Program;
+
+
+class CompiledProgram
+{
+public:
+
+  // compile a source, throwing a MyPLException on errors; path names
+  // its file ("" if none), which its imports are relative to, and with
+  // use_cache the .myplc caches of the file and its modules are used
+  static std::shared_ptr<const CompiledProgram> compile(const std::string& source,
+                                                        const std::string& path = "",
+                                                        bool use_cache = false);
+
+  // compile a file
+  static std::shared_ptr<const CompiledProgram> compile_file(const std::string& path,
+                                                             bool use_cache = true);
+
+  // the real path and source hash of each module the program imports
+  const std::vector<std::pair<std::string, uint64_t>>& modules() const {return module_sources;}
+
+private:
+
+  CompiledProgram() = default;
+  friend class ProgramInstance;
+
+  // the checked program (with its modules' declarations) as a cache
+  // image, from which each instance builds its AST
+  uint64_t hash = 0;
+  std::string image;
+  std::vector<std::pair<std::string, uint64_t>> module_sources;
+};
+
+
+class ProgramInstance
+{
+public:
+
+  explicit ProgramInstance(std::shared_ptr<const CompiledProgram> program);
+  ~ProgramInstance();
+
+  // run the program's main with the given standard input and output
+  // (writes from parfor loops take turns), and return its exit code;
+  // runtime errors are thrown as MyPLExceptions (input is read a buffer
+  // at a time, so the run may take more of it than main uses)
+  int run(std::istream& in, std::ostream& out);
+
+  // run with input from a string, appending the output to a string
+  int run(const std::string& input, std::string& output);
+
+  const std::shared_ptr<const CompiledProgram>& program() const {return compiled;}
+
+private:
+
+  std::shared_ptr<const CompiledProgram> compiled;
+
+  // built on the first run and kept for the next (the interpreter
+  // caches call targets in it)
+  std::unique_ptr<Program> ast;
+};
+
+
+#endif
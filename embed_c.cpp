@@ -0,0 +1,153 @@
+//----------------------------------------------------------------------
+// FILE: embed_c.cpp
+// DESC: The C embedding API (see embed_c.h). No exception crosses it:
+//       errors become messages.
+//----------------------------------------------------------------------
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include "embed.h"
+#include "embed_c.h"
+
+
+struct mypl_program
+{
+  std::shared_ptr<const CompiledProgram> program;
+};
+
+
+struct mypl_instance
+{
+  ProgramInstance instance;
+};
+
+
+// passes buffered output to a write function
+class CallbackOutput : public std::streambuf
+{
+public:
+  CallbackOutput(mypl_write_fn write, void* context);
+protected:
+  int overflow(int c) override;
+  int sync() override;
+private:
+  mypl_write_fn write;
+  void* context;
+  char buffer[4096];
+};
+
+
+CallbackOutput::CallbackOutput(mypl_write_fn write, void* context)
+  : write(write), context(context)
+{
+  setp(buffer, buffer + sizeof(buffer));
+}
+
+
+int CallbackOutput::overflow(int c)
+{
+  sync();
+  if (c != traits_type::eof()) {
+    *pptr() = (char)c;
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+
+int CallbackOutput::sync()
+{
+  if (pptr() > pbase() and write)
+    write(context, pbase(), pptr() - pbase());
+  setp(buffer, buffer + sizeof(buffer));
+  return 0;
+}
+
+
+// a message for the caller to free with mypl_free
+static char* error_message(const std::string& msg)
+{
+  char* copy = (char*)malloc(msg.size() + 1);
+  if (copy)
+    memcpy(copy, msg.c_str(), msg.size() + 1);
+  return copy;
+}
+
+
+mypl_program* mypl_compile(const char* source, size_t size, const char* path, char** error)
+{
+  try {
+    return new mypl_program {CompiledProgram::compile(std::string(source, size), path ? path : "")};
+  } catch (const MyPLException& e) {
+    *error = error_message(e.to_string());
+  } catch (const std::exception& e) {
+    *error = error_message(e.what());
+  }
+  return nullptr;
+}
+
+
+mypl_program* mypl_compile_file(const char* path, char** error)
+{
+  try {
+    return new mypl_program {CompiledProgram::compile_file(path)};
+  } catch (const MyPLException& e) {
+    *error = error_message(e.to_string());
+  } catch (const std::exception& e) {
+    *error = error_message(e.what());
+  }
+  return nullptr;
+}
+
+
+void mypl_program_free(mypl_program* program)
+{
+  delete program;
+}
+
+
+mypl_instance* mypl_instance_new(const mypl_program* program)
+{
+  try {
+    return new mypl_instance {ProgramInstance(program->program)};
+  } catch (const std::exception&) {
+    return nullptr;
+  }
+}
+
+
+void mypl_instance_free(mypl_instance* instance)
+{
+  delete instance;
+}
+
+
+int mypl_run(mypl_instance* instance, const char* input, size_t size,
+             mypl_write_fn write, void* context, int* exit_code, char** error)
+{
+  CallbackOutput buffer(write, context);
+  std::ostream out(&buffer);
+  std::istringstream in(std::string(input ? input : "", input ? size : 0));
+  try {
+    *exit_code = instance->instance.run(in, out);
+    out.flush();
+    return 0;
+  } catch (const MyPLException& e) {
+    *error = error_message(e.to_string());
+  } catch (const std::exception& e) {
+    *error = error_message(e.what());
+  }
+  // (the output before the error)
+  out.flush();
+  return -1;
+}
+
+
+void mypl_free(void* p)
+{
+  free(p);
+}
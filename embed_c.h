@@ -0,0 +1,48 @@
+/*----------------------------------------------------------------------
+ * FILE: embed_c.h
+ * DESC: The C embedding API (the mypl_embed library), over the C++ one
+ *       in embed.h. A compiled program may be shared by threads; each
+ *       instance runs on one thread at a time. Error messages are
+ *       allocated, and freed with mypl_free.
+ *----------------------------------------------------------------------*/
+
+#ifndef EMBED_C_H
+#define EMBED_C_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+typedef struct mypl_program mypl_program;
+typedef struct mypl_instance mypl_instance;
+
+/* receives a run's output as it is written */
+typedef void (*mypl_write_fn)(void* context, const char* data, size_t size);
+
+/* compile a source (path names its file, for its imports, or is NULL)
+ * or a file (using its .myplc cache); NULL with *error set on errors */
+mypl_program* mypl_compile(const char* source, size_t size, const char* path, char** error);
+mypl_program* mypl_compile_file(const char* path, char** error);
+void mypl_program_free(mypl_program* program);
+
+/* an interpreter for a compiled program (which must outlive it) */
+mypl_instance* mypl_instance_new(const mypl_program* program);
+void mypl_instance_free(mypl_instance* instance);
+
+/* run main with the size bytes of input as its standard input and its
+ * output passed to write (with context); returns 0 with *exit_code
+ * set, or -1 with *error set on a runtime error */
+int mypl_run(mypl_instance* instance, const char* input, size_t size,
+             mypl_write_fn write, void* context, int* exit_code, char** error);
+
+void mypl_free(void* p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,210 @@
+//----------------------------------------------------------------------
+// FILE: flat_map.h
+// DESC: Open addressing hash table storage for MyPL map values, shared
+//       by the interpreter (data_object.h) and translated programs
+//       (mypl_runtime.h) so both visit keys in the same order.
+//       Entries are kept in one vector in insertion order; the slot
+//       table probes linearly and holds entry numbers. Removed entries
+//       stay behind (as do their slots) until the next rebuild, which
+//       compacts the entries and rehashes them into a table of at most
+//       half load.
+//----------------------------------------------------------------------
+
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// finish a hash (the murmur3 64-bit finalizer), so that nearby keys
+// spread over the whole table
+inline uint64_t hash_mix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// hash a string eight bytes at a time
+inline uint64_t hash_bytes(const char* data, size_t size)
+{
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ size;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    h = hash_mix(h ^ word) * 0x9e3779b97f4a7c15ULL;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, data + i, size - i);
+  return hash_mix(h ^ tail);
+}
+
+inline uint64_t hash_double(double x)
+{
+  // 0.0 and -0.0 are equal keys
+  if (x == 0.0)
+    x = 0.0;
+  uint64_t bits;
+  std::memcpy(&bits, &x, 8);
+  return hash_mix(bits);
+}
+
+
+template<typename K, typename V, typename Hash>
+class FlatMap
+{
+public:
+
+  // number of keys
+  size_t size() const {return live;}
+
+  // the value of a key (nullptr if the key is not in the map); the key
+  // may be of any type Hash takes that compares equal to K keys
+  template<typename Q>
+  V* find(const Q& key);
+  template<typename Q>
+  const V* find(const Q& key) const;
+
+  // set the value of a key, adding the key after the others if new
+  void put(const K& key, V value);
+
+  // remove a key (false if it was not in the map)
+  template<typename Q>
+  bool remove(const Q& key);
+
+  // call f(key, value) for each key, in insertion order
+  template<typename F>
+  void for_each(F f) const;
+
+private:
+  struct Entry {K key; V value; uint64_t hash; bool live;};
+  static constexpr uint32_t EMPTY = 0;
+  static constexpr uint32_t REMOVED = UINT32_MAX;
+
+  std::vector<Entry> entries;
+  std::vector<uint32_t> slots;          // entry number + 1, EMPTY, or REMOVED
+  size_t live = 0;
+
+  // the slot holding a key (-1 if none)
+  template<typename Q>
+  long slot_of(const Q& key, uint64_t hash) const;
+  // compact the entries and rehash them into a large enough table
+  void rebuild();
+};
+
+
+template<typename K, typename V, typename Hash>
+template<typename Q>
+long FlatMap<K,V,Hash>::slot_of(const Q& key, uint64_t hash) const
+{
+  if (slots.empty())
+    return -1;
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+    uint32_t s = slots[i];
+    if (s == EMPTY)
+      return -1;
+    if (s != REMOVED) {
+      const Entry& e = entries[s - 1];
+      if (e.hash == hash and e.key == key)
+        return (long)i;
+    }
+  }
+}
+
+template<typename K, typename V, typename Hash>
+template<typename Q>
+V* FlatMap<K,V,Hash>::find(const Q& key)
+{
+  long i = slot_of(key, Hash()(key));
+  return i < 0 ? nullptr : &entries[slots[i] - 1].value;
+}
+
+template<typename K, typename V, typename Hash>
+template<typename Q>
+const V* FlatMap<K,V,Hash>::find(const Q& key) const
+{
+  long i = slot_of(key, Hash()(key));
+  return i < 0 ? nullptr : &entries[slots[i] - 1].value;
+}
+
+template<typename K, typename V, typename Hash>
+void FlatMap<K,V,Hash>::put(const K& key, V value)
+{
+  uint64_t hash = Hash()(key);
+  long i = slot_of(key, hash);
+  if (i >= 0) {
+    entries[slots[i] - 1].value = std::move(value);
+    return;
+  }
+  // every entry (removed or not) may hold a slot
+  if ((entries.size() + 1) * 4 > slots.size() * 3)
+    rebuild();
+  size_t mask = slots.size() - 1;
+  size_t s = hash & mask;
+  while (slots[s] != EMPTY and slots[s] != REMOVED)
+    s = (s + 1) & mask;
+  entries.push_back(Entry{key, std::move(value), hash, true});
+  slots[s] = (uint32_t)entries.size();
+  ++live;
+}
+
+template<typename K, typename V, typename Hash>
+template<typename Q>
+bool FlatMap<K,V,Hash>::remove(const Q& key)
+{
+  long i = slot_of(key, Hash()(key));
+  if (i < 0)
+    return false;
+  Entry& e = entries[slots[i] - 1];
+  e.live = false;
+  e.key = K();
+  e.value = V();
+  slots[i] = REMOVED;
+  --live;
+  return true;
+}
+
+template<typename K, typename V, typename Hash>
+template<typename F>
+void FlatMap<K,V,Hash>::for_each(F f) const
+{
+  for (const Entry& e : entries)
+    if (e.live)
+      f(e.key, e.value);
+}
+
+template<typename K, typename V, typename Hash>
+void FlatMap<K,V,Hash>::rebuild()
+{
+  size_t n = 0;
+  for (size_t i = 0; i < entries.size(); ++i)
+    if (entries[i].live) {
+      if (n != i)
+        entries[n] = std::move(entries[i]);
+      ++n;
+    }
+  entries.resize(n);
+  size_t size = 8;
+  while (size < (n + 1) * 2)
+    size *= 2;
+  slots.assign(size, EMPTY);
+  size_t mask = size - 1;
+  for (size_t i = 0; i < n; ++i) {
+    size_t s = entries[i].hash & mask;
+    while (slots[s] != EMPTY)
+      s = (s + 1) & mask;
+    slots[s] = (uint32_t)(i + 1);
+  }
+}
+
+
+#endif
@@ -7,8 +7,11 @@
 #ifndef HEAP_H
 #define HEAP_H
 
+#include <atomic>
+#include <mutex>
 #include <unordered_map>
 #include "data_object.h"
+#include "stats.h"
 
 
 class HeapObject
@@ -22,6 +25,7 @@ public:
   //   obj -- the attribute (variable) value
   //----------------------------------------------------------------------
   void set_att(const std::string& att, const DataObject& obj);
+  void set_att(const std::string& att, DataObject&& obj);
 
   //----------------------------------------------------------------------
   // Check if the attribute exists in the heap object
@@ -43,6 +47,18 @@ public:
   //----------------------------------------------------------------------
   bool get_val(const std::string& att, DataObject& val);  
 
+  //----------------------------------------------------------------------
+  // Move the value of the given attribute out of the object (leaving it
+  // nil), e.g. to update an array value without copying it
+  // Inputs:
+  //   att -- the attribute to take the value of
+  // Outputs:
+  //   obj -- the value of the object
+  // Returns:
+  //   true if the heap object has the given attribute defined
+  //----------------------------------------------------------------------
+  bool take_val(const std::string& att, DataObject& val);
+
 private:
   std::unordered_map<std::string,DataObject> attribute_values;
 };
@@ -52,6 +68,8 @@ class Heap
 {
 public:
 
+  ~Heap();
+
   //----------------------------------------------------------------------
   // Add or update the oid with the given heap object.
   // Inputs:
@@ -59,6 +77,7 @@ public:
   //   obj -- the value of the oid
   //----------------------------------------------------------------------
   void set_obj(size_t oid, const HeapObject& obj);
+  void set_obj(size_t oid, HeapObject&& obj);
 
   //----------------------------------------------------------------------
   // Check if the oid is in the heap.
@@ -80,8 +99,36 @@ public:
   //----------------------------------------------------------------------
   bool get_obj(size_t oid, HeapObject& obj) const;
 
+  //----------------------------------------------------------------------
+  // Move the user-defined type object associated with given oid out of
+  // the heap (leaving an empty object until it is set again).
+  // Inputs:
+  //   oid -- the oid to look up
+  // Outputs:
+  //   obj -- the heap object associated with the oid
+  // Returns:
+  //   true if the oid is present in the heap, and false otherwise
+  //----------------------------------------------------------------------
+  bool take_obj(size_t oid, HeapObject& obj);
+
+  //----------------------------------------------------------------------
+  // Get an unused oid (safe to call from any thread).
+  //----------------------------------------------------------------------
+  size_t new_oid();
+
+  //----------------------------------------------------------------------
+  // Guard the heap objects with a lock while a parallel loop shares
+  // the heap between threads.
+  // Inputs:
+  //   on -- true when the parallel loop starts, false when it ends
+  //----------------------------------------------------------------------
+  void set_concurrent(bool on);
+
 private:
   std::unordered_map<size_t, HeapObject> heap_objs;
+  std::atomic<size_t> next_oid {0};
+  mutable std::mutex lock;
+  bool concurrent = false;
 };
 
 
@@ -89,17 +136,22 @@ private:
 // HeapObject Member Functions
 //----------------------------------------------------------------------
 
-void HeapObject::set_att(const std::string& att, const DataObject& obj)
+inline void HeapObject::set_att(const std::string& att, const DataObject& obj)
 {
   attribute_values[att] = obj;
 }
 
-bool HeapObject::has_att(const std::string& att) const
+inline void HeapObject::set_att(const std::string& att, DataObject&& obj)
+{
+  attribute_values[att] = std::move(obj);
+}
+
+inline bool HeapObject::has_att(const std::string& att) const
 {
   return attribute_values.count(att) > 0;
 }
 
-bool HeapObject::get_val(const std::string& att, DataObject& val)
+inline bool HeapObject::get_val(const std::string& att, DataObject& val)
 {
   if (!has_att(att))
     return false;
@@ -107,30 +159,101 @@ bool HeapObject::get_val(const std::string& att, DataObject& val)
   return true;
 }
 
+inline bool HeapObject::take_val(const std::string& att, DataObject& val)
+{
+  auto it = attribute_values.find(att);
+  if (it == attribute_values.end())
+    return false;
+  val = std::move(it->second);
+  it->second.set_nil();
+  return true;
+}
+
 
 //----------------------------------------------------------------------
 // Heap Member Functions
 //----------------------------------------------------------------------
 
-void Heap::set_obj(size_t oid, const HeapObject& obj)
+inline Heap::~Heap()
+{
+  MYPL_COUNT(mypl_stats.heap_objects -= heap_objs.size());
+}
+
+
+inline void Heap::set_obj(size_t oid, const HeapObject& obj)
 {
+  std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+  if (concurrent)
+    guard.lock();
+#if MYPL_STATS
+  if (heap_objs.count(oid) == 0)
+    mypl_stats.max_heap_objects =
+      std::max(mypl_stats.max_heap_objects, ++mypl_stats.heap_objects);
+#endif
   heap_objs[oid] = obj;
 }
 
 
-bool Heap::has_obj(size_t oid) const
+inline void Heap::set_obj(size_t oid, HeapObject&& obj)
+{
+  std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+  if (concurrent)
+    guard.lock();
+#if MYPL_STATS
+  if (heap_objs.count(oid) == 0)
+    mypl_stats.max_heap_objects =
+      std::max(mypl_stats.max_heap_objects, ++mypl_stats.heap_objects);
+#endif
+  heap_objs[oid] = std::move(obj);
+}
+
+
+inline bool Heap::has_obj(size_t oid) const
 {
+  std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+  if (concurrent)
+    guard.lock();
   return heap_objs.count(oid) > 0;
 }
 
 
-bool Heap::get_obj(size_t oid, HeapObject& obj) const
+inline bool Heap::get_obj(size_t oid, HeapObject& obj) const
 {
-  if (!has_obj(oid))
+  std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+  if (concurrent)
+    guard.lock();
+  auto it = heap_objs.find(oid);
+  if (it == heap_objs.end())
     return false;
-  obj = heap_objs.at(oid);
+  obj = it->second;
   return true;
 }
 
 
+inline bool Heap::take_obj(size_t oid, HeapObject& obj)
+{
+  std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+  if (concurrent)
+    guard.lock();
+  auto it = heap_objs.find(oid);
+  if (it == heap_objs.end())
+    return false;
+  obj = std::move(it->second);
+  it->second = HeapObject();
+  return true;
+}
+
+
+inline size_t Heap::new_oid()
+{
+  return next_oid++;
+}
+
+
+inline void Heap::set_concurrent(bool on)
+{
+  concurrent = on;
+}
+
+
 #endif
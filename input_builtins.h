@@ -0,0 +1,82 @@
+//----------------------------------------------------------------------
+// FILE: input_builtins.h
+// DESC: Native input built-ins: read_line, read_int, read_double, and
+//       read_matrix, reading standard input through the interpreter's
+//       InputScanner (see input_scanner.h). Numbers are whitespace
+//       separated, wherever the lines break, and are parsed straight
+//       from the input buffer; read_matrix fills the matrix storage
+//       directly. read is in builtins.h.
+//----------------------------------------------------------------------
+
+#ifndef INPUT_BUILTINS_H
+#define INPUT_BUILTINS_H
+
+#include <mutex>
+#include <string>
+#include "builtins.h"
+#include "matrix_builtins.h"
+#include "input_scanner.h"
+
+
+// the next int or double of the input (with the input's lock held)
+template<typename T>
+inline T input_number(NativeContext& ctx, const char* kind)
+{
+  T x = 0;
+  if (!ctx.in.skip_space())
+    ctx.error(std::string("no ") + kind + " value left to read");
+  if (!ctx.in.number(x))
+    ctx.error(std::string("invalid ") + kind + " value '" + ctx.in.word() + "'");
+  return x;
+}
+
+// read_line() is the next line of the input ("" at its end); it is read
+// as a string, where read is typed nil
+inline void native_read_line(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  std::string line;
+  {
+    std::lock_guard<std::mutex> guard(ctx.in.lock);
+    ctx.in.line(line);
+  }
+  result.set(std::move(line));
+}
+
+inline void native_read_int(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  std::lock_guard<std::mutex> guard(ctx.in.lock);
+  result.set(input_number<int>(ctx, "int"));
+}
+
+inline void native_read_double(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  std::lock_guard<std::mutex> guard(ctx.in.lock);
+  result.set(input_number<double>(ctx, "double"));
+}
+
+// read_matrix(rows, cols) reads rows * cols doubles, row by row
+inline void native_read_matrix(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  size_t rows = dimension_arg(ctx, args, 0);
+  size_t cols = dimension_arg(ctx, args, 1);
+  Matrix m(rows, cols);
+  double* values = m.data();
+  {
+    std::lock_guard<std::mutex> guard(ctx.in.lock);
+    for (size_t i = 0; i < m.size(); ++i)
+      values[i] = input_number<double>(ctx, "double");
+  }
+  result.set(std::move(m));
+}
+
+
+inline void add_input_builtins(BuiltinRegistry& r)
+{
+  r.add("read_line", StringVec{"string"}, native_read_line);
+  r.add("read_int", StringVec{"int"}, native_read_int);
+  r.add("read_double", StringVec{"double"}, native_read_double);
+  r.add("read_matrix", StringVec{"int", "int", "matrix"}, native_read_matrix);
+}
+
+
+#endif
@@ -0,0 +1,233 @@
+//----------------------------------------------------------------------
+// FILE: input_scanner.h
+// DESC: Buffered reading of a program's standard input for the read
+//       built-ins (see input_builtins.h, and mypl_runtime.h for
+//       translated programs). Input is read a buffer at a time, lines
+//       are cut out of the buffer, and ints and doubles are parsed in
+//       place with std::from_chars (no string or stream per value).
+//       FileInput is a stream buffer reading a file descriptor
+//       directly, used for standard input in place of the stdio-synced
+//       one (which gives out a character per call).
+//----------------------------------------------------------------------
+
+#ifndef INPUT_SCANNER_H
+#define INPUT_SCANNER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+
+// bytes read at a time (the scanner's buffer grows for longer words)
+const size_t INPUT_BUFFER = 1 << 16;
+
+
+class InputScanner
+{
+public:
+
+  // read from a stream buffer, flushing tie (if any) before each wait
+  // for more input, as an istream does
+  InputScanner(std::streambuf* source, std::ostream* tie = nullptr);
+
+  // the next line, without its newline (false if the input has ended)
+  bool line(std::string& s);
+
+  // skip whitespace (false if the input ends first)
+  bool skip_space();
+
+  // the next word (after skip_space) as a number; false, leaving the
+  // word in place, if it is not one
+  bool number(int& x);
+  bool number(double& x);
+
+  // take the next word (e.g., one that is not a number)
+  std::string word();
+
+  // held by a reading built-in, so threads sharing the input (a
+  // parfor's workers) take turns
+  std::mutex lock;
+
+private:
+
+  // read more into the buffer (moving the unread bytes to its front);
+  // false at the end of the input
+  bool fill();
+
+  // the end of the word at pos (reading until the whole word is in)
+  size_t word_end();
+
+  template<typename T>
+  bool parse(T& x);
+
+  static bool space(char c)
+  {
+    return c == ' ' or c == '\n' or c == '\t' or c == '\r' or c == '\v' or c == '\f';
+  }
+
+  std::streambuf* source;
+  std::ostream* tie;
+  std::string buffer;
+  size_t pos = 0;               // the next unread byte
+  size_t end = 0;               // the end of the bytes read
+};
+
+
+class FileInput : public std::streambuf
+{
+public:
+  explicit FileInput(int fd) : fd(fd) {}
+protected:
+  int underflow() override;
+private:
+  int fd;
+  char buffer[INPUT_BUFFER];
+};
+
+
+//----------------------------------------------------------------------
+// INPUT SCANNER MEMBER FUNCTIONS
+//----------------------------------------------------------------------
+
+inline InputScanner::InputScanner(std::streambuf* source, std::ostream* tie)
+  : source(source), tie(tie), buffer(INPUT_BUFFER, '\0')
+{
+}
+
+
+inline bool InputScanner::fill()
+{
+  if (pos > 0) {
+    std::memmove(&buffer[0], &buffer[pos], end - pos);
+    end -= pos;
+    pos = 0;
+  }
+  if (end == buffer.size())
+    buffer.resize(2 * buffer.size());
+  if (tie)
+    tie->flush();
+  if (!source or source->sgetc() == std::char_traits<char>::eof())
+    return false;
+  // take what is there (at least the character just waited for)
+  std::streamsize n = std::min<std::streamsize>(source->in_avail(), buffer.size() - end);
+  end += source->sgetn(&buffer[end], std::max<std::streamsize>(n, 1));
+  return true;
+}
+
+
+inline bool InputScanner::line(std::string& s)
+{
+  s.clear();
+  while (true) {
+    const char* start = buffer.data() + pos;
+    const char* newline = (const char*)std::memchr(start, '\n', end - pos);
+    if (newline) {
+      s.append(start, newline - start);
+      pos += newline - start + 1;
+      return true;
+    }
+    s.append(start, end - pos);
+    pos = end;
+    // (a last line may have no newline)
+    if (!fill())
+      return !s.empty();
+  }
+}
+
+
+inline bool InputScanner::skip_space()
+{
+  while (true) {
+    while (pos < end and space(buffer[pos]))
+      ++pos;
+    if (pos < end)
+      return true;
+    if (!fill())
+      return false;
+  }
+}
+
+
+inline size_t InputScanner::word_end()
+{
+  size_t i = pos;
+  while (true) {
+    while (i < end and !space(buffer[i]))
+      ++i;
+    if (i < end)
+      return i;
+    // (fill moves the word to the front)
+    size_t length = i - pos;
+    if (!fill())
+      return end;
+    i = length;
+  }
+}
+
+
+template<typename T>
+inline bool InputScanner::parse(T& x)
+{
+  size_t stop = word_end();
+  const char* first = buffer.data() + pos;
+  const char* last = buffer.data() + stop;
+  // from_chars takes no plus sign (stoi and stod do)
+  if (last - first > 1 and first[0] == '+' and first[1] != '-')
+    ++first;
+  std::from_chars_result result = std::from_chars(first, last, x);
+  if (result.ec != std::errc() or result.ptr != last)
+    return false;
+  pos = stop;
+  return true;
+}
+
+
+inline bool InputScanner::number(int& x)
+{
+  return parse(x);
+}
+
+
+inline bool InputScanner::number(double& x)
+{
+  return parse(x);
+}
+
+
+inline std::string InputScanner::word()
+{
+  size_t stop = word_end();
+  std::string w = buffer.substr(pos, stop - pos);
+  pos = stop;
+  return w;
+}
+
+
+//----------------------------------------------------------------------
+// FILE INPUT MEMBER FUNCTIONS
+//----------------------------------------------------------------------
+
+inline int FileInput::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  ssize_t n;
+  do
+    n = ::read(fd, buffer, sizeof(buffer));
+  while (n < 0 and errno == EINTR);
+  // (a terminal may give more input after an end of input)
+  if (n <= 0)
+    return traits_type::eof();
+  setg(buffer, buffer, buffer + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+
+#endif
@@ -8,16 +8,23 @@
 #define INTERPRETER_H
 
 #include <iostream>
+#include <memory>
 #include <unordered_map>
-#include <regex>
 #include "ast.h"
 #include "symbol_table.h"
 #include "data_object.h"
 #include "heap.h"
+#include "builtins.h"
+#include "profiler.h"
+#include "jit.h"
+#include "thread_pool.h"
 #include <vector>
 
 class Interpreter : public Visitor {
 public:
+    Interpreter() = default;
+    // run with the given standard input and output
+    Interpreter(std::istream& in, std::ostream& out);
     // top-level
     void visit(Program& node);
     void visit(FunDecl& node);
@@ -40,9 +47,14 @@ public:
     void visit(IDRValue& node);
     void visit(NegatedRValue& node);
     void visit(MatrixValue& node);
+    void visit(ArrayValue& node);
     void visit(TransposedRValue& node);
     // return code from calling main
     int return_code() const;
+    // profile the run (nullptr, the default, disables profiling)
+    void set_profiler(Profiler* p);
+    // compile hot code (nullptr, the default, only interprets)
+    void set_jit(Jit* j);
 
 private:
     // return exception
@@ -55,14 +67,16 @@ private:
     // holds the previously computed value
     DataObject curr_val;
 
-    // the heap
-    Heap heap;
+    // the heap (a parfor worker uses its parent's)
+    Heap own_heap;
+    Heap* heap = &own_heap;
 
-    // the next oid
-    size_t next_oid = 0;
+    // true for the interpreters running parfor iterations (which run
+    // nested parfor loops sequentially and leave the AST unmodified)
+    bool parallel_worker = false;
 
     // the functions (all within the global environment)
-    std::unordered_map<std::string, FunDecl*> functions;
+    FunctionMap functions;
 
     // the user-defined types (all within the global environment)
     std::unordered_map<std::string, TypeDecl*> types;
@@ -73,22 +87,131 @@ private:
     // the program return code
     int ret_code = 0;
 
+    // the main function (its return value is the program return code)
+    FunDecl* main_fun = nullptr;
+
+    // evaluated arguments of in-progress native calls
+    std::vector<DataObject> arg_stack;
+
+    // evaluated indexes of in-progress array element accesses
+    std::vector<int> index_stack;
+
+    // the buffered standard input (shared with parfor workers)
+    std::shared_ptr<InputScanner> input =
+        std::make_shared<InputScanner>(std::cin.rdbuf(), std::cin.tie());
+
+    // input, output, and call site handed to native functions
+    NativeContext native_ctx {*input, std::cout};
+
+    // the active profiler (if any)
+    Profiler* profiler = nullptr;
+
+    // the JIT (if any) and the values handed to compiled code
+    Jit* jit = nullptr;
+    std::vector<JitValue> jit_slots;
+    std::vector<DataObject*> jit_vars;
+
+    // run a statement (counting it when profiling)
+    void execute(Stmt* stmt);
+
+    // a parfor worker sharing the parent's functions, types, and heap
+    explicit Interpreter(const Interpreter& parent);
+
+    // run a parfor loop's iterations on the thread pool, then combine
+    // the workers' reduction variables into this interpreter's
+    void run_parallel(ForStmt& node);
+
+    // run iterations first to last of a parfor loop (in a worker), given
+    // the values of the loop's shared variables, and return the
+    // values of its reduction variables
+    void run_block(ForStmt& node, const std::vector<DataObject>& shared,
+                   long long first, long long last, std::vector<DataObject>& partials);
+
+    // resolve the call target (built-in or user-defined) of a call
+    void resolve_call(const CallExpr& node, FunDecl*& fun_decl, const NativeFunction*& native);
+
+    // call a user-defined function
+    void call_function(CallExpr& node, FunDecl& fun_node);
+
+    // call a native (built-in) function
+    void call_native(CallExpr& node, const NativeFunction& native);
+
+    // evaluate array element indexes onto the index stack
+    void push_indexes(std::list<Expr*>& indexes);
+
+    // the array element of val at the indexes on the stack from base on
+    // (into curr_val), and the same element set to elem
+    void get_element(const DataObject& val, size_t base, const Token& token);
+    void set_element(DataObject& val, size_t base, const DataObject& elem, const Token& token);
+
+    // assign an array element (the rhs value is in curr_val)
+    void assign_element(AssignStmt& node);
+
+    // the heap id of the object holding the last field of a path (for
+    // x.f1...fn, the object x.f1...f(n-1)); an error if one is nil
+    size_t field_object(const std::list<Token>& path);
+
+    // run a for-in loop over an array's elements
+    void run_each(ForStmt& node);
+
+    // run a hot function as compiled code (false if it is interpreted)
+    bool call_compiled(FunDecl& fun, const std::list<DataObject>& args);
+
+    // finish a hot loop as compiled code (false if it is interpreted);
+    // a for loop passes its counter and end value
+    bool run_compiled_loop(Stmt& loop, int iterator = 0, int end = 0);
+
+    // unbox a value for compiled code (false if it is not of the kind)
+    bool unbox(const DataObject& val, JitKind kind, JitValue& slot);
+    // box a value from compiled code
+    void box(JitValue slot, JitKind kind, DataObject& val);
+
     // error message
     void error(const std::string& msg, const Token& token);
     void error(const std::string& msg);
 };
 
-int Interpreter::return_code() const
+inline Interpreter::Interpreter(std::istream& in, std::ostream& out)
+    : input(std::make_shared<InputScanner>(in.rdbuf(), in.tie())),
+      native_ctx {*input, out}
+{
+}
+
+inline Interpreter::Interpreter(const Interpreter& parent)
+    : heap(parent.heap), parallel_worker(true), functions(parent.functions),
+      types(parent.types), main_fun(parent.main_fun),
+      input(parent.input), native_ctx {*input, parent.native_ctx.out}
+{
+}
+
+inline int Interpreter::return_code() const
 {
     return ret_code;
 }
 
-void Interpreter::error(const std::string& msg, const Token& token)
+inline void Interpreter::set_profiler(Profiler* p)
+{
+    profiler = p;
+}
+
+inline void Interpreter::set_jit(Jit* j)
+{
+    jit = j;
+}
+
+inline void Interpreter::execute(Stmt* stmt)
+{
+    if (profiler)
+        profiler->count_stmt(stmt);
+    stmt->accept(*this);
+}
+
+inline void Interpreter::error(const std::string& msg, const Token& token)
 {
     throw MyPLException(RUNTIME, msg, token.line(), token.column());
 }
 
-void Interpreter::error(const std::string& msg)
+inline void Interpreter::error(const std::string& msg)
 {
     throw MyPLException(RUNTIME, msg);
 }
@@ -98,7 +221,7 @@ void Interpreter::error(const std::string& msg)
 
 
 
-void Interpreter::visit(MatrixValue& node) {
+inline void Interpreter::visit(MatrixValue& node) {
 Expr* iter;
 
 vector<vector<double>> evals;
@@ -128,7 +251,7 @@ curr_val = evals;
 
 
 
-void Interpreter::visit(Program& node)
+inline void Interpreter::visit(Program& node)
 {
 
     sym_table.push_environment();
@@ -136,27 +259,29 @@ void Interpreter::visit(Program& node)
     for (Decl* d : node.decls) {
         d->accept(*this);
     }
+    main_fun = functions["main"];
     CallExpr expr;
-    expr.function_id = functions["main"]->id;
+    expr.function_id = main_fun->id;
+    expr.fun_decl = main_fun;
     expr.accept(*this);
     sym_table.pop_environment(); 
     
     
 }
 
-void Interpreter::visit(FunDecl& node)
+inline void Interpreter::visit(FunDecl& node)
 {
 //Store function decl node
     functions.insert({ node.id.lexeme(), &node });
 }
 
-void Interpreter::visit(TypeDecl& node)
+inline void Interpreter::visit(TypeDecl& node)
 {
 //store type decl type
     types.insert({ node.id.lexeme(), &node });
 }
 // statements
-void Interpreter::visit(VarDeclStmt& node)
+inline void Interpreter::visit(VarDeclStmt& node)
 {
 
     sym_table.add_name(node.id.lexeme());
@@ -171,7 +296,7 @@ void Interpreter::visit(VarDeclStmt& node)
         curr_val.value(new_oid);
         if (!sym_table.has_val_info(node.id.lexeme())) {
             HeapObject t1;
-            heap.get_obj(new_oid, t1);
+            heap->get_obj(new_oid, t1);
             sym_table.set_val_info(node.id.lexeme(), new_oid);
         }
         //Otherwise do a shallow copy of the two udt variables
@@ -181,11 +306,29 @@ void Interpreter::visit(VarDeclStmt& node)
     }
 }
 
-void Interpreter::visit(AssignStmt& node)
+inline void Interpreter::visit(AssignStmt& node)
 {
-
+    if (Expr* rest = node.appended()) {
+    //x = x + e for a string x: append to x's string in place (x's value
+    //is not copied, so it is not shared unless another variable holds it)
+        rest->accept(*this);
+        DataObject* var = sym_table.get_val_ptr(node.lvalue_list.front().lexeme());
+        if (!var->is_string())
+            *var = curr_val;
+        else if (curr_val.is_string())
+            var->append(*curr_val.string_ptr());
+        else if (curr_val.is_char()) {
+            char c;
+            curr_val.value(c);
+            var->append(c);
+        }
+        return;
+    }
     node.expr->accept(*this);
-    if (node.lvalue_list.size() > 1) {
+    if (!node.indexes.empty()) {
+        assign_element(node);
+    }
+    else if (node.lvalue_list.size() > 1) {
     //Navigate to the end of the lvalue list by grabbing attributes from the heap
         DataObject t1;
         size_t my_oid;
@@ -193,30 +336,139 @@ void Interpreter::visit(AssignStmt& node)
         sym_table.get_val_info(node.lvalue_list.front().lexeme(), t1);
         t1.value(my_oid);
         int iterator = 0;
-        heap.get_obj(my_oid, x);
+        heap->get_obj(my_oid, x);
         for (Token iter : node.lvalue_list) {
             if (iterator > 0 && iterator < node.lvalue_list.size() - 1) {
                 x.get_val(iter.lexeme(), t1);
                 t1.value(my_oid);
-                heap.get_obj(my_oid, x);
+                heap->get_obj(my_oid, x);
             }
             iterator++;
         }
         x.set_att(node.lvalue_list.back().lexeme(), curr_val);
-        heap.set_obj(my_oid, x);
+        heap->set_obj(my_oid, x);
     }
     else {
     //if not accessing an attribute just set the variable to curr_val
         sym_table.set_val_info(node.lvalue_list.front().lexeme(), curr_val);
     }
 }
-void Interpreter::visit(ReturnStmt& node)
+inline void Interpreter::assign_element(AssignStmt& node)
+{
+    DataObject elem = std::move(curr_val);
+    size_t base = index_stack.size();
+    push_indexes(node.indexes);
+    const Token& token = node.lvalue_list.front();
+    if (node.lvalue_list.size() == 1) {
+        DataObject* var = sym_table.get_val_ptr(token.lexeme());
+        set_element(*var, base, elem, token);
+    }
+    else {
+    //Take the array out of its object while updating it (so it is not
+    //copied), then put it back
+        size_t my_oid;
+        try {
+            my_oid = field_object(node.lvalue_list);
+        }
+        catch (...) {
+            index_stack.resize(base);
+            throw;
+        }
+        HeapObject x;
+        const std::string& att = node.lvalue_list.back().lexeme();
+        DataObject array_val;
+        heap->take_obj(my_oid, x);
+        x.take_val(att, array_val);
+        try {
+            set_element(array_val, base, elem, token);
+        }
+        catch (...) {
+            x.set_att(att, std::move(array_val));
+            heap->set_obj(my_oid, std::move(x));
+            throw;
+        }
+        x.set_att(att, std::move(array_val));
+        heap->set_obj(my_oid, std::move(x));
+    }
+    index_stack.resize(base);
+}
+
+inline size_t Interpreter::field_object(const std::list<Token>& path)
+{
+    DataObject t1;
+    size_t oid = 0;
+    HeapObject x;
+    auto last = std::prev(path.end());
+    for (auto iter = path.begin(); iter != last; ++iter) {
+        if (iter == path.begin())
+            sym_table.get_val_info(iter->lexeme(), t1);
+        else {
+            heap->get_obj(oid, x);
+            x.get_val(iter->lexeme(), t1);
+        }
+        if (t1.is_nil())
+            error("nil object", *iter);
+        t1.value(oid);
+    }
+    return oid;
+}
+
+inline void Interpreter::push_indexes(std::list<Expr*>& indexes)
+{
+    for (Expr* index : indexes) {
+        index->accept(*this);
+        int i = 0;
+        curr_val.value(i);
+        index_stack.push_back(i);
+    }
+}
+
+inline void Interpreter::get_element(const DataObject& val, size_t base, const Token& token)
+{
+    const DataObject* array_val = &val;
+    DataObject elem;
+    for (size_t k = base; k < index_stack.size(); ++k) {
+        const Array* a = array_val->array_ptr();
+        int i = index_stack[k];
+        if (!a || i < 0 || (size_t)i >= a->size()) {
+            index_stack.resize(base);
+            error(a ? "array index out of range" : "nil array", token);
+        }
+        DataObject next;
+        a->get(i, next);
+        elem = std::move(next);
+        array_val = &elem;
+    }
+    index_stack.resize(base);
+    curr_val = std::move(elem);
+}
+
+inline void Interpreter::set_element(DataObject& val, size_t base, const DataObject& elem, const Token& token)
+{
+    DataObject* array_val = &val;
+    for (size_t k = base; k < index_stack.size(); ++k) {
+        Array* a = array_val->mutable_array_ptr();
+        int i = index_stack[k];
+        if (!a || i < 0 || (size_t)i >= a->size()) {
+            index_stack.resize(base);
+            error(a ? "array index out of range" : "nil array", token);
+        }
+        if (k + 1 < index_stack.size())
+            array_val = a->object(i);
+        else if (!a->set(i, elem)) {
+            index_stack.resize(base);
+            error("cannot store nil in an array of primitive values", token);
+        }
+    }
+}
+
+inline void Interpreter::visit(ReturnStmt& node)
 {
     node.expr->accept(*this);//Throw a return exception
-    throw new MyPLReturnException;
+    throw MyPLReturnException();
 }
 
-void Interpreter::visit(IfStmt& node)
+inline void Interpreter::visit(IfStmt& node)
 {
 //Test to see if we should execute statements within if stmt
     node.if_part->expr->accept(*this);
@@ -225,9 +477,9 @@ void Interpreter::visit(IfStmt& node)
     if (eval == true) {
         sym_table.push_environment();
         for (Stmt* iter : node.if_part->stmts) {
-            iter->accept(*this);
+            execute(iter);
         }
-        sym_table.push_environment();
+        sym_table.pop_environment();
         return;
     }
     else {
@@ -242,7 +494,7 @@ void Interpreter::visit(IfStmt& node)
                     sym_table.push_environment();
                     list<Stmt*> mango_stmt = iter->stmts;
                     for (Stmt* iter2 : mango_stmt) {
-                        iter2->accept(*this);
+                        execute(iter2);
                     }
                     sym_table.pop_environment();
                     return;
@@ -252,30 +504,44 @@ void Interpreter::visit(IfStmt& node)
     }
     sym_table.push_environment();
     for (Stmt* iter : node.body_stmts) {
-        iter->accept(*this);
+        execute(iter);
     }
     sym_table.pop_environment();
 }
 
-void Interpreter::visit(WhileStmt& node)
+inline void Interpreter::visit(WhileStmt& node)
 {
 //Should we execute the while stmt for a first time
     bool expr_cond = false;
+    if (jit and run_compiled_loop(node))
+        return;
     node.expr->accept(*this);
     curr_val.value(expr_cond);
     sym_table.push_environment();
     while (expr_cond) {
         for (Stmt* iter : node.stmts) {
-            iter->accept(*this);
+            execute(iter);
         }
+        //Hand the rest of a hot loop to compiled code
+        if (jit and run_compiled_loop(node))
+            break;
         //Continually update while expr condition when stmts finsihed executing
         node.expr->accept(*this);
         curr_val.value(expr_cond);
     }
     sym_table.pop_environment();
 }
-void Interpreter::visit(ForStmt& node)
+inline void Interpreter::visit(ForStmt& node)
 {
+    //parfor iterations go to the thread pool (nested ones run in order)
+    if (node.parallel && !parallel_worker) {
+        run_parallel(node);
+        return;
+    }
+    if (node.each) {
+        run_each(node);
+        return;
+    }
     sym_table.push_environment();
     sym_table.add_name(node.var_id.lexeme());
     node.start->accept(*this);
@@ -286,9 +552,19 @@ void Interpreter::visit(ForStmt& node)
     node.end->accept(*this);
     int end;
     curr_val.value(end);
+    //A counter the body never assigns (see TypeChecker) is kept here and
+    //copied into its variable's box in place
+    DataObject* counter = node.counter_written ? nullptr : sym_table.get_val_ptr(node.var_id.lexeme());
     while (iterator <= end) {
+        //Hand the rest of a hot loop to compiled code
+        if (jit and run_compiled_loop(node, iterator, end))
+            break;
         for (Stmt* iter : node.stmts) {
-            iter->accept(*this);
+            execute(iter);
+        }
+        if (counter) {
+            counter->set(++iterator);
+            continue;
         }
         DataObject t;
         //check to see if the iterator was changed in the proccess of executing for's stmt body
@@ -300,8 +576,146 @@ void Interpreter::visit(ForStmt& node)
     //Ensures that x end condition is int
     sym_table.pop_environment();
 }
+
+inline void Interpreter::run_each(ForStmt& node)
+{
+    //The loop holds its own reference to the array, so the body updating
+    //the array variable does not change the elements visited
+    sym_table.push_environment();
+    node.start->accept(*this);
+    DataObject items = std::move(curr_val);
+    const Array* a = items.array_ptr();
+    if (!a) {
+        error("nil array", node.var_id);
+    }
+    sym_table.add_name(node.var_id.lexeme());
+    DataObject elem;
+    for (size_t i = 0; i < a->size(); ++i) {
+        a->get(i, elem);
+        sym_table.set_val_info(node.var_id.lexeme(), elem);
+        for (Stmt* iter : node.stmts) {
+            execute(iter);
+        }
+    }
+    sym_table.pop_environment();
+}
+
+inline void Interpreter::run_parallel(ForStmt& node)
+{
+    //The range is evaluated once, as for a sequential loop
+    sym_table.push_environment();
+    sym_table.add_name(node.var_id.lexeme());
+    node.start->accept(*this);
+    sym_table.set_val_info(node.var_id.lexeme(), curr_val);
+    int first = 0;
+    curr_val.value(first);
+    node.end->accept(*this);
+    int last = 0;
+    curr_val.value(last);
+    sym_table.pop_environment();
+    if (last < first)
+        return;
+    //Copy out the shared values, then split the range into a few blocks
+    //per thread (evening out iterations of uneven cost)
+    std::vector<DataObject> shared;
+    for (const std::string& name : node.shared) {
+        shared.emplace_back();
+        sym_table.get_val_info(name, shared.back());
+    }
+    ThreadPool& pool = ThreadPool::instance();
+    long long count = (long long)last - first + 1;
+    size_t blocks = (size_t)std::min<long long>(count, pool.size() * 4);
+    std::vector<std::vector<DataObject>> partials(blocks);
+    Stats* parent_stats = &mypl_stats;
+    std::vector<Stats> block_stats(blocks);
+    //Workers profile into profilers of their own, merged in below
+    std::vector<std::unique_ptr<Profiler>> block_profiles(profiler ? blocks : 0);
+    heap->set_concurrent(true);
+    try {
+        pool.run(blocks, [&](size_t block) {
+            long long lo = first + count * (long long)block / (long long)blocks;
+            long long hi = first + count * (long long)(block + 1) / (long long)blocks - 1;
+            {
+                Interpreter worker(*this);
+                if (profiler) {
+                    block_profiles[block].reset(new Profiler);
+                    worker.set_profiler(block_profiles[block].get());
+                }
+                worker.run_block(node, shared, lo, hi, partials[block]);
+            }
+            //Pool threads hand their counters to the running thread
+            if (&mypl_stats != parent_stats) {
+                block_stats[block] = mypl_stats;
+                mypl_stats = Stats();
+            }
+        });
+    }
+    catch (...) {
+        heap->set_concurrent(false);
+        throw;
+    }
+    heap->set_concurrent(false);
+    for (const Stats& stats : block_stats)
+        mypl_stats.merge(stats);
+    for (const std::unique_ptr<Profiler>& profile : block_profiles)
+        profiler->merge(*profile);
+    //Combine the reduction values in block (iteration) order
+    DataObject args[2];
+    DataObject result;
+    native_ctx.call_site = &node.var_id;
+    size_t i = 0;
+    for (const auto& reduction : node.reductions) {
+        const NativeFunction* native = BuiltinRegistry::instance().find(reduction.second);
+        DataObject* target = sym_table.get_val_ptr(reduction.first);
+        if (!native || !target)
+            error("invalid reduction of '" + reduction.first + "'", node.var_id);
+        for (std::vector<DataObject>& partial : partials) {
+            if (partial.empty() || partial[i].is_nil())
+                continue;
+            args[0] = std::move(*target);
+            args[1] = std::move(partial[i]);
+            native->fun(native_ctx, NativeArgs(args, 2), result);
+            *target = std::move(args[0]);
+        }
+        ++i;
+    }
+}
+
+inline void Interpreter::run_block(ForStmt& node, const std::vector<DataObject>& shared,
+                            long long first, long long last, std::vector<DataObject>& partials)
+{
+    sym_table.push_environment();
+    global_env_id = sym_table.get_environment_id();
+    //The outer variables the body uses: copies of the shared values, and
+    //private reduction variables starting out nil
+    sym_table.push_environment();
+    size_t i = 0;
+    for (const std::string& name : node.shared) {
+        sym_table.add_name(name);
+        sym_table.set_val_info(name, shared[i++]);
+    }
+    for (const auto& reduction : node.reductions) {
+        sym_table.add_name(reduction.first);
+        sym_table.set_val_info(reduction.first, DataObject());
+    }
+    //Each iteration gets a fresh frame for the loop variable and locals
+    const std::string& var = node.var_id.lexeme();
+    for (long long iterator = first; iterator <= last; ++iterator) {
+        sym_table.push_environment();
+        sym_table.add_name(var);
+        sym_table.set_val_info(var, (int)iterator);
+        for (Stmt* iter : node.stmts) {
+            execute(iter);
+        }
+        sym_table.pop_environment();
+    }
+    for (const auto& reduction : node.reductions)
+        partials.push_back(std::move(*sym_table.get_val_ptr(reduction.first)));
+    sym_table.pop_environment();
+    sym_table.pop_environment();
+}
 // expressions
-void Interpreter::visit(Expr& node)
+inline void Interpreter::visit(Expr& node)
 {
     if (node.negated) {
         node.first->accept(*this);
@@ -461,26 +875,26 @@ void Interpreter::visit(Expr& node)
                     rhs_object.value(rhs_val);
                     curr_val.set(lhs_val + rhs_val);
                 }
+                //an unshared lhs (e.g., a call result) is appended to in place
                 else if (lhs_object.is_string() && rhs_object.is_string()) {
-                    string lhs_val;
-                    string rhs_val;
-                    lhs_object.value(lhs_val);
-                    rhs_object.value(rhs_val);
-                    curr_val.set(lhs_val + rhs_val);
+                    lhs_object.append(*rhs_object.string_ptr());
+                    curr_val = std::move(lhs_object);
                 }
                 else if (lhs_object.is_char() && rhs_object.is_string()) {
                     char lhs_val;
-                    string rhs_val;
                     lhs_object.value(lhs_val);
-                    rhs_object.value(rhs_val);
-                    curr_val.set(lhs_val + rhs_val);
+                    const string& rhs_val = *rhs_object.string_ptr();
+                    string joined;
+                    joined.reserve(rhs_val.size() + 1);
+                    joined += lhs_val;
+                    joined += rhs_val;
+                    curr_val.set(std::move(joined));
                 }
                 else if (lhs_object.is_string() && rhs_object.is_char()) {
-                    string lhs_val;
                     char rhs_val;
-                    lhs_object.value(lhs_val);
                     rhs_object.value(rhs_val);
-                    curr_val.set(lhs_val + rhs_val);
+                    lhs_object.append(rhs_val);
+                    curr_val = std::move(lhs_object);
                 }
                 else if (lhs_object.is_char() && rhs_object.is_char()) {
                     char lhs_val;
@@ -495,9 +909,7 @@ void Interpreter::visit(Expr& node)
                     curr_val.set(lhs_val);
                 }
                 else if ((lhs_object.is_string()) && rhs_object.is_nil()) {
-                    string lhs_val;
-                    lhs_object.value(lhs_val);
-                    curr_val.set(lhs_val);
+                    curr_val = lhs_object;
                 }
                 else if ((rhs_object.is_char()) && lhs_object.is_nil()) {
                     char rhs_val;
@@ -505,9 +917,7 @@ void Interpreter::visit(Expr& node)
                     curr_val.set(rhs_val);
                 }
                 else if ((rhs_object.is_string()) && lhs_object.is_nil()) {
-                    string rhs_val;
-                    rhs_object.value(rhs_val);
-                    curr_val.set(rhs_val);
+                    curr_val = rhs_object;
                 }
             }
 	//Subraction cases
@@ -882,6 +1292,11 @@ void Interpreter::visit(Expr& node)
                 else if (rhs_object.is_nil() && lhs_object.is_oid()) {
                     curr_val.set(false);
                 }
+                //arrays and maps only compare with nil
+                else if (rhs_object.is_array() || lhs_object.is_array() ||
+                         rhs_object.is_map() || lhs_object.is_map()) {
+                    curr_val.set(false);
+                }
             }
             //not equal cases
             else if (node.op->lexeme() == "!=") {
@@ -972,6 +1387,10 @@ void Interpreter::visit(Expr& node)
                 else if (rhs_object.is_nil() && lhs_object.is_nil()) {
                     curr_val.set(false);
                 }
+                else if (rhs_object.is_array() || lhs_object.is_array() ||
+                         rhs_object.is_map() || lhs_object.is_map()) {
+                    curr_val.set(true);
+                }
             }
             //Less than cases
             else if (node.op->lexeme() == "<") {
@@ -1104,17 +1523,17 @@ void Interpreter::visit(Expr& node)
     }
 }
 //just accept the next rvalue
-void Interpreter::visit(SimpleTerm& node)
+inline void Interpreter::visit(SimpleTerm& node)
 {
     node.rvalue->accept(*this);
 }
 //Complex term just accepts a new expr
-void Interpreter::visit(ComplexTerm& node)
+inline void Interpreter::visit(ComplexTerm& node)
 {
     node.expr->accept(*this);
 }
 // rvalues
-void Interpreter::visit(SimpleRValue& node)
+inline void Interpreter::visit(SimpleRValue& node)
 {
     if (node.value.type() == CHAR_VAL) {
         curr_val.set(node.value.lexeme().at(0));
@@ -1158,11 +1577,22 @@ void Interpreter::visit(SimpleRValue& node)
     }
 }
 
-void Interpreter::visit(NewRValue& node)
+inline void Interpreter::visit(NewRValue& node)
 {
 //Create and define a new heap object.  do not store in symbol table along with oid yet because we don't have an variable name
+    const std::string& type_id = node.type_id.lexeme();
+    if (type_id.compare(0, 6, "array<") == 0) {
+    //An empty array (no heap object)
+        curr_val.set(Array(type_id.substr(6, type_id.size() - 7)));
+        return;
+    }
+    if (type_id.compare(0, 4, "map<") == 0) {
+    //An empty map (key types are never generic, so the first comma ends the key)
+        curr_val.set(Map(type_id.substr(4, type_id.find(',') - 4)));
+        return;
+    }
     HeapObject t1;
-    size_t new_oid = next_oid;
+    size_t new_oid = heap->new_oid();
     TypeDecl* my_type_decl = types[node.type_id.lexeme()];
     int current_environment = sym_table.get_environment_id();
     sym_table.set_environment_id(global_env_id);
@@ -1174,200 +1604,252 @@ void Interpreter::visit(NewRValue& node)
     }
     sym_table.pop_environment();
     sym_table.set_environment_id(current_environment);
-    next_oid++;
-    heap.set_obj(new_oid, t1);
+    heap->set_obj(new_oid, t1);
+    if (profiler)
+        profiler->count_heap_object();
     curr_val.set(new_oid);
 }
 
-void Interpreter::visit(CallExpr& node)
+inline void Interpreter::visit(CallExpr& node)
 {
-//Built in functions
+//Dispatch on the cached call target (resolved on first execution; parfor
+//workers share the AST between threads, so they resolve without caching)
+    FunDecl* fun_decl = node.fun_decl;
+    const NativeFunction* native = node.native;
+    if (!fun_decl && !native) {
+        resolve_call(node, fun_decl, native);
+        if (!parallel_worker) {
+            node.fun_decl = fun_decl;
+            node.native = native;
+        }
+    }
+    if (fun_decl)
+        call_function(node, *fun_decl);
+    else
+        call_native(node, *native);
+}
+
+inline void Interpreter::resolve_call(const CallExpr& node, FunDecl*& fun_decl, const NativeFunction*& native)
+{
+//Built in functions take precedence (they cannot be redeclared)
     std::string fun_name = node.function_id.lexeme();
-    if (fun_name == "print") {
-        node.arg_list.front()->accept(*this);
-        std::string s = curr_val.to_string();
-        s = std::regex_replace(s, std::regex("\\\\n"), "\n");
-        s = std::regex_replace(s, std::regex("\\\\t"), "\t");
-        std::cout << s;
+    native = BuiltinRegistry::instance().find(fun_name);
+    if (native) {
+        for (int i = 0; i < node.overload && native->overload; ++i)
+            native = native->overload;
+        return;
     }
-  
-    else if (fun_name == "m_print") {
-    node.arg_list.front()->accept(*this);
-    vector<vector<double>> x;
-    
-    curr_val.value(x);
-    for (int row = 0; row < x.size(); row++) {
-    	cout << endl;
-    	for (int column = 0; column < x.at(row).size(); column++) {
-    	cout << x.at(row).at(column) << " "; 
-    	
-    	
-    	}
-    
+    auto fun = functions.find(fun_name);
+    if (fun == functions.end())
+        error("undefined function '" + fun_name + "'", node.function_id);
+    fun_decl = fun->second;
+}
+
+inline void Interpreter::call_function(CallExpr& node, FunDecl& fun_decl)
+{
+    FunDecl* fun_node = &fun_decl;
+    fun_node->read_body();
+    // call the function
+    // 1. evaluate the args and save
+    list<DataObject> resolved_args;
+    for (Expr* iter : node.arg_list) {
+        iter->accept(*this);
+        resolved_args.push_back(curr_val);
     }
-    cout << endl;
-    
+    // hot functions run as compiled code
+    if (jit and fun_node != main_fun and call_compiled(*fun_node, resolved_args))
+        return;
+    // 2. save the current environment
+    int curr_environment = sym_table.get_environment_id();
+    // 3. go to the gobal environment
+    sym_table.set_environment_id(global_env_id);
+    // 4. push a new environment
+    sym_table.push_environment();
+    int fun_environment = sym_table.get_environment_id();
+    // 5. add param values ( from 1)
+    for (const FunDecl::FunParam& iter : fun_node->params) {
+        sym_table.add_name(iter.id.lexeme());
+        sym_table.set_val_info(iter.id.lexeme(), resolved_args.front());
+        resolved_args.pop_front();
     }
-      else if (fun_name == "m_singleton") {
-      int iterator3 = 0;
-      vector<DataObject> list;
-    for (Expr* iter : node.arg_list) {
-            if (iterator3 < node.arg_list.size()) {
-                iter->accept(*this);
-                list.push_back(curr_val);
-            }
-            iterator3++;
+    // 6. eval each statement (until a return)
+    {
+        ProfiledCall profiled(profiler, fun_node, fun_node->id.lexeme());
+        try {
+            for (Stmt* stmt_iter : fun_node->stmts)
+                execute(stmt_iter);
+            // (ending without a return gives nil)
+            curr_val.set_nil();
+        }
+        catch (const MyPLReturnException& e) {
+            if (fun_node == main_fun)
+                curr_val.value(ret_code);
         }
-    
-    vector<vector<double>> x;
-   int R;
-   int C;
-    double V;
-    list.at(1).value(R);
-    list.at(2).value(C);
-    list.at(0).value(V);
-  
-   
-    for (int row = 0; row < R; row++) {
-    	x.push_back({});
-    	for (int column = 0; column < C; column++) {
-    	x.at(row).push_back(V);
-    	
-    	
-    	}
-    
     }
-    
-    curr_val = x;
-    
+    // 7. unwind any block environments left by the return
+    while (sym_table.get_environment_id() != fun_environment)
+        sym_table.pop_environment();
+    sym_table.pop_environment();
+    // 8. return to saved environment
+    sym_table.set_environment_id(curr_environment);
+}
+
+inline bool Interpreter::call_compiled(FunDecl& fun, const std::list<DataObject>& args)
+{
+    const JitFunction* code = jit->function_code(&fun, functions);
+    if (!code)
+        return false;
+    // nil arguments are left to the interpreter
+    jit_slots.resize(args.size());
+    size_t i = 0;
+    for (const DataObject& arg : args) {
+        if (!unbox(arg, code->params[i], jit_slots[i]))
+            return false;
+        ++i;
     }
-    else if (fun_name == "stod") {
-        node.arg_list.front()->accept(*this);
-        string string_arg = "";
-        curr_val.value(string_arg);
-        curr_val.set(stod(string_arg));
+    ProfiledCall profiled(profiler, &fun, fun.id.lexeme());
+    int nil = 0;
+    JitValue result = code->code(jit_slots.data(), &nil);
+    if (nil)
+        curr_val.set_nil();
+    else
+        box(result, code->result, curr_val);
+    return true;
+}
+
+inline bool Interpreter::run_compiled_loop(Stmt& loop, int iterator, int end)
+{
+    const JitLoop* code = jit->loop_code(&loop, functions, sym_table);
+    if (!code)
+        return false;
+    jit_slots.resize(code->first_var + code->vars.size());
+    jit_vars.clear();
+    if (code->first_var) {
+        jit_slots[0].i = iterator;
+        jit_slots[1].i = end;
     }
-    else if (fun_name == "stoi") {
-        node.arg_list.front()->accept(*this);
-        string string_arg = "";
-        curr_val.value(string_arg);
-        curr_val.set(stoi(string_arg));
+    for (size_t i = 0; i < code->vars.size(); ++i) {
+        DataObject* var = sym_table.get_val_ptr(code->vars[i]);
+        if (!var or !unbox(*var, code->kinds[i], jit_slots[code->first_var + i]))
+            return false;
+        jit_vars.push_back(var);
     }
-    else if (fun_name == "dtos") {
-        node.arg_list.front()->accept(*this);
-        double string_arg = 0.0;
-        curr_val.value(string_arg);
-        curr_val.set(to_string(string_arg));
+    JitValue ret;
+    bool returned = code->code(jit_slots.data(), &ret);
+    for (size_t i = 0; i < jit_vars.size(); ++i)
+        box(jit_slots[code->first_var + i], code->kinds[i], *jit_vars[i]);
+    if (returned) {
+        box(ret, code->result, curr_val);
+        throw MyPLReturnException();
     }
-    else if (fun_name == "itos") {
-        node.arg_list.front()->accept(*this);
-        int string_arg = 0.0;
-        curr_val.value(string_arg);
-        curr_val.set(to_string(string_arg));
+    return true;
+}
+
+inline bool Interpreter::unbox(const DataObject& val, JitKind kind, JitValue& slot)
+{
+    bool b = false;
+    switch (kind) {
+    case JIT_INT:
+        return val.is_integer() and val.value(slot.i);
+    case JIT_DOUBLE:
+        return val.is_double() and val.value(slot.d);
+    case JIT_BOOL:
+        if (!val.is_bool() or !val.value(b))
+            return false;
+        slot.i = b;
+        return true;
     }
-    else if (fun_name == "read") {
-        string string_arg = "";
-        cin.clear();
-        getline(cin, string_arg);
-        cin.clear();
-        if (string_arg.size() > 0) {
-            if (string_arg.at(string_arg.size() - 1) == '\n') {
-                string_arg.pop_back();
-            }
+    return false;
+}
+
+inline void Interpreter::box(JitValue slot, JitKind kind, DataObject& val)
+{
+    if (kind == JIT_INT)
+        val.set((int)slot.i);
+    else if (kind == JIT_DOUBLE)
+        val.set(slot.d);
+    else
+        val.set(slot.i != 0);
+}
+
+inline void Interpreter::call_native(CallExpr& node, const NativeFunction& native)
+{
+    // evaluate the args onto the argument stack (reused across calls)
+    size_t base = arg_stack.size();
+    bool in_place = native.in_place;
+    for (Expr* iter : node.arg_list) {
+        if (in_place and arg_stack.size() == base)
+            arg_stack.emplace_back(); // filled in below
+        else {
+            iter->accept(*this);
+            arg_stack.push_back(std::move(curr_val));
         }
-        curr_val.set(string_arg);
-    }
-    else if (fun_name == "length") {
-        node.arg_list.front()->accept(*this);
-        string string_arg = "";
-        curr_val.value(string_arg);
-        curr_val.set(string_arg.size());
     }
-    else if (fun_name == "m_get") {
-        vector<DataObject> list;
-        vector<vector<double>> M;
-        int col;
-        int row;
-        int iterator3 = 0;
-        for (Expr* iter : node.arg_list) {
-            if (iterator3 < node.arg_list.size()) {
-                iter->accept(*this);
-                list.push_back(curr_val);
+    // an in-place call takes over the variable's value (after the other
+    // args are evaluated, since they may read it) and hands it back after;
+    // a field's value is taken out of its object, itself taken out of
+    // the heap (so neither is copied)
+    DataObject* target = nullptr;
+    const Token* field = nullptr;
+    size_t field_oid = 0;
+    HeapObject object;
+    if (in_place) {
+        IDRValue* var = node.arg_list.front()->id_rvalue();
+        if (var and var->path.size() > 1) {
+            try {
+                field_oid = field_object(var->path);
             }
-            iterator3++;
+            catch (...) {
+                arg_stack.resize(base);
+                throw;
+            }
+            field = &var->path.back();
+            heap->take_obj(field_oid, object);
+            object.take_val(field->lexeme(), arg_stack[base]);
         }
-	list.at(0).value(M);
-	list.at(1).value(row);
-	list.at(2).value(col);
-	if (row >= M.size() || col >= M.at(0).size()) {
-	error("Accessing out of bounds matrix",node.function_id);
-	
-	}
-	curr_val = M.at(row).at(col);
-	
-    }
-    else if (fun_name == "get") {
-        vector<DataObject> list;
-        int iterator3 = 0;
-        for (Expr* iter : node.arg_list) {
-            if (iterator3 < node.arg_list.size()) {
-                iter->accept(*this);
-                list.push_back(curr_val);
+        else {
+            target = var ? sym_table.get_val_ptr(var->path.front().lexeme()) : nullptr;
+            if (!target) {
+                arg_stack.resize(base);
+                error("expecting a variable", node.function_id);
             }
-            iterator3++;
+            arg_stack[base] = std::move(*target);
         }
-        string string_arg = "";
-        DataObject second_arg = list.at(1);
-        second_arg.value(string_arg);
-        int first_arg = 0;
-        DataObject first_arg_object = list.at(0);
-        first_arg_object.value(first_arg);
-        curr_val.set(string_arg.at(first_arg));
     }
-    else {
-        // call the function
-        // 1. evaluate the args and save
-        int iterator = 0;
-        list<DataObject> resolved_args;
-        for (Expr* iter : node.arg_list) {
-            iter->accept(*this);
-            resolved_args.push_back(curr_val);
-            ++iterator;
-        }
-        // 2. save the current environment
-        int curr_environment = sym_table.get_environment_id();
-        // 3. go to the gobal environment
-        sym_table.set_environment_id(global_env_id);
-        // 4. push a new environment
-        sym_table.push_environment();
-        // 5. add param values ( from 1)
-        int iterator1 = 0;
-        for (FunDecl::FunParam iter : functions[fun_name]->params) {
-            sym_table.add_name(iter.id.lexeme());
-            DataObject resolved_arg = resolved_args.front();
-            sym_table.set_val_info(iter.id.lexeme(), resolved_arg);
-            resolved_args.pop_front();
+    auto hand_back = [&]() {
+        if (target)
+            *target = std::move(arg_stack[base]);
+        else if (field) {
+            object.set_att(field->lexeme(), std::move(arg_stack[base]));
+            heap->set_obj(field_oid, std::move(object));
         }
-        // 6. eval each statement
-        for (Stmt* stmt_iter : functions[fun_name]->stmts) {
-            try {
-                stmt_iter->accept(*this);
-            }
-            catch (const MyPLReturnException* e) {
-                if (fun_name == "main") {
-                    curr_val.value(ret_code);
-                    
-                }
-            }
-        }
-        sym_table.pop_environment();
-        // 9. return to saved environment
-        sym_table.set_environment_id(curr_environment);
-        FunDecl* fun_node = functions[fun_name];
+        arg_stack.resize(base);
+    };
+    native_ctx.call_site = &node.function_id;
+    NativeArgs args(arg_stack.data() + base, arg_stack.size() - base);
+    ProfiledCall profiled(profiler, &native, native.name);
+    try {
+        native.fun(native_ctx, args, curr_val);
     }
+    catch (...) {
+        hand_back();
+        throw;
+    }
+    hand_back();
 }
-void Interpreter::visit(IDRValue& node)
+inline void Interpreter::visit(IDRValue& node)
 {
+//An array element: the indexes are evaluated first, then a variable's
+//array is read where it is (without taking a reference to it)
+    size_t base = index_stack.size();
+    if (!node.indexes.empty()) {
+        push_indexes(node.indexes);
+        if (node.path.size() == 1) {
+            const DataObject* var = sym_table.get_val_ptr(node.path.front().lexeme());
+            get_element(*var, base, node.first_token());
+            return;
+        }
+    }
 //If it is a udt...
     if (node.path.size() > 1) {
         DataObject t1;
@@ -1376,7 +1858,7 @@ void Interpreter::visit(IDRValue& node)
         sym_table.get_val_info(node.path.front().lexeme(), t1);
         t1.value(my_oid);
         int iterator = 0;
-        heap.get_obj(my_oid, x);
+        heap->get_obj(my_oid, x);
         if (!t1.is_nil()) {
             for (Token iter : node.path) {//Navigate to the end of the attribute path
                 if (t1.is_nil()) {
@@ -1390,7 +1872,7 @@ void Interpreter::visit(IDRValue& node)
                         break;
                     }
                     t1.value(my_oid);
-                    heap.get_obj(my_oid, x);
+                    heap->get_obj(my_oid, x);
                 }
 
                 iterator++;
@@ -1411,8 +1893,13 @@ void Interpreter::visit(IDRValue& node)
         sym_table.get_val_info(node.path.front().lexeme(), P);
         curr_val = P;
     }
+    //The element of an object's array
+    if (!node.indexes.empty()) {
+        DataObject array_val = std::move(curr_val);
+        get_element(array_val, base, node.first_token());
+    }
 }
-void Interpreter::visit(NegatedRValue& node)
+inline void Interpreter::visit(NegatedRValue& node)
 {
 //Negate integer or double rvalue
     node.expr->accept(*this);
@@ -1428,7 +1915,19 @@ void Interpreter::visit(NegatedRValue& node)
     }
 }
 
-void Interpreter::visit(TransposedRValue& node) {
+inline void Interpreter::visit(ArrayValue& node)
+{
+    Array elements(node.elem_type);
+    for (Expr* iter : node.elements) {
+        iter->accept(*this);
+        if (!elements.push(curr_val)) {
+            error("cannot store nil in an array of primitive values", iter->first_token());
+        }
+    }
+    curr_val.set(std::move(elements));
+}
+
+inline void Interpreter::visit(TransposedRValue& node) {
 node.expr->accept(*this);
 vector<vector<double>> N;
 vector<vector<double>> O;
@@ -0,0 +1,945 @@
+//----------------------------------------------------------------------
+// FILE: jit.h
+// DESC: Baseline JIT for hot MyPL code (see --jit). The interpreter
+//       counts function calls and loop iterations; once a function or
+//       a loop crosses the threshold it is translated to C, compiled
+//       into a shared library with the system C compiler, and loaded
+//       with dlopen. The translation uses the expression types found
+//       by the type checker to keep int, double, and bool values
+//       unboxed. Code using any other kind of value (or anything else
+//       the translator does not handle) is left to the interpreter.
+//----------------------------------------------------------------------
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "ast.h"
+#include "builtins.h"
+#include "symbol_table.h"
+#include "stats.h"
+
+
+// a value passed to or from compiled code (bools are stored as ints)
+union JitValue
+{
+  int32_t i;
+  double d;
+};
+
+// value kinds handled by compiled code
+enum JitKind : char {JIT_INT = 'i', JIT_DOUBLE = 'd', JIT_BOOL = 'b'};
+
+// compiled function: the arguments in, the result returned (*nil is
+// set instead if the function ended without a return)
+typedef JitValue (*JitFunctionCode)(const JitValue* args, int* nil);
+
+// compiled loop: runs the loop to completion over the given variable
+// values (updated in place); returns 1 if a return statement ran (with
+// its value in ret), else 0
+typedef int (*JitLoopCode)(JitValue* vars, JitValue* ret);
+
+
+// a compiled function
+struct JitFunction
+{
+  JitFunctionCode code = nullptr;
+  std::vector<JitKind> params;  // parameter kinds
+  JitKind result = JIT_INT;     // return value kind
+};
+
+
+// a compiled while or for loop
+struct JitLoop
+{
+  JitLoopCode code = nullptr;
+  size_t first_var = 0;         // slot of vars[0] (a for loop passes
+                                // its counter and end value first)
+  std::vector<std::string> vars; // variables from outside the loop
+  std::vector<JitKind> kinds;   // their kinds
+  JitKind result = JIT_INT;     // kind of a returned value
+};
+
+
+// the user-defined functions (by name)
+typedef std::unordered_map<std::string,FunDecl*> FunctionMap;
+
+
+//----------------------------------------------------------------------
+// C TRANSLATION
+//----------------------------------------------------------------------
+
+class JitEmitter : public Visitor
+{
+public:
+
+  JitEmitter(const FunctionMap& functions) : functions(functions) {}
+
+  // translate fun (and the functions it calls) into a C unit exporting
+  // mypl_entry; returns false if any of it cannot be translated
+  bool function_unit(FunDecl& fun, std::string& source, JitFunction& info);
+
+  // translate a while or for loop into a C unit exporting mypl_entry;
+  // variables from outside the loop are looked up in sym_table
+  bool loop_unit(Stmt& loop, SymbolTable& sym_table, std::string& source,
+                 JitLoop& info);
+
+  // top-level
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  // rvalues
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+  void visit(MatrixValue& node);
+  void visit(ArrayValue& node);
+  void visit(TransposedRValue& node);
+
+private:
+
+  // thrown on anything the translator does not handle
+  class Unsupported {};
+
+  const FunctionMap& functions;
+
+  // functions in the unit (by C name f<index>) and their definitions
+  std::unordered_map<FunDecl*,size_t> fun_ids;
+  std::vector<FunDecl*> unit_funs;
+  std::string prototypes;
+  std::string definitions;
+
+  // variable kinds, innermost scope last
+  std::vector<std::unordered_map<std::string,JitKind>> scopes;
+
+  // the statements being emitted
+  std::string out;
+  int indent = 0;
+  size_t next_temp = 0;
+
+  // the translation of the last expression
+  std::string curr_code;
+  JitKind curr_kind = JIT_INT;
+
+  // return kind of the function being emitted
+  JitKind return_kind = JIT_INT;
+
+  // the function a function unit is for; its returns record whether
+  // it ended without one (other functions then give zero)
+  FunDecl* entry_fun = nullptr;
+  bool nil_flag = false;
+
+  // loop translation: outer variables come from sym_table
+  bool in_loop = false;
+  SymbolTable* sym_table = nullptr;
+  JitLoop* loop_info = nullptr;
+  bool loop_returns = false;
+  std::unordered_set<std::string> declared;
+
+  // variable whose initializer is being translated
+  std::string declaring;
+
+  void reset();
+  void line(const std::string& code);
+  void statements(std::list<Stmt*>& stmts);
+  void block(std::list<Stmt*>& stmts);
+  void condition(Expr* expr);
+  void declare(const std::string& name, JitKind kind);
+  JitKind variable(const std::string& name);
+  size_t function_id(FunDecl* fun);
+  std::string signature(FunDecl& fun, size_t id);
+  void emit_functions();
+  std::string unit_source(const std::string& entry) const;
+
+  static JitKind kind_of(const std::string& type);
+  static std::string c_type(JitKind kind);
+  static std::string field(JitKind kind);
+};
+
+
+// C helpers matching the interpreter's semantics (and the scalar math
+// kernels in matrix.h)
+const char* const JIT_PRELUDE =
+  "#include <stdint.h>\n"
+  "#include <math.h>\n"
+  "typedef union {int32_t i; double d;} JitValue;\n"
+  "static _Thread_local int mypl_nil;\n"
+  "static int32_t mypl_ipow(int32_t a, int32_t b)\n"
+  "{int32_t p = a; for (int32_t k = 1; k < b; ++k) p *= a; return p;}\n"
+  "static double mypl_min(double a, double b) {return a < b ? a : b;}\n"
+  "static double mypl_max(double a, double b) {return a > b ? a : b;}\n"
+  "static double mypl_pow(double x, double p) {return p == 2.0 ? x * x : pow(x, p);}\n";
+
+
+// built-ins with a C translation
+inline const std::unordered_map<std::string,std::string>& jit_natives()
+{
+  static const std::unordered_map<std::string,std::string> natives = {
+    {"sqrt", "sqrt"}, {"exp", "exp"}, {"log", "log"}, {"sin", "sin"},
+    {"cos", "cos"}, {"abs", "fabs"}, {"floor", "floor"}, {"ceil", "ceil"},
+    {"pow", "mypl_pow"}, {"min", "mypl_min"}, {"max", "mypl_max"}
+  };
+  return natives;
+}
+
+
+inline JitKind JitEmitter::kind_of(const std::string& type)
+{
+  if (type == "int")
+    return JIT_INT;
+  if (type == "double")
+    return JIT_DOUBLE;
+  if (type == "bool")
+    return JIT_BOOL;
+  throw Unsupported();
+}
+
+inline std::string JitEmitter::c_type(JitKind kind)
+{
+  return kind == JIT_DOUBLE ? "double" : kind == JIT_INT ? "int32_t" : "int";
+}
+
+inline std::string JitEmitter::field(JitKind kind)
+{
+  return kind == JIT_DOUBLE ? "d" : "i";
+}
+
+
+inline void JitEmitter::reset()
+{
+  fun_ids.clear();
+  unit_funs.clear();
+  prototypes.clear();
+  definitions.clear();
+  scopes.clear();
+  out.clear();
+  next_temp = 0;
+  in_loop = false;
+  entry_fun = nullptr;
+  nil_flag = false;
+  sym_table = nullptr;
+  loop_info = nullptr;
+  loop_returns = false;
+  declared.clear();
+  declaring.clear();
+}
+
+inline void JitEmitter::line(const std::string& code)
+{
+  out.append(2 * indent, ' ');
+  out += code;
+  out += '\n';
+}
+
+inline void JitEmitter::statements(std::list<Stmt*>& stmts)
+{
+  for (Stmt* s : stmts) {
+    s->accept(*this);
+    // a call statement leaves its (unused) value expression
+    if (dynamic_cast<CallExpr*>(s))
+      line(curr_code + ";");
+  }
+}
+
+inline void JitEmitter::block(std::list<Stmt*>& stmts)
+{
+  scopes.emplace_back();
+  ++indent;
+  statements(stmts);
+  --indent;
+  scopes.pop_back();
+}
+
+inline void JitEmitter::condition(Expr* expr)
+{
+  expr->accept(*this);
+  if (curr_kind != JIT_BOOL)
+    throw Unsupported();
+}
+
+inline void JitEmitter::declare(const std::string& name, JitKind kind)
+{
+  // shadowing is left to the interpreter
+  for (const auto& scope : scopes)
+    if (scope.count(name))
+      throw Unsupported();
+  scopes.back()[name] = kind;
+  declared.insert(name);
+}
+
+inline JitKind JitEmitter::variable(const std::string& name)
+{
+  // a variable initialized with itself reads the new (unset) variable
+  if (name == declaring)
+    throw Unsupported();
+  for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+    auto var = it->find(name);
+    if (var != it->end())
+      return var->second;
+  }
+  // in a loop, anything else comes from outside (and must be a value
+  // the loop can hold unboxed)
+  if (!in_loop)
+    throw Unsupported();
+  DataObject* val = sym_table->get_val_ptr(name);
+  if (!val)
+    throw Unsupported();
+  JitKind kind;
+  if (val->is_integer())
+    kind = JIT_INT;
+  else if (val->is_double())
+    kind = JIT_DOUBLE;
+  else if (val->is_bool())
+    kind = JIT_BOOL;
+  else
+    throw Unsupported();
+  scopes.front()[name] = kind;
+  loop_info->vars.push_back(name);
+  loop_info->kinds.push_back(kind);
+  return kind;
+}
+
+inline size_t JitEmitter::function_id(FunDecl* fun)
+{
+  auto it = fun_ids.find(fun);
+  if (it != fun_ids.end())
+    return it->second;
+  size_t id = unit_funs.size();
+  fun_ids[fun] = id;
+  unit_funs.push_back(fun);
+  prototypes += "static " + signature(*fun, id) + ";\n";
+  return id;
+}
+
+inline std::string JitEmitter::signature(FunDecl& fun, size_t id)
+{
+  std::string sig = c_type(kind_of(fun.return_type.lexeme())) + " f" + std::to_string(id) + "(";
+  bool first = true;
+  for (const FunDecl::FunParam& p : fun.params) {
+    if (!first)
+      sig += ", ";
+    sig += c_type(kind_of(p.type.lexeme())) + " v_" + p.id.lexeme();
+    first = false;
+  }
+  return sig + (first ? "void)" : ")");
+}
+
+inline void JitEmitter::emit_functions()
+{
+  // functions called from the unit are added as they are found
+  for (size_t i = 0; i < unit_funs.size(); ++i)
+    unit_funs[i]->accept(*this);
+}
+
+inline std::string JitEmitter::unit_source(const std::string& entry) const
+{
+  return std::string(JIT_PRELUDE) + prototypes + definitions + entry;
+}
+
+
+inline bool JitEmitter::function_unit(FunDecl& fun, std::string& source, JitFunction& info)
+{
+  reset();
+  entry_fun = &fun;
+  try {
+    function_id(&fun);
+    emit_functions();
+    info.params.clear();
+    std::string call = "f0(";
+    size_t i = 0;
+    for (const FunDecl::FunParam& p : fun.params) {
+      JitKind kind = kind_of(p.type.lexeme());
+      info.params.push_back(kind);
+      call += (i ? ", args[" : "args[") + std::to_string(i) + "]." + field(kind);
+      ++i;
+    }
+    info.result = kind_of(fun.return_type.lexeme());
+    source = unit_source(
+      "JitValue mypl_entry(const JitValue* args, int* nil)\n{\n"
+      "  JitValue result;\n"
+      "  result." + field(info.result) + " = " + call + ");\n"
+      "  *nil = mypl_nil;\n"
+      "  return result;\n}\n");
+    return true;
+  }
+  catch (const Unsupported&) {
+    return false;
+  }
+}
+
+
+inline bool JitEmitter::loop_unit(Stmt& loop, SymbolTable& sym_table, std::string& source,
+                           JitLoop& info)
+{
+  reset();
+  in_loop = true;
+  this->sym_table = &sym_table;
+  loop_info = &info;
+  info.vars.clear();
+  info.kinds.clear();
+  try {
+    // the outermost scope holds the variables from outside the loop
+    scopes.emplace_back();
+    scopes.emplace_back();
+    indent = 1;
+    if (ForStmt* for_stmt = dynamic_cast<ForStmt*>(&loop)) {
+      // the interpreter hands over the counter and end value
+      info.first_var = 2;
+      std::string var = "v_" + for_stmt->var_id.lexeme();
+      declare(for_stmt->var_id.lexeme(), JIT_INT);
+      line("int32_t " + var + " = vars[0].i;");
+      line("int32_t end = vars[1].i;");
+      line("while (" + var + " <= end) {");
+      ++indent;
+      statements(for_stmt->stmts);
+      line("++" + var + ";");
+      --indent;
+      line("}");
+    }
+    else if (dynamic_cast<WhileStmt*>(&loop)) {
+      info.first_var = 0;
+      loop.accept(*this);
+    }
+    else
+      return false;
+    std::string body = out;
+    in_loop = false;
+    emit_functions();
+    // an outer variable the loop also declares would be looked up in
+    // the wrong environment
+    for (const std::string& name : info.vars)
+      if (declared.count(name))
+        return false;
+    std::string load, store;
+    for (size_t i = 0; i < info.vars.size(); ++i) {
+      std::string slot = "vars[" + std::to_string(info.first_var + i) + "]." + field(info.kinds[i]);
+      std::string var = "v_" + info.vars[i];
+      load += "  " + c_type(info.kinds[i]) + " " + var + " = " + slot + ";\n";
+      store += "  " + slot + " = " + var + ";\n";
+    }
+    source = unit_source(
+      "int mypl_entry(JitValue* vars, JitValue* ret)\n{\n"
+      "  int status = 0;\n" + load + body +
+      " done:\n" + store +
+      "  return status;\n}\n");
+    return true;
+  }
+  catch (const Unsupported&) {
+    return false;
+  }
+}
+
+
+//----------------------------------------------------------------------
+// DECLARATIONS AND STATEMENTS
+//----------------------------------------------------------------------
+
+inline void JitEmitter::visit(Program& node)
+{
+  throw Unsupported();
+}
+
+inline void JitEmitter::visit(FunDecl& node)
+{
+  node.read_body();
+  if (node.id.lexeme() == "main")
+    throw Unsupported();
+  std::string sig = signature(node, fun_ids.at(&node));
+  return_kind = kind_of(node.return_type.lexeme());
+  nil_flag = &node == entry_fun;
+  scopes.assign(1, {});
+  for (const FunDecl::FunParam& p : node.params)
+    declare(p.id.lexeme(), kind_of(p.type.lexeme()));
+  out.clear();
+  indent = 1;
+  statements(node.stmts);
+  // a function ending without a return gives nil (zero to compiled
+  // callers)
+  if (node.stmts.empty() or !dynamic_cast<ReturnStmt*>(node.stmts.back())) {
+    if (nil_flag)
+      line("mypl_nil = 1;");
+    line("return 0;");
+  }
+  definitions += "static " + sig + "\n{\n" + out + "}\n";
+}
+
+inline void JitEmitter::visit(TypeDecl& node)
+{
+  throw Unsupported();
+}
+
+inline void JitEmitter::visit(VarDeclStmt& node)
+{
+  const std::string& name = node.id.lexeme();
+  declaring = name;
+  node.expr->accept(*this);
+  declaring.clear();
+  if (node.type and kind_of(node.type->lexeme()) != curr_kind)
+    throw Unsupported();
+  declare(name, curr_kind);
+  line(c_type(curr_kind) + " v_" + name + " = " + curr_code + ";");
+}
+
+inline void JitEmitter::visit(AssignStmt& node)
+{
+  if (node.lvalue_list.size() != 1 or !node.indexes.empty())
+    throw Unsupported();
+  const std::string& name = node.lvalue_list.front().lexeme();
+  node.expr->accept(*this);
+  if (variable(name) != curr_kind)
+    throw Unsupported();
+  line("v_" + name + " = " + curr_code + ";");
+}
+
+inline void JitEmitter::visit(ReturnStmt& node)
+{
+  node.expr->accept(*this);
+  if (!in_loop) {
+    if (curr_kind != return_kind)
+      throw Unsupported();
+    if (nil_flag)
+      line("mypl_nil = 0;");
+    line("return " + curr_code + ";");
+    return;
+  }
+  // a return from a compiled loop hands its value back to the
+  // interpreter
+  if (loop_returns and loop_info->result != curr_kind)
+    throw Unsupported();
+  loop_info->result = curr_kind;
+  loop_returns = true;
+  line("{ret->" + field(curr_kind) + " = " + curr_code + "; status = 1; goto done;}");
+}
+
+inline void JitEmitter::visit(IfStmt& node)
+{
+  condition(node.if_part->expr);
+  line("if (" + curr_code + ") {");
+  block(node.if_part->stmts);
+  for (BasicIf* else_if : node.else_ifs) {
+    condition(else_if->expr);
+    line("}");
+    line("else if (" + curr_code + ") {");
+    block(else_if->stmts);
+  }
+  if (!node.body_stmts.empty()) {
+    line("}");
+    line("else {");
+    block(node.body_stmts);
+  }
+  line("}");
+}
+
+inline void JitEmitter::visit(WhileStmt& node)
+{
+  condition(node.expr);
+  line("while (" + curr_code + ") {");
+  block(node.stmts);
+  line("}");
+}
+
+inline void JitEmitter::visit(ForStmt& node)
+{
+  // the counter shares the body's scope; the start value cannot see it
+  // but the end value can (it is set before the end is evaluated)
+  // parfor loops stay with the interpreter (and its thread pool), as
+  // do for-in loops over arrays
+  if (node.parallel or node.each)
+    throw Unsupported();
+  const std::string& name = node.var_id.lexeme();
+  std::string end = "t" + std::to_string(next_temp++);
+  line("{");
+  ++indent;
+  scopes.emplace_back();
+  declaring = name;
+  node.start->accept(*this);
+  declaring.clear();
+  if (curr_kind != JIT_INT)
+    throw Unsupported();
+  declare(name, JIT_INT);
+  line("int32_t v_" + name + " = " + curr_code + ";");
+  node.end->accept(*this);
+  if (curr_kind != JIT_INT)
+    throw Unsupported();
+  line("int32_t " + end + " = " + curr_code + ";");
+  line("while (v_" + name + " <= " + end + ") {");
+  ++indent;
+  statements(node.stmts);
+  line("++v_" + name + ";");
+  --indent;
+  line("}");
+  scopes.pop_back();
+  --indent;
+  line("}");
+}
+
+
+//----------------------------------------------------------------------
+// EXPRESSIONS
+//----------------------------------------------------------------------
+
+inline void JitEmitter::visit(Expr& node)
+{
+  JitKind kind = kind_of(node.type);
+  node.first->accept(*this);
+  if (node.negated) {
+    if (curr_kind != JIT_BOOL)
+      throw Unsupported();
+    curr_code = "(!" + curr_code + ")";
+  }
+  else if (node.op) {
+    std::string lhs = curr_code;
+    JitKind lhs_kind = curr_kind;
+    node.rest->accept(*this);
+    std::string rhs = curr_code;
+    JitKind rhs_kind = curr_kind;
+    const std::string& op = node.op->lexeme();
+    bool numbers = lhs_kind == rhs_kind and lhs_kind != JIT_BOOL;
+    bool ints = lhs_kind == JIT_INT and rhs_kind == JIT_INT;
+    bool bools = lhs_kind == JIT_BOOL and rhs_kind == JIT_BOOL;
+    JitKind result = lhs_kind;
+    // both operands are always evaluated (as in the interpreter)
+    if ((op == "+" or op == "-" or op == "*") and numbers)
+      curr_code = "(" + lhs + " " + op + " " + rhs + ")";
+    else if (op == "/" and numbers and !ints)
+      curr_code = "(" + lhs + " / " + rhs + ")";
+    else if (op == "%" and ints)
+      curr_code = "(" + lhs + " % " + rhs + ")";
+    else if (op == "^" and ints)
+      curr_code = "mypl_ipow(" + lhs + ", " + rhs + ")";
+    else if ((op == "and" or op == "or") and bools)
+      curr_code = "(" + lhs + (op == "and" ? " & " : " | ") + rhs + ")";
+    else if ((op == "<" or op == "<=" or op == ">" or op == ">=") and numbers) {
+      curr_code = "(" + lhs + " " + op + " " + rhs + ")";
+      result = JIT_BOOL;
+    }
+    else if (op == "==" and lhs_kind == rhs_kind) {
+      curr_code = "(" + lhs + " == " + rhs + ")";
+      result = JIT_BOOL;
+    }
+    else
+      throw Unsupported();
+    curr_kind = result;
+  }
+  if (curr_kind != kind)
+    throw Unsupported();
+}
+
+inline void JitEmitter::visit(SimpleTerm& node)
+{
+  node.rvalue->accept(*this);
+}
+
+inline void JitEmitter::visit(ComplexTerm& node)
+{
+  node.expr->accept(*this);
+}
+
+inline void JitEmitter::visit(SimpleRValue& node)
+{
+  const std::string& lexeme = node.value.lexeme();
+  try {
+    if (node.value.type() == INT_VAL) {
+      curr_code = std::to_string(std::stoi(lexeme));
+      curr_kind = JIT_INT;
+    }
+    else if (node.value.type() == DOUBLE_VAL) {
+      // hex floats keep the exact value
+      char buffer[64];
+      snprintf(buffer, sizeof(buffer), "%a", std::stod(lexeme));
+      curr_code = buffer;
+      curr_kind = JIT_DOUBLE;
+    }
+    else if (node.value.type() == BOOL_VAL) {
+      curr_code = lexeme == "true" ? "1" : "0";
+      curr_kind = JIT_BOOL;
+    }
+    else
+      throw Unsupported();
+  }
+  catch (const std::logic_error&) {
+    // out of range literals are reported by the interpreter
+    throw Unsupported();
+  }
+}
+
+inline void JitEmitter::visit(NewRValue& node)
+{
+  throw Unsupported();
+}
+
+inline void JitEmitter::visit(CallExpr& node)
+{
+  const std::string& name = node.function_id.lexeme();
+  std::string callee;
+  std::vector<JitKind> params;
+  JitKind result;
+  // built-ins take precedence over user-defined functions
+  if (const NativeFunction* native = BuiltinRegistry::instance().find(name)) {
+    auto it = jit_natives().find(name);
+    if (it == jit_natives().end())
+      throw Unsupported();
+    callee = it->second;
+    for (size_t i = 0; i + 1 < native->type.size(); ++i)
+      params.push_back(kind_of(native->type[i]));
+    result = kind_of(native->type.back());
+  }
+  else {
+    auto it = functions.find(name);
+    if (it == functions.end() or name == "main")
+      throw Unsupported();
+    FunDecl* fun = it->second;
+    callee = "f" + std::to_string(function_id(fun));
+    for (const FunDecl::FunParam& p : fun->params)
+      params.push_back(kind_of(p.type.lexeme()));
+    result = kind_of(fun->return_type.lexeme());
+  }
+  if (params.size() != node.arg_list.size())
+    throw Unsupported();
+  std::string call = callee + "(";
+  size_t i = 0;
+  for (Expr* arg : node.arg_list) {
+    arg->accept(*this);
+    if (curr_kind != params[i])
+      throw Unsupported();
+    call += (i ? ", " : "") + curr_code;
+    ++i;
+  }
+  curr_code = call + ")";
+  curr_kind = result;
+}
+
+inline void JitEmitter::visit(IDRValue& node)
+{
+  if (node.path.size() != 1 or !node.indexes.empty())
+    throw Unsupported();
+  const std::string& name = node.path.front().lexeme();
+  curr_kind = variable(name);
+  curr_code = "v_" + name;
+}
+
+inline void JitEmitter::visit(NegatedRValue& node)
+{
+  node.expr->accept(*this);
+  if (curr_kind == JIT_BOOL)
+    throw Unsupported();
+  curr_code = "(-1 * " + curr_code + ")";
+}
+
+inline void JitEmitter::visit(MatrixValue& node)
+{
+  throw Unsupported();
+}
+
+inline void JitEmitter::visit(ArrayValue& node)
+{
+  throw Unsupported();
+}
+
+inline void JitEmitter::visit(TransposedRValue& node)
+{
+  throw Unsupported();
+}
+
+
+//----------------------------------------------------------------------
+// TIERING
+//----------------------------------------------------------------------
+
+class Jit
+{
+public:
+
+  // compile functions and loops once they have run threshold times
+  Jit(size_t threshold);
+  ~Jit();
+
+  // count a call of fun; returns its compiled code once it is hot
+  // (nullptr while it is still interpreted)
+  const JitFunction* function_code(FunDecl* fun, const FunctionMap& functions);
+
+  // count an iteration of a while or for loop; returns its compiled
+  // code once it is hot (the variables the loop uses from outside must
+  // be in scope in sym_table)
+  const JitLoop* loop_code(Stmt* loop, const FunctionMap& functions,
+                           SymbolTable& sym_table);
+
+private:
+
+  struct Entry {
+    size_t count = 0;
+    bool tried = false;
+    JitFunction fun;
+    JitLoop loop;
+  };
+
+  size_t threshold;
+  std::unordered_map<const void*,Entry> entries;
+  std::vector<void*> libraries;
+  std::string work_dir;
+  size_t next_unit = 0;
+
+  // compile a unit and return its mypl_entry (nullptr on failure)
+  void* build(const std::string& source);
+
+  // run the compiler (no shell; its output is discarded), returning
+  // true if it succeeded
+  static bool run_compiler(const std::vector<std::string>& args);
+};
+
+
+inline Jit::Jit(size_t threshold)
+  : threshold(threshold)
+{
+}
+
+
+inline Jit::~Jit()
+{
+  for (void* library : libraries)
+    dlclose(library);
+  if (!work_dir.empty())
+    rmdir(work_dir.c_str());
+}
+
+
+inline const JitFunction* Jit::function_code(FunDecl* fun, const FunctionMap& functions)
+{
+  Entry& entry = entries[fun];
+  if (entry.fun.code)
+    return &entry.fun;
+  if (entry.tried or ++entry.count < threshold)
+    return nullptr;
+  entry.tried = true;
+  std::string source;
+  JitEmitter emitter(functions);
+  if (!emitter.function_unit(*fun, source, entry.fun))
+    return nullptr;
+  entry.fun.code = (JitFunctionCode)build(source);
+  if (!entry.fun.code)
+    return nullptr;
+  MYPL_COUNT(++mypl_stats.jit_functions);
+  return &entry.fun;
+}
+
+
+inline const JitLoop* Jit::loop_code(Stmt* loop, const FunctionMap& functions,
+                              SymbolTable& sym_table)
+{
+  Entry& entry = entries[loop];
+  if (entry.loop.code)
+    return &entry.loop;
+  if (entry.tried or ++entry.count < threshold)
+    return nullptr;
+  entry.tried = true;
+  std::string source;
+  JitEmitter emitter(functions);
+  if (!emitter.loop_unit(*loop, sym_table, source, entry.loop))
+    return nullptr;
+  entry.loop.code = (JitLoopCode)build(source);
+  if (!entry.loop.code)
+    return nullptr;
+  MYPL_COUNT(++mypl_stats.jit_loops);
+  return &entry.loop;
+}
+
+
+inline void* Jit::build(const std::string& source)
+{
+  if (work_dir.empty()) {
+    const char* tmp = getenv("TMPDIR");
+    std::string pattern = std::string(tmp ? tmp : "/tmp") + "/mypl-jit-XXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    if (!mkdtemp(path.data()))
+      return nullptr;
+    work_dir = path.data();
+  }
+  std::string base = work_dir + "/unit" + std::to_string(next_unit++);
+  std::string c_file = base + ".c";
+  std::string lib_file = base + ".so";
+  {
+    std::ofstream out(c_file);
+    out << source;
+    if (!out)
+      return nullptr;
+  }
+  // MYPL_JIT_CC selects the C compiler (default cc), with any options
+  // it gives separated by spaces
+  const char* cc = getenv("MYPL_JIT_CC");
+  std::vector<std::string> args;
+  std::istringstream words(cc ? cc : "cc");
+  for (std::string word; words >> word; )
+    args.push_back(word);
+  if (args.empty())
+    args.push_back("cc");
+  for (const char* option : {"-O2", "-fPIC", "-shared", "-fwrapv", "-ffp-contract=off", "-o"})
+    args.push_back(option);
+  args.insert(args.end(), {lib_file, c_file, "-lm"});
+  void* entry = nullptr;
+  if (run_compiler(args)) {
+    void* library = dlopen(lib_file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (library) {
+      libraries.push_back(library);
+      entry = dlsym(library, "mypl_entry");
+    }
+  }
+  unlink(c_file.c_str());
+  unlink(lib_file.c_str());
+  return entry;
+}
+
+
+inline bool Jit::run_compiler(const std::vector<std::string>& args)
+{
+  std::vector<char*> argv;
+  for (const std::string& arg : args)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+  pid_t pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0) {
+      dup2(null, STDOUT_FILENO);
+      dup2(null, STDERR_FILENO);
+    }
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0)
+    if (errno != EINTR)
+      return false;
+  return WIFEXITED(status) and WEXITSTATUS(status) == 0;
+}
+
+
+#endif
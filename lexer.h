@@ -12,12 +12,17 @@
 #include <string>
 #include "token.h"
 #include "mypl_exception.h"
+#include "stats.h"
 using namespace std;
 class Lexer {
 public:
     // construct a new lexer from the input stream
     Lexer(std::istream& input_stream);
 
+    // construct a lexer for part of a larger source, continuing from the
+    // line and column the lexer had reached there (see split_source)
+    Lexer(std::istream& input_stream, int line, int column);
+
     // return the next available token in the input stream (including
     // EOS if at the end of the stream)
     Token next_token();
@@ -28,6 +33,9 @@ private:
     int line;
     int column;
 
+    // lex the next token (see next_token)
+    Token read_token();
+
     // return a single character from the input stream and advance
     char read();
 
@@ -38,30 +46,44 @@ private:
     void error(const std::string& msg, int line, int column) const;
 };
 //Constructor
-Lexer::Lexer(std::istream& input_stream)
+inline Lexer::Lexer(std::istream& input_stream)
     : input_stream(input_stream)
     , line(1)
     , column(1)
 {
 }
+
+inline Lexer::Lexer(std::istream& input_stream, int line, int column)
+    : input_stream(input_stream)
+    , line(line)
+    , column(column)
+{
+}
 //Moves cursor and returns char from input stream
-char Lexer::read()
+inline char Lexer::read()
 {
     return input_stream.get();
 }
 //Peeks char but does not move cursor
-char Lexer::peek()
+inline char Lexer::peek()
 {
     return input_stream.peek();
 }
 //Throws exception with comment
-void Lexer::error(const std::string& msg, int line, int column) const
+inline void Lexer::error(const std::string& msg, int line, int column) const
 {
     throw MyPLException(LEXER, msg, line, column);
 }
 
+//Returns the next token, counting it for --stats
+inline Token Lexer::next_token()
+{
+    MYPL_COUNT(++mypl_stats.tokens);
+    return read_token();
+}
+
 //Takes grabs and returns next token
-Token Lexer::next_token()
+inline Token Lexer::read_token()
 {
 //Lexeme which accumulates chars
     std::string lexeme = "";
@@ -178,6 +200,14 @@ Token Lexer::next_token()
          
             return Token(R_BRACKET, "]", line, column);
         }
+        if (ch == '{') {
+            lexeme = "";
+            return Token(L_BRACE, "{", line, column);
+        }
+        if (ch == '}') {
+            lexeme = "";
+            return Token(R_BRACE, "}", line, column);
+        }
         if (ch == ':') {
             lexeme = "";
             return Token(COLON, ":", line, column);
@@ -235,7 +265,8 @@ Token Lexer::next_token()
                 column++;
                 return Token(GREATER_EQUAL, ">=", line, column - 1);
             }
-            else if (peek() == ' ') {
+            else {
+                // also closes an array<T> type
                 lexeme = "";
                 return Token(GREATER, ">", line, column);
             }
@@ -246,7 +277,8 @@ Token Lexer::next_token()
                 column++;
                 return Token(LESS_EQUAL, "<=", line, column - 1);
             }
-            else if (peek() == ' ') {
+            else {
+                // also opens an array<T> type
                 lexeme = "";
                 return Token(LESS, "<", line, column);
             }
@@ -318,7 +350,7 @@ Token Lexer::next_token()
             line_holder = line;
             column_holder = column;
             lexeme += ch;
-            while (peek() != ' ' && peek() != '\n' && peek() != '#' && peek() != '"' && peek() != '\'' && peek() != '('&& peek() != ')' && peek() != '-' && peek() != '%' && peek() != '+' && peek() != '/' && peek() != '*' && peek() != ',' && peek() != ';' && peek() != ']' && peek() != '[') {
+            while (peek() != ' ' && peek() != '\n' && peek() != '#' && peek() != '"' && peek() != '\'' && peek() != '('&& peek() != ')' && peek() != '-' && peek() != '%' && peek() != '+' && peek() != '/' && peek() != '*' && peek() != ',' && peek() != ';' && peek() != ']' && peek() != '[' && peek() != '}') {
                 ch = read();
                 column++;
                 lexeme += ch;
@@ -372,6 +404,10 @@ Token Lexer::next_token()
                 lexeme = "";
                 return Token(TYPE, "type", line, column - 4);
             }
+            if (lexeme == "import") {
+                lexeme = "";
+                return Token(IMPORT, "import", line, column - 5);
+            }
             if (lexeme == "while") {
                 lexeme = "";
                 return Token(WHILE, "while", line, column - 5);
@@ -380,6 +416,14 @@ Token Lexer::next_token()
                 lexeme = "";
                 return Token(FOR, "for", line, column - 2);
             }
+            if (lexeme == "parfor") {
+                lexeme = "";
+                return Token(PARFOR, "parfor", line, column - 5);
+            }
+            if (lexeme == "in") {
+                lexeme = "";
+                return Token(IN, "in", line, column - 1);
+            }
             if (lexeme == "or") {
                 lexeme = "";
                 return Token(OR, "or", line, column - 1);
@@ -0,0 +1,81 @@
+//----------------------------------------------------------------------
+// FILE: map_builtins.h
+// DESC: Native map built-ins: put, get, has, remove, and keys. put and
+//       remove update the map variable given as their first argument in
+//       place (so it is only copied if it is shared). get is an
+//       overload of the string get in builtins.h, as map length is of
+//       length.
+//----------------------------------------------------------------------
+
+#ifndef MAP_BUILTINS_H
+#define MAP_BUILTINS_H
+
+#include "builtins.h"
+
+
+// the map given as the first argument
+inline const Map* map_arg(NativeContext& ctx, NativeArgs args)
+{
+  const Map* m = args[0].map_ptr();
+  if (!m)
+    ctx.error("nil map");
+  return m;
+}
+
+// put(m, k, v) sets the value of key k in m to v
+inline void native_put(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Map* m = args[0].mutable_map_ptr();
+  if (!m)
+    ctx.error("nil map");
+  if (!m->put(args[1], args[2]))
+    ctx.error("nil map key");
+  result.set_nil();
+}
+
+// get(m, k) is the value of key k in m
+inline void native_map_get(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const DataObject* val = map_arg(ctx, args)->find(args[1]);
+  if (!val)
+    ctx.error("key not in map");
+  result = *val;
+}
+
+// has(m, k) is true if m has key k
+inline void native_has(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  result.set(map_arg(ctx, args)->find(args[1]) != nullptr);
+}
+
+// remove(m, k) removes key k from m, giving true if it was there
+inline void native_remove(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Map* m = args[0].mutable_map_ptr();
+  if (!m)
+    ctx.error("nil map");
+  result.set(m->remove(args[1]));
+}
+
+// keys(m) is an array of the keys of m, in the order they were added
+inline void native_keys(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Map* m = map_arg(ctx, args);
+  Array keys(m->key_type_name());
+  m->keys(keys);
+  result.set(std::move(keys));
+}
+
+
+// register the map family
+inline void add_map_builtins(BuiltinRegistry& r)
+{
+  r.add("put", StringVec{"map<K,V>", "K", "V", "nil"}, native_put, true);
+  r.add_overload("get", StringVec{"map<K,V>", "K", "V"}, native_map_get);
+  r.add("has", StringVec{"map<K,V>", "K", "bool"}, native_has);
+  r.add("remove", StringVec{"map<K,V>", "K", "bool"}, native_remove, true);
+  r.add("keys", StringVec{"map<K,V>", "array<K>"}, native_keys);
+}
+
+
+#endif
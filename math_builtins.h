@@ -0,0 +1,125 @@
+//----------------------------------------------------------------------
+// FILE: math_builtins.h
+// DESC: Native math built-ins over doubles (sqrt, exp, log, pow, sin,
+//       cos, abs, floor, ceil, min, max) and their elementwise m_
+//       matrix variants. Both forms run the same kernels from
+//       matrix.h, so scalar and matrix results always agree.
+//----------------------------------------------------------------------
+
+#ifndef MATH_BUILTINS_H
+#define MATH_BUILTINS_H
+
+#include <cmath>
+#include <utility>
+#include "builtins.h"
+#include "matrix.h"
+
+
+// kernel signatures (see matrix.h)
+typedef void (*UnaryKernel)(const double* in, double* out, size_t n);
+typedef void (*BinaryKernel)(const double* a, const double* b, double* out, size_t n);
+
+
+// double -> double built-in
+template<UnaryKernel K>
+void native_unary(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  double x = 0.0;
+  double y = 0.0;
+  args[0].value(x);
+  K(&x, &y, 1);
+  result.set(y);
+}
+
+// (double, double) -> double built-in
+template<BinaryKernel K>
+void native_binary(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  double a = 0.0;
+  double b = 0.0;
+  double y = 0.0;
+  args[0].value(a);
+  args[1].value(b);
+  K(&a, &b, &y, 1);
+  result.set(y);
+}
+
+// matrix -> matrix built-in (the argument is owned by the call, so the
+// kernel runs in place on its storage, copied only if it is shared)
+template<UnaryKernel K>
+void native_m_unary(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Matrix* m = args[0].mutable_matrix_ptr();
+  if (!m)
+    ctx.error("expecting a matrix argument");
+  K(m->data(), m->data(), m->size());
+  result = std::move(args[0]);
+}
+
+// (matrix, matrix) -> matrix built-in, dimensions must match
+template<BinaryKernel K>
+void native_m_binary(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Matrix* a = args[0].mutable_matrix_ptr();
+  const Matrix* b = args[1].matrix_ptr();
+  if (!a or !b)
+    ctx.error("expecting matrix arguments");
+  if (a->rows() != b->rows() or a->cols() != b->cols())
+    ctx.error("Matrix dimensions must be equivalent");
+  K(a->data(), b->data(), a->data(), a->size());
+  result = std::move(args[0]);
+}
+
+inline void native_pow(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  double x = 0.0;
+  double p = 0.0;
+  double y = 0.0;
+  args[0].value(x);
+  args[1].value(p);
+  kernel_pow(&x, p, &y, 1);
+  result.set(y);
+}
+
+inline void native_m_pow(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Matrix* m = args[0].mutable_matrix_ptr();
+  double p = 0.0;
+  if (!m)
+    ctx.error("expecting a matrix argument");
+  args[1].value(p);
+  kernel_pow(m->data(), p, m->data(), m->size());
+  result = std::move(args[0]);
+}
+
+
+// register the math family
+inline void add_math_builtins(BuiltinRegistry& r)
+{
+  r.add("sqrt", StringVec{"double", "double"}, native_unary<kernel_sqrt>);
+  r.add("exp", StringVec{"double", "double"}, native_unary<kernel_exp>);
+  r.add("log", StringVec{"double", "double"}, native_unary<kernel_log>);
+  r.add("sin", StringVec{"double", "double"}, native_unary<kernel_sin>);
+  r.add("cos", StringVec{"double", "double"}, native_unary<kernel_cos>);
+  r.add("abs", StringVec{"double", "double"}, native_unary<kernel_abs>);
+  r.add("floor", StringVec{"double", "double"}, native_unary<kernel_floor>);
+  r.add("ceil", StringVec{"double", "double"}, native_unary<kernel_ceil>);
+  r.add("pow", StringVec{"double", "double", "double"}, native_pow);
+  r.add("min", StringVec{"double", "double", "double"}, native_binary<kernel_min>);
+  r.add("max", StringVec{"double", "double", "double"}, native_binary<kernel_max>);
+  // elementwise matrix variants
+  r.add("m_sqrt", StringVec{"matrix", "matrix"}, native_m_unary<kernel_sqrt>);
+  r.add("m_exp", StringVec{"matrix", "matrix"}, native_m_unary<kernel_exp>);
+  r.add("m_log", StringVec{"matrix", "matrix"}, native_m_unary<kernel_log>);
+  r.add("m_sin", StringVec{"matrix", "matrix"}, native_m_unary<kernel_sin>);
+  r.add("m_cos", StringVec{"matrix", "matrix"}, native_m_unary<kernel_cos>);
+  r.add("m_abs", StringVec{"matrix", "matrix"}, native_m_unary<kernel_abs>);
+  r.add("m_floor", StringVec{"matrix", "matrix"}, native_m_unary<kernel_floor>);
+  r.add("m_ceil", StringVec{"matrix", "matrix"}, native_m_unary<kernel_ceil>);
+  r.add("m_pow", StringVec{"matrix", "double", "matrix"}, native_m_pow);
+  r.add("m_min", StringVec{"matrix", "matrix", "matrix"}, native_m_binary<kernel_min>);
+  r.add("m_max", StringVec{"matrix", "matrix", "matrix"}, native_m_binary<kernel_max>);
+}
+
+
+#endif
@@ -0,0 +1,414 @@
+//----------------------------------------------------------------------
+// FILE: matrix.h
+// DESC: Contiguous (row-major) matrix storage for MyPL matrix values,
+//       plus the SIMD kernels (elementwise, reductions, LU) used by the
+//       m_ built-ins.
+//       Kernels use AVX when available, then SSE2, and always finish
+//       (or fall back) with a scalar loop.
+//----------------------------------------------------------------------
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <cmath>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MYPL_SIMD 1
+#define MYPL_SIMD_ROUND 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MYPL_SIMD 1
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#define MYPL_SIMD_ROUND 1
+#endif
+#endif
+
+
+class Matrix
+{
+public:
+
+  // construction
+  Matrix();
+  Matrix(size_t rows, size_t cols, double fill = 0.0);
+  Matrix(const std::vector<std::vector<double>>& nested);
+
+  // dimensions
+  size_t rows() const;
+  size_t cols() const;
+  size_t size() const;
+
+  // element access (row-major)
+  double& at(size_t row, size_t col);
+  double at(size_t row, size_t col) const;
+
+  // the contiguous element storage
+  double* data();
+  const double* data() const;
+
+  // copy out as a vector of rows
+  std::vector<std::vector<double>> to_nested() const;
+
+private:
+  size_t n_rows = 0;
+  size_t n_cols = 0;
+  std::vector<double> values;
+};
+
+
+//----------------------------------------------------------------------
+// MATRIX MEMBER FUNCTIONS
+//----------------------------------------------------------------------
+
+inline Matrix::Matrix()
+{
+}
+
+inline Matrix::Matrix(size_t rows, size_t cols, double fill)
+  : n_rows(rows), n_cols(cols), values(rows * cols, fill)
+{
+}
+
+inline Matrix::Matrix(const std::vector<std::vector<double>>& nested)
+  : n_rows(nested.size())
+{
+  // ragged rows are padded with zeros to the widest row
+  for (const std::vector<double>& row : nested)
+    if (row.size() > n_cols)
+      n_cols = row.size();
+  values.assign(n_rows * n_cols, 0.0);
+  for (size_t i = 0; i < n_rows; ++i)
+    for (size_t j = 0; j < nested[i].size(); ++j)
+      values[i * n_cols + j] = nested[i][j];
+}
+
+inline size_t Matrix::rows() const
+{
+  return n_rows;
+}
+
+inline size_t Matrix::cols() const
+{
+  return n_cols;
+}
+
+inline size_t Matrix::size() const
+{
+  return values.size();
+}
+
+inline double& Matrix::at(size_t row, size_t col)
+{
+  return values[row * n_cols + col];
+}
+
+inline double Matrix::at(size_t row, size_t col) const
+{
+  return values[row * n_cols + col];
+}
+
+inline double* Matrix::data()
+{
+  return values.data();
+}
+
+inline const double* Matrix::data() const
+{
+  return values.data();
+}
+
+inline std::vector<std::vector<double>> Matrix::to_nested() const
+{
+  std::vector<std::vector<double>> nested(n_rows);
+  for (size_t i = 0; i < n_rows; ++i)
+    nested[i].assign(values.begin() + i * n_cols,
+                     values.begin() + (i + 1) * n_cols);
+  return nested;
+}
+
+
+//----------------------------------------------------------------------
+// SIMD HELPERS
+//----------------------------------------------------------------------
+
+#if defined(__AVX__)
+typedef __m256d SimdVec;
+const size_t SIMD_WIDTH = 4;
+inline SimdVec simd_load(const double* p) {return _mm256_loadu_pd(p);}
+inline void simd_store(double* p, SimdVec v) {_mm256_storeu_pd(p, v);}
+inline SimdVec simd_set1(double x) {return _mm256_set1_pd(x);}
+inline SimdVec simd_add(SimdVec a, SimdVec b) {return _mm256_add_pd(a, b);}
+inline SimdVec simd_mul(SimdVec a, SimdVec b) {return _mm256_mul_pd(a, b);}
+inline SimdVec simd_sqrt(SimdVec v) {return _mm256_sqrt_pd(v);}
+inline SimdVec simd_abs(SimdVec v) {return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v);}
+inline SimdVec simd_min(SimdVec a, SimdVec b) {return _mm256_min_pd(a, b);}
+inline SimdVec simd_max(SimdVec a, SimdVec b) {return _mm256_max_pd(a, b);}
+inline SimdVec simd_floor(SimdVec v) {return _mm256_floor_pd(v);}
+inline SimdVec simd_ceil(SimdVec v) {return _mm256_ceil_pd(v);}
+#elif defined(__SSE2__)
+typedef __m128d SimdVec;
+const size_t SIMD_WIDTH = 2;
+inline SimdVec simd_load(const double* p) {return _mm_loadu_pd(p);}
+inline void simd_store(double* p, SimdVec v) {_mm_storeu_pd(p, v);}
+inline SimdVec simd_set1(double x) {return _mm_set1_pd(x);}
+inline SimdVec simd_add(SimdVec a, SimdVec b) {return _mm_add_pd(a, b);}
+inline SimdVec simd_mul(SimdVec a, SimdVec b) {return _mm_mul_pd(a, b);}
+inline SimdVec simd_sqrt(SimdVec v) {return _mm_sqrt_pd(v);}
+inline SimdVec simd_abs(SimdVec v) {return _mm_andnot_pd(_mm_set1_pd(-0.0), v);}
+inline SimdVec simd_min(SimdVec a, SimdVec b) {return _mm_min_pd(a, b);}
+inline SimdVec simd_max(SimdVec a, SimdVec b) {return _mm_max_pd(a, b);}
+#if defined(__SSE4_1__)
+inline SimdVec simd_floor(SimdVec v) {return _mm_floor_pd(v);}
+inline SimdVec simd_ceil(SimdVec v) {return _mm_ceil_pd(v);}
+#endif
+#endif
+
+
+//----------------------------------------------------------------------
+// ELEMENTWISE KERNELS (out may alias in; scalar tails match the SIMD
+// min/max semantics, returning the second operand on NaN)
+//----------------------------------------------------------------------
+
+inline void kernel_sqrt(const double* in, double* out, size_t n)
+{
+  size_t i = 0;
+#if defined(MYPL_SIMD)
+  for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    simd_store(out + i, simd_sqrt(simd_load(in + i)));
+#endif
+  for (; i < n; ++i)
+    out[i] = std::sqrt(in[i]);
+}
+
+inline void kernel_abs(const double* in, double* out, size_t n)
+{
+  size_t i = 0;
+#if defined(MYPL_SIMD)
+  for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    simd_store(out + i, simd_abs(simd_load(in + i)));
+#endif
+  for (; i < n; ++i)
+    out[i] = std::fabs(in[i]);
+}
+
+inline void kernel_floor(const double* in, double* out, size_t n)
+{
+  size_t i = 0;
+#if defined(MYPL_SIMD_ROUND)
+  for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    simd_store(out + i, simd_floor(simd_load(in + i)));
+#endif
+  for (; i < n; ++i)
+    out[i] = std::floor(in[i]);
+}
+
+inline void kernel_ceil(const double* in, double* out, size_t n)
+{
+  size_t i = 0;
+#if defined(MYPL_SIMD_ROUND)
+  for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    simd_store(out + i, simd_ceil(simd_load(in + i)));
+#endif
+  for (; i < n; ++i)
+    out[i] = std::ceil(in[i]);
+}
+
+inline void kernel_min(const double* a, const double* b, double* out, size_t n)
+{
+  size_t i = 0;
+#if defined(MYPL_SIMD)
+  for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    simd_store(out + i, simd_min(simd_load(a + i), simd_load(b + i)));
+#endif
+  for (; i < n; ++i)
+    out[i] = a[i] < b[i] ? a[i] : b[i];
+}
+
+inline void kernel_max(const double* a, const double* b, double* out, size_t n)
+{
+  size_t i = 0;
+#if defined(MYPL_SIMD)
+  for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    simd_store(out + i, simd_max(simd_load(a + i), simd_load(b + i)));
+#endif
+  for (; i < n; ++i)
+    out[i] = a[i] > b[i] ? a[i] : b[i];
+}
+
+// transcendental kernels have no portable SIMD instruction; these plain
+// loops are left for the compiler to vectorize (e.g., with libmvec)
+inline void kernel_exp(const double* in, double* out, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    out[i] = std::exp(in[i]);
+}
+
+inline void kernel_log(const double* in, double* out, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    out[i] = std::log(in[i]);
+}
+
+inline void kernel_sin(const double* in, double* out, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    out[i] = std::sin(in[i]);
+}
+
+inline void kernel_cos(const double* in, double* out, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    out[i] = std::cos(in[i]);
+}
+
+inline void kernel_pow(const double* in, double p, double* out, size_t n)
+{
+  // squaring avoids the pow() call entirely
+  if (p == 2.0) {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = in[i] * in[i];
+  }
+  else {
+    for (size_t i = 0; i < n; ++i)
+      out[i] = std::pow(in[i], p);
+  }
+}
+
+
+//----------------------------------------------------------------------
+// REDUCTION KERNELS
+//----------------------------------------------------------------------
+
+inline double kernel_sum(const double* in, size_t n)
+{
+  size_t i = 0;
+  double total = 0.0;
+#if defined(MYPL_SIMD)
+  // two independent accumulators hide the add latency
+  SimdVec acc1 = simd_set1(0.0);
+  SimdVec acc2 = simd_set1(0.0);
+  for (; i + 2 * SIMD_WIDTH <= n; i += 2 * SIMD_WIDTH) {
+    acc1 = simd_add(acc1, simd_load(in + i));
+    acc2 = simd_add(acc2, simd_load(in + i + SIMD_WIDTH));
+  }
+  double lanes[SIMD_WIDTH];
+  simd_store(lanes, simd_add(acc1, acc2));
+  for (size_t j = 0; j < SIMD_WIDTH; ++j)
+    total += lanes[j];
+#endif
+  for (; i < n; ++i)
+    total += in[i];
+  return total;
+}
+
+inline double kernel_dot(const double* a, const double* b, size_t n)
+{
+  size_t i = 0;
+  double total = 0.0;
+#if defined(MYPL_SIMD)
+  SimdVec acc1 = simd_set1(0.0);
+  SimdVec acc2 = simd_set1(0.0);
+  for (; i + 2 * SIMD_WIDTH <= n; i += 2 * SIMD_WIDTH) {
+    acc1 = simd_add(acc1, simd_mul(simd_load(a + i), simd_load(b + i)));
+    acc2 = simd_add(acc2, simd_mul(simd_load(a + i + SIMD_WIDTH),
+                                   simd_load(b + i + SIMD_WIDTH)));
+  }
+  double lanes[SIMD_WIDTH];
+  simd_store(lanes, simd_add(acc1, acc2));
+  for (size_t j = 0; j < SIMD_WIDTH; ++j)
+    total += lanes[j];
+#endif
+  for (; i < n; ++i)
+    total += a[i] * b[i];
+  return total;
+}
+
+// out[i] += alpha * in[i]
+inline void kernel_axpy(double alpha, const double* in, double* out, size_t n)
+{
+  size_t i = 0;
+#if defined(MYPL_SIMD)
+  SimdVec va = simd_set1(alpha);
+  for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)
+    simd_store(out + i, simd_add(simd_load(out + i), simd_mul(va, simd_load(in + i))));
+#endif
+  for (; i < n; ++i)
+    out[i] += alpha * in[i];
+}
+
+
+//----------------------------------------------------------------------
+// LU DECOMPOSITION (partial pivoting, row-major so every inner loop
+// walks a contiguous row)
+//----------------------------------------------------------------------
+
+// Factor the square matrix a in place into L (unit diagonal, below the
+// diagonal) and U (on and above it). perm receives the row order and
+// sign the permutation parity. Returns false if a is singular.
+inline bool lu_decompose(Matrix& a, std::vector<size_t>& perm, int& sign)
+{
+  size_t n = a.rows();
+  perm.resize(n);
+  for (size_t i = 0; i < n; ++i)
+    perm[i] = i;
+  sign = 1;
+  bool singular = false;
+  for (size_t k = 0; k < n; ++k) {
+    // pick the largest pivot in column k
+    size_t pivot = k;
+    for (size_t i = k + 1; i < n; ++i)
+      if (std::fabs(a.at(i, k)) > std::fabs(a.at(pivot, k)))
+        pivot = i;
+    if (a.at(pivot, k) == 0.0) {
+      singular = true;
+      continue;
+    }
+    if (pivot != k) {
+      std::swap_ranges(a.data() + k * n, a.data() + (k + 1) * n, a.data() + pivot * n);
+      std::swap(perm[k], perm[pivot]);
+      sign = -sign;
+    }
+    // eliminate below the pivot, one contiguous row update at a time
+    double* row_k = a.data() + k * n;
+    for (size_t i = k + 1; i < n; ++i) {
+      double* row_i = a.data() + i * n;
+      double factor = row_i[k] / row_k[k];
+      row_i[k] = factor;
+      kernel_axpy(-factor, row_k + k + 1, row_i + k + 1, n - k - 1);
+    }
+  }
+  return !singular;
+}
+
+// Solve (LU) x = P b for every column of b, where lu and perm come from
+// lu_decompose. Rows of x are updated whole, keeping accesses contiguous.
+inline Matrix lu_solve(const Matrix& lu, const std::vector<size_t>& perm, const Matrix& b)
+{
+  size_t n = lu.rows();
+  size_t m = b.cols();
+  Matrix x(n, m);
+  for (size_t i = 0; i < n; ++i)
+    std::copy(b.data() + perm[i] * m, b.data() + (perm[i] + 1) * m, x.data() + i * m);
+  // forward substitution (L has a unit diagonal)
+  for (size_t i = 0; i < n; ++i)
+    for (size_t k = 0; k < i; ++k)
+      kernel_axpy(-lu.at(i, k), x.data() + k * m, x.data() + i * m, m);
+  // back substitution
+  for (size_t i = n; i > 0; --i) {
+    size_t r = i - 1;
+    for (size_t k = r + 1; k < n; ++k)
+      kernel_axpy(-lu.at(r, k), x.data() + k * m, x.data() + r * m, m);
+    double inv = 1.0 / lu.at(r, r);
+    for (size_t j = 0; j < m; ++j)
+      x.at(r, j) *= inv;
+  }
+  return x;
+}
+
+
+#endif
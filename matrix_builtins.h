@@ -0,0 +1,262 @@
+//----------------------------------------------------------------------
+// FILE: matrix_builtins.h
+// DESC: Native matrix built-ins: reductions (sums, means, norm, dot),
+//       element and shape access (m_set, m_rows, m_cols), LU-based
+//       linear algebra (m_solve, m_inverse, m_det) and constructors
+//       (m_identity, m_zeros, m_random). All of them run directly on
+//       the contiguous Matrix storage (see matrix.h).
+//----------------------------------------------------------------------
+
+#ifndef MATRIX_BUILTINS_H
+#define MATRIX_BUILTINS_H
+
+#include <cmath>
+#include <random>
+#include <utility>
+#include "builtins.h"
+#include "matrix.h"
+
+
+// the i-th argument as a matrix (error if it is not one)
+inline const Matrix* matrix_arg(NativeContext& ctx, NativeArgs args, size_t i)
+{
+  const Matrix* m = args[i].matrix_ptr();
+  if (!m)
+    ctx.error("expecting a matrix argument");
+  return m;
+}
+
+// the i-th argument as a matrix to modify (unshared first)
+inline Matrix* mutable_matrix_arg(NativeContext& ctx, NativeArgs args, size_t i)
+{
+  Matrix* m = args[i].mutable_matrix_ptr();
+  if (!m)
+    ctx.error("expecting a matrix argument");
+  return m;
+}
+
+// the i-th argument as a (non-negative) matrix dimension
+inline size_t dimension_arg(NativeContext& ctx, NativeArgs args, size_t i)
+{
+  int n = 0;
+  args[i].value(n);
+  if (n < 0)
+    ctx.error("Negative matrix dimensions");
+  return n;
+}
+
+
+//----------------------------------------------------------------------
+// REDUCTIONS
+//----------------------------------------------------------------------
+
+inline void native_m_sum(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Matrix* m = matrix_arg(ctx, args, 0);
+  result.set(kernel_sum(m->data(), m->size()));
+}
+
+inline void native_m_mean(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Matrix* m = matrix_arg(ctx, args, 0);
+  if (m->size() == 0)
+    ctx.error("mean of an empty matrix");
+  result.set(kernel_sum(m->data(), m->size()) / m->size());
+}
+
+// rows x 1 matrix of row totals, scaled by 1/cols for the mean
+template<bool Mean>
+void native_m_row_reduce(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Matrix* m = matrix_arg(ctx, args, 0);
+  if (Mean and m->cols() == 0)
+    ctx.error("mean of an empty matrix");
+  Matrix out(m->rows(), 1);
+  for (size_t r = 0; r < m->rows(); ++r) {
+    double total = kernel_sum(m->data() + r * m->cols(), m->cols());
+    out.at(r, 0) = Mean ? total / m->cols() : total;
+  }
+  result.set(std::move(out));
+}
+
+// 1 x cols matrix of column totals, accumulated a whole row at a time
+// so the matrix is read in storage order
+template<bool Mean>
+void native_m_col_reduce(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Matrix* m = matrix_arg(ctx, args, 0);
+  if (Mean and m->rows() == 0)
+    ctx.error("mean of an empty matrix");
+  Matrix out(1, m->cols());
+  for (size_t r = 0; r < m->rows(); ++r)
+    kernel_axpy(1.0, m->data() + r * m->cols(), out.data(), m->cols());
+  if (Mean)
+    for (size_t c = 0; c < m->cols(); ++c)
+      out.at(0, c) /= m->rows();
+  result.set(std::move(out));
+}
+
+// Frobenius norm
+inline void native_m_norm(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Matrix* m = matrix_arg(ctx, args, 0);
+  result.set(std::sqrt(kernel_dot(m->data(), m->data(), m->size())));
+}
+
+// sum of the elementwise products, dimensions must match
+inline void native_m_dot(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Matrix* a = matrix_arg(ctx, args, 0);
+  const Matrix* b = matrix_arg(ctx, args, 1);
+  if (a->rows() != b->rows() or a->cols() != b->cols())
+    ctx.error("Matrix dimensions must be equivalent");
+  result.set(kernel_dot(a->data(), b->data(), a->size()));
+}
+
+
+//----------------------------------------------------------------------
+// ELEMENT AND SHAPE ACCESS
+//----------------------------------------------------------------------
+
+// m_set(M, row, col, value) replaces the element in the variable M
+// itself (registered in place, so M is only copied if it is shared)
+inline void native_m_set(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Matrix* m = mutable_matrix_arg(ctx, args, 0);
+  int row = 0;
+  int col = 0;
+  double v = 0.0;
+  args[1].value(row);
+  args[2].value(col);
+  args[3].value(v);
+  if (row < 0 or col < 0 or row >= m->rows() or col >= m->cols())
+    ctx.error("Accessing out of bounds matrix");
+  m->at(row, col) = v;
+  result.set_nil();
+}
+
+inline void native_m_rows(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  result.set((int)matrix_arg(ctx, args, 0)->rows());
+}
+
+inline void native_m_cols(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  result.set((int)matrix_arg(ctx, args, 0)->cols());
+}
+
+
+//----------------------------------------------------------------------
+// LINEAR ALGEBRA
+//----------------------------------------------------------------------
+
+// the i-th argument as a square matrix to factor in place
+inline Matrix* square_arg(NativeContext& ctx, NativeArgs args, size_t i)
+{
+  Matrix* m = mutable_matrix_arg(ctx, args, i);
+  if (m->rows() != m->cols())
+    ctx.error("expecting a square matrix");
+  return m;
+}
+
+// m_solve(A, B) returns X such that A X = B
+inline void native_m_solve(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Matrix* a = square_arg(ctx, args, 0);
+  const Matrix* b = matrix_arg(ctx, args, 1);
+  if (b->rows() != a->rows())
+    ctx.error("Matrix dimensions do not match for solve");
+  std::vector<size_t> perm;
+  int sign = 1;
+  if (!lu_decompose(*a, perm, sign))
+    ctx.error("matrix is singular");
+  result.set(lu_solve(*a, perm, *b));
+}
+
+inline void native_m_inverse(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Matrix* a = square_arg(ctx, args, 0);
+  std::vector<size_t> perm;
+  int sign = 1;
+  if (!lu_decompose(*a, perm, sign))
+    ctx.error("matrix is singular");
+  Matrix identity(a->rows(), a->cols());
+  for (size_t i = 0; i < a->rows(); ++i)
+    identity.at(i, i) = 1.0;
+  result.set(lu_solve(*a, perm, identity));
+}
+
+inline void native_m_det(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  Matrix* a = square_arg(ctx, args, 0);
+  std::vector<size_t> perm;
+  int sign = 1;
+  if (!lu_decompose(*a, perm, sign)) {
+    result.set(0.0);
+    return;
+  }
+  double det = sign;
+  for (size_t i = 0; i < a->rows(); ++i)
+    det *= a->at(i, i);
+  result.set(det);
+}
+
+
+//----------------------------------------------------------------------
+// CONSTRUCTORS
+//----------------------------------------------------------------------
+
+inline void native_m_identity(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  size_t n = dimension_arg(ctx, args, 0);
+  Matrix m(n, n);
+  for (size_t i = 0; i < n; ++i)
+    m.at(i, i) = 1.0;
+  result.set(std::move(m));
+}
+
+inline void native_m_zeros(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  size_t rows = dimension_arg(ctx, args, 0);
+  size_t cols = dimension_arg(ctx, args, 1);
+  result.set(Matrix(rows, cols));
+}
+
+// uniform values in [0, 1)
+inline void native_m_random(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  static thread_local std::mt19937_64 engine {std::random_device{}()};
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  size_t rows = dimension_arg(ctx, args, 0);
+  size_t cols = dimension_arg(ctx, args, 1);
+  Matrix m(rows, cols);
+  for (size_t i = 0; i < m.size(); ++i)
+    m.data()[i] = uniform(engine);
+  result.set(std::move(m));
+}
+
+
+// register the matrix family
+inline void add_matrix_builtins(BuiltinRegistry& r)
+{
+  r.add("m_sum", StringVec{"matrix", "double"}, native_m_sum);
+  r.add("m_mean", StringVec{"matrix", "double"}, native_m_mean);
+  r.add("m_row_sums", StringVec{"matrix", "matrix"}, native_m_row_reduce<false>);
+  r.add("m_row_means", StringVec{"matrix", "matrix"}, native_m_row_reduce<true>);
+  r.add("m_col_sums", StringVec{"matrix", "matrix"}, native_m_col_reduce<false>);
+  r.add("m_col_means", StringVec{"matrix", "matrix"}, native_m_col_reduce<true>);
+  r.add("m_norm", StringVec{"matrix", "double"}, native_m_norm);
+  r.add("m_dot", StringVec{"matrix", "matrix", "double"}, native_m_dot);
+  r.add("m_set", StringVec{"matrix", "int", "int", "double", "nil"}, native_m_set, true);
+  r.add("m_rows", StringVec{"matrix", "int"}, native_m_rows);
+  r.add("m_cols", StringVec{"matrix", "int"}, native_m_cols);
+  r.add("m_solve", StringVec{"matrix", "matrix", "matrix"}, native_m_solve);
+  r.add("m_inverse", StringVec{"matrix", "matrix"}, native_m_inverse);
+  r.add("m_det", StringVec{"matrix", "double"}, native_m_det);
+  r.add("m_identity", StringVec{"int", "matrix"}, native_m_identity);
+  r.add("m_zeros", StringVec{"int", "int", "matrix"}, native_m_zeros);
+  r.add("m_random", StringVec{"int", "int", "matrix"}, native_m_random);
+}
+
+
+#endif
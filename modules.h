@@ -0,0 +1,214 @@
+//----------------------------------------------------------------------
+// FILE: modules.h
+// DESC: Imported modules. A program (or module) may start with
+//       import "path" declarations naming other MyPL files, relative to
+//       the importing file. Each module is compiled once per run: lexed,
+//       parsed, and type checked with its own imports linked in. It is
+//       cached in <module>.myplc under a key combining its source hash
+//       with its imports' keys, so it is only recompiled when it (or
+//       something it imports) changes. An importing program is checked
+//       against its modules' declarations, which are then moved, each
+//       module once and imports first, in front of its own to run.
+//----------------------------------------------------------------------
+
+#ifndef MODULES_H
+#define MODULES_H
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "ast.h"
+#include "ast_cache.h"
+#include "flat_map.h"
+#include "lexer.h"
+#include "parallel_parser.h"
+#include "type_checker.h"
+
+
+struct Module
+{
+  std::string path;                 // as named from the importing file
+  uint64_t hash = 0;                // its source's hash
+  uint64_t key = 0;                 // cache key
+  Program program;                  // its own (checked) declarations
+  std::vector<Module*> imports;
+  bool loaded = false;              // false while its imports load
+};
+
+
+class ModuleLoader
+{
+public:
+
+  // modules are read from and saved to their caches if use_cache
+  explicit ModuleLoader(bool use_cache);
+
+  // load the modules a source imports (file is the importing file, ""
+  // for standard input)
+  std::vector<Module*> load_imports(const std::string& source, const std::string& file);
+
+  // the cache key of a source with the given imports (its hash if none)
+  static uint64_t key(const std::string& source, const std::vector<Module*>& imports);
+
+  // make the modules' declarations visible to a checker
+  void link(TypeChecker& checker, const std::vector<Module*>& imports);
+
+  // move the modules' declarations in front of a checked program's
+  void link(Program& program, const std::vector<Module*>& imports);
+
+  // the real path and source hash of each module loaded
+  std::vector<std::pair<std::string, uint64_t>> sources() const;
+
+private:
+
+  // load a module, compiling it if its cache is out of date
+  Module& load(const std::string& path, const Token& import);
+
+  // the modules and their imports, each once, imports first
+  std::vector<Module*> link_order(const std::vector<Module*>& imports);
+  void link_order(Module* module, std::unordered_set<Module*>& seen, std::vector<Module*>& order);
+
+  // by real path
+  std::unordered_map<std::string, std::unique_ptr<Module>> modules;
+  bool use_cache;
+};
+
+
+inline ModuleLoader::ModuleLoader(bool use_cache)
+  : use_cache(use_cache)
+{
+}
+
+
+inline std::vector<Module*> ModuleLoader::load_imports(const std::string& source, const std::string& file)
+{
+  // only the leading import declarations are lexed here (the parser
+  // reports any errors in them)
+  std::vector<Token> paths;
+  try {
+    std::istringstream in(source);
+    Lexer lexer(in);
+    while (lexer.next_token().type() == IMPORT) {
+      Token path = lexer.next_token();
+      if (path.type() != STRING_VAL)
+        break;
+      paths.push_back(path);
+    }
+  }
+  catch (const MyPLException&) {
+  }
+  std::string dir = file.substr(0, file.find_last_of('/') + 1);
+  std::vector<Module*> imports;
+  for (const Token& path : paths) {
+    const std::string& name = path.lexeme();
+    imports.push_back(&load(!name.empty() and name[0] == '/' ? name : dir + name, path));
+  }
+  return imports;
+}
+
+
+inline uint64_t ModuleLoader::key(const std::string& source, const std::vector<Module*>& imports)
+{
+  uint64_t h = source_hash(source);
+  for (Module* module : imports)
+    h = hash_mix(h ^ module->key);
+  return h;
+}
+
+
+inline Module& ModuleLoader::load(const std::string& path, const Token& import)
+{
+  char* real = realpath(path.c_str(), nullptr);
+  if (!real)
+    throw MyPLException(SEMANTIC, "cannot open module '" + import.lexeme() + "'", import.line(), import.column());
+  std::string real_path = real;
+  free(real);
+  auto found = modules.find(real_path);
+  if (found != modules.end()) {
+    if (!found->second->loaded)
+      throw MyPLException(SEMANTIC, "import cycle through module '" + import.lexeme() + "'", import.line(), import.column());
+    return *found->second;
+  }
+  Module& module = *(modules[real_path] = std::unique_ptr<Module>(new Module));
+  module.path = path;
+  std::string source;
+  {
+    std::stringstream buffer;
+    buffer << std::ifstream(real_path).rdbuf();
+    source = buffer.str();
+  }
+  try {
+    module.imports = load_imports(source, path);
+    module.hash = source_hash(source);
+    module.key = key(source, module.imports);
+    std::string cache_path = real_path + ".myplc";
+    if (!use_cache or !load_program_cache(cache_path, module.key, module.program)) {
+      parse_source(source, module.program);
+      TypeChecker checker;
+      checker.set_module(true);
+      link(checker, module.imports);
+      module.program.accept(checker);
+      if (use_cache)
+        save_program_cache(cache_path, module.key, module.program);
+    }
+  }
+  catch (MyPLException& e) {
+    e.set_file(path);
+    throw;
+  }
+  module.loaded = true;
+  return module;
+}
+
+
+inline std::vector<Module*> ModuleLoader::link_order(const std::vector<Module*>& imports)
+{
+  std::unordered_set<Module*> seen;
+  std::vector<Module*> order;
+  for (Module* module : imports)
+    link_order(module, seen, order);
+  return order;
+}
+
+
+inline void ModuleLoader::link_order(Module* module, std::unordered_set<Module*>& seen, std::vector<Module*>& order)
+{
+  if (!seen.insert(module).second)
+    return;
+  for (Module* import : module->imports)
+    link_order(import, seen, order);
+  order.push_back(module);
+}
+
+
+inline void ModuleLoader::link(TypeChecker& checker, const std::vector<Module*>& imports)
+{
+  for (Module* module : link_order(imports))
+    checker.link(module->program);
+}
+
+
+inline void ModuleLoader::link(Program& program, const std::vector<Module*>& imports)
+{
+  std::vector<Module*> order = link_order(imports);
+  for (auto it = order.rbegin(); it != order.rend(); ++it)
+    program.decls.splice(program.decls.begin(), (*it)->program.decls);
+}
+
+
+inline std::vector<std::pair<std::string, uint64_t>> ModuleLoader::sources() const
+{
+  std::vector<std::pair<std::string, uint64_t>> result;
+  for (auto& module : modules)
+    result.push_back({module.first, module.second->hash});
+  return result;
+}
+
+
+#endif
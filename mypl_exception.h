@@ -8,6 +8,9 @@
 #ifndef MYPL_EXCEPTION
 #define MYPL_EXCEPTION
 
+#include <exception>
+#include <string>
+
 
 // the compilation stage where the error occurred
 enum ExceptionType {LEXER, SYNTAX, SEMANTIC, RUNTIME};
@@ -24,6 +27,10 @@ class MyPLException : public std::exception
   // construct an error exception without a line and column
   MyPLException(ExceptionType type, const std::string& msg);
   
+  // name the file the error is in (if not already named), for errors
+  // in imported modules
+  void set_file(const std::string& path);
+
   // return a string representation for printing
   std::string to_string() const;
   
@@ -34,23 +41,31 @@ class MyPLException : public std::exception
   bool has_line_column;
   int line;
   int column;
+  std::string file;
 
 };
 
 
-MyPLException::MyPLException(ExceptionType t, const std::string& m, int l, int c)
+inline MyPLException::MyPLException(ExceptionType t, const std::string& m, int l, int c)
   : type(t), message(m), line(l), column(c), has_line_column(true)
 {
 }
 
 
-MyPLException::MyPLException(ExceptionType t, const std::string& m)
+inline MyPLException::MyPLException(ExceptionType t, const std::string& m)
   : type(t), message(m), has_line_column(false)
 {
 }
 
 
-std::string MyPLException::to_string() const
+inline void MyPLException::set_file(const std::string& path)
+{
+  if (file.empty())
+    file = path;
+}
+
+
+inline std::string MyPLException::to_string() const
 {
   std::string s = "Lexer";
   switch(type) {
@@ -62,6 +77,8 @@ std::string MyPLException::to_string() const
   if (has_line_column)
     s += " at line " + std::to_string(line) +
       " column " + std::to_string(column);
+  if (!file.empty())
+    s += " in " + file;
   return s;
 }
 
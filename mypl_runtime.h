@@ -0,0 +1,963 @@
+//----------------------------------------------------------------------
+// FILE: mypl_runtime.h
+// DESC: Runtime library for MyPL programs translated to C++ (see
+//       cpp_emitter.h). Values are native C++ values (int, double,
+//       bool, char, std::string, Matrix, std::vector for arrays, a
+//       FlatMap for maps, and a struct pointer for each user-defined
+//       type). A primitive value that may be nil (a field, or a
+//       variable, parameter, or result the translator finds may be
+//       given nil) is a Nullable. The operators and built-ins here
+//       follow the interpreter, quirks included, so a translated
+//       program prints what the interpreted one prints.
+//----------------------------------------------------------------------
+
+#ifndef MYPL_RUNTIME_H
+#define MYPL_RUNTIME_H
+
+#include <algorithm>
+#include <iostream>
+#include <type_traits>
+#include <string>
+#include <vector>
+#include <random>
+#include <exception>
+#include <stdexcept>
+#include "mypl_exception.h"
+#include "matrix.h"
+#include "flat_map.h"
+#include "input_scanner.h"
+
+
+// field access through a (possibly nil) object: nil reads as the
+// field's zero value
+#define MYPL_FIELD(obj, member) \
+  mypl::field(obj, [](auto* o) {return o->member;})
+
+// a field to update in place (an error at the object's name, whose Loc
+// is given last, if it is nil)
+#define MYPL_FIELD_REF(obj, member, ...) \
+  (*mypl::field_ref(__VA_ARGS__, obj, [](auto* o) {return &o->member;}))
+
+
+namespace mypl {
+
+// a source location (for runtime error messages)
+struct Loc {int line; int column;};
+
+template<typename T>
+class Nullable;
+
+template<typename T>
+struct IsNullable : std::false_type {};
+template<typename T>
+struct IsNullable<Nullable<T>> : std::true_type {};
+
+// the nil value; converts to the zero value of any type (and to a nil
+// Nullable)
+struct Nil
+{
+  template<typename T, typename = typename std::enable_if<!IsNullable<T>::value>::type>
+  operator T() const {return T();}
+};
+
+const Nil nil;
+
+// a primitive value or nil; read as a plain value, nil is the zero
+// value (as the interpreter reads a nil argument)
+template<typename T>
+class Nullable
+{
+public:
+  Nullable() : x() {}
+  Nullable(const T& x) : x(x) {}
+  Nullable(T&& x) : x(std::move(x)) {}
+  Nullable(Nil) : nil(true), x() {}
+  bool is_nil() const {return nil;}
+  const T& get() const {return x;}
+  operator const T&() const {return x;}
+  // the value to update in place (no longer nil)
+  T& ref() {nil = false; return x;}
+private:
+  bool nil = false;
+  T x;
+};
+
+// the plain value of an argument passed to a built-in
+template<typename T>
+const T& value(const T& x) {return x;}
+template<typename T>
+const T& value(const Nullable<T>& x) {return x.get();}
+
+// a variable updated in place by a built-in
+template<typename T>
+T& ref(T& x) {return x;}
+template<typename T>
+T& ref(Nullable<T>& x) {return x.ref();}
+
+// whether a value is nil (plain values never are; objects are when null)
+template<typename T>
+bool is_nil(const T& x) {return false;}
+template<typename T>
+bool is_nil(T* x) {return x == nullptr;}
+template<typename T>
+bool is_nil(const Nullable<T>& x) {return x.is_nil();}
+bool is_nil(Nil) {return true;}
+
+// the result type of an operator with a Nullable operand
+template<typename T>
+struct Lift {typedef Nullable<T> type;};
+template<typename T>
+struct Lift<Nullable<T>> {typedef Nullable<T> type;};
+template<>
+struct Lift<Nil> {typedef Nil type;};
+
+// one row of a matrix value
+typedef std::vector<double> Row;
+
+
+// throw a runtime error located at the given source location
+[[noreturn]] void error(Loc at, const std::string& msg)
+{
+  throw MyPLException(RUNTIME, msg, at.line, at.column);
+}
+
+// read a field of an object (the zero value if the object is nil)
+template<typename T, typename F>
+auto field(T* obj, F get) -> decltype(get(obj))
+{
+  if (!obj)
+    return decltype(get(obj))();
+  return get(obj);
+}
+
+// the address of a field to update in place (an error if the object is
+// nil)
+template<typename T, typename F>
+auto field_ref(Loc at, T* obj, F get) -> decltype(get(obj))
+{
+  if (!obj)
+    error(at, "nil object");
+  return get(obj);
+}
+
+// a matrix value from its rows (ragged rows are zero padded)
+Matrix matrix(const std::vector<Row>& rows)
+{
+  return Matrix(rows);
+}
+
+
+//----------------------------------------------------------------------
+// OPERATORS
+//
+// Each operator has one overload per operand types the interpreter
+// handles. Any other combination gives the right operand, as the
+// interpreter does (e.g., int / int and .^).
+//----------------------------------------------------------------------
+
+// operand dimensions checked before +, -, .*, and ./ on two matrices
+void check_same_dims(Loc at, const Matrix& a, const Matrix& b)
+{
+  if (a.rows() != b.rows() or a.cols() != b.cols())
+    error(at, "Matrix dimensions must be equivalent");
+}
+
+// the interpreter's matrix product: a.rows() x a.cols(), summing over
+// a.cols()
+Matrix matrix_product(const Matrix& a, const Matrix& b)
+{
+  Matrix mul(a.rows(), a.cols());
+  for (size_t p = 0; p < a.rows(); ++p)
+    for (size_t j = 0; j < a.cols(); ++j)
+      for (size_t k = 0; k < a.cols(); ++k)
+        if (k < b.rows() and j < b.cols())
+          mul.at(p, j) += a.at(p, k) * b.at(k, j);
+  return mul;
+}
+
+// apply f to each element of a
+template<typename F>
+Matrix elementwise(const Matrix& a, F f)
+{
+  Matrix z(a.rows(), a.cols());
+  for (size_t i = 0; i < a.size(); ++i)
+    z.data()[i] = f(a.data()[i], i);
+  return z;
+}
+
+
+// + (char + char is the sum of the character codes)
+template<typename A, typename B>
+B op_add(Loc at, const A& a, const B& b) {return b;}
+int op_add(Loc at, int a, int b) {return a + b;}
+double op_add(Loc at, double a, double b) {return a + b;}
+std::string op_add(Loc at, const std::string& a, const std::string& b) {return a + b;}
+std::string op_add(Loc at, char a, const std::string& b) {return a + b;}
+std::string op_add(Loc at, const std::string& a, char b) {return a + b;}
+std::string op_add(Loc at, char a, char b) {return std::to_string(a + b);}
+// s = s + b for a string variable s (adding nil leaves s as is)
+template<typename B>
+void append(std::string& s, const B& b) {}
+void append(std::string& s, const std::string& b) {s += b;}
+void append(std::string& s, char b) {s += b;}
+template<typename B>
+void append(std::string& s, const Nullable<B>& b) {if (!b.is_nil()) append(s, b.get());}
+// (nil + b is b)
+template<typename B>
+void append(Nullable<std::string>& s, const B& b)
+{
+  if (!s.is_nil() or !is_nil(b))
+    append(s.ref(), b);
+}
+Matrix op_add(Loc at, const Matrix& a, const Matrix& b)
+{
+  check_same_dims(at, a, b);
+  return elementwise(a, [&](double x, size_t i) {return x + b.data()[i];});
+}
+
+// -
+template<typename A, typename B>
+B op_sub(Loc at, const A& a, const B& b) {return b;}
+int op_sub(Loc at, int a, int b) {return a - b;}
+double op_sub(Loc at, double a, double b) {return a - b;}
+Matrix op_sub(Loc at, const Matrix& a, const Matrix& b)
+{
+  check_same_dims(at, a, b);
+  return elementwise(a, [&](double x, size_t i) {return x - b.data()[i];});
+}
+
+// *
+template<typename A, typename B>
+B op_mul(Loc at, const A& a, const B& b) {return b;}
+int op_mul(Loc at, int a, int b) {return a * b;}
+double op_mul(Loc at, double a, double b) {return a * b;}
+Matrix op_mul(Loc at, const Matrix& a, int b)
+{
+  return elementwise(a, [&](double x, size_t i) {return x * b;});
+}
+Matrix op_mul(Loc at, const Matrix& a, double b)
+{
+  return elementwise(a, [&](double x, size_t i) {return x * b;});
+}
+Matrix op_mul(Loc at, int a, const Matrix& b)
+{
+  return elementwise(b, [&](double x, size_t i) {return x * a;});
+}
+Matrix op_mul(Loc at, double a, const Matrix& b)
+{
+  return elementwise(b, [&](double x, size_t i) {return x * a;});
+}
+Matrix op_mul(Loc at, const Matrix& a, const Matrix& b)
+{
+  if (a.cols() != b.rows())
+    error(at, "Inner dimensions must match for '*' operation");
+  return matrix_product(a, b);
+}
+
+// / (int / int gives the right operand)
+template<typename A, typename B>
+B op_div(Loc at, const A& a, const B& b) {return b;}
+double op_div(Loc at, double a, double b) {return a / b;}
+Matrix op_div(Loc at, const Matrix& a, double b)
+{
+  return elementwise(a, [&](double x, size_t i) {return x / b;});
+}
+Matrix op_div(Loc at, const Matrix& a, int b)
+{
+  return elementwise(a, [&](double x, size_t i) {return x / b;});
+}
+
+// %
+template<typename A, typename B>
+B op_mod(Loc at, const A& a, const B& b) {return b;}
+int op_mod(Loc at, int a, int b) {return a % b;}
+Matrix op_mod(Loc at, const Matrix& a, int b)
+{
+  return elementwise(a, [&](double x, size_t i) {
+    return static_cast<double>(static_cast<int>(x) % b);
+  });
+}
+
+// ^ (repeated multiplication; powers below 2 give the base)
+template<typename A, typename B>
+B op_pow(Loc at, const A& a, const B& b) {return b;}
+int op_pow(Loc at, int a, int b)
+{
+  int p = a;
+  for (int k = 1; k < b; ++k)
+    p = p * a;
+  return p;
+}
+Matrix op_pow(Loc at, const Matrix& a, int b)
+{
+  Matrix p = a;
+  for (int k = 1; k < b; ++k)
+    p = matrix_product(p, a);
+  return p;
+}
+
+// .* and ./
+template<typename A, typename B>
+B op_emul(Loc at, const A& a, const B& b) {return b;}
+Matrix op_emul(Loc at, const Matrix& a, const Matrix& b)
+{
+  check_same_dims(at, a, b);
+  return elementwise(a, [&](double x, size_t i) {return x * b.data()[i];});
+}
+template<typename A, typename B>
+B op_ediv(Loc at, const A& a, const B& b) {return b;}
+Matrix op_ediv(Loc at, const Matrix& a, const Matrix& b)
+{
+  check_same_dims(at, a, b);
+  return elementwise(a, [&](double x, size_t i) {return x / b.data()[i];});
+}
+
+// .^ (not implemented by the interpreter: gives the right operand)
+template<typename A, typename B>
+B op_epow(Loc at, const A& a, const B& b) {return b;}
+
+// and, or (both operands are always evaluated)
+bool op_and(Loc at, bool a, bool b) {return a and b;}
+bool op_or(Loc at, bool a, bool b) {return a or b;}
+
+// unary minus
+template<typename T>
+T op_neg(const T& x) {return x;}
+int op_neg(int x) {return -1 * x;}
+double op_neg(double x) {return -1 * x;}
+template<typename T>
+Nullable<T> op_neg(const Nullable<T>& x)
+{
+  if (x.is_nil())
+    return x;
+  return op_neg(x.get());
+}
+
+// ~
+Matrix op_transpose(const Matrix& a)
+{
+  Matrix t(a.cols(), a.rows());
+  for (size_t i = 0; i < a.cols(); ++i)
+    for (size_t j = 0; j < a.rows(); ++j)
+      t.at(i, j) = a.at(j, i);
+  return t;
+}
+
+
+// == and != (values never equal nil; objects equal nil when null)
+
+template<typename A, typename B>
+B op_eq(Loc at, const A& a, const B& b) {return b;}
+bool op_eq(Loc at, int a, int b) {return a == b;}
+bool op_eq(Loc at, double a, double b) {return a == b;}
+bool op_eq(Loc at, const std::string& a, const std::string& b) {return a == b;}
+bool op_eq(Loc at, char a, char b) {return a == b;}
+bool op_eq(Loc at, bool a, bool b) {return a == b;}
+template<typename T>
+bool op_eq(Loc at, T* a, T* b) {return a == b;}
+template<typename A>
+bool op_eq(Loc at, const A& a, Nil b) {return is_nil(a);}
+template<typename B>
+bool op_eq(Loc at, Nil a, const B& b) {return is_nil(b);}
+bool op_eq(Loc at, Nil a, Nil b) {return true;}
+
+template<typename A, typename B>
+B op_ne(Loc at, const A& a, const B& b) {return b;}
+bool op_ne(Loc at, int a, int b) {return a != b;}
+bool op_ne(Loc at, double a, double b) {return a != b;}
+bool op_ne(Loc at, const std::string& a, const std::string& b) {return a != b;}
+bool op_ne(Loc at, char a, char b) {return a != b;}
+bool op_ne(Loc at, bool a, bool b) {return a != b;}
+template<typename T>
+bool op_ne(Loc at, T* a, T* b) {return a != b;}
+template<typename A>
+bool op_ne(Loc at, const A& a, Nil b) {return !is_nil(a);}
+template<typename B>
+bool op_ne(Loc at, Nil a, const B& b) {return !is_nil(b);}
+bool op_ne(Loc at, Nil a, Nil b) {return false;}
+
+// <, <=, >, >= (on ints, doubles, strings, and chars)
+#define MYPL_COMPARISON(name, op) \
+  template<typename A, typename B> \
+  B name(Loc at, const A& a, const B& b) {return b;} \
+  bool name(Loc at, int a, int b) {return a op b;} \
+  bool name(Loc at, double a, double b) {return a op b;} \
+  bool name(Loc at, const std::string& a, const std::string& b) {return a op b;} \
+  bool name(Loc at, char a, char b) {return a op b;}
+
+MYPL_COMPARISON(op_lt, <)
+MYPL_COMPARISON(op_le, <=)
+MYPL_COMPARISON(op_gt, >)
+MYPL_COMPARISON(op_ge, >=)
+
+#undef MYPL_COMPARISON
+
+
+// each operator on a Nullable operand: on nil it is the operator on
+// nil, and otherwise the operator on the value (either one as a
+// Nullable result)
+#define MYPL_NULLABLE_OPERATOR(name) \
+  template<typename A, typename B> \
+  auto name(Loc at, const Nullable<A>& a, const B& b) \
+    -> typename Lift<decltype(name(at, a.get(), b))>::type \
+  { \
+    typedef typename Lift<decltype(name(at, a.get(), b))>::type R; \
+    return a.is_nil() ? R(name(at, nil, b)) : R(name(at, a.get(), b)); \
+  } \
+  template<typename A, typename B> \
+  auto name(Loc at, const A& a, const Nullable<B>& b) \
+    -> typename Lift<decltype(name(at, a, b.get()))>::type \
+  { \
+    typedef typename Lift<decltype(name(at, a, b.get()))>::type R; \
+    return b.is_nil() ? R(name(at, a, nil)) : R(name(at, a, b.get())); \
+  } \
+  template<typename A, typename B> \
+  auto name(Loc at, const Nullable<A>& a, const Nullable<B>& b) \
+    -> typename Lift<decltype(name(at, a.get(), b))>::type \
+  { \
+    typedef typename Lift<decltype(name(at, a.get(), b))>::type R; \
+    return a.is_nil() ? R(name(at, nil, b)) : R(name(at, a.get(), b)); \
+  } \
+  template<typename A> \
+  auto name(Loc at, const Nullable<A>& a, Nil b) \
+    -> typename Lift<decltype(name(at, a.get(), b))>::type \
+  { \
+    typedef typename Lift<decltype(name(at, a.get(), b))>::type R; \
+    return a.is_nil() ? R(name(at, nil, b)) : R(name(at, a.get(), b)); \
+  } \
+  template<typename B> \
+  auto name(Loc at, Nil a, const Nullable<B>& b) \
+    -> typename Lift<decltype(name(at, a, b.get()))>::type \
+  { \
+    typedef typename Lift<decltype(name(at, a, b.get()))>::type R; \
+    return b.is_nil() ? R(name(at, a, nil)) : R(name(at, a, b.get())); \
+  }
+
+MYPL_NULLABLE_OPERATOR(op_add)
+MYPL_NULLABLE_OPERATOR(op_sub)
+MYPL_NULLABLE_OPERATOR(op_mul)
+MYPL_NULLABLE_OPERATOR(op_div)
+MYPL_NULLABLE_OPERATOR(op_mod)
+MYPL_NULLABLE_OPERATOR(op_pow)
+MYPL_NULLABLE_OPERATOR(op_emul)
+MYPL_NULLABLE_OPERATOR(op_ediv)
+MYPL_NULLABLE_OPERATOR(op_epow)
+MYPL_NULLABLE_OPERATOR(op_eq)
+MYPL_NULLABLE_OPERATOR(op_ne)
+MYPL_NULLABLE_OPERATOR(op_lt)
+MYPL_NULLABLE_OPERATOR(op_le)
+MYPL_NULLABLE_OPERATOR(op_gt)
+MYPL_NULLABLE_OPERATOR(op_ge)
+
+#undef MYPL_NULLABLE_OPERATOR
+
+
+//----------------------------------------------------------------------
+// BUILT-INS (see builtins.h, math_builtins.h, and matrix_builtins.h)
+//----------------------------------------------------------------------
+
+Nil print(Loc at, const std::string& s)
+{
+  // expand the \n and \t escapes left in string literals
+  std::string out;
+  out.reserve(s.size());
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '\\' and i + 1 < s.size() and (s[i+1] == 'n' or s[i+1] == 't')) {
+      out += s[i+1] == 'n' ? '\n' : '\t';
+      ++i;
+    }
+    else
+      out += s[i];
+  }
+  std::cout << out;
+  return nil;
+}
+
+int stoi(Loc at, const std::string& s)
+{
+  try {
+    return std::stoi(s);
+  }
+  catch (const std::exception& e) {
+    error(at, "invalid int value '" + s + "'");
+  }
+}
+
+double stod(Loc at, const std::string& s)
+{
+  try {
+    return std::stod(s);
+  }
+  catch (const std::exception& e) {
+    error(at, "invalid double value '" + s + "'");
+  }
+}
+
+std::string itos(Loc at, int x) {return std::to_string(x);}
+
+std::string dtos(Loc at, double x) {return std::to_string(x);}
+
+char get(Loc at, int index, const std::string& s)
+{
+  if (index < 0 or index >= (int)s.size())
+    error(at, "string index out of range");
+  return s.at(index);
+}
+
+int length(Loc at, const std::string& s) {return s.size();}
+
+std::string substr(Loc at, const std::string& s, int start, int count)
+{
+  if (start < 0 or count < 0 or (size_t)start + count > s.size())
+    error(at, "substring out of range");
+  return s.substr(start, count);
+}
+
+int find(Loc at, const std::string& s, const std::string& t, int from = 0)
+{
+  if (from < 0 or from > (int)s.size())
+    error(at, "string index out of range");
+  size_t i = s.find(t, from);
+  return i == std::string::npos ? -1 : (int)i;
+}
+
+std::vector<std::string> split(Loc at, const std::string& s, const std::string& sep)
+{
+  if (sep.empty())
+    error(at, "empty separator");
+  std::vector<std::string> parts;
+  size_t start = 0;
+  for (size_t end; (end = s.find(sep, start)) != std::string::npos; start = end + sep.size())
+    parts.push_back(s.substr(start, end - start));
+  parts.push_back(s.substr(start));
+  return parts;
+}
+
+std::string join(Loc at, const std::vector<std::string>& xs, const std::string& sep)
+{
+  std::string joined;
+  for (size_t i = 0; i < xs.size(); ++i) {
+    if (i > 0)
+      joined += sep;
+    joined += xs[i];
+  }
+  return joined;
+}
+
+std::string replace(Loc at, const std::string& s, const std::string& old_part,
+                    const std::string& new_part)
+{
+  if (old_part.empty())
+    error(at, "empty string to replace");
+  std::string replaced;
+  size_t start = 0;
+  for (size_t end; (end = s.find(old_part, start)) != std::string::npos;
+       start = end + old_part.size()) {
+    replaced.append(s, start, end - start);
+    replaced += new_part;
+  }
+  replaced.append(s, start, std::string::npos);
+  return replaced;
+}
+
+template<typename T>
+int length(Loc at, const std::vector<T>& xs) {return xs.size();}
+
+// standard input, read a buffer at a time (see input_scanner.h)
+InputScanner& standard_input()
+{
+  static FileInput buffer(STDIN_FILENO);
+  static InputScanner scanner(&buffer, &std::cout);
+  return scanner;
+}
+
+std::string read(Loc at)
+{
+  std::string s;
+  standard_input().line(s);
+  return s;
+}
+
+std::string read_line(Loc at)
+{
+  return read(at);
+}
+
+template<typename T>
+T read_number(Loc at, const char* kind)
+{
+  InputScanner& in = standard_input();
+  T x = 0;
+  if (!in.skip_space())
+    error(at, std::string("no ") + kind + " value left to read");
+  if (!in.number(x))
+    error(at, std::string("invalid ") + kind + " value '" + in.word() + "'");
+  return x;
+}
+
+int read_int(Loc at) {return read_number<int>(at, "int");}
+
+double read_double(Loc at) {return read_number<double>(at, "double");}
+
+Matrix read_matrix(Loc at, int rows, int cols)
+{
+  if (rows < 0 or cols < 0)
+    error(at, "Negative matrix dimensions");
+  Matrix m(rows, cols);
+  double* values = m.data();
+  for (size_t i = 0; i < m.size(); ++i)
+    values[i] = read_number<double>(at, "double");
+  return m;
+}
+
+Nil m_print(Loc at, const Matrix& x)
+{
+  for (size_t row = 0; row < x.rows(); row++) {
+    std::cout << std::endl;
+    for (size_t column = 0; column < x.cols(); column++)
+      std::cout << x.at(row, column) << " ";
+  }
+  std::cout << std::endl;
+  return nil;
+}
+
+double m_get(Loc at, const Matrix& m, int row, int col)
+{
+  if (row < 0 or col < 0 or row >= (int)m.rows() or col >= (int)m.cols())
+    error(at, "Accessing out of bounds matrix");
+  return m.at(row, col);
+}
+
+Nil m_set(Loc at, Matrix& m, int row, int col, double v)
+{
+  if (row < 0 or col < 0 or row >= (int)m.rows() or col >= (int)m.cols())
+    error(at, "Accessing out of bounds matrix");
+  m.at(row, col) = v;
+  return nil;
+}
+
+// a matrix dimension argument
+size_t dimension(Loc at, int n)
+{
+  if (n < 0)
+    error(at, "Negative matrix dimensions");
+  return n;
+}
+
+Matrix m_singleton(Loc at, double v, int rows, int cols)
+{
+  if (rows < 0 or cols < 0)
+    error(at, "Negative matrix dimensions");
+  return Matrix(rows, cols, v);
+}
+
+Matrix m_zeros(Loc at, int rows, int cols)
+{
+  size_t r = dimension(at, rows);
+  return Matrix(r, dimension(at, cols));
+}
+
+Matrix m_identity(Loc at, int n)
+{
+  Matrix m(dimension(at, n), n);
+  for (size_t i = 0; i < m.rows(); ++i)
+    m.at(i, i) = 1.0;
+  return m;
+}
+
+Matrix m_random(Loc at, int rows, int cols)
+{
+  static std::mt19937_64 engine {std::random_device{}()};
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  size_t r = dimension(at, rows);
+  Matrix m(r, dimension(at, cols));
+  for (size_t i = 0; i < m.size(); ++i)
+    m.data()[i] = uniform(engine);
+  return m;
+}
+
+int m_rows(Loc at, const Matrix& m) {return m.rows();}
+
+int m_cols(Loc at, const Matrix& m) {return m.cols();}
+
+
+// math built-ins run the same kernels as the interpreter
+#define MYPL_UNARY(name, kernel) \
+  double name(Loc at, double x) {double y = 0.0; kernel(&x, &y, 1); return y;} \
+  Matrix m_##name(Loc at, Matrix m) {kernel(m.data(), m.data(), m.size()); return m;}
+
+MYPL_UNARY(sqrt, kernel_sqrt)
+MYPL_UNARY(exp, kernel_exp)
+MYPL_UNARY(log, kernel_log)
+MYPL_UNARY(sin, kernel_sin)
+MYPL_UNARY(cos, kernel_cos)
+MYPL_UNARY(abs, kernel_abs)
+MYPL_UNARY(floor, kernel_floor)
+MYPL_UNARY(ceil, kernel_ceil)
+
+#undef MYPL_UNARY
+
+#define MYPL_BINARY(name, kernel) \
+  double name(Loc at, double a, double b) {double y = 0.0; kernel(&a, &b, &y, 1); return y;} \
+  Matrix m_##name(Loc at, Matrix a, const Matrix& b) \
+  { \
+    check_same_dims(at, a, b); \
+    kernel(a.data(), b.data(), a.data(), a.size()); \
+    return a; \
+  }
+
+MYPL_BINARY(min, kernel_min)
+MYPL_BINARY(max, kernel_max)
+
+#undef MYPL_BINARY
+
+double pow(Loc at, double x, double p)
+{
+  double y = 0.0;
+  kernel_pow(&x, p, &y, 1);
+  return y;
+}
+
+Matrix m_pow(Loc at, Matrix m, double p)
+{
+  kernel_pow(m.data(), p, m.data(), m.size());
+  return m;
+}
+
+
+// reductions
+double m_sum(Loc at, const Matrix& m)
+{
+  return kernel_sum(m.data(), m.size());
+}
+
+double m_mean(Loc at, const Matrix& m)
+{
+  if (m.size() == 0)
+    error(at, "mean of an empty matrix");
+  return kernel_sum(m.data(), m.size()) / m.size();
+}
+
+Matrix m_row_reduce(Loc at, const Matrix& m, bool mean)
+{
+  if (mean and m.cols() == 0)
+    error(at, "mean of an empty matrix");
+  Matrix out(m.rows(), 1);
+  for (size_t r = 0; r < m.rows(); ++r) {
+    double total = kernel_sum(m.data() + r * m.cols(), m.cols());
+    out.at(r, 0) = mean ? total / m.cols() : total;
+  }
+  return out;
+}
+
+Matrix m_col_reduce(Loc at, const Matrix& m, bool mean)
+{
+  if (mean and m.rows() == 0)
+    error(at, "mean of an empty matrix");
+  Matrix out(1, m.cols());
+  for (size_t r = 0; r < m.rows(); ++r)
+    kernel_axpy(1.0, m.data() + r * m.cols(), out.data(), m.cols());
+  if (mean)
+    for (size_t c = 0; c < m.cols(); ++c)
+      out.at(0, c) /= m.rows();
+  return out;
+}
+
+Matrix m_row_sums(Loc at, const Matrix& m) {return m_row_reduce(at, m, false);}
+Matrix m_row_means(Loc at, const Matrix& m) {return m_row_reduce(at, m, true);}
+Matrix m_col_sums(Loc at, const Matrix& m) {return m_col_reduce(at, m, false);}
+Matrix m_col_means(Loc at, const Matrix& m) {return m_col_reduce(at, m, true);}
+
+double m_norm(Loc at, const Matrix& m)
+{
+  return std::sqrt(kernel_dot(m.data(), m.data(), m.size()));
+}
+
+double m_dot(Loc at, const Matrix& a, const Matrix& b)
+{
+  check_same_dims(at, a, b);
+  return kernel_dot(a.data(), b.data(), a.size());
+}
+
+
+// linear algebra
+void check_square(Loc at, const Matrix& m)
+{
+  if (m.rows() != m.cols())
+    error(at, "expecting a square matrix");
+}
+
+Matrix m_solve(Loc at, Matrix a, const Matrix& b)
+{
+  check_square(at, a);
+  if (b.rows() != a.rows())
+    error(at, "Matrix dimensions do not match for solve");
+  std::vector<size_t> perm;
+  int sign = 1;
+  if (!lu_decompose(a, perm, sign))
+    error(at, "matrix is singular");
+  return lu_solve(a, perm, b);
+}
+
+Matrix m_inverse(Loc at, Matrix a)
+{
+  check_square(at, a);
+  std::vector<size_t> perm;
+  int sign = 1;
+  if (!lu_decompose(a, perm, sign))
+    error(at, "matrix is singular");
+  Matrix identity(a.rows(), a.cols());
+  for (size_t i = 0; i < a.rows(); ++i)
+    identity.at(i, i) = 1.0;
+  return lu_solve(a, perm, identity);
+}
+
+double m_det(Loc at, Matrix a)
+{
+  check_square(at, a);
+  std::vector<size_t> perm;
+  int sign = 1;
+  if (!lu_decompose(a, perm, sign))
+    return 0.0;
+  double det = sign;
+  for (size_t i = 0; i < a.rows(); ++i)
+    det *= a.at(i, i);
+  return det;
+}
+
+// arrays: element access checks the index, and push and pop update the
+// array variable they are given
+void check_index(Loc at, size_t size, int i)
+{
+  if (i < 0 or (size_t)i >= size)
+    error(at, "array index out of range");
+}
+
+template<typename T>
+typename std::vector<T>::const_reference element(Loc at, const std::vector<T>& xs, int i)
+{
+  check_index(at, xs.size(), i);
+  return xs[i];
+}
+
+template<typename T>
+T& at(Loc at, std::vector<T>& xs, int i)
+{
+  check_index(at, xs.size(), i);
+  return xs[i];
+}
+
+template<typename T, typename X>
+Nil set(Loc at, std::vector<T>& xs, int i, const X& x)
+{
+  check_index(at, xs.size(), i);
+  T y = x;
+  xs[i] = std::move(y);
+  return nil;
+}
+
+template<typename T, typename X>
+Nil push(Loc at, std::vector<T>& xs, const X& x)
+{
+  T y = x;
+  xs.push_back(std::move(y));
+  return nil;
+}
+
+template<typename T>
+T pop(Loc at, std::vector<T>& xs)
+{
+  if (xs.empty())
+    error(at, "pop from an empty array");
+  T x = std::move(xs.back());
+  xs.pop_back();
+  return x;
+}
+
+// maps: keys are hashed as in the interpreter, and put and remove update
+// the map variable they are given
+struct Hash
+{
+  uint64_t operator()(int x) const {return hash_mix((uint64_t)(long long)x);}
+  uint64_t operator()(double x) const {return hash_double(x);}
+  uint64_t operator()(bool x) const {return hash_mix(x);}
+  uint64_t operator()(char x) const {return hash_mix((uint64_t)(long long)x);}
+  uint64_t operator()(const std::string& x) const {return hash_bytes(x.data(), x.size());}
+};
+
+template<typename K, typename V>
+using Map = FlatMap<K, V, Hash>;
+
+// the key of type K for x (x itself if it is one, so a string key is
+// looked up without a copy)
+template<typename K>
+const K& map_key(const K& x) {return x;}
+template<typename K, typename X>
+typename std::enable_if<!std::is_same<K, X>::value, K>::type map_key(const X& x) {return x;}
+
+template<typename K, typename V>
+int length(Loc at, const Map<K,V>& m) {return m.size();}
+
+template<typename K, typename V, typename X, typename Y>
+Nil put(Loc at, Map<K,V>& m, const X& k, const Y& v)
+{
+  K key = k;
+  V val = v;
+  m.put(key, std::move(val));
+  return nil;
+}
+
+template<typename K, typename V, typename X>
+V get(Loc at, const Map<K,V>& m, const X& k)
+{
+  const V* val = m.find(map_key<K>(k));
+  if (!val)
+    error(at, "key not in map");
+  return *val;
+}
+
+template<typename K, typename V, typename X>
+bool has(Loc at, const Map<K,V>& m, const X& k)
+{
+  return m.find(map_key<K>(k)) != nullptr;
+}
+
+template<typename K, typename V, typename X>
+bool remove(Loc at, Map<K,V>& m, const X& k)
+{
+  return m.remove(map_key<K>(k));
+}
+
+template<typename K, typename V>
+std::vector<K> keys(Loc at, const Map<K,V>& m)
+{
+  std::vector<K> ks;
+  m.for_each([&](const K& k, const V& v) {ks.push_back(k);});
+  return ks;
+}
+
+// parfor reductions (a translated parfor runs its iterations in order,
+// so these fold straight into the variable)
+Nil reduce_sum(Loc at, double& var, double x) {var += x; return nil;}
+Nil reduce_min(Loc at, double& var, double x) {var = std::min(var, x); return nil;}
+Nil reduce_max(Loc at, double& var, double x) {var = std::max(var, x); return nil;}
+Nil reduce_isum(Loc at, int& var, int x) {var += x; return nil;}
+Nil reduce_imin(Loc at, int& var, int x) {var = std::min(var, x); return nil;}
+Nil reduce_imax(Loc at, int& var, int x) {var = std::max(var, x); return nil;}
+
+Nil m_reduce_sum(Loc at, Matrix& m, const Matrix& x)
+{
+  if (m.size() == 0) {
+    m = x;
+    return nil;
+  }
+  if (m.rows() != x.rows() or m.cols() != x.cols())
+    error(at, "Matrix dimensions must be equivalent");
+  kernel_axpy(1.0, x.data(), m.data(), m.size());
+  return nil;
+}
+
+}
+
+
+#endif
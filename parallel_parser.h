@@ -0,0 +1,194 @@
+//----------------------------------------------------------------------
+// FILE: parallel_parser.h
+// DESC: Parse a whole source, splitting larger ones at their top-level
+//       declarations and lexing and parsing the pieces on the thread
+//       pool. Only declarations start with type or fun, so a quick scan
+//       of the source finds the ones starting a line. The scan skips
+//       strings, chars, comments and numbers, and counts lines, the way
+//       the lexer does. Each piece gets a lexer started at the line and
+//       column the lexer would have reached there, so tokens carry the
+//       same positions as in an in-order parse. If any piece fails, the
+//       whole source is parsed again in order, so the error reported is
+//       the in-order parser's.
+//----------------------------------------------------------------------
+
+#ifndef PARALLEL_PARSER_H
+#define PARALLEL_PARSER_H
+
+#include <atomic>
+#include <cctype>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+#include "stats.h"
+#include "thread_pool.h"
+
+
+// below this many bytes a source is parsed on the calling thread alone
+const size_t PARALLEL_PARSE_BYTES = 1 << 16;
+
+// where a top-level declaration starts, and the lexer's line and column
+// there
+struct SourceSplit {size_t pos; int line; int column;};
+
+// the declarations (after the first) that start a line; none if the
+// scan meets something the lexer rejects
+std::vector<SourceSplit> split_source(const std::string& source);
+
+// parse a source into the program
+void parse_source(const std::string& source, Program& node);
+
+
+inline std::vector<SourceSplit> split_source(const std::string& source)
+{
+  // how the last newline was read: as whitespace, as the end of a
+  // comment (the lexer then counts the next character's column), or as
+  // the end of a .5 style double (the line is not counted)
+  enum {WHITESPACE, COMMENT, DOUBLE} newline = WHITESPACE;
+  auto word = [&](size_t i) {
+    return i < source.size() and (isalnum((unsigned char)source[i]) or source[i] == '_');
+  };
+  auto space = [&](size_t i) {
+    return i < source.size() and isspace((unsigned char)source[i]);
+  };
+  static const std::string number_ends = " \n#\"'()-%+/*,;[]}";
+  std::vector<SourceSplit> splits;
+  size_t n = source.size();
+  size_t i = 0;
+  int line = 1;
+  while (i < n) {
+    char ch = source[i];
+    if (i > 0 and source[i - 1] == '\n' and newline != DOUBLE) {
+      bool fun = source.compare(i, 3, "fun") == 0 and space(i + 3);
+      bool type = source.compare(i, 4, "type") == 0 and !word(i + 4);
+      if (fun or type)
+        splits.push_back({i, line, newline == COMMENT ? 1 : 0});
+    }
+    if (ch == '\n') {
+      ++line;
+      newline = WHITESPACE;
+      ++i;
+    }
+    else if (isspace((unsigned char)ch))
+      ++i;
+    else if (ch == '#') {
+      // a comment ends at any whitespace but a space
+      while (i < n and (!space(i) or source[i] == ' '))
+        ++i;
+      if (i == n)
+        return {};
+      if (source[i] == '\n') {
+        ++line;
+        newline = COMMENT;
+      }
+      ++i;
+    }
+    else if (ch == '"') {
+      // newlines within a string are not counted
+      size_t close = source.find('"', i + 1);
+      if (close == std::string::npos)
+        return {};
+      i = close + 1;
+    }
+    else if (ch == '\'') {
+      size_t close = i + 1;
+      while (close < n and source[close] != '\'') {
+        if (space(close))
+          return {};
+        ++close;
+      }
+      if (close == n)
+        return {};
+      i = close + 1;
+    }
+    else if (isdigit((unsigned char)ch)) {
+      ++i;
+      while (i < n and number_ends.find(source[i]) == std::string::npos)
+        ++i;
+    }
+    else if (isalpha((unsigned char)ch)) {
+      ++i;
+      while (word(i))
+        ++i;
+    }
+    else if (ch == '.' and i + 1 < n and isdigit((unsigned char)source[i + 1])) {
+      // runs to (and takes) the next whitespace
+      ++i;
+      while (i < n and !space(i)) {
+        if (!isdigit((unsigned char)source[i]))
+          return {};
+        ++i;
+      }
+      if (i == n)
+        return {};
+      if (source[i] == '\n')
+        newline = DOUBLE;
+      ++i;
+    }
+    else if (i + 1 < n and ((ch == '.' and (source[i + 1] == '/' or source[i + 1] == '*' or source[i + 1] == '^')) or
+                            ((ch == '=' or ch == '<' or ch == '>' or ch == '!') and source[i + 1] == '=')))
+      i += 2;
+    else
+      ++i;
+  }
+  return splits;
+}
+
+
+inline void parse_source(const std::string& source, Program& node)
+{
+  std::vector<SourceSplit> starts = {{0, 1, 1}};
+  if (source.size() >= PARALLEL_PARSE_BYTES and ThreadPool::instance().size() > 1) {
+    std::vector<SourceSplit> splits = split_source(source);
+    starts.insert(starts.end(), splits.begin(), splits.end());
+  }
+  if (starts.size() > 1) {
+    // a few pieces per thread, each a run of declarations
+    ThreadPool& pool = ThreadPool::instance();
+    size_t pieces = std::min(starts.size(), pool.size() * 4);
+    Stats before = mypl_stats;
+    std::vector<Program> parts(pieces);
+    std::atomic<bool> failed {false};
+    Stats* parent_stats = &mypl_stats;
+    std::vector<Stats> piece_stats(pieces);
+    pool.run(pieces, [&](size_t piece) {
+      size_t first = starts.size() * piece / pieces;
+      size_t last = starts.size() * (piece + 1) / pieces;
+      size_t end = last < starts.size() ? starts[last].pos : source.size();
+      try {
+        std::istringstream in(source.substr(starts[first].pos, end - starts[first].pos));
+        Lexer lexer(in, starts[first].line, starts[first].column);
+        Parser parser(lexer);
+        parser.parse(parts[piece]);
+      }
+      catch (...) {
+        failed = true;
+      }
+      // pool threads hand their counters to the parsing thread
+      if (&mypl_stats != parent_stats) {
+        piece_stats[piece] = mypl_stats;
+        mypl_stats = Stats();
+      }
+    });
+    if (!failed) {
+      for (size_t piece = 0; piece < pieces; ++piece) {
+        mypl_stats.merge(piece_stats[piece]);
+        node.imports.splice(node.imports.end(), parts[piece].imports);
+        node.decls.splice(node.decls.end(), parts[piece].decls);
+      }
+      // the pieces' own program nodes are not part of the tree
+      MYPL_COUNT(mypl_stats.ast_nodes -= pieces);
+      return;
+    }
+    mypl_stats = before;
+  }
+  std::istringstream in(source);
+  Lexer lexer(in);
+  Parser parser(lexer);
+  parser.parse(node);
+}
+
+
+#endif
@@ -63,21 +63,22 @@ private:
     void idrval(IDRValue*);
     void assign_call_mediator(list<Stmt*>& stmts_list);
     void idrval_S(IDRValue*);
+    void indexes(list<Expr*>& index_list);
 };
 
 // constructor
-Parser::Parser(const Lexer& program_lexer)
+inline Parser::Parser(const Lexer& program_lexer)
     : lexer(program_lexer)
 {
 }
 
 // Helper functions
-void Parser::advance()
+inline void Parser::advance()
 {
     curr_token = lexer.next_token();
 }
 
-void Parser::eat(TokenType t, std::string err_msg)
+inline void Parser::eat(TokenType t, std::string err_msg)
 {
     if (curr_token.type() == t) {
         advance();
@@ -86,7 +87,7 @@ void Parser::eat(TokenType t, std::string err_msg)
         error(err_msg);
 }
 
-void Parser::error(std::string err_msg)
+inline void Parser::error(std::string err_msg)
 {
     std::string s = err_msg + "found '" + curr_token.lexeme() + "'";
     int line = curr_token.line();
@@ -94,15 +95,21 @@ void Parser::error(std::string err_msg)
     throw MyPLException(SYNTAX, s, line, col);
 }
 
-bool Parser::is_operator(TokenType t)
+inline bool Parser::is_operator(TokenType t)
 {
     return t == PLUS or t == MINUS or t == DIVIDE or t == MULTIPLY or t == MODULO or t == AND or t == OR or t == EQUAL or t == LESS or t == GREATER or t == LESS_EQUAL or t == GREATER_EQUAL or t == NOT_EQUAL;
 }
 // Recursive-decent functio
-void Parser::parse(Program& node)
+inline void Parser::parse(Program& node)
 {
 
     advance();
+    //imports come before the declarations
+    while (curr_token.type() == IMPORT) {
+        advance();
+        node.imports.push_back(curr_token);
+        eat(STRING_VAL, "expecting module path ");
+    }
     while (curr_token.type() != EOS) {
         if (curr_token.type() == TYPE) {
             TypeDecl* type_decl = new TypeDecl;
@@ -119,7 +126,7 @@ void Parser::parse(Program& node)
     eat(EOS, "expecting end-of-file ");
 }
 
-void Parser::tdecl(TypeDecl* type_decl)
+inline void Parser::tdecl(TypeDecl* type_decl)
 {
     // TODO
     eat(TYPE, "Expecting type");
@@ -129,7 +136,7 @@ void Parser::tdecl(TypeDecl* type_decl)
     eat(END, "Expecting END");
 }
 //Function grammar
-void Parser::fdecl(FunDecl* fun_decl)
+inline void Parser::fdecl(FunDecl* fun_decl)
 {
     // TODO
     eat(FUN, "Expecting fun");
@@ -154,7 +161,7 @@ void Parser::fdecl(FunDecl* fun_decl)
     eat(END, "expecting end1");
 }
 //Variable grammar
-void Parser::vdecls(TypeDecl* type_decl)
+inline void Parser::vdecls(TypeDecl* type_decl)
 {
     if (curr_token.type() == VAR) {
         VarDeclStmt* new_var_decl = new VarDeclStmt;
@@ -166,7 +173,7 @@ void Parser::vdecls(TypeDecl* type_decl)
     }
 }
 //Function parameter grammar
-void Parser::params(FunDecl* fun_decl)
+inline void Parser::params(FunDecl* fun_decl)
 {
 
     if (curr_token.type() == ID) {
@@ -194,9 +201,32 @@ void Parser::params(FunDecl* fun_decl)
     }
 }
 //declaration type grammar
-void Parser::dtype(Token* token_type)
+inline void Parser::dtype(Token* token_type)
 {
-    if (curr_token.type() == STRING_TYPE || curr_token.type() == DOUBLE_TYPE || curr_token.type() == CHAR_TYPE || curr_token.type() == ID || curr_token.type() == BOOL_TYPE || curr_token.type() == INT_TYPE || curr_token.type() == MATRIX_TYPE) {
+    if (curr_token.type() == ID && curr_token.lexeme() == "array") {
+        //array<T>: the type token's lexeme spells out the whole type
+        Token array_token = curr_token;
+        advance();
+        eat(LESS, "expecting < after array");
+        Token elem_type;
+        dtype(&elem_type);
+        eat(GREATER, "expecting > after array element type");
+        *token_type = Token(ID, "array<" + elem_type.lexeme() + ">", array_token.line(), array_token.column());
+    }
+    else if (curr_token.type() == ID && curr_token.lexeme() == "map") {
+        //map<K,V>, spelled out the same way
+        Token map_token = curr_token;
+        advance();
+        eat(LESS, "expecting < after map");
+        Token key_type;
+        dtype(&key_type);
+        eat(COMMA, "expecting , after map key type");
+        Token value_type;
+        dtype(&value_type);
+        eat(GREATER, "expecting > after map value type");
+        *token_type = Token(ID, "map<" + key_type.lexeme() + "," + value_type.lexeme() + ">", map_token.line(), map_token.column());
+    }
+    else if (curr_token.type() == STRING_TYPE || curr_token.type() == DOUBLE_TYPE || curr_token.type() == CHAR_TYPE || curr_token.type() == ID || curr_token.type() == BOOL_TYPE || curr_token.type() == INT_TYPE || curr_token.type() == MATRIX_TYPE) {
         *token_type = curr_token;
         advance();
     }
@@ -205,15 +235,15 @@ void Parser::dtype(Token* token_type)
     }
 }
 //General statements within a function body grammar
-void Parser::stmts(list<Stmt*>& stmts_list)
+inline void Parser::stmts(list<Stmt*>& stmts_list)
 {
-    if (curr_token.type() == ID || curr_token.type() == VAR || curr_token.type() == IF || curr_token.type() == WHILE || curr_token.type() == FOR || curr_token.type() == RETURN) {
+    if (curr_token.type() == ID || curr_token.type() == VAR || curr_token.type() == IF || curr_token.type() == WHILE || curr_token.type() == FOR || curr_token.type() == PARFOR || curr_token.type() == RETURN) {
         stmt(stmts_list);
         stmts(stmts_list);
     }
 }
 //Single statement
-void Parser::stmt(list<Stmt*>& stmts_list)
+inline void Parser::stmt(list<Stmt*>& stmts_list)
 {
     if (curr_token.type() == VAR) {
         VarDeclStmt* new_var_decl = new VarDeclStmt;
@@ -236,7 +266,7 @@ void Parser::stmt(list<Stmt*>& stmts_list)
         while_stmt(new_while_stmt);
         stmts_list.push_back(new_while_stmt);
     }
-    else if (curr_token.type() == FOR) {
+    else if (curr_token.type() == FOR || curr_token.type() == PARFOR) {
         ForStmt* new_for_stmt = new ForStmt;
         for_stmt(new_for_stmt);
         stmts_list.push_back(new_for_stmt);
@@ -250,7 +280,7 @@ void Parser::stmt(list<Stmt*>& stmts_list)
 }
 
 //Mediates a special case of call_expr and assign_stmt in expr to keep expr() LL(1)
-void Parser::assign_call_mediator(list<Stmt*>& stmts_list)
+inline void Parser::assign_call_mediator(list<Stmt*>& stmts_list)
 {
     Token new_token = curr_token;
    
@@ -270,7 +300,7 @@ void Parser::assign_call_mediator(list<Stmt*>& stmts_list)
     }
 }
 //variable declaration grammar
-void Parser::vdecl_stmt(VarDeclStmt* var_decl_stmt)
+inline void Parser::vdecl_stmt(VarDeclStmt* var_decl_stmt)
 {
     eat(VAR, "expecting var here2");
     var_decl_stmt->id = curr_token;
@@ -289,7 +319,7 @@ void Parser::vdecl_stmt(VarDeclStmt* var_decl_stmt)
     var_decl_stmt->expr = expr_node;
 }
 //Assigning grammar special case with two ID's in parent recursive function
-void Parser::assign_stmt_S(AssignStmt* new_assign_stmt)
+inline void Parser::assign_stmt_S(AssignStmt* new_assign_stmt)
 {
     Expr* expr_node = new Expr;
     while (curr_token.type() == DOT) {
@@ -297,12 +327,13 @@ void Parser::assign_stmt_S(AssignStmt* new_assign_stmt)
         new_assign_stmt->lvalue_list.push_back(curr_token);
         eat(ID, "expecting id");
     }
+    indexes(new_assign_stmt->indexes);
     eat(ASSIGN, "expecting assign hi2");
     expr(expr_node);
     new_assign_stmt->expr = expr_node;
 }
 //Assigning grammar general case
-void Parser::assign_stmt(AssignStmt* new_assign_stmt)
+inline void Parser::assign_stmt(AssignStmt* new_assign_stmt)
 {
     Expr* expr_node = new Expr;
     lvalue(new_assign_stmt);
@@ -311,7 +342,7 @@ void Parser::assign_stmt(AssignStmt* new_assign_stmt)
     new_assign_stmt->expr = expr_node;
 }
 //grammar for conditional statements
-void Parser::lvalue(AssignStmt* new_assign_stmt)
+inline void Parser::lvalue(AssignStmt* new_assign_stmt)
 {
     new_assign_stmt->lvalue_list.push_back(curr_token);
     eat(ID, "expecting id");
@@ -320,9 +351,10 @@ void Parser::lvalue(AssignStmt* new_assign_stmt)
         new_assign_stmt->lvalue_list.push_back(curr_token);
         eat(ID, "expecting id");
     }
+    indexes(new_assign_stmt->indexes);
 }
 //if stmt
-void Parser::cond_stmt(IfStmt* new_if_stmt)
+inline void Parser::cond_stmt(IfStmt* new_if_stmt)
 {
     BasicIf* new_basic_if = new BasicIf;
     Expr* expr_node = new Expr;
@@ -338,7 +370,7 @@ void Parser::cond_stmt(IfStmt* new_if_stmt)
     eat(END, "expecting end2");
 }
 //conditional grammar
-void Parser::condt(IfStmt* new_if_stmt)
+inline void Parser::condt(IfStmt* new_if_stmt)
 {
     if (curr_token.type() == ELSEIF) {
         BasicIf* new_basic_if = new BasicIf;
@@ -363,7 +395,7 @@ void Parser::condt(IfStmt* new_if_stmt)
     }
 }
 //while loop grammar
-void Parser::while_stmt(WhileStmt* new_while_stmt)
+inline void Parser::while_stmt(WhileStmt* new_while_stmt)
 {
     Expr* expr_node = new Expr;
     eat(WHILE, "expecting while");
@@ -376,12 +408,30 @@ void Parser::while_stmt(WhileStmt* new_while_stmt)
     eat(END, "expecting end3");
 }
 //for loop grammar
-void Parser::for_stmt(ForStmt* new_for_stmt)
+inline void Parser::for_stmt(ForStmt* new_for_stmt)
 {
     Expr* expr_node = new Expr;
-    eat(FOR, "expecting for");
+    if (curr_token.type() == PARFOR) {
+        new_for_stmt->parallel = true;
+        eat(PARFOR, "expecting parfor");
+    }
+    else
+        eat(FOR, "expecting for");
     new_for_stmt->var_id = curr_token;
     eat(ID, "execting id");
+    //for x in xs: one iteration per array element
+    if (curr_token.type() == IN && !new_for_stmt->parallel) {
+        eat(IN, "expecting in");
+        new_for_stmt->each = true;
+        expr(expr_node);
+        new_for_stmt->start = expr_node;
+        eat(DO, "expecting do");
+        list<Stmt*> stmts_list;
+        stmts(stmts_list);
+        new_for_stmt->stmts = stmts_list;
+        eat(END, "expecting end4");
+        return;
+    }
     eat(ASSIGN, "expecting assign hi4");
     expr(expr_node);
     new_for_stmt->start = expr_node;
@@ -396,7 +446,7 @@ void Parser::for_stmt(ForStmt* new_for_stmt)
     eat(END, "expecting end4");
 }
 //call expression grammar: special case where there are two LPAREN alterations in parent recursive function
-void Parser::call_expr_S(CallExpr* new_call_expr)
+inline void Parser::call_expr_S(CallExpr* new_call_expr)
 {
     eat(LPAREN, "expecting lparen");
     list<Expr*> expr_list;
@@ -406,7 +456,7 @@ void Parser::call_expr_S(CallExpr* new_call_expr)
     eat(RPAREN, "expecting rparen");
 }
 //general call expression grammar
-void Parser::call_expr(CallExpr* new_call_expr)
+inline void Parser::call_expr(CallExpr* new_call_expr)
 {
     new_call_expr->function_id = curr_token;
     eat(ID, "expecting ID");
@@ -418,7 +468,7 @@ void Parser::call_expr(CallExpr* new_call_expr)
     eat(RPAREN, "expecting rparen");
 }
 //function arguments
-void Parser::args(list<Expr*>& expr_list)
+inline void Parser::args(list<Expr*>& expr_list)
 {
 string current_token = curr_token.lexeme();
 
@@ -444,7 +494,7 @@ if (curr_token.lexeme() == ")") {
     
 }
 //Return statement grammar
-void Parser::exit_stmt(ReturnStmt* new_return_stmt)
+inline void Parser::exit_stmt(ReturnStmt* new_return_stmt)
 {
     eat(RETURN, "expecting return");
     Expr* expr_node = new Expr;
@@ -452,10 +502,10 @@ void Parser::exit_stmt(ReturnStmt* new_return_stmt)
     new_return_stmt->expr = expr_node;
 }
 //general expression grammar
-void Parser::expr(Expr* node)
+inline void Parser::expr(Expr* node)
 {
 
-    if (curr_token.type() == INT_VAL || curr_token.type() == STRING_VAL || curr_token.type() == CHAR_VAL || curr_token.type() == DOUBLE_VAL || curr_token.type() == BOOL_VAL || curr_token.type() == ID || curr_token.type() == NIL || curr_token.type() == NEW || curr_token.type() == NEG || curr_token.type() == L_BRACKET || curr_token.type() == TRANSPOSE) {
+    if (curr_token.type() == INT_VAL || curr_token.type() == STRING_VAL || curr_token.type() == CHAR_VAL || curr_token.type() == DOUBLE_VAL || curr_token.type() == BOOL_VAL || curr_token.type() == ID || curr_token.type() == NIL || curr_token.type() == NEW || curr_token.type() == NEG || curr_token.type() == L_BRACKET || curr_token.type() == L_BRACE || curr_token.type() == TRANSPOSE) {
         SimpleTerm* new_sim_term = new SimpleTerm;
         new_sim_term->rvalue = rvalue();
          
@@ -496,7 +546,7 @@ void Parser::expr(Expr* node)
     }
 }
 
-void Parser::operate()
+inline void Parser::operate()
 {
 
     if (curr_token.type() == PLUS) {
@@ -529,6 +579,9 @@ void Parser::operate()
     if (curr_token.type() == GREATER_EQUAL) {
         eat(GREATER_EQUAL, "Expecting GREATER_EQUAL");
     }
+    if (curr_token.type() == NOT_EQUAL) {
+        eat(NOT_EQUAL, "Expecting NOT_EQUAL");
+    }
     if (curr_token.type() == GREATER) {
         eat(GREATER, "Expecting GREATER");
     }
@@ -550,7 +603,7 @@ void Parser::operate()
     
 }
 //value type grammars
-RValue* Parser::rvalue()
+inline RValue* Parser::rvalue()
 {
 
 
@@ -611,6 +664,23 @@ RValue* Parser::rvalue()
     	}
     
     }
+    else if (curr_token.type() == L_BRACE) {
+        //array literal: {e1, e2, ...}
+        ArrayValue* new_array_val = new ArrayValue;
+        new_array_val->first_brace = curr_token;
+        eat(L_BRACE, "Expecting L_BRACE");
+        Expr* new_expr_node = new Expr;
+        expr(new_expr_node);
+        new_array_val->elements.push_back(new_expr_node);
+        while (curr_token.type() == COMMA) {
+            eat(COMMA, "Expecting comma");
+            new_expr_node = new Expr;
+            expr(new_expr_node);
+            new_array_val->elements.push_back(new_expr_node);
+        }
+        eat(R_BRACE, "Expecting R_BRACE");
+        return new_array_val;
+    }
     else if (curr_token.type() == NIL) {
 
         SimpleRValue* new_r_val = new SimpleRValue;
@@ -622,6 +692,11 @@ RValue* Parser::rvalue()
         eat(NEW, "Expecting NEW");
         NewRValue* new_r_val = new NewRValue;
         new_r_val->type_id = curr_token;
+        if (curr_token.type() == ID && (curr_token.lexeme() == "array" || curr_token.lexeme() == "map")) {
+            //an empty array<T> or map<K,V>
+            dtype(&new_r_val->type_id);
+            return new_r_val;
+        }
 
         eat(ID, "expecting id");
         return new_r_val;
@@ -630,10 +705,7 @@ RValue* Parser::rvalue()
    
         Token hold_token = curr_token;
         eat(ID, "Expecting ID here5");
-	if (curr_token.type() == R_BRACKET) {
-	
-	}
-        else if (curr_token.type() == LPAREN) {
+        if (curr_token.type() == LPAREN) {
             CallExpr* new_call_expr = new CallExpr;
             call_expr_S(new_call_expr);
             new_call_expr->function_id = hold_token;
@@ -643,6 +715,7 @@ RValue* Parser::rvalue()
             IDRValue* new_idr_value = new IDRValue;
             new_idr_value->path.push_back(hold_token);
             idrval_S(new_idr_value);
+            indexes(new_idr_value->indexes);
             return new_idr_value;
         }
     }
@@ -666,7 +739,7 @@ RValue* Parser::rvalue()
     }
 }
 
-void Parser::pval()
+inline void Parser::pval()
 {
     if (curr_token.type() == INT_VAL) {
         eat(INT_VAL, "Expecting INT_VAL");
@@ -685,7 +758,7 @@ void Parser::pval()
         eat(BOOL_VAL, "Expecting BOOL_VAL");
     }
 }
-void Parser::idrval_S(IDRValue* new_idr_val)
+inline void Parser::idrval_S(IDRValue* new_idr_val)
 {
     while (curr_token.type() == DOT) {
         eat(DOT, "expecting DOT");
@@ -693,8 +766,19 @@ void Parser::idrval_S(IDRValue* new_idr_val)
         eat(ID, "expecting ID");
     }
 }
+//array element indexes: [e1][e2]...
+inline void Parser::indexes(list<Expr*>& index_list)
+{
+    while (curr_token.type() == L_BRACKET) {
+        eat(L_BRACKET, "expecting [");
+        Expr* index_expr = new Expr;
+        expr(index_expr);
+        index_list.push_back(index_expr);
+        eat(R_BRACKET, "expecting ]");
+    }
+}
 //id and attribute grammar
-void Parser::idrval(IDRValue* new_idr_val)
+inline void Parser::idrval(IDRValue* new_idr_val)
 {
     new_idr_val->path.push_back(curr_token);
     eat(ID, "Expecting ID here4");
@@ -41,6 +41,7 @@ public:
     void visit(IDRValue& node);
     void visit(NegatedRValue& node);
     void visit(TransposedRValue& node);
+    void visit(ArrayValue& node);
 private:
     std::ostream& out;
     int indent = 0;
@@ -52,8 +53,11 @@ private:
 
 //Visit root node
 
-void Printer::visit(Program& node)
+inline void Printer::visit(Program& node)
 {
+    for (const Token& path : node.imports) {
+        out << "import \"" << path.lexeme() << "\"" << endl;
+    }
     //Returns if ast is empty
     if (node.decls.size() == 0) {
         return;
@@ -65,8 +69,9 @@ void Printer::visit(Program& node)
 }
 
 //visit function declaration
-void Printer::visit(FunDecl& node)
+inline void Printer::visit(FunDecl& node)
 {
+    node.read_body();
     string s = "fun " + node.return_type.lexeme() + " " + node.id.lexeme() + "(";
     //Output function parameters
     for (FunDecl::FunParam iter : node.params) {
@@ -93,7 +98,7 @@ void Printer::visit(FunDecl& node)
 }
 
 //Visit Type Declaration
-void Printer::visit(TypeDecl& node)
+inline void Printer::visit(TypeDecl& node)
 {
     string s;
     s += "type " + node.id.lexeme() + '\n';
@@ -110,7 +115,7 @@ void Printer::visit(TypeDecl& node)
         << endl;
 }
 // var declaration statements
-void Printer::visit(VarDeclStmt& node)
+inline void Printer::visit(VarDeclStmt& node)
 {
     string s = "var " + node.id.lexeme();
     if (node.type != nullptr) {
@@ -121,7 +126,7 @@ void Printer::visit(VarDeclStmt& node)
     node.expr->accept(*this);
 }
 //Visit Assignment statement
-void Printer::visit(AssignStmt& node)
+inline void Printer::visit(AssignStmt& node)
 {
     string s = "";
     int inter = 0;
@@ -133,6 +138,11 @@ void Printer::visit(AssignStmt& node)
         }
         inter++;
     }
+    for (Expr* index : node.indexes) {
+        out << "[";
+        index->accept(*this);
+        out << "]";
+    }
     out << " "
         << "="
         << " ";
@@ -140,13 +150,13 @@ void Printer::visit(AssignStmt& node)
     node.expr->accept(*this);
 }
 //Visit Return Statement
-void Printer::visit(ReturnStmt& node)
+inline void Printer::visit(ReturnStmt& node)
 {
     out << "return ";
     node.expr->accept(*this);
 }
 //Visit if statement
-void Printer::visit(IfStmt& node)
+inline void Printer::visit(IfStmt& node)
 {
     out << "if"
         << " ";
@@ -192,7 +202,7 @@ void Printer::visit(IfStmt& node)
     out << get_indent() << "end";
 }
 //Visit while Stmt
-void Printer::visit(WhileStmt& node)
+inline void Printer::visit(WhileStmt& node)
 {
     out << "while ";
     //Params of while stmt
@@ -210,17 +220,23 @@ void Printer::visit(WhileStmt& node)
     out << get_indent() << "end";
 }
 //Visit for stmt
-void Printer::visit(ForStmt& node)
+inline void Printer::visit(ForStmt& node)
 {
-    out << "for " << node.var_id.lexeme() << " ";
-    out << "= ";
-    //first expr of for argument
-    node.start->accept(*this);
-    out << " "
-        << "to"
-        << " ";
-    //second expr of for argument
-    node.end->accept(*this);
+    out << (node.parallel ? "parfor " : "for ") << node.var_id.lexeme() << " ";
+    if (node.each) {
+        out << "in ";
+        node.start->accept(*this);
+    }
+    else {
+        out << "= ";
+        //first expr of for argument
+        node.start->accept(*this);
+        out << " "
+            << "to"
+            << " ";
+        //second expr of for argument
+        node.end->accept(*this);
+    }
     out << endl;
     inc_indent();
     for (Stmt* iter : node.stmts) {
@@ -234,7 +250,7 @@ void Printer::visit(ForStmt& node)
 
 //Visit expression
 // expressions
-void Printer::visit(Expr& node)
+inline void Printer::visit(Expr& node)
 {
     string s = "";
     //Checks for non-single rvalue expression to add (
@@ -261,32 +277,32 @@ void Printer::visit(Expr& node)
 }
 
 //Visit Simple Term
-void Printer::visit(SimpleTerm& node)
+inline void Printer::visit(SimpleTerm& node)
 {
     node.rvalue->accept(*this);
 }
 
 //Visit Simple Term
-void Printer::visit(ComplexTerm& node)
+inline void Printer::visit(ComplexTerm& node)
 {
     node.expr->accept(*this);
 }
 
 // Visit SimpleRVAlue
-void Printer::visit(SimpleRValue& node)
+inline void Printer::visit(SimpleRValue& node)
 {
     out << node.value.lexeme();
 }
 
 //Visit NewRValue Term
-void Printer::visit(NewRValue& node)
+inline void Printer::visit(NewRValue& node)
 {
     out << "new ";
     out << node.type_id.lexeme();
 }
 
 //Visit Call Expr
-void Printer::visit(CallExpr& node)
+inline void Printer::visit(CallExpr& node)
 {
     out << node.function_id.lexeme();
     out << "(";
@@ -302,7 +318,7 @@ void Printer::visit(CallExpr& node)
 }
 
 //visit IDRValue
-void Printer::visit(IDRValue& node)
+inline void Printer::visit(IDRValue& node)
 {
     string s = "";
     int pass_by = 0;
@@ -313,16 +329,34 @@ void Printer::visit(IDRValue& node)
         }
         pass_by += 1;
     }
+    for (Expr* index : node.indexes) {
+        out << "[";
+        index->accept(*this);
+        out << "]";
+    }
 }
 
 //visit NegatedRValue
-void Printer::visit(NegatedRValue& node)
+inline void Printer::visit(NegatedRValue& node)
 {
     out << "neg ";
     node.expr->accept(*this);
 }
-void Printer::visit(TransposedRValue& node) {
+inline void Printer::visit(TransposedRValue& node) {
 
 
+}
+inline void Printer::visit(ArrayValue& node)
+{
+    out << "{";
+    int pass_by = 0;
+    for (Expr* element : node.elements) {
+        if (pass_by > 0) {
+            out << ", ";
+        }
+        element->accept(*this);
+        pass_by += 1;
+    }
+    out << "}";
 }
 #endif
@@ -0,0 +1,306 @@
+//----------------------------------------------------------------------
+// FILE: profiler.h
+// DESC: Instrumenting profiler for MyPL programs (see --profile). The
+//       interpreter reports function entries/exits, executed
+//       statements, and heap object creation; the profiler keeps
+//       per-function call counts with inclusive and exclusive times,
+//       per-line statement hits, allocation counts, and a call tree
+//       that is written out in the collapsed-stack format used by
+//       flamegraph tools. Each parfor worker has a profiler of its
+//       own, merged in when the loop ends (so worker times are summed
+//       over the threads).
+//----------------------------------------------------------------------
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include "ast.h"
+#include "data_object.h"
+
+
+class Profiler;
+
+
+// reports a call to the profiler (if any) for as long as it is in scope,
+// so the call is closed however it ends (e.g., by a runtime error)
+class ProfiledCall
+{
+public:
+  ProfiledCall(Profiler* profiler, const void* fun, const std::string& name);
+  ~ProfiledCall();
+  ProfiledCall(const ProfiledCall&) = delete;
+  ProfiledCall& operator=(const ProfiledCall&) = delete;
+private:
+  Profiler* profiler;
+};
+
+
+class Profiler
+{
+public:
+
+  Profiler();
+
+  // a function (identified by its declaration) starts running
+  void enter_function(const void* fun, const std::string& name);
+
+  // the most recently entered function returns
+  void exit_function();
+
+  // a statement is about to run
+  void count_stmt(Stmt* stmt);
+
+  // a user-defined type instance was created on the heap
+  void count_heap_object();
+
+  // add a parfor worker's counts and times (its calls ran below the
+  // function running now)
+  void merge(const Profiler& worker);
+
+  // close any functions still running (e.g., after a runtime error)
+  void finish();
+
+  // write the report and the collapsed-stack file
+  void write_report(const std::string& path) const;
+  void write_collapsed(const std::string& path) const;
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+  typedef Clock::time_point TimePoint;
+
+  struct FunctionStats {
+    std::string name;
+    size_t calls = 0;
+    size_t active = 0;          // running instances (for recursion)
+    long long inclusive_ns = 0; // outermost instances only
+    long long exclusive_ns = 0;
+  };
+
+  // call tree node (one per distinct call path)
+  struct CallNode {
+    const void* fun;
+    size_t parent;
+    long long self_ns = 0;
+    std::vector<size_t> children;
+  };
+
+  // a running function
+  struct Frame {
+    FunctionStats* stats;
+    size_t node;
+    TimePoint start;
+    long long child_ns;
+  };
+
+  std::unordered_map<const void*,FunctionStats> functions;
+  std::vector<CallNode> call_tree;
+  std::vector<Frame> frames;
+  size_t curr_node = 0;
+
+  std::unordered_map<Stmt*,size_t> stmt_hits;
+
+  TimePoint start_time;
+  long long total_ns = 0;
+  size_t heap_objects = 0;
+  size_t workers = 0;           // parfor worker profiles merged in
+  size_t start_strings = 0;
+  size_t start_matrices = 0;
+
+  // the child of node for the given function (added if new)
+  size_t child_node(size_t node, const void* fun);
+
+  // the ;-separated call path of a call tree node
+  std::string node_path(size_t node) const;
+};
+
+
+inline Profiler::Profiler()
+  : start_time(Clock::now()),
+    start_strings(DataObject::string_allocations),
+    start_matrices(DataObject::matrix_allocations)
+{
+  // root of the call tree (not a function)
+  call_tree.push_back(CallNode{nullptr, 0});
+}
+
+
+inline void Profiler::enter_function(const void* fun, const std::string& name)
+{
+  FunctionStats& stats = functions[fun];
+  if (stats.calls == 0)
+    stats.name = name;
+  ++stats.calls;
+  ++stats.active;
+  curr_node = child_node(curr_node, fun);
+  frames.push_back(Frame{&stats, curr_node, Clock::now(), 0});
+}
+
+
+inline void Profiler::exit_function()
+{
+  if (frames.empty())
+    return;
+  Frame frame = frames.back();
+  frames.pop_back();
+  long long elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    Clock::now() - frame.start).count();
+  long long self = elapsed - frame.child_ns;
+  frame.stats->exclusive_ns += self;
+  if (--frame.stats->active == 0)
+    frame.stats->inclusive_ns += elapsed;
+  call_tree[frame.node].self_ns += self;
+  curr_node = call_tree[frame.node].parent;
+  if (!frames.empty())
+    frames.back().child_ns += elapsed;
+}
+
+
+inline void Profiler::count_stmt(Stmt* stmt)
+{
+  ++stmt_hits[stmt];
+}
+
+
+inline void Profiler::count_heap_object()
+{
+  ++heap_objects;
+}
+
+
+inline void Profiler::merge(const Profiler& worker)
+{
+  for (const auto& entry : worker.functions) {
+    FunctionStats& stats = functions[entry.first];
+    if (stats.calls == 0)
+      stats.name = entry.second.name;
+    stats.calls += entry.second.calls;
+    stats.inclusive_ns += entry.second.inclusive_ns;
+    stats.exclusive_ns += entry.second.exclusive_ns;
+  }
+  for (const auto& entry : worker.stmt_hits)
+    stmt_hits[entry.first] += entry.second;
+  heap_objects += worker.heap_objects;
+  ++workers;
+  // the worker's call tree goes below the current node (a node's
+  // parent always comes before it)
+  std::vector<size_t> nodes(worker.call_tree.size());
+  nodes[0] = curr_node;
+  for (size_t node = 1; node < worker.call_tree.size(); ++node) {
+    const CallNode& call = worker.call_tree[node];
+    nodes[node] = child_node(nodes[call.parent], call.fun);
+    call_tree[nodes[node]].self_ns += call.self_ns;
+  }
+}
+
+
+inline void Profiler::finish()
+{
+  while (!frames.empty())
+    exit_function();
+  total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    Clock::now() - start_time).count();
+}
+
+
+inline size_t Profiler::child_node(size_t node, const void* fun)
+{
+  for (size_t child : call_tree[node].children)
+    if (call_tree[child].fun == fun)
+      return child;
+  call_tree.push_back(CallNode{fun, node});
+  call_tree[node].children.push_back(call_tree.size() - 1);
+  return call_tree.size() - 1;
+}
+
+
+inline std::string Profiler::node_path(size_t node) const
+{
+  std::vector<const std::string*> names;
+  for (; node != 0; node = call_tree[node].parent)
+    names.push_back(&functions.at(call_tree[node].fun).name);
+  std::string path;
+  for (auto it = names.rbegin(); it != names.rend(); ++it) {
+    if (!path.empty())
+      path += ";";
+    path += **it;
+  }
+  return path;
+}
+
+
+inline void Profiler::write_report(const std::string& path) const
+{
+  std::ofstream out(path);
+  out << std::fixed << std::setprecision(3);
+  out << "MyPL profile" << std::endl;
+  out << "total time: " << total_ns / 1e6 << " ms" << std::endl;
+  if (workers > 0)
+    out << "parfor workers: " << workers << " (their times are summed over the threads)" << std::endl;
+  out << std::endl;
+
+  // functions, most expensive (exclusive) first
+  std::vector<const FunctionStats*> funs;
+  for (const auto& entry : functions)
+    funs.push_back(&entry.second);
+  std::sort(funs.begin(), funs.end(),
+            [](const FunctionStats* a, const FunctionStats* b) {
+              return a->exclusive_ns > b->exclusive_ns;
+            });
+  out << std::left << std::setw(24) << "function" << std::right
+      << std::setw(12) << "calls" << std::setw(18) << "inclusive (ms)"
+      << std::setw(18) << "exclusive (ms)" << std::endl;
+  for (const FunctionStats* f : funs)
+    out << std::left << std::setw(24) << f->name << std::right
+        << std::setw(12) << f->calls << std::setw(18) << f->inclusive_ns / 1e6
+        << std::setw(18) << f->exclusive_ns / 1e6 << std::endl;
+
+  // statement hits, by line
+  std::map<int,size_t> lines;
+  for (const auto& entry : stmt_hits)
+    lines[entry.first->first_token().line()] += entry.second;
+  out << std::endl << std::setw(8) << "line" << std::setw(16) << "hits" << std::endl;
+  for (const auto& entry : lines)
+    out << std::setw(8) << entry.first << std::setw(16) << entry.second << std::endl;
+
+  out << std::endl << "allocations" << std::endl;
+  out << "  heap objects: " << heap_objects << std::endl;
+  out << "  strings:      " << DataObject::string_allocations - start_strings << std::endl;
+  out << "  matrices:     " << DataObject::matrix_allocations - start_matrices << std::endl;
+}
+
+
+inline void Profiler::write_collapsed(const std::string& path) const
+{
+  // one "caller;...;callee self-time" line per call path
+  std::ofstream out(path);
+  for (size_t node = 1; node < call_tree.size(); ++node)
+    if (call_tree[node].self_ns > 0)
+      out << node_path(node) << " " << call_tree[node].self_ns << std::endl;
+}
+
+
+inline ProfiledCall::ProfiledCall(Profiler* profiler, const void* fun, const std::string& name)
+  : profiler(profiler)
+{
+  if (profiler)
+    profiler->enter_function(fun, name);
+}
+
+
+inline ProfiledCall::~ProfiledCall()
+{
+  if (profiler)
+    profiler->exit_function();
+}
+
+
+#endif
@@ -0,0 +1,85 @@
+//----------------------------------------------------------------------
+// FILE: reduction_builtins.h
+// DESC: Native reduction built-ins (reduce_sum, reduce_min, reduce_max
+//       and their int and matrix forms). Each folds its second argument
+//       into the variable given as the first, and they are the only
+//       way a parfor body may update a variable declared outside it:
+//       every worker reduces into a private copy, and the copies are
+//       combined into the variable with the same built-in once the
+//       loop finishes (see Interpreter::run_parallel).
+//----------------------------------------------------------------------
+
+#ifndef REDUCTION_BUILTINS_H
+#define REDUCTION_BUILTINS_H
+
+#include <utility>
+#include "builtins.h"
+#include "matrix.h"
+
+
+// the combining operations
+template<typename T> T reduce_add(T a, T b) {return a + b;}
+template<typename T> T reduce_min(T a, T b) {return b < a ? b : a;}
+template<typename T> T reduce_max(T a, T b) {return a < b ? b : a;}
+
+// reduce_X(var, x) sets var to var op x; a nil var takes x, and a nil
+// x leaves var as it is
+template<typename T, T (*Op)(T, T)>
+void native_reduce(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  result.set_nil();
+  if (args[1].is_nil())
+    return;
+  T x {};
+  args[1].value(x);
+  if (!args[0].is_nil()) {
+    T var {};
+    args[0].value(var);
+    x = Op(var, x);
+  }
+  args[0].set(x);
+}
+
+// m_reduce_sum(M, X) adds X to the matrix variable M, dimensions must
+// match
+inline void native_m_reduce_sum(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  result.set_nil();
+  const Matrix* x = args[1].matrix_ptr();
+  if (!x)
+    return;
+  if (args[0].is_nil()) {
+    args[0] = args[1];
+    return;
+  }
+  Matrix* m = args[0].mutable_matrix_ptr();
+  if (!m)
+    ctx.error("expecting a matrix argument");
+  if (m->rows() != x->rows() or m->cols() != x->cols())
+    ctx.error("Matrix dimensions must be equivalent");
+  kernel_axpy(1.0, x->data(), m->data(), m->size());
+}
+
+
+// register the reduction family (in place, and marked as reductions
+// for the type checker's parfor rules)
+inline void add_reduction_builtins(BuiltinRegistry& r)
+{
+  r.add("reduce_sum", StringVec{"double", "double", "nil"},
+        native_reduce<double, reduce_add<double>>, true, true);
+  r.add("reduce_min", StringVec{"double", "double", "nil"},
+        native_reduce<double, reduce_min<double>>, true, true);
+  r.add("reduce_max", StringVec{"double", "double", "nil"},
+        native_reduce<double, reduce_max<double>>, true, true);
+  r.add("reduce_isum", StringVec{"int", "int", "nil"},
+        native_reduce<int, reduce_add<int>>, true, true);
+  r.add("reduce_imin", StringVec{"int", "int", "nil"},
+        native_reduce<int, reduce_min<int>>, true, true);
+  r.add("reduce_imax", StringVec{"int", "int", "nil"},
+        native_reduce<int, reduce_max<int>>, true, true);
+  r.add("m_reduce_sum", StringVec{"matrix", "matrix", "nil"},
+        native_m_reduce_sum, true, true);
+}
+
+
+#endif
@@ -0,0 +1,377 @@
+//----------------------------------------------------------------------
+// FILE: server.h
+// DESC: A long-running interpreter (mypl --serve SOCKET) taking runs
+//       over a Unix socket, so short scripts skip process startup and,
+//       once seen, the lexer, parser, and type checker. A connection
+//       carries one run: a script path or source and the script's
+//       standard input, answered with its exit code and output. Runs
+//       are taken by a few threads. Compiled programs (see embed.h) are
+//       kept in memory, keyed by their source and path, along with
+//       their instances: a run takes an instance no other run is using
+//       (making another if there is none), and leaves it for the next.
+//       A kept program is used only while its modules are unchanged.
+//
+//       request:  "MYPL <path size> <source size> <input size>\n",
+//                 path, source (read from the path if empty), input
+//       response: "<exit code> <output size>\n", output
+//
+//       A request over the size limits below, or one the server fails
+//       on outside the run itself, has its connection closed unanswered.
+//----------------------------------------------------------------------
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "ast_cache.h"
+#include "embed.h"
+#include "flat_map.h"
+#include "mypl_exception.h"
+#include "thread_pool.h"
+
+
+// checked programs kept in memory (the least recently run are dropped)
+const size_t SERVER_PROGRAMS = 256;
+
+// runs taken at once (at least; more with a larger thread pool)
+const size_t SERVER_THREADS = 4;
+
+// largest script path, and largest source or input, taken in a request
+const size_t SERVER_PATH_SIZE = 4096;
+const size_t SERVER_PART_SIZE = size_t(1) << 28;
+
+
+class Server
+{
+public:
+
+  // serve on the socket path (replacing any socket there); modules are
+  // read from and saved to their caches if use_cache
+  Server(const std::string& socket_path, bool use_cache);
+
+  // take runs until the process is stopped (returns 1 if the socket
+  // cannot be set up)
+  int serve();
+
+  // run a script on a server, with this process's standard input and
+  // output, and return its exit code (mypl --connect SOCKET [file])
+  static int connect(const std::string& socket_path, const std::string& file_name);
+
+private:
+
+  // a kept program and its instances not running
+  struct Compiled
+  {
+    std::shared_ptr<const CompiledProgram> program;
+    std::vector<std::unique_ptr<ProgramInstance>> idle;
+    uint64_t last_run = 0;
+  };
+
+  // take and answer connections
+  void take_runs();
+  void answer(int fd);
+
+  // run a script (as mypl would) and return its exit code
+  int run(const std::string& path, const std::string& source,
+          const std::string& input, std::string& output);
+
+  // the kept program for a script, compiling it if there is none or
+  // its modules changed
+  std::shared_ptr<Compiled> program(const std::string& path, const std::string& source);
+
+  // whole reads and writes (false if the connection closed)
+  static bool read_all(int fd, char* data, size_t size);
+  static bool write_all(int fd, const char* data, size_t size);
+  static bool read_line(int fd, std::string& line);
+  static std::string read_file(const std::string& path);
+
+  std::string socket_path;
+  bool use_cache;
+  int listener = -1;
+  std::mutex lock;                    // guards programs, idle, and runs
+  std::unordered_map<uint64_t, std::shared_ptr<Compiled>> programs;
+  uint64_t runs = 0;
+};
+
+
+inline Server::Server(const std::string& socket_path, bool use_cache)
+  : socket_path(socket_path), use_cache(use_cache)
+{
+}
+
+
+inline int Server::serve()
+{
+  // clients that hang up early must not stop the server
+  signal(SIGPIPE, SIG_IGN);
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0 or socket_path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "cannot listen on socket '" << socket_path << "'" << std::endl;
+    return 1;
+  }
+  socket_path.copy(addr.sun_path, socket_path.size());
+  unlink(socket_path.c_str());
+  if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 or listen(listener, SOMAXCONN) != 0) {
+    std::cerr << "cannot listen on socket '" << socket_path << "'" << std::endl;
+    return 1;
+  }
+  // every thread waits for connections itself
+  std::vector<std::thread> threads;
+  size_t count = std::max(SERVER_THREADS, ThreadPool::instance().size());
+  for (size_t i = 0; i < count; ++i)
+    threads.emplace_back([this] {take_runs();});
+  for (std::thread& t : threads)
+    t.join();
+  return 0;
+}
+
+
+inline void Server::take_runs()
+{
+  while (true) {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR or errno == ECONNABORTED)
+        continue;
+      return;
+    }
+    // (one bad connection must not stop the server)
+    try {
+      answer(fd);
+    } catch (...) {
+    }
+    close(fd);
+  }
+}
+
+
+inline void Server::answer(int fd)
+{
+  std::string header;
+  if (!read_line(fd, header))
+    return;
+  std::istringstream fields(header);
+  std::string magic;
+  size_t sizes[3];
+  if (!(fields >> magic >> sizes[0] >> sizes[1] >> sizes[2]) or magic != "MYPL")
+    return;
+  if (sizes[0] > SERVER_PATH_SIZE or sizes[1] > SERVER_PART_SIZE or sizes[2] > SERVER_PART_SIZE)
+    return;
+  std::string parts[3];
+  for (int i = 0; i < 3; ++i) {
+    parts[i].resize(sizes[i]);
+    if (!read_all(fd, &parts[i][0], sizes[i]))
+      return;
+  }
+  std::string& path = parts[0];
+  if (sizes[1] == 0 and path != "")
+    parts[1] = read_file(path);
+  std::string output;
+  int code = run(path, parts[1], parts[2], output);
+  std::string reply = std::to_string(code) + " " + std::to_string(output.size()) + "\n";
+  if (write_all(fd, reply.data(), reply.size()))
+    write_all(fd, output.data(), output.size());
+}
+
+
+inline int Server::run(const std::string& path, const std::string& source,
+                const std::string& input, std::string& output)
+{
+  int code;
+  std::shared_ptr<Compiled> compiled;
+  std::unique_ptr<ProgramInstance> instance;
+  try {
+    compiled = program(path, source);
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (!compiled->idle.empty()) {
+        instance = std::move(compiled->idle.back());
+        compiled->idle.pop_back();
+      }
+    }
+    if (!instance)
+      instance.reset(new ProgramInstance(compiled->program));
+    code = instance->run(input, output);
+  } catch (MyPLException e) {
+    output += e.to_string() + "\n";
+    code = 1;
+  } catch (const std::exception& e) {
+    // (e.g., out of memory) only this run fails
+    output += std::string(e.what()) + "\n";
+    code = 1;
+  }
+  // (a failed run leaves the instance as usable as a finished one)
+  if (instance) {
+    std::lock_guard<std::mutex> guard(lock);
+    compiled->idle.push_back(std::move(instance));
+  }
+  return code;
+}
+
+
+inline std::shared_ptr<Server::Compiled> Server::program(const std::string& path, const std::string& source)
+{
+  // the path is part of the key, as imports are relative to it
+  uint64_t key = hash_mix(source_hash(source) ^ source_hash(path));
+  std::shared_ptr<Compiled> compiled;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = programs.find(key);
+    if (found != programs.end())
+      compiled = found->second;
+  }
+  if (compiled) {
+    for (auto& module : compiled->program->modules()) {
+      if (source_hash(read_file(module.first)) != module.second) {
+        compiled = nullptr;
+        break;
+      }
+    }
+  }
+  // (two runs of a new script may both compile it)
+  if (!compiled) {
+    compiled.reset(new Compiled);
+    compiled->program = CompiledProgram::compile(source, path, use_cache);
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  compiled->last_run = ++runs;
+  if (!programs.count(key) and programs.size() == SERVER_PROGRAMS) {
+    auto oldest = programs.begin();
+    for (auto it = programs.begin(); it != programs.end(); ++it)
+      if (it->second->last_run < oldest->second->last_run)
+        oldest = it;
+    programs.erase(oldest);
+  }
+  programs[key] = compiled;
+  return compiled;
+}
+
+
+inline int Server::connect(const std::string& socket_path, const std::string& file_name)
+{
+  // a script given by path is read by the server (by its real path,
+  // as the server's working directory may differ); otherwise the
+  // source is standard input, and the script's input is empty
+  std::string path, source, input;
+  {
+    std::stringstream buffer;
+    buffer << std::cin.rdbuf();
+    if (file_name != "") {
+      char* real = realpath(file_name.c_str(), nullptr);
+      path = real ? real : file_name;
+      free(real);
+      input = buffer.str();
+    }
+    else
+      source = buffer.str();
+  }
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  bool connected = fd >= 0 and socket_path.size() < sizeof(addr.sun_path);
+  if (connected) {
+    socket_path.copy(addr.sun_path, socket_path.size());
+    connected = ::connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+  }
+  if (!connected) {
+    std::cerr << "cannot connect to socket '" << socket_path << "'" << std::endl;
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+  std::string request = "MYPL " + std::to_string(path.size()) + " " + std::to_string(source.size()) +
+    " " + std::to_string(input.size()) + "\n" + path + source + input;
+  std::string reply;
+  size_t size = 0;
+  int code = 0;
+  bool answered = write_all(fd, request.data(), request.size()) and read_line(fd, reply);
+  if (answered) {
+    std::istringstream fields(reply);
+    answered = (bool)(fields >> code >> size);
+  }
+  std::string output(size, '\0');
+  answered = answered and read_all(fd, &output[0], size);
+  close(fd);
+  if (!answered) {
+    std::cerr << "no answer from socket '" << socket_path << "'" << std::endl;
+    return 1;
+  }
+  std::cout << output << std::flush;
+  return code;
+}
+
+
+inline bool Server::read_all(int fd, char* data, size_t size)
+{
+  while (size > 0) {
+    ssize_t n = read(fd, data, size);
+    if (n < 0 and errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+
+inline bool Server::write_all(int fd, const char* data, size_t size)
+{
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 and errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+
+inline bool Server::read_line(int fd, std::string& line)
+{
+  // (only the short header lines are read this way)
+  char c;
+  line.clear();
+  while (read_all(fd, &c, 1)) {
+    if (c == '\n')
+      return true;
+    if (line.size() == 256)
+      return false;
+    line += c;
+  }
+  return false;
+}
+
+
+inline std::string Server::read_file(const std::string& path)
+{
+  std::stringstream buffer;
+  std::ifstream file(path);
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+
+#endif
@@ -0,0 +1,61 @@
+//----------------------------------------------------------------------
+// FILE: stats.h
+// DESC: Run statistics counters (see --stats). The lexer, AST, symbol
+//       table, heap, and data objects bump these as they work. The
+//       counters compile away entirely when MYPL_STATS is 0.
+//----------------------------------------------------------------------
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <algorithm>
+
+#ifndef MYPL_STATS
+#define MYPL_STATS 1
+#endif
+
+// run a counter update only when statistics are compiled in
+#if MYPL_STATS
+#define MYPL_COUNT(update) update
+#else
+#define MYPL_COUNT(update)
+#endif
+
+
+struct Stats
+{
+  size_t tokens = 0;            // tokens returned by Lexer::next_token
+  size_t ast_nodes = 0;         // AST nodes created
+  size_t environments = 0;      // live symbol-table environments
+  size_t max_environments = 0;  // environment high-water mark
+  size_t heap_objects = 0;      // live heap objects
+  size_t max_heap_objects = 0;  // heap object high-water mark
+  size_t data_objects = 0;      // DataObject value allocations
+  size_t jit_functions = 0;     // functions compiled by the JIT
+  size_t jit_loops = 0;         // loops compiled by the JIT
+
+  // add the counts of another thread (a parfor worker) to these
+  void merge(const Stats& other);
+};
+
+// the counters for this run (each parfor worker thread keeps its own,
+// merged into the running thread's when its iterations are done)
+inline thread_local Stats mypl_stats;
+
+
+inline void Stats::merge(const Stats& other)
+{
+  tokens += other.tokens;
+  ast_nodes += other.ast_nodes;
+  max_environments = std::max(max_environments, environments + other.max_environments);
+  environments += other.environments;
+  max_heap_objects = std::max(max_heap_objects, heap_objects + other.max_heap_objects);
+  heap_objects += other.heap_objects;
+  data_objects += other.data_objects;
+  jit_functions += other.jit_functions;
+  jit_loops += other.jit_loops;
+}
+
+
+#endif
@@ -0,0 +1,121 @@
+//----------------------------------------------------------------------
+// FILE: string_builtins.h
+// DESC: Native string built-ins: substr, find, split, join, and
+//       replace. Arguments are read where they are stored (see
+//       string_arg), so each call costs time in the size of its result
+//       rather than its inputs; a substring covering the whole string
+//       shares it. get and length are in builtins.h.
+//----------------------------------------------------------------------
+
+#ifndef STRING_BUILTINS_H
+#define STRING_BUILTINS_H
+
+#include "builtins.h"
+
+
+// substr(s, i, n) is the n characters of s starting at index i
+inline void native_substr(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const std::string& s = string_arg(args, 0);
+  int start = 0;
+  int count = 0;
+  args[1].value(start);
+  args[2].value(count);
+  if (start < 0 or count < 0 or (size_t)start + count > s.size())
+    ctx.error("substring out of range");
+  if (count == s.size())
+    result = args[0];
+  else
+    result.set(s.substr(start, count));
+}
+
+// find(s, t) is the index of the first t in s (-1 if there is none),
+// and find(s, t, i) the index of the first t at or after index i
+inline void native_find(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const std::string& s = string_arg(args, 0);
+  int from = 0;
+  if (args.size() > 2) {
+    args[2].value(from);
+    if (from < 0 or from > s.size())
+      ctx.error("string index out of range");
+  }
+  size_t i = s.find(string_arg(args, 1), from);
+  result.set(i == std::string::npos ? -1 : (int)i);
+}
+
+// split(s, sep) is the parts of s between the separators sep
+inline void native_split(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const std::string& s = string_arg(args, 0);
+  const std::string& sep = string_arg(args, 1);
+  if (sep.empty())
+    ctx.error("empty separator");
+  Array parts("string");
+  size_t start = 0;
+  while (true) {
+    size_t end = s.find(sep, start);
+    if (end == std::string::npos)
+      break;
+    parts.push(DataObject(s.substr(start, end - start)));
+    start = end + sep.size();
+  }
+  parts.push(DataObject(s.substr(start)));
+  result.set(std::move(parts));
+}
+
+// join(xs, sep) is the strings of xs with sep between each two
+inline void native_join(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const Array* xs = args[0].array_ptr();
+  if (!xs)
+    ctx.error("nil array");
+  const std::string& sep = string_arg(args, 1);
+  std::string joined;
+  DataObject x;
+  for (size_t i = 0; i < xs->size(); ++i) {
+    xs->get(i, x);
+    if (i > 0)
+      joined += sep;
+    if (const std::string* s = x.string_ptr())
+      joined += *s;
+  }
+  result.set(std::move(joined));
+}
+
+// replace(s, old, new) is s with each old replaced by new (from left to
+// right, without overlaps)
+inline void native_replace(NativeContext& ctx, NativeArgs args, DataObject& result)
+{
+  const std::string& s = string_arg(args, 0);
+  const std::string& old_part = string_arg(args, 1);
+  const std::string& new_part = string_arg(args, 2);
+  if (old_part.empty())
+    ctx.error("empty string to replace");
+  std::string replaced;
+  size_t start = 0;
+  while (true) {
+    size_t end = s.find(old_part, start);
+    if (end == std::string::npos)
+      break;
+    replaced.append(s, start, end - start);
+    replaced += new_part;
+    start = end + old_part.size();
+  }
+  replaced.append(s, start, std::string::npos);
+  result.set(std::move(replaced));
+}
+
+
+inline void add_string_builtins(BuiltinRegistry& r)
+{
+  r.add("substr", StringVec{"string", "int", "int", "string"}, native_substr);
+  r.add("find", StringVec{"string", "string", "int"}, native_find);
+  r.add_overload("find", StringVec{"string", "string", "int", "int"}, native_find);
+  r.add("split", StringVec{"string", "string", "array<string>"}, native_split);
+  r.add("join", StringVec{"array<string>", "string", "string"}, native_join);
+  r.add("replace", StringVec{"string", "string", "string", "string"}, native_replace);
+}
+
+
+#endif
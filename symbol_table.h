@@ -1,4 +1,4 @@
------------------------------------------------------------
+//-----------------------------------------------------------
 
 
 #ifndef SYMBOL_TABLE_H
@@ -8,6 +8,7 @@
 #include <vector>
 #include <list>
 #include "data_object.h"
+#include "stats.h"
 
 // string->string map to store type information for user-defined types
 typedef std::map<std::string,std::string> StringMap;
@@ -46,6 +47,10 @@ public:
   // check if name exists in given environment
   bool name_exists_in_env(const std::string& name, int env_id) const;
 
+  // id of the environment the name is found in, searching from the
+  // current environment (-1 if the name does not exist)
+  int name_environment_id(const std::string& name) const;
+
   // set the name's symbol-table info (as a string)
   void set_str_info(const std::string& name, const std::string& info);
 
@@ -76,6 +81,10 @@ public:
   // get the name's symbol-table info (if stored as a data object)
   void get_val_info(const std::string& name, DataObject& info) const;
 
+  // the name's data object itself, for in-place updates (nullptr if
+  // the name has no data-object information)
+  DataObject* get_val_ptr(const std::string& name);
+
   // get the name's symbol-table info (if stored as a map)
   void get_map_info(const std::string& name, StringMap& info) const;
 
@@ -146,18 +155,19 @@ private:
 // BASIC SYMBOL TABLE OPERATIONS
 //----------------------------------------------------------------------
 
-SymbolTable::~SymbolTable()
+inline SymbolTable::~SymbolTable()
 {
   for (std::pair<int,Environment> p1 : environments) {
     for (std::pair<std::string,SymTableObject*> p2 : p1.second)
       delete_sym_obj(p2.second);
     p1.second.clear();
   }
+  MYPL_COUNT(mypl_stats.environments -= environments.size());
   environments.clear();
 }
 
 
-void SymbolTable::push_environment()
+inline void SymbolTable::push_environment()
 {
   std::pair<int,Environment> env_entry;
   env_entry.first = environment_count++;
@@ -168,10 +178,12 @@ void SymbolTable::push_environment()
   else
     environments.insert(it + curr_env_index() + 1, env_entry);
   current_environment_id = env_entry.first;
+  MYPL_COUNT(mypl_stats.max_environments =
+             std::max(mypl_stats.max_environments, ++mypl_stats.environments));
 }
 
 
-void SymbolTable::pop_environment()
+inline void SymbolTable::pop_environment()
 {
   if (environments.size() == 0)
     return;
@@ -181,6 +193,7 @@ void SymbolTable::pop_environment()
     delete_sym_obj(m.second);
   // remove the environment
   environments.erase(environments.begin() + index);
+  MYPL_COUNT(--mypl_stats.environments);
   if (index > 0)
     current_environment_id = environments[index-1].first;
   else
@@ -188,19 +201,19 @@ void SymbolTable::pop_environment()
 }
 
 
-int SymbolTable::get_environment_id()
+inline int SymbolTable::get_environment_id()
 {
   return current_environment_id;
 }
 
 
-void SymbolTable::set_environment_id(int env_id)
+inline void SymbolTable::set_environment_id(int env_id)
 {
   current_environment_id = env_id;
 }
 
   
-void SymbolTable::add_name(const std::string& name)
+inline void SymbolTable::add_name(const std::string& name)
 {
   if (environments.size() == 0)
     return;
@@ -208,7 +221,7 @@ void SymbolTable::add_name(const std::string& name)
 }
 
 
-bool SymbolTable::name_exists(const std::string& name) const
+inline bool SymbolTable::name_exists(const std::string& name) const
 {
   if (environments.size() == 0)
     return false;
@@ -216,11 +229,19 @@ bool SymbolTable::name_exists(const std::string& name) const
   return get_env_for_name(name, index);
 }
 
+inline int SymbolTable::name_environment_id(const std::string& name) const
+{
+  int index = 0;
+  if (environments.size() == 0 or !get_env_for_name(name, index))
+    return -1;
+  return environments[index].first;
+}
+
 //----------------------------------------------------------------------
 // SET FUNCTIONS
 //----------------------------------------------------------------------
 
-void SymbolTable::set_str_info(const std::string& name, const std::string& info)
+inline void SymbolTable::set_str_info(const std::string& name, const std::string& info)
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -233,7 +254,7 @@ void SymbolTable::set_str_info(const std::string& name, const std::string& info)
 }
 
 
-void SymbolTable::set_val_info(const std::string& name, const DataObject& info)
+inline void SymbolTable::set_val_info(const std::string& name, const DataObject& info)
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -246,7 +267,7 @@ void SymbolTable::set_val_info(const std::string& name, const DataObject& info)
 }
 
 
-void SymbolTable::set_vec_info(const std::string& name, const StringVec& info)
+inline void SymbolTable::set_vec_info(const std::string& name, const StringVec& info)
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -259,7 +280,7 @@ void SymbolTable::set_vec_info(const std::string& name, const StringVec& info)
 }
 
 
-void SymbolTable::set_map_info(const std::string& name, const StringMap& info)
+inline void SymbolTable::set_map_info(const std::string& name, const StringMap& info)
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -276,7 +297,7 @@ void SymbolTable::set_map_info(const std::string& name, const StringMap& info)
 // HAS FUNCTIONS
 //----------------------------------------------------------------------
 
-bool SymbolTable::has_str_info(const std::string& name) const
+inline bool SymbolTable::has_str_info(const std::string& name) const
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -287,7 +308,7 @@ bool SymbolTable::has_str_info(const std::string& name) const
 }
 
 
-bool SymbolTable::has_val_info(const std::string& name) const
+inline bool SymbolTable::has_val_info(const std::string& name) const
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -298,7 +319,7 @@ bool SymbolTable::has_val_info(const std::string& name) const
 }
   
 
-bool SymbolTable::has_vec_info(const std::string& name) const
+inline bool SymbolTable::has_vec_info(const std::string& name) const
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -309,7 +330,7 @@ bool SymbolTable::has_vec_info(const std::string& name) const
 }
 
 
-bool SymbolTable::has_map_info(const std::string& name) const
+inline bool SymbolTable::has_map_info(const std::string& name) const
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -324,7 +345,7 @@ bool SymbolTable::has_map_info(const std::string& name) const
 // GET FUNCTIONS
 //----------------------------------------------------------------------
 
-void SymbolTable::get_str_info(const std::string& name, std::string& info) const
+inline void SymbolTable::get_str_info(const std::string& name, std::string& info) const
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -335,7 +356,7 @@ void SymbolTable::get_str_info(const std::string& name, std::string& info) const
 }
 
 
-void SymbolTable::get_val_info(const std::string& name, DataObject& info) const
+inline void SymbolTable::get_val_info(const std::string& name, DataObject& info) const
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -346,7 +367,19 @@ void SymbolTable::get_val_info(const std::string& name, DataObject& info) const
 }
 
 
-void SymbolTable::get_vec_info(const std::string& name, StringVec& info) const
+inline DataObject* SymbolTable::get_val_ptr(const std::string& name)
+{
+  int index = -1;
+  if (get_env_for_name(name, index)) {
+    SymTableObject* obj = environments[index].second.at(name);
+    if (obj and obj->type() == VAL)
+      return &((ValObject*)obj)->obj_val;
+  }
+  return nullptr;
+}
+
+
+inline void SymbolTable::get_vec_info(const std::string& name, StringVec& info) const
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -357,7 +390,7 @@ void SymbolTable::get_vec_info(const std::string& name, StringVec& info) const
 }
 
 
-void SymbolTable::get_map_info(const std::string& name, StringMap& info) const
+inline void SymbolTable::get_map_info(const std::string& name, StringMap& info) const
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -372,7 +405,7 @@ void SymbolTable::get_map_info(const std::string& name, StringMap& info) const
 // PRETTY PRINT ENVIRONMENTS
 //----------------------------------------------------------------------
 
-std::string SymbolTable::to_string() const
+inline std::string SymbolTable::to_string() const
 {
   std::string s = "";
   for (std::pair<int,Environment> env_entry : environments) {
@@ -421,7 +454,7 @@ std::string SymbolTable::to_string() const
 // HELPER FUNCTIONS
 //----------------------------------------------------------------------
 
-void SymbolTable::delete_sym_obj(SymTableObject* obj)
+inline void SymbolTable::delete_sym_obj(SymTableObject* obj)
 {
   if (!obj)
     return;
@@ -436,13 +469,13 @@ void SymbolTable::delete_sym_obj(SymTableObject* obj)
 }
 
 
-bool SymbolTable::name_exists_in_curr_env(const std::string& name) const
+inline bool SymbolTable::name_exists_in_curr_env(const std::string& name) const
 {
   return name_exists_in_env(name, current_environment_id);
 }
 
 
-bool SymbolTable::name_exists_in_env(const std::string& name, int env_id) const
+inline bool SymbolTable::name_exists_in_env(const std::string& name, int env_id) const
 {
   for (std::pair<int,Environment> env_entry : environments) {
     if (env_entry.first == env_id)
@@ -452,7 +485,7 @@ bool SymbolTable::name_exists_in_env(const std::string& name, int env_id) const
 }
 
 
-bool SymbolTable::get_env_for_name(const std::string& name, int& index) const
+inline bool SymbolTable::get_env_for_name(const std::string& name, int& index) const
 {
   int curr_index = curr_env_index();
   for (size_t i = curr_index + 1; i > 0; --i) {
@@ -465,7 +498,7 @@ bool SymbolTable::get_env_for_name(const std::string& name, int& index) const
 }
 
   
-int SymbolTable::curr_env_index() const
+inline int SymbolTable::curr_env_index() const
 {
   for (int i = 0; i < environments.size(); ++i) {
     if (current_environment_id == environments[i].first)
@@ -0,0 +1,143 @@
+//----------------------------------------------------------------------
+// FILE: cache_test.cpp
+// DESC: Checks that damaged program caches are rejected (so mypl
+//       compiles the source again) instead of crashing the run. A
+//       script is compiled and its cache image is truncated at every
+//       length and has every byte changed, both as is (the checksum
+//       must catch it) and with the checksum fixed up (the decoder
+//       must fail cleanly or build some program). Function bodies
+//       left in the image are read as well.
+//
+//       usage: cache_test SCRIPT WORK_DIR
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <memory>
+#include "token.h"
+#include "mypl_exception.h"
+#include "lexer.h"
+#include "parser.h"
+#include "parallel_parser.h"
+#include "ast.h"
+#include "type_checker.h"
+#include "ast_cache.h"
+
+using namespace std;
+
+
+// the header in front of the checksummed payload: magic, version (one
+// byte as a varint), source hash, checksum
+const size_t HEADER = 5 + 1 + 8 + 8;
+
+static int failures = 0;
+
+static void fail(const string& what)
+{
+  if (++failures <= 20)
+    cerr << "FAIL: " << what << endl;
+}
+
+
+// read an image, leaving the bodies in it and then reading each of them;
+// true if the whole program was rebuilt
+static bool read_image(const string& image, uint64_t hash)
+{
+  shared_ptr<string> owner(new string(image));
+  Program program;
+  AstReader reader(owner->data(), owner->size());
+  reader.leave_bodies(owner);
+  if (!reader.read(program, hash))
+    return false;
+  for (Decl* d : program.decls) {
+    FunDecl* f = dynamic_cast<FunDecl*>(d);
+    try {
+      if (f)
+        f->read_body();
+    }
+    catch (const MyPLException& e) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// put the payload's checksum back into the header
+static void fix_checksum(string& image)
+{
+  uint64_t checksum = fnv1a_hash(image.data() + HEADER, image.size() - HEADER);
+  for (int i = 0; i < 8; ++i)
+    image[HEADER - 8 + i] = (char)(checksum >> (8 * i));
+}
+
+
+int main(int argc, char* argv[])
+{
+  if (argc != 3) {
+    cerr << "usage: " << argv[0] << " SCRIPT WORK_DIR" << endl;
+    return 2;
+  }
+  ifstream file(argv[1]);
+  stringstream buffer;
+  buffer << file.rdbuf();
+  string source = buffer.str();
+  uint64_t hash = source_hash(source);
+
+  Program program;
+  parse_source(source, program);
+  TypeChecker type_checker;
+  program.accept(type_checker);
+  string image = AstWriter().write(program, hash);
+
+  if (image.size() <= HEADER or image[5] != (char)AST_CACHE_VERSION)
+    fail("unexpected image header");
+  if (!read_image(image, hash))
+    fail("the image as written is not read back");
+  if (read_image(image, hash + 1))
+    fail("an image is read for another source");
+
+  // truncated images
+  for (size_t n = 0; n < image.size(); ++n)
+    if (read_image(image.substr(0, n), hash))
+      fail("image truncated to " + to_string(n) + " bytes is read");
+
+  for (size_t i = 0; i < image.size(); ++i) {
+    for (unsigned char flip : {0x01, 0x80, 0xff}) {
+      string damaged = image;
+      damaged[i] ^= flip;
+      // caught by the header or the checksum
+      if (read_image(damaged, hash))
+        fail("byte " + to_string(i) + " changed and the image is read");
+      // caught by the decoder (or decoded into some other program)
+      if (i >= HEADER) {
+        fix_checksum(damaged);
+        read_image(damaged, hash);
+      }
+    }
+  }
+
+  // a damaged cache file is not loaded, so mypl compiles the source
+  string path = string(argv[2]) + "/cache_test.myplc";
+  string damaged = image;
+  damaged[image.size() / 2] ^= 0x55;
+  for (bool intact : {true, false}) {
+    ofstream out(path, ios::binary | ios::trunc);
+    out << (intact ? image : damaged);
+    out.close();
+    Program loaded;
+    bool ok = load_program_cache(path, hash, loaded);
+    if (ok != intact)
+      fail(ok ? "a damaged cache file is loaded" : "the cache file is not loaded");
+  }
+  remove(path.c_str());
+
+  if (failures) {
+    cerr << failures << " failures" << endl;
+    return 1;
+  }
+  cout << "checked " << image.size() << " byte image" << endl;
+  return 0;
+}
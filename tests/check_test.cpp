@@ -0,0 +1,143 @@
+//----------------------------------------------------------------------
+// FILE: check_test.cpp
+// DESC: Checks that type checking function bodies in parallel gives
+//       the same results as checking them one at a time: a generated
+//       program large enough for the bodies to run on the thread pool
+//       checks cleanly, and with errors in several places the error
+//       reported is always the first in source order.
+//
+//       usage: check_test
+//----------------------------------------------------------------------
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <set>
+#include "token.h"
+#include "mypl_exception.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "type_checker.h"
+
+using namespace std;
+
+
+// functions in the generated program, and statements in each body
+const int FUNCTIONS = 100;
+const int STATEMENTS = 12;
+
+// times each erroneous program is checked (the bodies finish in a
+// different order each time)
+const int RUNS = 20;
+
+static int failures = 0;
+
+static void fail(const string& what)
+{
+  if (++failures <= 20)
+    cerr << "FAIL: " << what << endl;
+}
+
+
+// a program of FUNCTIONS functions (each calling the one before it)
+// and a main; the functions in bad_funs have a type error on their
+// first line, and the types in bad_types (declared before the function
+// of the same number) have one in their field
+static string program(const set<int>& bad_funs, const set<int>& bad_types = {})
+{
+  ostringstream s;
+  for (int f = 0; f < FUNCTIONS; ++f) {
+    if (bad_types.count(f)) {
+      s << "type T" << f << "\n";
+      s << "  var v: int = \"text\"\n";
+      s << "end\n";
+    }
+    s << "fun int f" << f << "(x: int)\n";
+    if (bad_funs.count(f))
+      s << "  var bad: int = 2.5\n";
+    else
+      s << "  var y = x + 1\n";
+    s << "  var total = 0\n";
+    s << "  var name = \"f" << f << "\"\n";
+    for (int i = 3; i < STATEMENTS - 1; ++i)
+      s << "  total = total + (x * " << i << ")\n";
+    if (f > 0)
+      s << "  return f" << f - 1 << "(total % 10)\n";
+    else
+      s << "  return total\n";
+    s << "end\n";
+  }
+  s << "fun int main()\n";
+  s << "  return f" << FUNCTIONS - 1 << "(1)\n";
+  s << "end\n";
+  return s.str();
+}
+
+// the line the first statement of function f is on (or its type's
+// field), in a program with the given erroneous types
+static int line_of(int f, const set<int>& bad_types, bool type_field = false)
+{
+  int line = 1;
+  for (int g = 0; g < f; ++g)
+    line += STATEMENTS + 2 + (bad_types.count(g) ? 3 : 0);
+  if (bad_types.count(f))
+    return type_field ? line + 1 : line + 4;
+  return line + 1;
+}
+
+// the error checking the program reports (empty if none)
+static string check(const string& source)
+{
+  istringstream in(source);
+  Lexer lexer(in);
+  Parser parser(lexer);
+  Program program;
+  try {
+    parser.parse(program);
+    TypeChecker type_checker;
+    program.accept(type_checker);
+  }
+  catch (const MyPLException& e) {
+    return e.to_string();
+  }
+  return "";
+}
+
+// check a program RUNS times, expecting an error on line (0 for none)
+static void expect(const string& what, const string& source, int line)
+{
+  string at = " at line " + to_string(line) + " ";
+  for (int run = 0; run < RUNS; ++run) {
+    string error = check(source);
+    if (line == 0 and !error.empty())
+      fail(what + ": unexpected " + error);
+    else if (line != 0 and error.find(at) == string::npos)
+      fail(what + ": expected an error at line " + to_string(line) +
+           ", got '" + error + "'");
+  }
+}
+
+
+int main()
+{
+  // several threads, however many cores there are
+  setenv("MYPL_THREADS", "4", 0);
+  expect("no errors", program({}), 0);
+  expect("one body", program({57}), line_of(57, {}));
+  expect("two bodies", program({40, 90}), line_of(40, {}));
+  expect("first and last bodies", program({0, FUNCTIONS - 1}), line_of(0, {}));
+  expect("every body", program({0, 1, 2, 3, 60, 61, 62}), line_of(0, {}));
+  // a body error before an erroneous type is reported, and one after it
+  // is not
+  expect("body then type", program({30}, {70}), line_of(30, {70}));
+  expect("type then body", program({80}, {70}), line_of(70, {70}, true));
+
+  if (failures) {
+    cerr << failures << " failures" << endl;
+    return 1;
+  }
+  cout << "checked " << FUNCTIONS << " functions" << endl;
+  return 0;
+}
@@ -0,0 +1,182 @@
+//----------------------------------------------------------------------
+// FILE: embed_test.cpp
+// DESC: Checks the embedding APIs: two instances of one compiled
+//       program, run over and over on two threads at once, each print
+//       what the program computes from its own input, through the C++
+//       API (ProgramInstance) and the C one (mypl_run). A runtime error
+//       in one run must leave its instance usable for the next.
+//
+//       usage: embed_test
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "embed.h"
+#include "embed_c.h"
+
+using namespace std;
+
+
+// runs each instance makes
+const int RUNS = 200;
+
+// builds a list of 1..n (from a line of input) and prints its sum; a
+// negative n indexes an array out of range
+const string SOURCE =
+  "type Node\n"
+  "  var value: int = 0\n"
+  "  var next: Node = nil\n"
+  "end\n"
+  "fun int main()\n"
+  "  var n = read_int()\n"
+  "  var head: Node = nil\n"
+  "  for i = 1 to n do\n"
+  "    var node = new Node\n"
+  "    node.value = i\n"
+  "    node.next = head\n"
+  "    head = node\n"
+  "  end\n"
+  "  if n < 0 then\n"
+  "    var xs = {1, 2}\n"
+  "    return xs[0 - n]\n"
+  "  end\n"
+  "  var total = 0\n"
+  "  while head != nil do\n"
+  "    total = total + head.value\n"
+  "    head = head.next\n"
+  "  end\n"
+  "  print(itos(n) + \" \" + itos(total) + \"\\n\")\n"
+  "  return n % 7\n"
+  "end\n";
+
+static int failures[2] = {0, 0};
+
+static void fail(int thread, const string& what)
+{
+  // (each thread counts its own, and the first few are printed at the end)
+  if (++failures[thread] <= 10)
+    cerr << "FAIL: thread " + to_string(thread) + ": " + what + "\n";
+}
+
+// the input of run r on thread t, and the output expected for input n
+static int input_of(int t, int r) {return t * 1000 + r;}
+
+static string output_of(int n)
+{
+  return to_string(n) + " " + to_string((long long)n * (n + 1) / 2) + "\n";
+}
+
+
+// run an instance of program RUNS times on thread t (C++ API)
+static void run_instance(shared_ptr<const CompiledProgram> program, int t)
+{
+  ProgramInstance instance(program);
+  for (int r = 0; r < RUNS; ++r) {
+    int n = input_of(t, r);
+    string output;
+    try {
+      int code = instance.run(to_string(n) + "\n", output);
+      if (code != n % 7 or output != output_of(n))
+        fail(t, "run " + to_string(r) + " exited " + to_string(code) + " with '" + output + "'");
+    }
+    catch (const MyPLException& e) {
+      fail(t, "run " + to_string(r) + ": " + e.to_string());
+    }
+  }
+}
+
+// appends output to a string (the context)
+static void append(void* context, const char* data, size_t size)
+{
+  ((string*)context)->append(data, size);
+}
+
+// run an instance of program RUNS times on thread t (C API)
+static void run_c_instance(const mypl_program* program, int t)
+{
+  mypl_instance* instance = mypl_instance_new(program);
+  for (int r = 0; r < RUNS; ++r) {
+    int n = input_of(t, r);
+    string input = to_string(n) + "\n";
+    string output;
+    int code = -1;
+    char* error = nullptr;
+    if (mypl_run(instance, input.data(), input.size(), append, &output, &code, &error) != 0) {
+      fail(t, "C run " + to_string(r) + ": " + error);
+      mypl_free(error);
+    }
+    else if (code != n % 7 or output != output_of(n))
+      fail(t, "C run " + to_string(r) + " exited " + to_string(code) + " with '" + output + "'");
+  }
+  mypl_instance_free(instance);
+}
+
+
+int main()
+{
+  // C++: two instances of one program at once, then a failed run and a
+  // good one on the same instance
+  shared_ptr<const CompiledProgram> program;
+  try {
+    program = CompiledProgram::compile(SOURCE);
+  }
+  catch (const MyPLException& e) {
+    cerr << "FAIL: compile: " << e.to_string() << endl;
+    return 1;
+  }
+  {
+    thread other(run_instance, program, 1);
+    run_instance(program, 0);
+    other.join();
+  }
+  ProgramInstance instance(program);
+  string output;
+  try {
+    instance.run("-3\n", output);
+    fail(0, "an array was indexed out of range without an error");
+  }
+  catch (const MyPLException& e) {
+    if (e.to_string().find("out of range") == string::npos)
+      fail(0, "unexpected error: " + e.to_string());
+  }
+  output.clear();
+  if (instance.run("5\n", output) != 5 or output != output_of(5))
+    fail(0, "a run after an error printed '" + output + "'");
+
+  // C: the same, and a compile error as a message
+  char* error = nullptr;
+  mypl_program* c_program = mypl_compile(SOURCE.data(), SOURCE.size(), nullptr, &error);
+  if (!c_program) {
+    cerr << "FAIL: C compile: " << error << endl;
+    mypl_free(error);
+    return 1;
+  }
+  {
+    thread other(run_c_instance, c_program, 1);
+    run_c_instance(c_program, 0);
+    other.join();
+  }
+  mypl_instance* c_instance = mypl_instance_new(c_program);
+  int code = 0;
+  output.clear();
+  if (mypl_run(c_instance, "-3\n", 3, append, &output, &code, &error) != -1)
+    fail(0, "C: an array was indexed out of range without an error");
+  else
+    mypl_free(error);
+  mypl_instance_free(c_instance);
+  mypl_program_free(c_program);
+  string bad = "fun int main()\n  return \"text\"\nend\n";
+  if (mypl_compile(bad.data(), bad.size(), nullptr, &error) or !error)
+    fail(0, "C: a type error compiled");
+  else
+    mypl_free(error);
+
+  if (failures[0] + failures[1]) {
+    cerr << failures[0] + failures[1] << " failures" << endl;
+    return 1;
+  }
+  cout << "ran " << 4 * RUNS << " runs on two threads" << endl;
+  return 0;
+}
@@ -0,0 +1,146 @@
+//----------------------------------------------------------------------
+// FILE: parse_test.cpp
+// DESC: Checks that parsing a large source in pieces on the thread
+//       pool gives the program an in-order parse does. Generated
+//       sources (with comments, chars, and strings holding newlines
+//       and declaration keywords, and with LF or CRLF line ends) must
+//       give the same cache image either way, and sources with a
+//       syntax error must give the same error message.
+//
+//       usage: parse_test
+//----------------------------------------------------------------------
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "token.h"
+#include "mypl_exception.h"
+#include "lexer.h"
+#include "parser.h"
+#include "parallel_parser.h"
+#include "ast.h"
+#include "type_checker.h"
+#include "ast_cache.h"
+
+using namespace std;
+
+
+// functions in a generated source (over PARALLEL_PARSE_BYTES)
+const int FUNCTIONS = 400;
+
+static int failures = 0;
+
+static void fail(const string& what)
+{
+  if (++failures <= 20)
+    cerr << "FAIL: " << what << endl;
+}
+
+
+// a source of FUNCTIONS functions and types and a main, with lines
+// ended by newline; function bad (if any) has a syntax error in it
+static string source(const string& newline, int bad = -1)
+{
+  ostringstream s;
+  for (int f = 0; f < FUNCTIONS; ++f) {
+    s << "# function " << f << ": fun and type start declarations" << newline;
+    s << "type T" << f << newline;
+    s << "  var n: int = " << f << newline;
+    s << "  var c: char = 'f'" << newline;
+    s << "end" << newline;
+    s << "fun int f" << f << "(x: int)" << newline;
+    s << "  var t = new T" << f << newline;
+    // (a string holding lines that look like declarations)
+    s << "  var s = \"text" << newline << "fun int fake()" << newline << "type Fake\"" << newline;
+    s << "  var d = 2.5 # not fun" << newline;
+    if (f == bad)
+      s << "  var = x" << newline;
+    s << "  if t.c == 'f' then" << newline;
+    s << "    return x + t.n + length(s)" << newline;
+    s << "  end" << newline;
+    s << "  return 0" << newline;
+    s << "end" << newline;
+  }
+  s << "fun int main()" << newline;
+  s << "  return f0(1)" << newline;
+  s << "end" << newline;
+  return s.str();
+}
+
+// parse a source in order (false and the error message on an error)
+static bool parse_in_order(const string& text, Program& program, string& error)
+{
+  istringstream in(text);
+  Lexer lexer(in);
+  Parser parser(lexer);
+  try {
+    parser.parse(program);
+  }
+  catch (const MyPLException& e) {
+    error = e.to_string();
+    return false;
+  }
+  return true;
+}
+
+// parse a source in pieces (false and the error message on an error)
+static bool parse_in_pieces(const string& text, Program& program, string& error)
+{
+  try {
+    parse_source(text, program);
+  }
+  catch (const MyPLException& e) {
+    error = e.to_string();
+    return false;
+  }
+  return true;
+}
+
+// the cache image of a parsed program (type checked first)
+static string image(Program& program)
+{
+  TypeChecker type_checker;
+  program.accept(type_checker);
+  return AstWriter().write(program, 0);
+}
+
+
+int main()
+{
+  // several threads, however many cores there are
+  setenv("MYPL_THREADS", "4", 0);
+  for (string newline : {"\n", "\r\n"}) {
+    string kind = newline == "\n" ? "LF" : "CRLF";
+    string text = source(newline);
+    if (text.size() < PARALLEL_PARSE_BYTES or split_source(text).size() < FUNCTIONS)
+      fail(kind + ": the source is not split");
+
+    Program in_order, in_pieces;
+    string error;
+    if (!parse_in_order(text, in_order, error))
+      fail(kind + ": in-order parse failed: " + error);
+    else if (!parse_in_pieces(text, in_pieces, error))
+      fail(kind + ": parse in pieces failed: " + error);
+    else if (image(in_order) != image(in_pieces))
+      fail(kind + ": the programs differ");
+
+    // errors at the start, middle and end
+    for (int bad : {0, FUNCTIONS / 2, FUNCTIONS - 1}) {
+      string with_error = source(newline, bad);
+      Program p1, p2;
+      string e1, e2;
+      bool ok1 = parse_in_order(with_error, p1, e1);
+      bool ok2 = parse_in_pieces(with_error, p2, e2);
+      if (ok1 or ok2 or e1 != e2)
+        fail(kind + ": error in function " + to_string(bad) + ": '" + e1 + "' and '" + e2 + "'");
+    }
+  }
+
+  if (failures) {
+    cerr << failures << " failures" << endl;
+    return 1;
+  }
+  cout << "checked " << FUNCTIONS << " declarations" << endl;
+  return 0;
+}
@@ -0,0 +1,65 @@
+# Runs one MyPL script for ctest (see CMakeLists.txt):
+#
+#   cmake -DMYPL=<mypl> -DSCRIPT=<file.mypl> -DMODE=<mode> [-DCXX=<c++>
+#         -DINCLUDE=<source dir> -DWORK=<dir>] -P run_test.cmake
+#
+# MODE is "interp" (mypl SCRIPT), "jit" (mypl --jit=1 SCRIPT, so every
+# function and loop the JIT takes is compiled), or "cpp" (the program
+# --emit-cpp translates SCRIPT to, built with CXX). The output must
+# match the script's .expected file, or without one, what the
+# interpreter prints. Standard input is the script's .input file, if
+# any.
+
+get_filename_component(dir "${SCRIPT}" DIRECTORY)
+get_filename_component(name "${SCRIPT}" NAME_WE)
+set(input /dev/null)
+if(EXISTS "${dir}/${name}.input")
+  set(input "${dir}/${name}.input")
+endif()
+
+# run a command on the input, setting <var> to its output (standard
+# output and error) and <var>_code to its exit code
+function(run var)
+  execute_process(COMMAND ${ARGN}
+    INPUT_FILE "${input}"
+    OUTPUT_VARIABLE out ERROR_VARIABLE out
+    RESULT_VARIABLE code
+    TIMEOUT 120)
+  set(${var} "${out}" PARENT_SCOPE)
+  set(${var}_code "${code}" PARENT_SCOPE)
+endfunction()
+
+if(MODE STREQUAL "interp")
+  run(actual "${MYPL}" --no-cache "${SCRIPT}")
+elseif(MODE STREQUAL "jit")
+  run(actual "${MYPL}" --no-cache --jit=1 "${SCRIPT}")
+elseif(MODE STREQUAL "cpp")
+  file(MAKE_DIRECTORY "${WORK}")
+  set(source "${WORK}/${name}.cpp")
+  set(program "${WORK}/${name}")
+  # a program that fails to check prints the same error either way
+  run(actual "${MYPL}" --no-cache --emit-cpp "${SCRIPT}")
+  if(actual_code EQUAL 0)
+    file(WRITE "${source}" "${actual}")
+    run(build "${CXX}" -std=c++17 -O1 "-I${INCLUDE}" "${source}" -o "${program}")
+    if(NOT build_code EQUAL 0)
+      message(FATAL_ERROR "the translated program does not build:\n${build}")
+    endif()
+    run(actual "${program}")
+  endif()
+else()
+  message(FATAL_ERROR "unknown MODE '${MODE}'")
+endif()
+
+if(EXISTS "${dir}/${name}.expected")
+  file(READ "${dir}/${name}.expected" expected)
+else()
+  run(expected "${MYPL}" --no-cache "${SCRIPT}")
+  if(NOT actual_code EQUAL expected_code)
+    message(FATAL_ERROR "exit code ${actual_code}, expected ${expected_code}")
+  endif()
+endif()
+
+if(NOT actual STREQUAL expected)
+  message(FATAL_ERROR "output differs\n--- expected:\n${expected}\n--- actual:\n${actual}")
+endif()
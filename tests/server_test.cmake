@@ -0,0 +1,67 @@
+# Runs scripts on mypl --serve for ctest (see CMakeLists.txt):
+#
+#   cmake -DMYPL=<mypl> -DTESTS=<tests dir> -DWORK=<dir> -P server_test.cmake
+#
+# Starts a server on a socket in WORK, and has two --connect clients
+# run at once: one gives input.mypl by path with input.input as its
+# standard input, the other gives strings.mypl as source on standard
+# input. Each must print its .expected output and exit with 0. The
+# first script is then run again, from the kept program.
+
+file(MAKE_DIRECTORY "${WORK}")
+set(socket "${WORK}/server_test.sock")
+file(REMOVE "${socket}" "${WORK}/input.out" "${WORK}/input.code"
+  "${WORK}/strings.out" "${WORK}/strings.code")
+
+# (the server's output goes to a file, so this does not wait on it)
+execute_process(
+  COMMAND sh -c "\"$0\" --no-cache --serve \"$1\" >\"$2\" 2>&1 & echo $!"
+    "${MYPL}" "${socket}" "${WORK}/server_test.log"
+  OUTPUT_VARIABLE server OUTPUT_STRIP_TRAILING_WHITESPACE)
+
+foreach(wait RANGE 100)
+  if(EXISTS "${socket}")
+    break()
+  endif()
+  execute_process(COMMAND ${CMAKE_COMMAND} -E sleep 0.1)
+endforeach()
+
+# run the clients at once, each writing <name>.out and <name>.code
+execute_process(
+  COMMAND sh -c "
+    (\"$0\" --connect \"$1\" \"$2/input.mypl\" <\"$2/input.input\" >\"$3/input.out\" 2>&1
+     echo $? >\"$3/input.code\") &
+    (\"$0\" --connect \"$1\" <\"$2/strings.mypl\" >\"$3/strings.out\" 2>&1
+     echo $? >\"$3/strings.code\") &
+    wait"
+    "${MYPL}" "${socket}" "${TESTS}" "${WORK}"
+  TIMEOUT 120)
+execute_process(
+  COMMAND "${MYPL}" --connect "${socket}" "${TESTS}/input.mypl"
+  INPUT_FILE "${TESTS}/input.input"
+  OUTPUT_VARIABLE again ERROR_VARIABLE again
+  RESULT_VARIABLE again_code
+  TIMEOUT 120)
+
+execute_process(COMMAND kill "${server}")
+file(REMOVE "${socket}")
+
+set(errors "")
+foreach(name input strings)
+  file(READ "${TESTS}/${name}.expected" expected)
+  set(actual "")
+  set(code "")
+  if(EXISTS "${WORK}/${name}.out")
+    file(READ "${WORK}/${name}.out" actual)
+    file(STRINGS "${WORK}/${name}.code" code)
+  endif()
+  if(NOT code STREQUAL "0" OR NOT actual STREQUAL expected)
+    string(APPEND errors "${name}.mypl: exit code '${code}'\n--- expected:\n${expected}\n--- actual:\n${actual}\n")
+  endif()
+  if(name STREQUAL "input" AND (NOT again_code EQUAL 0 OR NOT again STREQUAL expected))
+    string(APPEND errors "input.mypl run again: exit code '${again_code}'\n--- expected:\n${expected}\n--- actual:\n${again}\n")
+  endif()
+endforeach()
+if(errors)
+  message(FATAL_ERROR "${errors}")
+endif()
@@ -0,0 +1,165 @@
+//----------------------------------------------------------------------
+// FILE: thread_pool.h
+// DESC: A fixed pool of worker threads running the iterations of
+//       parfor loops. A job is a count of numbered tasks; the pool's
+//       threads and the calling thread take task numbers until none
+//       are left. The pool size is $MYPL_THREADS if set, and the number
+//       of hardware threads otherwise. Jobs from several threads (runs
+//       in mypl --serve) share the pool: its threads take a task from
+//       each job in turn, so a long job does not hold up the others.
+//----------------------------------------------------------------------
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool
+{
+public:
+
+  // the pool shared by all parallel loops (started on first use)
+  static ThreadPool& instance();
+
+  ~ThreadPool();
+
+  // number of threads running a job's tasks (including the caller)
+  size_t size() const;
+
+  // run task(0), ..., task(count - 1) on the pool and the calling
+  // thread, returning once all of them are done; the exception of the
+  // lowest numbered failed task (if any) is rethrown
+  void run(size_t count, const std::function<void(size_t)>& task);
+
+private:
+
+  // a running job (on its caller's stack)
+  struct Job
+  {
+    const std::function<void(size_t)>* task;
+    size_t count;
+    std::vector<std::exception_ptr> errors;
+    size_t next = 0;                  // next task number to take
+    size_t busy = 0;                  // threads running one of its tasks
+  };
+
+  explicit ThreadPool(size_t threads);
+
+  // worker thread loop: wait for a job and help run it
+  void work();
+
+  // take the job's next task (with the lock held), and run it
+  void run_task(Job& job, std::unique_lock<std::mutex>& guard);
+
+  std::vector<std::thread> threads;
+  std::mutex lock;                    // guards jobs and their counters
+  std::condition_variable wake;       // a new job or shutdown
+  std::condition_variable finished;   // a thread left a job
+  std::list<Job*> jobs;               // jobs with tasks left to take
+  bool stopping = false;
+};
+
+
+inline ThreadPool& ThreadPool::instance()
+{
+  static ThreadPool pool([] {
+    const char* env = std::getenv("MYPL_THREADS");
+    long n = env ? std::atol(env) : (long)std::thread::hardware_concurrency();
+    return n > 0 ? (size_t)n : (size_t)1;
+  }());
+  return pool;
+}
+
+
+inline ThreadPool::ThreadPool(size_t threads)
+{
+  // the caller is the last thread
+  for (size_t i = 1; i < threads; ++i)
+    this->threads.emplace_back([this] {work();});
+}
+
+
+inline ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& t : threads)
+    t.join();
+}
+
+
+inline size_t ThreadPool::size() const
+{
+  return threads.size() + 1;
+}
+
+
+inline void ThreadPool::run(size_t count, const std::function<void(size_t)>& task)
+{
+  if (count == 0)
+    return;
+  Job job;
+  job.task = &task;
+  job.count = count;
+  job.errors.assign(count, nullptr);
+  std::unique_lock<std::mutex> guard(lock);
+  jobs.push_back(&job);
+  wake.notify_all();
+  // the caller works on its own job only
+  while (job.next < job.count)
+    run_task(job, guard);
+  // (the pool's threads may still be running the last tasks)
+  finished.wait(guard, [&] {return job.busy == 0;});
+  guard.unlock();
+  for (std::exception_ptr& e : job.errors)
+    if (e)
+      std::rethrow_exception(e);
+}
+
+
+inline void ThreadPool::work()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    wake.wait(guard, [this] {return stopping or !jobs.empty();});
+    if (stopping)
+      return;
+    // the job that has waited longest for a thread
+    run_task(*jobs.front(), guard);
+  }
+}
+
+
+inline void ThreadPool::run_task(Job& job, std::unique_lock<std::mutex>& guard)
+{
+  size_t i = job.next++;
+  // a job with tasks left goes to the back of the line
+  jobs.remove(&job);
+  if (job.next < job.count)
+    jobs.push_back(&job);
+  ++job.busy;
+  guard.unlock();
+  try {
+    (*job.task)(i);
+  }
+  catch (...) {
+    job.errors[i] = std::current_exception();
+  }
+  guard.lock();
+  if (--job.busy == 0)
+    finished.notify_all();
+}
+
+
+#endif
@@ -28,7 +28,7 @@ ASSIGN, COMMA, DOT, LPAREN, RPAREN, COLON,
   EQUAL, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL, NOT_EQUAL,
   // reserved words
 
- TYPE, WHILE, FOR, TO, DO, IF, ELSEIF, THEN, ELSE, END, FUN, VAR, RETURN, NEW,
+ TYPE, WHILE, FOR, PARFOR, IN, TO, DO, IF, ELSEIF, THEN, ELSE, END, FUN, VAR, RETURN, NEW,
 
   // primitive types
   BOOL_TYPE, INT_TYPE, DOUBLE_TYPE, CHAR_TYPE, STRING_TYPE, 
@@ -37,7 +37,11 @@ ASSIGN, COMMA, DOT, LPAREN, RPAREN, COLON,
   // end-of-stream
   EOS,
   //Matrices
-  MATRIX_TYPE, R_BRACKET, L_BRACKET,SEMICOLON,MATRIX_VAL
+  MATRIX_TYPE, R_BRACKET, L_BRACKET,SEMICOLON,MATRIX_VAL,
+  //Arrays
+  L_BRACE, R_BRACE,
+  //Modules
+  IMPORT
 };
 
 
@@ -80,8 +84,15 @@ private:
   // the column location of the start of the lexeme (starts at 1)
   int token_column;
 
-  // token type to string representation (for printing)
-  std::map<TokenType,std::string> token_type_map =
+  // token type to string representation (for printing), shared by
+  // all tokens
+  static const std::map<TokenType,std::string>& token_type_map();
+};
+
+
+inline const std::map<TokenType,std::string>& Token::token_type_map()
+{
+  static const std::map<TokenType,std::string> names =
     { // basic symbols
 
       // *** TODO *** 
@@ -99,7 +110,7 @@ private:
       // reserved words
 
       // *** TODO ***
-    {TYPE, "TYPE"}, {WHILE, "WHILE"}, {FOR, "FOR"}, {TO, "TO"}, {DO, "DO"}, {IF, "IF"}, {THEN, "THEN"}, {ELSEIF, "ELSEIF"}, {ELSE, "ELSE"}, {END, "END"}, {FUN, "FUN"}, {VAR, "VAR"}, {RETURN, "RETURN"}, {NEW, "NEW"},
+    {TYPE, "TYPE"}, {WHILE, "WHILE"}, {FOR, "FOR"}, {PARFOR, "PARFOR"}, {IN, "IN"}, {TO, "TO"}, {DO, "DO"}, {IF, "IF"}, {THEN, "THEN"}, {ELSEIF, "ELSEIF"}, {ELSE, "ELSE"}, {END, "END"}, {FUN, "FUN"}, {VAR, "VAR"}, {RETURN, "RETURN"}, {NEW, "NEW"},
 
       // primitive types
       {BOOL_TYPE, "BOOL_TYPE"}, {INT_TYPE, "INT_TYPE"},
@@ -112,52 +123,57 @@ private:
       // eos
       {EOS, "EOS"},
       {MATRIX_TYPE,"MATRIX_TYPE"}, {R_BRACKET,"R_BRACKET"}, {L_BRACKET,"L_BRACKET"},{SEMICOLON,"SEMICOLON"},{MATRIX_VAL,"MATRIX_VAL"},
+      //Arrays
+      {L_BRACE, "L_BRACE"}, {R_BRACE, "R_BRACE"},
       //Dot operations
-       {DOT_MULTIPLY,"DOT_MULTIPLY"}, {DOT_DIVIDE,"DOT_DIVIDE"},{DOT_EXPO,"DOT_EXPO"}, {EXPO,"EXPO"}, {TRANSPOSE, "TRANSPOSE"}
+       {DOT_MULTIPLY,"DOT_MULTIPLY"}, {DOT_DIVIDE,"DOT_DIVIDE"},{DOT_EXPO,"DOT_EXPO"}, {EXPO,"EXPO"}, {TRANSPOSE, "TRANSPOSE"},
+      //Modules
+      {IMPORT, "IMPORT"}
     };
-};
+  return names;
+}
 
 
-Token::Token()
+inline Token::Token()
   : token_type(EOS), token_lexeme(""), token_line(0), token_column(0)
 {
 }
 
 
-Token::Token(TokenType type, const std::string& lexeme, int line, int column)
+inline Token::Token(TokenType type, const std::string& lexeme, int line, int column)
   : token_type(type), token_lexeme(lexeme), token_line(line),
     token_column(column)
 {
 }
 
 
-TokenType Token::type() const
+inline TokenType Token::type() const
 {
   return token_type;
 }
 
 
-std::string Token::lexeme() const
+inline std::string Token::lexeme() const
 {
   return token_lexeme;
 }
 
 
-int Token::line() const
+inline int Token::line() const
 {
   return token_line;
 }
 
 
-int Token::column() const
+inline int Token::column() const
 {
   return token_column;
 }
 
 
-std::string Token::to_string() const
+inline std::string Token::to_string() const
 {
-  return token_type_map.find(token_type)->second +
+  return token_type_map().find(token_type)->second +
     " '" + lexeme() + "' " +
     std::to_string(line()) + ":" + std::to_string(column());
 }
@@ -9,11 +9,29 @@
 #define TYPE_CHECKER_H
 
 #include <iostream>
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include "ast.h"
-#include "symbol_table.h"
+#include "type_table.h"
+#include "builtins.h"
+#include "thread_pool.h"
 
+// Type declarations and function signatures are checked in order first,
+// then the function bodies, each by its own checker and (for larger
+// programs) on the thread pool. A declaration sees only the types and
+// functions declared before it (and itself), and the error reported is
+// the first one in source order.
 class TypeChecker : public Visitor {
 public:
+    TypeChecker();
+    // make the (checked) declarations of an imported module visible to
+    // the program checked next, ahead of its own
+    void link(Program& module);
+    // check a module, which needs no main function
+    void set_module(bool is_module);
     // top-level
     void visit(Program& node);
     void visit(FunDecl& node);
@@ -36,78 +54,350 @@ public:
     void visit(IDRValue& node);
     void visit(NegatedRValue& node);
     void visit(MatrixValue& node);
+    void visit(ArrayValue& node);
     void visit(TransposedRValue& node);
 private:
-    // the symbol table
-    SymbolTable sym_table;
+    // a user-defined function's param types followed by its return type,
+    // and the index of its declaration
+    struct FunSig {std::vector<TypeId> types; int decl;};
+
+    // a built-in's signatures with interned types: the alternatives of
+    // each param type (see match_type) and the return type
+    struct NativeSig {std::vector<std::vector<TypeId>> params; TypeId result;};
+
+    // the tables shared by the checkers of a program's function bodies
+    // (only types are added once the bodies are being checked)
+    struct Globals {
+        TypeTable types;
+        std::unordered_map<std::string, FunSig> functions;
+        std::unordered_map<const NativeFunction*, NativeSig> native_sigs;
+    };
+    std::shared_ptr<Globals> globals;
+    TypeTable& types;
+    std::unordered_map<std::string, FunSig>& functions;
+
+    // a checker for the body of the declaration with the given index
+    TypeChecker(const TypeChecker& program, int decl);
+
+    // index of the declaration being checked
+    int decl = 0;
+
+    // the modules linked in, and whether their declarations (which are
+    // only registered) are being visited
+    std::vector<Program*> modules;
+    bool linking = false;
+    bool is_module = false;
+
+    // the functions whose bodies are left to check, with their indexes
+    std::vector<std::pair<FunDecl*,int>> bodies;
+
+    // below this many statements in all, bodies are checked on the
+    // calling thread alone
+    static constexpr size_t PARALLEL_CHECK_STMTS = 1024;
+
+    // check the collected bodies, throwing the first error in source
+    // order
+    void check_bodies();
+    void check_body(FunDecl& node);
+
+    // a user-defined type or function the declaration being checked can
+    // see (nullptr for a function it cannot)
+    bool is_udt(TypeId type) const;
+    const FunSig* function(const std::string& name) const;
 
     // the previously inferred type
-    std::string curr_type;
+    TypeId curr_type = TYPE_NIL;
+
+    // the variables in scope: the types of each name, innermost last,
+    // with the environment each is declared in (the return type of the
+    // function being checked is the variable "return")
+    struct Var {TypeId type; int env_id;};
+    std::unordered_map<std::string, std::vector<Var>> vars;
+
+    // the names declared in each open environment (innermost last); an
+    // environment's id is its depth
+    std::vector<std::vector<std::string>> environments;
+
+    // open and close an environment
+    void push_environment();
+    void pop_environment();
+    int environment_id() const {return (int)environments.size() - 1;}
+
+    // declare a variable in the current environment
+    void declare(const std::string& name, TypeId type);
 
-    // helper to add built in functions
-    void initialize_built_in_types();
+    // the type of a variable (false if it is not in scope)
+    bool var_type(const std::string& name, TypeId& type) const;
+
+    // id of the environment declaring a variable (-1 if not in scope)
+    int var_environment_id(const std::string& name) const;
+
+    // intern a built-in's signature (done for all of them up front, so
+    // the bodies only look them up)
+    void intern_native_sig(const NativeFunction* native);
+    const NativeSig& native_sig(const NativeFunction* native) const {return globals->native_sigs.at(native);}
+
+    // match an argument type against a built-in's parameter type, which
+    // may use the type variables T, K, and V ("array<T>", "map<K,V>") and
+    // list alternatives ("string|array<T>"); vars holds the variables
+    // bound so far (TYPE_NONE if unbound)
+    typedef TypeId TypeVars[3];
+    bool match_type(const std::vector<TypeId>& param, TypeId arg, TypeVars& vars) const;
+    bool match_one(TypeId param, TypeId arg, TypeVars& vars) const;
+    // a built-in's result type with its type variables replaced
+    TypeId bind_type(TypeId type, const TypeVars& vars);
+
+    // check a call of a built-in, picking the first of its signatures
+    // the arguments match
+    void check_native_call(CallExpr& node, const NativeFunction* native);
+
+    // check the [i] indexes applied to a value of the given type,
+    // returning the indexed element's type
+    TypeId index_type(TypeId type, std::list<Expr*>& indexes);
+
+    // the parfor loops being checked (innermost last), each with the id
+    // of its environment: names from older environments are shared
+    // with the other iterations
+    struct ParallelLoop {ForStmt* node; int env_id;};
+    std::vector<ParallelLoop> parallel_loops;
+
+    // the reduction built-in whose target variable is being checked
+    // (empty otherwise)
+    std::string reduction_target;
+
+    // the counted for loops being checked, each with the id of the
+    // environment holding its loop variable
+    std::vector<std::pair<ForStmt*,int>> counted_loops;
+
+    // record a use of a variable within the enclosing parfor loops,
+    // rejecting writes to shared variables (a reduction names the
+    // built-in combining into the variable)
+    enum SharedUse {SHARED_READ, SHARED_WRITE, SHARED_REDUCE};
+    void shared_use(const Token& id, SharedUse use, const std::string& reduction = "");
+
+    // reject reading an object shared with the other iterations of a
+    // parfor loop (held by a variable declared outside it, or by a
+    // field of one): any use could hand the iteration a reference to
+    // it (in a local, an array, or a function argument) that it could
+    // change. Its primitive fields can still be read, and arrays and
+    // maps of primitive values are copied when changed, so they are safe
+    bool shares_objects(TypeId type) const;
+    void shared_object(IDRValue& node);
 
     // error message
     void error(const std::string& msg, const Token& token);
     void error(const std::string& msg);
 };
 
-void TypeChecker::error(const std::string& msg, const Token& token)
+inline TypeChecker::TypeChecker()
+    : globals(std::make_shared<Globals>()), types(globals->types), functions(globals->functions)
+{
+}
+
+inline TypeChecker::TypeChecker(const TypeChecker& program, int decl)
+    : globals(program.globals), types(globals->types), functions(globals->functions), decl(decl)
+{
+}
+
+inline void TypeChecker::link(Program& module)
+{
+    modules.push_back(&module);
+}
+
+inline void TypeChecker::set_module(bool is_module)
+{
+    this->is_module = is_module;
+}
+
+inline bool TypeChecker::is_udt(TypeId type) const
+{
+    return types.is_udt(type) && types.udt_decl(type) <= decl;
+}
+
+inline const TypeChecker::FunSig* TypeChecker::function(const std::string& name) const
+{
+    auto it = functions.find(name);
+    if (it == functions.end() || it->second.decl > decl)
+        return nullptr;
+    return &it->second;
+}
+
+inline void TypeChecker::error(const std::string& msg, const Token& token)
 {
     throw MyPLException(SEMANTIC, msg, token.line(), token.column());
 }
 
-void TypeChecker::error(const std::string& msg)
+inline void TypeChecker::error(const std::string& msg)
 {
     throw MyPLException(SEMANTIC, msg);
 }
 
-void TypeChecker::initialize_built_in_types()
-{
-    // print function
-    sym_table.add_name("print");
-    sym_table.set_vec_info("print", StringVec{ "string", "nil" });
-    // stoi function
-    sym_table.add_name("stoi");
-    sym_table.set_vec_info("stoi", StringVec{ "string", "int" });
-    //stod
-    sym_table.add_name("stod");
-    sym_table.set_vec_info("stod", StringVec{ "string", "double" });
-    //itos
-    sym_table.add_name("itos");
-    sym_table.set_vec_info("itos", StringVec{ "int", "string" });
-    //dtos
-    sym_table.add_name("dtos");
-    sym_table.set_vec_info("dtos", StringVec{ "double", "string" });
-    //get
-    sym_table.add_name("get");
-    sym_table.set_vec_info("get", StringVec{ "int", "string", "char" });
-    //length
-    sym_table.add_name("length");
-    sym_table.set_vec_info("length", StringVec{ "string", "int" });
-    //read
-    sym_table.add_name("read");
-    sym_table.set_vec_info("read", StringVec{ "nil" });
-    //Print Matrix
-     sym_table.add_name("m_print");
-    sym_table.set_vec_info("m_print",StringVec{"matrix","nil"});
-    
-     sym_table.add_name("m_get");
-     sym_table.set_vec_info("m_get",StringVec{"matrix","int","int","double"});
-     sym_table.add_name("m_singleton");
-     sym_table.set_vec_info("m_singleton",StringVec{"double", "int", "int", "matrix"});
-    
-    
-}
-void TypeChecker::visit(MatrixValue& node) {
+inline void TypeChecker::push_environment()
+{
+    environments.emplace_back();
+}
+
+inline void TypeChecker::pop_environment()
+{
+    for (const std::string& name : environments.back()) {
+        vars[name].pop_back();
+    }
+    environments.pop_back();
+}
+
+inline void TypeChecker::declare(const std::string& name, TypeId type)
+{
+    std::vector<Var>& scopes = vars[name];
+    if (!scopes.empty() && scopes.back().env_id == environment_id()) {
+        scopes.back().type = type;
+        return;
+    }
+    scopes.push_back({type, environment_id()});
+    environments.back().push_back(name);
+}
+
+inline bool TypeChecker::var_type(const std::string& name, TypeId& type) const
+{
+    auto it = vars.find(name);
+    if (it == vars.end() || it->second.empty())
+        return false;
+    type = it->second.back().type;
+    return true;
+}
+
+inline int TypeChecker::var_environment_id(const std::string& name) const
+{
+    auto it = vars.find(name);
+    if (it == vars.end() || it->second.empty())
+        return -1;
+    return it->second.back().env_id;
+}
+
+inline void TypeChecker::shared_use(const Token& id, SharedUse use, const std::string& reduction)
+{
+    const string& name = id.lexeme();
+    int env_id = var_environment_id(name);
+    //a loop whose variable is never assigned keeps it as a plain counter
+    if (use != SHARED_READ) {
+        for (auto& loop : counted_loops) {
+            if (env_id == loop.second && name == loop.first->var_id.lexeme())
+                loop.first->counter_written = true;
+        }
+    }
+    for (ParallelLoop& loop : parallel_loops) {
+        ForStmt& node = *loop.node;
+        if (env_id == loop.env_id && name == node.var_id.lexeme() && use != SHARED_READ)
+            error("cannot assign to parfor variable '" + name + "'", id);
+        // variables declared within the loop are private to an iteration
+        if (env_id < 0 || env_id >= loop.env_id)
+            continue;
+        bool shared = std::find(node.shared.begin(), node.shared.end(), name) != node.shared.end();
+        auto reduced = std::find_if(node.reductions.begin(), node.reductions.end(),
+                                    [&](const std::pair<string,string>& r) {return r.first == name;});
+        if (use == SHARED_WRITE)
+            error("cannot assign to shared variable '" + name + "' in a parfor loop (use a reduction built-in)", id);
+        else if (use == SHARED_READ) {
+            if (reduced != node.reductions.end())
+                error("cannot read reduction variable '" + name + "' in a parfor loop", id);
+            if (!shared)
+                node.shared.push_back(name);
+        }
+        else {
+            if (shared)
+                error("cannot reduce into variable '" + name + "' read in a parfor loop", id);
+            if (reduced == node.reductions.end())
+                node.reductions.push_back({name, reduction});
+            else if (reduced->second != reduction)
+                error("variable '" + name + "' reduced with both " + reduced->second + " and " + reduction, id);
+        }
+    }
+}
+
+inline void TypeChecker::intern_native_sig(const NativeFunction* native)
+{
+    NativeSig sig;
+    for (size_t i = 0; i + 1 < native->type.size(); ++i) {
+        const std::string& param = native->type[i];
+        std::vector<TypeId> alternatives;
+        size_t start = 0;
+        while (start <= param.size()) {
+            size_t bar = param.find('|', start);
+            if (bar == std::string::npos)
+                bar = param.size();
+            alternatives.push_back(types.intern(param.substr(start, bar - start)));
+            start = bar + 1;
+        }
+        sig.params.push_back(alternatives);
+    }
+    sig.result = types.intern(native->type.back());
+    globals->native_sigs[native] = std::move(sig);
+}
+
+inline bool TypeChecker::match_type(const std::vector<TypeId>& param, TypeId arg, TypeVars& vars) const
+{
+    for (TypeId alternative : param) {
+        TypeVars bound = {vars[0], vars[1], vars[2]};
+        if (match_one(alternative, arg, bound)) {
+            std::copy(bound, bound + 3, vars);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool TypeChecker::match_one(TypeId param, TypeId arg, TypeVars& vars) const
+{
+    if (TypeTable::is_type_var(param)) {
+        TypeId& var = vars[param - TYPE_VAR_T];
+        if (var != TYPE_NONE)
+            return var == arg;
+        var = arg;
+        return true;
+    }
+    if (types.is_array(param) && types.is_array(arg))
+        return match_one(types.element(param), types.element(arg), vars);
+    if (types.is_map(param) && types.is_map(arg))
+        return match_one(types.key(param), types.key(arg), vars) && match_one(types.value(param), types.value(arg), vars);
+    return param == arg;
+}
+
+inline TypeId TypeChecker::bind_type(TypeId type, const TypeVars& vars)
+{
+    if (TypeTable::is_type_var(type)) {
+        TypeId var = vars[type - TYPE_VAR_T];
+        return var == TYPE_NONE ? TYPE_NIL : var;
+    }
+    if (types.is_array(type))
+        return types.array_of(bind_type(types.element(type), vars));
+    if (types.is_map(type))
+        return types.map_of(bind_type(types.key(type), vars), bind_type(types.value(type), vars));
+    return type;
+}
+
+inline TypeId TypeChecker::index_type(TypeId type, std::list<Expr*>& indexes)
+{
+    for (Expr* index : indexes) {
+        if (!types.is_array(type)) {
+            error("indexing a value that is not an array", index->first_token());
+        }
+        index->accept(*this);
+        if (curr_type != TYPE_INT) {
+            error("expecting \'int\' array index", index->first_token());
+        }
+        type = types.element(type);
+    }
+    return type;
+}
+
+inline void TypeChecker::visit(MatrixValue& node) {
 
 for (int row = 0; row < node.M.size(); row++) {
-	
+
 	for (int column = 0; column < node.M.at(row).size();column++) {
 		node.M.at(row).at(column)->accept(*this);
-		if (curr_type != "double") {
+		if (curr_type != TYPE_DOUBLE) {
 		error("Matrix needs to be of all double types",node.first_bracket);
-		
+
 		}
 
 
@@ -118,127 +408,197 @@ for (int row = 0; row < node.M.size(); row++) {
 
 }
 
-curr_type = "matrix";
+curr_type = TYPE_MATRIX;
 
 }
 
 
 
-void TypeChecker::visit(Program& node)
+inline void TypeChecker::visit(Program& node)
 {
-    // push the global environment
-    sym_table.push_environment();
-    // add built-in functions
-    initialize_built_in_types();
-    // push
-    for (Decl* d : node.decls)
-        d->accept(*this);
+    for (const NativeFunction* native : BuiltinRegistry::instance().functions()) {
+        for (const NativeFunction* f = native; f; f = f->overload)
+            intern_native_sig(f);
+    }
+    // push the global environment (built-in functions are looked up in
+    // the native registry)
+    push_environment();
+    // the linked modules' types and signatures come first
+    linking = true;
+    for (Program* module : modules) {
+        for (Decl* d : module->decls) {
+            d->accept(*this);
+            ++decl;
+        }
+    }
+    linking = false;
+    // types and signatures, up to the first declaration with an error
+    std::exception_ptr decl_error;
+    for (Decl* d : node.decls) {
+        try {
+            d->accept(*this);
+        }
+        catch (...) {
+            decl_error = std::current_exception();
+            break;
+        }
+        ++decl;
+    }
+    // the bodies before it come first
+    check_bodies();
+    if (decl_error) {
+        std::rethrow_exception(decl_error);
+    }
     // check for a main function
-    if (sym_table.name_exists("main") and sym_table.has_vec_info("main")) {
-        StringVec the_type;
-        sym_table.get_vec_info("main", the_type);
-        if (the_type[the_type.size() - 1] != "int") {
+    auto main_fun = functions.find("main");
+    if (main_fun != functions.end()) {
+        if (main_fun->second.types.back() != TYPE_INT) {
             error("Incorrect main function signature");
         }
-      
+
     }
-    else {
-    
+    //modules need not have one
+    else if (!is_module) {
+
         error("undefined 'main' function");
     }
     // pop the global environment
-    sym_table.pop_environment();
+    pop_environment();
 }
 
+inline void TypeChecker::check_bodies()
+{
+    auto check = [this](size_t i) {
+        TypeChecker body(*this, bodies[i].second);
+        body.check_body(*bodies[i].first);
+    };
+    size_t stmts = 0;
+    for (auto& body : bodies) {
+        stmts += body.first->stmts.size();
+    }
+    if (bodies.size() > 1 && stmts >= PARALLEL_CHECK_STMTS) {
+        //the pool rethrows the error of the earliest body
+        ThreadPool::instance().run(bodies.size(), check);
+    }
+    else {
+        for (size_t i = 0; i < bodies.size(); ++i)
+            check(i);
+    }
+}
 
-void TypeChecker::visit(FunDecl& node)
+
+inline void TypeChecker::visit(FunDecl& node)
 {
 //We ensure that the function is not previously defined
-    if (sym_table.has_vec_info(node.id.lexeme())) {
+    if (function(node.id.lexeme()) || BuiltinRegistry::instance().find(node.id.lexeme())) {
         error("Previously declared function", node.id);
     }
     //Extract param types
-    StringVec the_type;
+    std::vector<TypeId> the_type;
     for (FunDecl::FunParam iter : node.params) {
-        the_type.push_back(iter.type.lexeme());
+        the_type.push_back(types.intern(iter.type.lexeme()));
+    }
+
+    the_type.push_back(types.intern(node.return_type.lexeme()));
+    functions[node.id.lexeme()] = {the_type, decl};
+    if (!linking) {
+        bodies.push_back({&node, decl});
     }
-    
-    the_type.push_back(node.return_type.lexeme());
-    sym_table.add_name(node.id.lexeme());
-    sym_table.set_vec_info(node.id.lexeme(), the_type);
+}
+
+inline void TypeChecker::check_body(FunDecl& node)
+{
+    node.read_body();
     //Params and body
-    if (!sym_table.has_vec_info(node.id.lexeme())) {
-        error("No matching function for id", node.id);
-    }
-    
-    StringVec second_type;
-    sym_table.get_vec_info(node.id.lexeme(), second_type);
-    string return_type = second_type[second_type.size() - 1];
-    sym_table.push_environment();
-    sym_table.add_name("return");
-    sym_table.set_str_info("return", return_type);
+    push_environment();
+    declare("return", types.intern(node.return_type.lexeme()));
     //Check for duplicate param types
     for (FunDecl::FunParam iter : node.params) {
-        if (sym_table.has_str_info(iter.id.lexeme())) {
+        TypeId existing;
+        if (var_type(iter.id.lexeme(), existing)) {
             error("duplicate types", iter.id);
         }
-        
-        sym_table.add_name(iter.id.lexeme());
-        sym_table.set_str_info(iter.id.lexeme(), iter.type.lexeme());
+
+        declare(iter.id.lexeme(), types.intern(iter.type.lexeme()));
     }
     //Function body
     for (Stmt* iter : node.stmts) {
         iter->accept(*this);
     }
-    sym_table.pop_environment();
+    pop_environment();
 }
 
-void TypeChecker::visit(TypeDecl& node)
+inline void TypeChecker::visit(TypeDecl& node)
 {
 //Check for type redeclaration
-if (sym_table.has_map_info(node.id.lexeme())) {
+TypeId udt = types.intern(node.id.lexeme());
+if (types.is_udt(udt)) {
 error("Type redeclaration",node.id);
 
 }
-    sym_table.add_name(node.id.lexeme());
-    StringMap the_type;
-    sym_table.push_environment();
+    types.declare_udt(udt, decl);
+    std::vector<TypeTable::Field> the_type;
+    //a linked type's fields were checked with its module
+    if (linking) {
+        for (VarDeclStmt* iter : node.vdecls) {
+            const std::string& name = iter->type ? iter->type->lexeme() : iter->expr->type;
+            the_type.push_back({iter->id.lexeme(), types.intern(name)});
+        }
+        types.set_fields(udt, std::move(the_type));
+        return;
+    }
+    push_environment();
     //member variables
     for (VarDeclStmt* iter : node.vdecls) {
         iter->accept(*this);
-        the_type[iter->id.lexeme()] = curr_type;
+        the_type.push_back({iter->id.lexeme(), curr_type});
+    }
+    pop_environment();
+    types.set_fields(udt, std::move(the_type));
+}
+inline bool TypeChecker::shares_objects(TypeId type) const
+{
+    if (types.is_array(type))
+        return shares_objects(types.element(type));
+    if (types.is_map(type))
+        return shares_objects(types.value(type));
+    return types.is_udt(type);
+}
+
+inline void TypeChecker::shared_object(IDRValue& node)
+{
+    const Token& id = node.path.front();
+    if (parallel_loops.empty() || !shares_objects(curr_type))
+        return;
+    int env_id = var_environment_id(id.lexeme());
+    if (env_id >= 0 && env_id < parallel_loops.back().env_id) {
+        std::string name;
+        for (const Token& t : node.path)
+            name += (name.empty() ? "" : ".") + t.lexeme();
+        error("cannot use shared object '" + name + "' in a parfor loop (only its fields can be read)", id);
     }
-    sym_table.pop_environment();
-    sym_table.set_map_info(node.id.lexeme(), the_type);
 }
+
 // statements
-void TypeChecker::visit(VarDeclStmt& node)
+inline void TypeChecker::visit(VarDeclStmt& node)
 {
     node.expr->accept(*this);
-    string exp_type = curr_type;
-    string var_name = node.id.lexeme();
+    TypeId exp_type = curr_type;
+    const string& var_name = node.id.lexeme();
     //Shadowing
-    if (sym_table.has_str_info(var_name) && sym_table.name_exists_in_curr_env(var_name)) {
+    if (var_environment_id(var_name) == environment_id()) {
         error("variable \'" + var_name + "\' redefined in current scope", node.id);
     }
-    sym_table.add_name(var_name);
-    string lhs_type;
-    if (node.type == nullptr) {
-        lhs_type = "nul";
-    }
-    else {
-        lhs_type = node.type->lexeme();
-    }
     //Checking for flexible type declaration
-    if (lhs_type == "nul") {
-        sym_table.set_str_info(var_name, exp_type);
+    if (node.type == nullptr) {
+        declare(var_name, exp_type);
         curr_type = exp_type;
     }
     //Type checking
     else {
-        if (lhs_type == exp_type || exp_type == "nil") {
-            sym_table.add_name(var_name);
-            sym_table.set_str_info(var_name, lhs_type);
+        TypeId lhs_type = types.intern(node.type->lexeme());
+        if (lhs_type == exp_type || exp_type == TYPE_NIL) {
+            declare(var_name, lhs_type);
             curr_type = lhs_type;
         }
         else {
@@ -247,52 +607,30 @@ void TypeChecker::visit(VarDeclStmt& node)
     }
 }
 
-void TypeChecker::visit(AssignStmt& node)
+inline void TypeChecker::visit(AssignStmt& node)
 {
 
     node.expr->accept(*this);
-    string rhs_type = curr_type;
-    string lhs_type;
-    //check to see if we have str info
-    if (!sym_table.has_str_info(node.lvalue_list.front().lexeme())) {
+    shared_use(node.lvalue_list.front(), SHARED_WRITE);
+    TypeId rhs_type = curr_type;
+    TypeId lhs_type;
+    //check to see if we have the variable's type
+    if (!var_type(node.lvalue_list.front().lexeme(), lhs_type)) {
         error("ID does not exist: \'" + node.lvalue_list.front().lexeme(), node.lvalue_list.front());
     }
-    //If the lvalue is not a udt, 
-    if (node.lvalue_list.size() == 1) {
-        if (!sym_table.has_str_info(node.lvalue_list.front().lexeme())) {
-            error("ID does not exist901", node.lvalue_list.front());
-        }
-        else {
-            sym_table.get_str_info(node.lvalue_list.front().lexeme(), lhs_type);
-        }
-    }
-    else {
-    //When we have a udt
-        StringMap prev_type_udt;
-        string the_name;
-        string the_type;
-        the_name = node.lvalue_list.front().lexeme();
-        //if id doesn\t have type info
-        if (!sym_table.has_str_info(the_name)) {
-            error("ID does not exist5", node.lvalue_list.front());
-        }
-        sym_table.get_str_info(the_name, the_type);
+    //If the lvalue is a udt, follow the path
+    if (node.lvalue_list.size() > 1) {
+        TypeId the_type = lhs_type;
         //Ensures that our lvalue sequence is actually a udt
-        if (!sym_table.has_map_info(the_type)) {
+        if (!is_udt(the_type)) {
             error("Type doesn't exist3", node.lvalue_list.front());
         }
-        sym_table.get_map_info(the_type, prev_type_udt);
         int inter = 0;
         //Go through lvalue list and check
-        for (Token iter : node.lvalue_list) {
+        for (const Token& iter : node.lvalue_list) {
             if (inter != 0 && inter < node.lvalue_list.size() - 1) {
-                if (prev_type_udt.count(iter.lexeme()) > 0) {
-                    the_type = prev_type_udt[iter.lexeme()];
-                    the_name = iter.lexeme();
-                    if (sym_table.has_map_info(the_type)) {
-                        sym_table.get_map_info(the_type, prev_type_udt);
-                    }
-                    else {
+                if (types.field_type(the_type, iter.lexeme(), the_type)) {
+                    if (!is_udt(the_type)) {
                     //Error when we try to access a member variable which does not exist
                         error("Variable not a user-defined type", node.lvalue_list.front());
                     }
@@ -303,27 +641,33 @@ void TypeChecker::visit(AssignStmt& node)
             }
             inter++;
         }
-        lhs_type = prev_type_udt[node.lvalue_list.back().lexeme()];
+        lhs_type = TYPE_NONE;
+        types.field_type(the_type, node.lvalue_list.back().lexeme(), lhs_type);
     }
-    if (rhs_type != lhs_type && rhs_type != "nil") {
+    //Assigning an array element
+    lhs_type = index_type(lhs_type, node.indexes);
+    if (rhs_type != lhs_type && rhs_type != TYPE_NIL) {
         error("Mismatched types in assignment", node.lvalue_list.front());
     }
 }
-void TypeChecker::visit(ReturnStmt& node)
+inline void TypeChecker::visit(ReturnStmt& node)
 {
+    //Iterations of a parfor loop cannot return from the function
+    if (!parallel_loops.empty()) {
+        error("return not allowed in a parfor loop", node.expr->first_token());
+    }
 //Grab the expression type in after return token
     node.expr->accept(*this);
-    string the_type;
-    if (sym_table.has_str_info("return")) {
-        sym_table.get_str_info("return", the_type);
-        if (the_type == "nil") {
+    TypeId the_type;
+    if (var_type("return", the_type)) {
+        if (the_type == TYPE_NIL) {
             if (the_type != curr_type) {
             	//we cannot return anything but nil to a nil return type
                 error("invalid return expression type", node.expr->first_token());
             }
         }
         //We cannot return mismatched types unless the return type is nil
-        else if (the_type != curr_type && curr_type != "nil") {
+        else if (the_type != curr_type && curr_type != TYPE_NIL) {
             error("invalid return expression type", node.expr->first_token());
         }
     }
@@ -332,98 +676,120 @@ void TypeChecker::visit(ReturnStmt& node)
     }
 }
 
-void TypeChecker::visit(IfStmt& node)
+inline void TypeChecker::visit(IfStmt& node)
 {
 //If if does not exist but we still have else ifs statements, there is a problem
     if (node.if_part == nullptr && (node.else_ifs.size() > 0)) {
         error("else if declared without previous if", node.else_ifs.front()->expr->first_token());
     }
-    
+
     else if (node.if_part == nullptr && (node.else_ifs.size() > 0)) {
         error("else declared without previous if");
     }
     //Checks if expression for bool
     node.if_part->expr->accept(*this);
-    if (curr_type != "bool") {
+    if (curr_type != TYPE_BOOL) {
         error("Expected bool in if expression", node.if_part->expr->first_token());
     }
-    sym_table.push_environment();
+    push_environment();
     for (Stmt* iter2 : node.if_part->stmts) {
         iter2->accept(*this);
     }
-    sym_table.pop_environment();
+    pop_environment();
 
     if (node.else_ifs.size() != 0) {
         for (BasicIf* iter : node.else_ifs) {
             iter->expr->accept(*this);
-            if (curr_type != "bool") {
+            if (curr_type != TYPE_BOOL) {
                 error("expecting bool", iter->expr->first_token());
             }
-            sym_table.push_environment();
-            list<Stmt*> mango_stmt = iter->stmts;
-            for (Stmt* iter2 : mango_stmt) {
+            push_environment();
+            for (Stmt* iter2 : iter->stmts) {
                 iter2->accept(*this);
             }
-            sym_table.pop_environment();
+            pop_environment();
         }
     }
-    sym_table.push_environment();
+    push_environment();
     if (node.body_stmts.size() != 0) {
         for (Stmt* iter2 : node.body_stmts) {
             iter2->accept(*this);
         }
     }
-    sym_table.pop_environment();
+    pop_environment();
 }
-void TypeChecker::visit(WhileStmt& node)
+inline void TypeChecker::visit(WhileStmt& node)
 {
     if (node.expr == nullptr) {
         error("expecting while condition");
     }
     //Checks while expression for bool
     node.expr->accept(*this);
-    if (curr_type != "bool") {
+    if (curr_type != TYPE_BOOL) {
         error("Expecting bool expression", node.expr->first_token());
     }
-    sym_table.push_environment();
+    push_environment();
     for (Stmt* iter : node.stmts) {
         iter->accept(*this);
     }
-    sym_table.pop_environment();
+    pop_environment();
 }
 
-void TypeChecker::visit(ForStmt& node)
+inline void TypeChecker::visit(ForStmt& node)
 {
 
-    sym_table.push_environment();
-    sym_table.add_name(node.var_id.lexeme());
-    sym_table.set_str_info(node.var_id.lexeme(), "int");
+    push_environment();
+    //for x in xs: x takes each element (xs cannot see x)
+    if (node.each) {
+        node.start->accept(*this);
+        if (!types.is_array(curr_type)) {
+            error("expecting an array in for-in loop", node.start->first_token());
+        }
+        declare(node.var_id.lexeme(), types.element(curr_type));
+        for (Stmt* iter : node.stmts) {
+            iter->accept(*this);
+        }
+        pop_environment();
+        return;
+    }
+    declare(node.var_id.lexeme(), TYPE_INT);
     node.start->accept(*this);
     //Ensures that x start condition is int
-    if (curr_type != "int") {
+    if (curr_type != TYPE_INT) {
         error("expecting \'int\' in start expression", node.start->first_token());
     }
     node.end->accept(*this);
     //Ensures that x end condition is int
-    if (curr_type != "int") {
+    if (curr_type != TYPE_INT) {
         error("expecting \'int\' in end expression", node.end->first_token());
     }
 
-    //Body statements
+    //Body statements (a parfor body runs in its own frame per iteration)
+    if (node.parallel) {
+        node.shared.clear();
+        node.reductions.clear();
+        parallel_loops.push_back({&node, environment_id()});
+    }
+    node.counter_written = false;
+    counted_loops.push_back({&node, environment_id()});
     for (Stmt* iter : node.stmts) {
         iter->accept(*this);
     }
-    sym_table.pop_environment();
+    counted_loops.pop_back();
+    if (node.parallel) {
+        parallel_loops.pop_back();
+    }
+    pop_environment();
 }
 // expressions
-void TypeChecker::visit(Expr& node)
+inline void TypeChecker::visit(Expr& node)
 {
 //Checks for missing expr parts
     if (node.first != nullptr) {
         node.first->accept(*this);
     }
     //Right hand side is first expr
-    string rhs_type = curr_type;
+    TypeId rhs_type = curr_type;
     if (node.rest != nullptr) {
         node.rest->accept(*this);
     }
@@ -431,149 +797,148 @@ void TypeChecker::visit(Expr& node)
     if (node.op != nullptr) {
         Token* op = node.op;
         if (node.op->lexeme() == "%") {
-       
-            if (curr_type == "int" && rhs_type == "int") {
-                curr_type = "int";
+
+            if (curr_type == TYPE_INT && rhs_type == TYPE_INT) {
+                curr_type = TYPE_INT;
             }
-            else if (curr_type == "int" && rhs_type == "matrix") {
-           
-            curr_type = "matrix";
+            else if (curr_type == TYPE_INT && rhs_type == TYPE_MATRIX) {
+
+            curr_type = TYPE_MATRIX;
             }
             else {
                 error("incorrect modulo", node.first_token());
             }
         }
         else if ((node.op->lexeme() == ".*" || node.op->lexeme() == "./" || node.op->lexeme() == ".^")) {
-        	
-        	
-        	if (curr_type == "matrix" && rhs_type == "matrix") {
-        	curr_type = "matrix";
-        	
+
+
+        	if (curr_type == TYPE_MATRIX && rhs_type == TYPE_MATRIX) {
+        	curr_type = TYPE_MATRIX;
+
         	}
         	else {
         	error("Expecting matrix values",node.first_token());
-        	
+
         	}
 
-        	
-        
+
+
         }
-        
 
-        	
-        
+
+
+
         else if (node.op->lexeme() == "^") {
-       	 if (curr_type == "int" && rhs_type == "matrix") {
-        	curr_type = "matrix";
-        
-        
+       	 if (curr_type == TYPE_INT && rhs_type == TYPE_MATRIX) {
+        	curr_type = TYPE_MATRIX;
+
+
        	 }
-        	else if (curr_type == "int" && rhs_type == "int") {
-        	curr_type == "int";
-        	
+        	else if (curr_type == TYPE_INT && rhs_type == TYPE_INT) {
+
         	}
-        	else if (curr_type == "int" && rhs_type == "double") {
-        	curr_type == "double";
-        	
+        	else if (curr_type == TYPE_INT && rhs_type == TYPE_DOUBLE) {
+
         	}
         	else {
         	error("Improper use of '^'", node.first_token());
-        	
+
         	}
         }
-        else if ((node.op->lexeme() == "-" || node.op->lexeme() == "*" || node.op->lexeme() == "/") && (rhs_type == "char" || curr_type == "char" || rhs_type == "string" || curr_type == "string")) {
+        else if ((node.op->lexeme() == "-" || node.op->lexeme() == "*" || node.op->lexeme() == "/") && (rhs_type == TYPE_CHAR || curr_type == TYPE_CHAR || rhs_type == TYPE_STRING || curr_type == TYPE_STRING)) {
             error("mismatched types", node.first_token());
         }
-        else if ((node.op->lexeme() == "+" || node.op->lexeme() == "-" || node.op->lexeme() == "*" || node.op->lexeme() == "/") && (curr_type != "char" && rhs_type != "char" && curr_type != "string" && rhs_type != "string")) {
-            if (curr_type == "int" && rhs_type == "int") {
-                curr_type = "int";
+        else if ((node.op->lexeme() == "+" || node.op->lexeme() == "-" || node.op->lexeme() == "*" || node.op->lexeme() == "/") && (curr_type != TYPE_CHAR && rhs_type != TYPE_CHAR && curr_type != TYPE_STRING && rhs_type != TYPE_STRING)) {
+            if (curr_type == TYPE_INT && rhs_type == TYPE_INT) {
+                curr_type = TYPE_INT;
             }
-            else if (curr_type == "double" && rhs_type == "double") {
-                curr_type = "double";
+            else if (curr_type == TYPE_DOUBLE && rhs_type == TYPE_DOUBLE) {
+                curr_type = TYPE_DOUBLE;
             }
-             else if (curr_type == "matrix" && rhs_type == "matrix") {
-            curr_type = "matrix";
-            
+             else if (curr_type == TYPE_MATRIX && rhs_type == TYPE_MATRIX) {
+            curr_type = TYPE_MATRIX;
+
             }
-             else if (curr_type == "matrix" && (rhs_type == "double" ||rhs_type == "int") && node.op->lexeme() == "*") {
-            curr_type = "matrix";
-            
+             else if (curr_type == TYPE_MATRIX && (rhs_type == TYPE_DOUBLE ||rhs_type == TYPE_INT) && node.op->lexeme() == "*") {
+            curr_type = TYPE_MATRIX;
+
             }
-             else if (rhs_type == "matrix" && (curr_type == "double" || curr_type == "int") && node.op->lexeme() == "*") {
-            curr_type = "matrix";
-            
+             else if (rhs_type == TYPE_MATRIX && (curr_type == TYPE_DOUBLE || curr_type == TYPE_INT) && node.op->lexeme() == "*") {
+            curr_type = TYPE_MATRIX;
+
             }
-            
-             else if (rhs_type == "matrix" && (curr_type == "double" || curr_type == "int") && node.op->lexeme() == "/") {
-            curr_type = "matrix";
-            
+
+             else if (rhs_type == TYPE_MATRIX && (curr_type == TYPE_DOUBLE || curr_type == TYPE_INT) && node.op->lexeme() == "/") {
+            curr_type = TYPE_MATRIX;
+
             }
             else {
                 error("incorrect math operation", node.first_token());
             }
         }
-        
+
         else if (node.op->lexeme() == "+") {
-            if ((curr_type == "char" || curr_type == "string") && (rhs_type == "char" || rhs_type == "string")) {
-                curr_type = "string";
+            if ((curr_type == TYPE_CHAR || curr_type == TYPE_STRING) && (rhs_type == TYPE_CHAR || rhs_type == TYPE_STRING)) {
+                curr_type = TYPE_STRING;
             }
-           
+
             else {
                 error("mismatched types in " + op->lexeme(), node.first_token());
             }
         }
         else if (node.op->lexeme() == "not") {
-            if (curr_type == "bool" && rhs_type == "DNE") {
-                curr_type == "bool";
+            if (curr_type == TYPE_BOOL && types.name(rhs_type) == "DNE") {
             }
             else {
                 error("expecting bool", node.first_token());
             }
         }
         else if (node.op->lexeme() == "and") {
-            if (curr_type == "bool" && rhs_type == "bool") {
-                curr_type == "bool";
+            if (curr_type == TYPE_BOOL && rhs_type == TYPE_BOOL) {
             }
             else {
                 error("expecting boolean", node.first_token());
             }
         }
         else if (node.op->lexeme() == "or") {
-            if (curr_type == "bool" && rhs_type == "bool") {
-                curr_type == "bool";
+            if (curr_type == TYPE_BOOL && rhs_type == TYPE_BOOL) {
             }
             else {
                 error("expecting boolean", node.first_token());
             }
         }
         else if (node.op->lexeme() == "==" || node.op->lexeme() == "!=") {
-            if (curr_type == "nil" && rhs_type == "nil") {
-                curr_type = "bool";
+            if (curr_type == TYPE_NIL && rhs_type == TYPE_NIL) {
+                curr_type = TYPE_BOOL;
+            }
+            else if ((curr_type == TYPE_STRING || curr_type == TYPE_NIL) && (rhs_type == TYPE_STRING || rhs_type == TYPE_NIL)) {
+                curr_type = TYPE_BOOL;
             }
-            else if ((curr_type == "string" || curr_type == "nil") && (rhs_type == "string" || rhs_type == "nil")) {
-                curr_type = "bool";
+            else if ((curr_type == TYPE_INT || curr_type == TYPE_NIL) && (rhs_type == TYPE_INT || rhs_type == TYPE_NIL)) {
+                curr_type = TYPE_BOOL;
             }
-            else if ((curr_type == "int" || curr_type == "nil") && (rhs_type == "int" || rhs_type == "nil")) {
-                curr_type = "bool";
+            else if ((curr_type == TYPE_CHAR || curr_type == TYPE_NIL) && (rhs_type == TYPE_CHAR || rhs_type == TYPE_NIL)) {
+                curr_type = TYPE_BOOL;
             }
-            else if ((curr_type == "char" || curr_type == "nil") && (rhs_type == "char" || rhs_type == "nil")) {
-                curr_type = "bool";
+            else if ((curr_type == TYPE_BOOL || curr_type == TYPE_NIL) && (rhs_type == TYPE_BOOL || rhs_type == TYPE_NIL)) {
+                curr_type = TYPE_BOOL;
             }
-            else if ((curr_type == "bool" || curr_type == "nil") && (rhs_type == "bool" || rhs_type == "nil")) {
-                curr_type = "bool";
+            else if ((curr_type == TYPE_DOUBLE || curr_type == TYPE_NIL) && (rhs_type == TYPE_DOUBLE || rhs_type == TYPE_NIL)) {
+                curr_type = TYPE_BOOL;
             }
-            else if ((curr_type == "double" || curr_type == "nil") && (rhs_type == "double" || rhs_type == "nil")) {
-                curr_type = "bool";
+            //arrays and maps only compare with nil
+            else if (((types.is_array(curr_type) || types.is_map(curr_type)) && rhs_type == TYPE_NIL) || (curr_type == TYPE_NIL && (types.is_array(rhs_type) || types.is_map(rhs_type)))) {
+                curr_type = TYPE_BOOL;
             }
-            else if (sym_table.has_map_info(curr_type) || sym_table.has_map_info(rhs_type)) {
-                if (sym_table.has_map_info(curr_type) && sym_table.has_map_info(rhs_type) && curr_type == rhs_type) {
-                    curr_type = "bool";
+            else if (is_udt(curr_type) || is_udt(rhs_type)) {
+                if (is_udt(curr_type) && is_udt(rhs_type) && curr_type == rhs_type) {
+                    curr_type = TYPE_BOOL;
                 }
-                else if (sym_table.has_map_info(curr_type) && rhs_type == "nil") {
-                    curr_type = "bool";
+                else if (is_udt(curr_type) && rhs_type == TYPE_NIL) {
+                    curr_type = TYPE_BOOL;
                 }
-                else if (sym_table.has_map_info(rhs_type) && curr_type == "nil") {
-                    curr_type = "bool";
+                else if (is_udt(rhs_type) && curr_type == TYPE_NIL) {
+                    curr_type = TYPE_BOOL;
                 }
                 else {
                     error("incorrect use of equality" + node.op->lexeme(), node.first_token());
@@ -585,8 +950,8 @@ void TypeChecker::visit(Expr& node)
         }
         //More type checking rules for equality comparison
         else if (node.op->lexeme() == "<" || node.op->lexeme() == "<=" || node.op->lexeme() == ">" || node.op->lexeme() == ">=") {
-            if ((curr_type == "string" && rhs_type == "string") || (curr_type == "int" && rhs_type == "int") || (curr_type == "char" && rhs_type == "char") || (curr_type == "double" && rhs_type == "double")) {
-                curr_type = "bool";
+            if ((curr_type == TYPE_STRING && rhs_type == TYPE_STRING) || (curr_type == TYPE_INT && rhs_type == TYPE_INT) || (curr_type == TYPE_CHAR && rhs_type == TYPE_CHAR) || (curr_type == TYPE_DOUBLE && rhs_type == TYPE_DOUBLE)) {
+                curr_type = TYPE_BOOL;
             }
             else {
                 error("mismatched types", node.first_token());
@@ -595,67 +960,84 @@ void TypeChecker::visit(Expr& node)
     }
     //We want our expr type that we are negating to be bool
     if (node.negated == true) {
-        if (curr_type == "bool") {
+        if (curr_type == TYPE_BOOL) {
         }
         else {
             error("expecting bool expression", node.first_token());
         }
     }
+    node.type = types.name(curr_type);
 }
 //Nothing to type check in simple term
-void TypeChecker::visit(SimpleTerm& node)
+inline void TypeChecker::visit(SimpleTerm& node)
 {
     node.rvalue->accept(*this);
     //HERE
 }
-void TypeChecker::visit(ComplexTerm& node)
+inline void TypeChecker::visit(ComplexTerm& node)
 {
     node.expr->accept(*this);
 }
 
 // assign curr_type to new r value rvalues
-void TypeChecker::visit(SimpleRValue& node)
+inline void TypeChecker::visit(SimpleRValue& node)
 {
 //sets curr type to whichever rvalue
     if (node.value.type() == CHAR_VAL) {
-        curr_type = "char";
+        curr_type = TYPE_CHAR;
     }
     else if (node.value.type() == STRING_VAL) {
-        curr_type = "string";
+        curr_type = TYPE_STRING;
     }
     else if (node.value.type() == INT_VAL) {
-        curr_type = "int";
+        curr_type = TYPE_INT;
     }
     else if (node.value.type() == BOOL_VAL) {
-        curr_type = "bool";
+        curr_type = TYPE_BOOL;
     }
     else if (node.value.type() == DOUBLE_VAL) {
-        curr_type = "double";
+        curr_type = TYPE_DOUBLE;
     }
     else if (node.value.type() == NIL) {
-        curr_type = "nil";
+        curr_type = TYPE_NIL;
     }
 }
 
-void TypeChecker::visit(NewRValue& node)
+inline void TypeChecker::visit(NewRValue& node)
 {
-    if (sym_table.has_map_info(node.type_id.lexeme()) || sym_table.name_exists(node.type_id.lexeme())) {
-        curr_type = node.type_id.lexeme();
+    const string& name = node.type_id.lexeme();
+    TypeId type = types.intern(name);
+    TypeId existing;
+    if (types.is_map(type)) {
+        //map keys are hashed by value
+        TypeId key = types.key(type);
+        if (key != TYPE_INT && key != TYPE_DOUBLE && key != TYPE_BOOL && key != TYPE_CHAR && key != TYPE_STRING) {
+            error("map key type must be int, double, bool, char, or string", node.type_id);
+        }
+        curr_type = type;
+    }
+    else if (is_udt(type) || types.is_array(type) || var_type(name, existing) || function(name) || BuiltinRegistry::instance().find(name)) {
+        curr_type = type;
     }
     else {
         error("Undeclared Type", node.type_id);
     }
 }
 //Type checks call expressions
-void TypeChecker::visit(CallExpr& node)
+inline void TypeChecker::visit(CallExpr& node)
 {
-    string fun_name = node.function_id.lexeme();
-    StringVec fun_type;
-    sym_table.get_vec_info(fun_name, fun_type);
+    const string& fun_name = node.function_id.lexeme();
+    const NativeFunction* native = BuiltinRegistry::instance().find(fun_name);
+    if (native) {
+        check_native_call(node, native);
+        return;
+    }
     //ensures that the function exists
-    if (sym_table.has_vec_info(fun_name) == false) {
+    const FunSig* fun = function(fun_name);
+    if (!fun) {
         error("function id not found", node.function_id);
     }
+    const std::vector<TypeId>& fun_type = fun->types;
     if (fun_type.size() == 1 && node.arg_list.size() == 0) {
         curr_type = fun_type[fun_type.size() - 1];
     }
@@ -673,7 +1055,7 @@ void TypeChecker::visit(CallExpr& node)
         for (Expr* iter : node.arg_list) {
             if (iterator < fun_type.size() - 1) {
                 iter->accept(*this);
-                if (curr_type != fun_type.at(iterator) && curr_type != "nil") {
+                if (curr_type != fun_type.at(iterator) && curr_type != TYPE_NIL) {
                     error("Mismatched types in function call,", iter->first_token());
                 }
             }
@@ -683,48 +1065,89 @@ void TypeChecker::visit(CallExpr& node)
     }
 }
 
-void TypeChecker::visit(IDRValue& node)
+inline void TypeChecker::check_native_call(CallExpr& node, const NativeFunction* native)
 {
-    StringMap prev_type_udt;
-    string the_name;
-    string the_type;
+    //some signature must take this many arguments (the first one's count
+    //is reported otherwise)
+    const NativeFunction* sig = native;
+    while (sig && sig->type.size() - 1 != node.arg_list.size()) {
+        sig = sig->overload;
+    }
+    if (!sig && native->type.size() - 1 < node.arg_list.size()) {
+        error("Too many arguments in function call at " + node.function_id.to_string());
+    }
+    else if (!sig) {
+        error("Too few arguments in function call at " + node.function_id.to_string());
+    }
+    //in-place built-ins update their first argument, so it must be a variable
+    //or a field (reductions take a variable)
+    if (native->in_place) {
+        IDRValue* var = node.arg_list.front()->id_rvalue();
+        if (!var || !var->indexes.empty() || (native->reduction && var->path.size() != 1))
+            error("expecting a variable as the first argument", node.arg_list.front()->first_token());
+        if (!native->reduction)
+            shared_use(var->path.front(), SHARED_WRITE);
+    }
+    std::vector<TypeId> arg_types;
+    for (Expr* iter : node.arg_list) {
+        if (arg_types.empty() && native->reduction)
+            reduction_target = node.function_id.lexeme();
+        iter->accept(*this);
+        reduction_target = "";
+        arg_types.push_back(curr_type);
+    }
+    //the first signature (with this many params) the argument types match
+    int overload = 0;
+    for (const NativeFunction* f = native; f; f = f->overload, ++overload) {
+        const NativeSig& f_sig = native_sig(f);
+        if (f_sig.params.size() != arg_types.size())
+            continue;
+        TypeVars vars = {TYPE_NONE, TYPE_NONE, TYPE_NONE};
+        size_t i = 0;
+        while (i < arg_types.size() && (arg_types[i] == TYPE_NIL || match_type(f_sig.params[i], arg_types[i], vars)))
+            ++i;
+        if (i == arg_types.size()) {
+            node.overload = overload;
+            curr_type = bind_type(f_sig.result, vars);
+            return;
+        }
+    }
+    //report the first mismatch against the first signature that fits
+    const NativeSig& first_sig = native_sig(sig);
+    TypeVars vars = {TYPE_NONE, TYPE_NONE, TYPE_NONE};
+    auto iter = node.arg_list.begin();
+    for (size_t i = 0; i < arg_types.size(); ++i, ++iter) {
+        if (arg_types[i] != TYPE_NIL && !match_type(first_sig.params[i], arg_types[i], vars)) {
+            error("Mismatched types in function call,", (*iter)->first_token());
+        }
+    }
+}
+
+inline void TypeChecker::visit(IDRValue& node)
+{
+    shared_use(node.path.front(), reduction_target.empty() ? SHARED_READ : SHARED_REDUCE, reduction_target);
     //If it is not a udt member variable grab the front type
     if (node.path.size() == 1) {
-        if (!sym_table.has_str_info(node.path.front().lexeme())) {
+        if (!var_type(node.path.front().lexeme(), curr_type)) {
             error("Undeclared variable \'" + node.path.front().lexeme() + "\'", node.first_token());
         }
-        else {
-            the_name = node.path.front().lexeme();
-            sym_table.get_str_info(the_name, the_type);
-            curr_type = the_type;
-        }
     }
     else {
-        StringMap prev_type_udt;
-        string the_name;
-        string the_type;
-        the_name = node.path.front().lexeme();
+        TypeId the_type;
         //Possible error
-        if (!sym_table.has_str_info(the_name)) {
-            error("Undeclared variable \'" + the_name + "\'", node.path.front());
+        if (!var_type(node.path.front().lexeme(), the_type)) {
+            error("Undeclared variable \'" + node.path.front().lexeme() + "\'", node.path.front());
         }
-        sym_table.get_str_info(the_name, the_type);
         //ensures that we have a udt
-        if (!sym_table.has_map_info(the_type)) {
-            error("\'" + node.path.back().lexeme() + "\' not defined in \'" + the_type + "\'", node.path.front());
+        if (!is_udt(the_type)) {
+            error("\'" + node.path.back().lexeme() + "\' not defined in \'" + types.name(the_type) + "\'", node.path.front());
         }
-        sym_table.get_map_info(the_type, prev_type_udt);
         int inter = 0;
         //check path types to ensure that we aren't accessing any member variables that don't exist
-        for (Token iter : node.path) {
+        for (const Token& iter : node.path) {
             if (inter != 0 && inter < node.path.size() - 1) {
-                if (prev_type_udt.count(iter.lexeme()) > 0) {
-                    the_type = prev_type_udt[iter.lexeme()];
-                    the_name = iter.lexeme();
-                    if (sym_table.has_map_info(the_type)) {
-                        sym_table.get_map_info(the_type, prev_type_udt);
-                    }
-                    else {
+                if (types.field_type(the_type, iter.lexeme(), the_type)) {
+                    if (!is_udt(the_type)) {
                         error("variable not a user-defined type", iter);
                     }
                 }
@@ -734,22 +1157,50 @@ void TypeChecker::visit(IDRValue& node)
             }
             inter++;
         }
-        curr_type = prev_type_udt[node.path.back().lexeme()];
+        curr_type = TYPE_NONE;
+        types.field_type(the_type, node.path.back().lexeme(), curr_type);
     }
+    //Array elements
+    if (!node.indexes.empty()) {
+        curr_type = index_type(curr_type, node.indexes);
+    }
+    shared_object(node);
 }
-void TypeChecker::visit(NegatedRValue& node)
+inline void TypeChecker::visit(NegatedRValue& node)
 {
 //Ensures that negating an rvalue negates an int or double
     node.expr->accept(*this);
-    if (curr_type == "int" || curr_type == "double") {
+    if (curr_type == TYPE_INT || curr_type == TYPE_DOUBLE) {
     }
     else {
         error("improper use of negation on rvalue",node.first_token());
     }
 }
-void TypeChecker::visit(TransposedRValue& node) {
+inline void TypeChecker::visit(ArrayValue& node)
+{
+    //the element type is the first non-nil element's, and the rest must match
+    TypeId elem = TYPE_NONE;
+    for (Expr* iter : node.elements) {
+        iter->accept(*this);
+        if (curr_type == TYPE_NIL) {
+            continue;
+        }
+        if (elem == TYPE_NONE) {
+            elem = curr_type;
+        }
+        else if (curr_type != elem) {
+            error("Mismatched array element types", iter->first_token());
+        }
+    }
+    if (elem == TYPE_NONE) {
+        error("cannot infer the element type of an array of nils", node.first_brace);
+    }
+    node.elem_type = types.name(elem);
+    curr_type = types.array_of(elem);
+}
+inline void TypeChecker::visit(TransposedRValue& node) {
 node.expr->accept(*this);
-if (curr_type == "matrix") {
+if (curr_type == TYPE_MATRIX) {
 
 
 
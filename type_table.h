@@ -0,0 +1,180 @@
+//----------------------------------------------------------------------
+// FILE: type_table.h
+// DESC: Interned types for the type checker. Each distinct type name is
+//       given a small integer id the first time it is seen, so checking
+//       compares ids instead of names. Array and map types keep the ids
+//       of their element (key and value) types, and user-defined types
+//       their fields as a flat vector in declaration order.
+//       Function bodies are checked on several threads, so interning is
+//       locked and entries are kept in fixed size chunks that never move.
+//       User-defined types are only declared before the bodies are
+//       checked.
+//----------------------------------------------------------------------
+
+#ifndef TYPE_TABLE_H
+#define TYPE_TABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "mypl_exception.h"
+
+
+typedef uint32_t TypeId;
+
+// types every table starts with, in this order: TYPE_NONE (named "") is
+// the type of a missing field, and T, K, and V are the type variables of
+// built-in signatures
+enum : TypeId {TYPE_NONE, TYPE_NIL, TYPE_INT, TYPE_DOUBLE, TYPE_BOOL, TYPE_CHAR,
+               TYPE_STRING, TYPE_MATRIX, TYPE_VAR_T, TYPE_VAR_K, TYPE_VAR_V};
+
+
+class TypeTable
+{
+public:
+
+  TypeTable();
+
+  // the id of a type name (interning it and its parts if new)
+  TypeId intern(const std::string& name);
+
+  // the name of a type
+  const std::string& name(TypeId type) const {return info(type).name;}
+
+  // array<T> and map<K,V> types, and their element, key, and value types
+  bool is_array(TypeId type) const {return info(type).kind == ARRAY;}
+  bool is_map(TypeId type) const {return info(type).kind == MAP;}
+  TypeId element(TypeId type) const {return info(type).first;}
+  TypeId key(TypeId type) const {return info(type).first;}
+  TypeId value(TypeId type) const {return info(type).second;}
+  TypeId array_of(TypeId elem);
+  TypeId map_of(TypeId key, TypeId value);
+
+  // T, K, or V
+  static bool is_type_var(TypeId type) {return type >= TYPE_VAR_T and type <= TYPE_VAR_V;}
+
+  // a user-defined type's field
+  struct Field {std::string name; TypeId type;};
+
+  // declare a user-defined type with the index of its declaration in
+  // the program (its fields are added once checked)
+  void declare_udt(TypeId type, int decl) {info(type).kind = UDT; info(type).decl = decl;}
+  void set_fields(TypeId type, std::vector<Field> fields) {info(type).fields = std::move(fields);}
+  bool is_udt(TypeId type) const {return info(type).kind == UDT;}
+  int udt_decl(TypeId type) const {return info(type).decl;}
+
+  // the type of a user-defined type's field (false if there is none)
+  bool field_type(TypeId type, const std::string& field, TypeId& result) const;
+
+private:
+  enum Kind {BASIC, ARRAY, MAP, UDT};
+  struct Info
+  {
+    std::string name;
+    Kind kind;
+    TypeId first;               // element or key type
+    TypeId second;              // value type
+    std::vector<Field> fields;
+    int decl;                   // declaration index of a user-defined type
+  };
+  static constexpr size_t CHUNK_SIZE = 1024;
+  static constexpr size_t MAX_CHUNKS = 4096;
+  Info& info(TypeId type) {return chunks[type / CHUNK_SIZE][type % CHUNK_SIZE];}
+  const Info& info(TypeId type) const {return chunks[type / CHUNK_SIZE][type % CHUNK_SIZE];}
+
+  // never resized, so entries stay put while others are added
+  std::vector<std::unique_ptr<Info[]>> chunks;
+  size_t count = 0;
+  std::unordered_map<std::string,TypeId> ids;
+  mutable std::shared_mutex lock;     // guards count and ids
+};
+
+
+inline TypeTable::TypeTable()
+  : chunks(MAX_CHUNKS)
+{
+  for (const char* name : {"", "nil", "int", "double", "bool", "char", "string",
+                           "matrix", "T", "K", "V"})
+    intern(name);
+}
+
+
+inline TypeId TypeTable::intern(const std::string& name)
+{
+  {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    auto it = ids.find(name);
+    if (it != ids.end())
+      return it->second;
+  }
+  // the parts are interned first (without holding the lock)
+  Kind kind = BASIC;
+  TypeId first = TYPE_NONE;
+  TypeId second = TYPE_NONE;
+  size_t n = name.size();
+  if (n > 7 and name.compare(0, 6, "array<") == 0 and name.back() == '>') {
+    kind = ARRAY;
+    first = intern(name.substr(6, n - 7));
+  }
+  else if (n > 7 and name.compare(0, 4, "map<") == 0 and name.back() == '>') {
+    // split at the comma outside any nested <...>
+    int depth = 0;
+    for (size_t i = 4; i + 1 < n; ++i) {
+      if (name[i] == '<')
+        ++depth;
+      else if (name[i] == '>')
+        --depth;
+      else if (name[i] == ',' and depth == 0) {
+        kind = MAP;
+        first = intern(name.substr(4, i - 4));
+        second = intern(name.substr(i + 1, n - i - 2));
+        break;
+      }
+    }
+  }
+  std::lock_guard<std::shared_mutex> guard(lock);
+  // another thread may have added it in the meantime
+  auto it = ids.find(name);
+  if (it != ids.end())
+    return it->second;
+  if (count == CHUNK_SIZE * MAX_CHUNKS)
+    throw MyPLException(SEMANTIC, "too many types");
+  TypeId id = count++;
+  if (id % CHUNK_SIZE == 0)
+    chunks[id / CHUNK_SIZE].reset(new Info[CHUNK_SIZE]);
+  info(id) = Info{name, kind, first, second, {}, -1};
+  ids.emplace(name, id);
+  return id;
+}
+
+
+inline TypeId TypeTable::array_of(TypeId elem)
+{
+  return intern("array<" + name(elem) + ">");
+}
+
+
+inline TypeId TypeTable::map_of(TypeId key, TypeId value)
+{
+  return intern("map<" + name(key) + "," + name(value) + ">");
+}
+
+
+inline bool TypeTable::field_type(TypeId type, const std::string& field, TypeId& result) const
+{
+  for (const Field& f : info(type).fields) {
+    if (f.name == field) {
+      result = f.type;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+#endif